@@ -36,6 +36,7 @@
 
 #include "../Toolbox.h"
 #include "../OrthancException.h"
+#include "../Logging.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -153,21 +154,143 @@ namespace Orthanc
   }
 
 
-  HierarchicalZipWriter::HierarchicalZipWriter(const char* path)
+  HierarchicalZipWriter::HierarchicalZipWriter(const char* path) :
+    file_(new ZipWriter)
+  {
+    file_->SetOutputPath(path);
+    file_->Open();
+  }
+
+  HierarchicalZipWriter::HierarchicalZipWriter(ZipStreamWriter::IOutputStream& output) :
+    stream_(new ZipStreamWriter(output))
   {
-    writer_.SetOutputPath(path);
-    writer_.Open();
   }
 
   HierarchicalZipWriter::~HierarchicalZipWriter()
   {
-    writer_.Close();
+    if (file_.get() != NULL)
+    {
+      file_->Close();
+    }
+  }
+
+  void HierarchicalZipWriter::SetZip64(bool isZip64)
+  {
+    if (IsStreamed())
+    {
+      stream_->SetZip64(isZip64);
+    }
+    else
+    {
+      file_->SetZip64(isZip64);
+    }
+  }
+
+  bool HierarchicalZipWriter::IsZip64() const
+  {
+    return IsStreamed() ? stream_->IsZip64() : file_->IsZip64();
+  }
+
+  void HierarchicalZipWriter::SetCompressionLevel(uint8_t level)
+  {
+    if (IsStreamed())
+    {
+      stream_->SetCompressionLevel(level);
+    }
+    else
+    {
+      file_->SetCompressionLevel(level);
+    }
+  }
+
+  uint8_t HierarchicalZipWriter::GetCompressionLevel() const
+  {
+    return IsStreamed() ? stream_->GetCompressionLevel() : file_->GetCompressionLevel();
+  }
+
+  void HierarchicalZipWriter::SetAppendToExisting(bool append)
+  {
+    if (IsStreamed())
+    {
+      if (append)
+      {
+        LOG(ERROR) << "Cannot append to a streamed ZIP archive";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+    }
+    else
+    {
+      file_->SetAppendToExisting(append);
+    }
+  }
+
+  bool HierarchicalZipWriter::IsAppendToExisting() const
+  {
+    return IsStreamed() ? false : file_->IsAppendToExisting();
   }
 
   void HierarchicalZipWriter::OpenFile(const char* name)
   {
     std::string p = indexer_.OpenFile(name);
-    writer_.OpenFile(p.c_str());
+
+    if (IsStreamed())
+    {
+      stream_->OpenFile(p.c_str());
+    }
+    else
+    {
+      file_->OpenFile(p.c_str());
+    }
+  }
+
+  void HierarchicalZipWriter::WritePreparedFile(const std::string& path,
+                                                const ZipStreamWriter::PreparedFile& file)
+  {
+    if (IsStreamed())
+    {
+      stream_->WritePreparedFile(path.c_str(), file);
+    }
+    else
+    {
+      LOG(ERROR) << "Prepared files can only be written to streamed ZIP archives";
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+  void HierarchicalZipWriter::Write(const char* data, size_t length)
+  {
+    if (IsStreamed())
+    {
+      stream_->Write(data, length);
+    }
+    else
+    {
+      file_->Write(data, length);
+    }
+  }
+
+  void HierarchicalZipWriter::Write(const std::string& data)
+  {
+    if (IsStreamed())
+    {
+      stream_->Write(data);
+    }
+    else
+    {
+      file_->Write(data);
+    }
+  }
+
+  void HierarchicalZipWriter::Close()
+  {
+    if (IsStreamed())
+    {
+      stream_->Close();
+    }
+    else
+    {
+      file_->Close();
+    }
   }
 
   void HierarchicalZipWriter::OpenDirectory(const char* name)
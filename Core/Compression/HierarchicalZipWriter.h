@@ -34,9 +34,11 @@
 #pragma once
 
 #include "ZipWriter.h"
+#include "ZipStreamWriter.h"
 
 #include <map>
 #include <list>
+#include <memory>
 #include <boost/lexical_cast.hpp>
 
 #if ORTHANC_BUILD_UNIT_TESTS == 1
@@ -92,45 +94,47 @@ namespace Orthanc
     };
 
     Index indexer_;
-    ZipWriter writer_;
+    std::auto_ptr<ZipWriter>        file_;
+    std::auto_ptr<ZipStreamWriter>  stream_;
 
   public:
     HierarchicalZipWriter(const char* path);
 
+    // Streams the archive to "output" instead of writing to a file
+    HierarchicalZipWriter(ZipStreamWriter::IOutputStream& output);
+
     ~HierarchicalZipWriter();
 
-    void SetZip64(bool isZip64)
+    bool IsStreamed() const
     {
-      writer_.SetZip64(isZip64);
+      return stream_.get() != NULL;
     }
 
-    bool IsZip64() const
-    {
-      return writer_.IsZip64();
-    }
+    void SetZip64(bool isZip64);
 
-    void SetCompressionLevel(uint8_t level)
-    {
-      writer_.SetCompressionLevel(level);
-    }
+    bool IsZip64() const;
 
-    uint8_t GetCompressionLevel() const
-    {
-      return writer_.GetCompressionLevel();
-    }
+    void SetCompressionLevel(uint8_t level);
 
-    void SetAppendToExisting(bool append)
-    {
-      writer_.SetAppendToExisting(append);
-    }
+    uint8_t GetCompressionLevel() const;
+
+    void SetAppendToExisting(bool append);
     
-    bool IsAppendToExisting() const
-    {
-      return writer_.IsAppendToExisting();
-    }
+    bool IsAppendToExisting() const;
     
     void OpenFile(const char* name);
 
+    // Registers a file in the current directory, and returns its
+    // unique path in the archive, to be written later on by
+    // WritePreparedFile() (only for streamed archives)
+    std::string ReserveFile(const char* name)
+    {
+      return indexer_.OpenFile(name);
+    }
+
+    void WritePreparedFile(const std::string& path,
+                           const ZipStreamWriter::PreparedFile& file);
+
     void OpenDirectory(const char* name);
 
     void CloseDirectory();
@@ -140,14 +144,12 @@ namespace Orthanc
       return indexer_.GetCurrentDirectoryPath();
     }
 
-    void Write(const char* data, size_t length)
-    {
-      writer_.Write(data, length);
-    }
+    void Write(const char* data, size_t length);
 
-    void Write(const std::string& data)
-    {
-      writer_.Write(data);
-    }
+    void Write(const std::string& data);
+
+    // Mandatory for streamed archives, that are otherwise left
+    // truncated. Files are automatically closed by the destructor.
+    void Close();
   };
 }
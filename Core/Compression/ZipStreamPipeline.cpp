@@ -0,0 +1,336 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZipStreamPipeline.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  struct ZipStreamPipeline::Item : public boost::noncopyable
+  {
+    std::string                    path_;
+    std::auto_ptr<IFile>           file_;
+    uint8_t                        compressionLevel_;
+    State                          state_;
+    ErrorCode                      error_;
+    std::string                    content_;
+    ZipStreamWriter::PreparedFile  prepared_;
+
+    Item() :
+      compressionLevel_(0),
+      state_(State_Pending),
+      error_(ErrorCode_Success)
+    {
+    }
+  };
+
+
+  ZipStreamPipeline::Item* ZipStreamPipeline::Find(State state)
+  {
+    // The mutex must be locked. The files are processed in the order
+    // they were added, as they are written in this order.
+    for (Queue::iterator it = queue_.begin(); it != queue_.end(); ++it)
+    {
+      if ((*it)->state_ == state)
+      {
+        return *it;
+      }
+    }
+
+    return NULL;
+  }
+
+
+  void ZipStreamPipeline::ReaderThread(ZipStreamPipeline* that)
+  {
+    for (;;)
+    {
+      Item* item = NULL;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (!that->done_ &&
+               (item = that->Find(State_Pending)) == NULL)
+        {
+          that->changed_.wait(lock);
+        }
+
+        if (that->done_)
+        {
+          return;
+        }
+
+        item->state_ = State_Reading;
+      }
+
+      State next = State_Read;
+      ErrorCode error = ErrorCode_Success;
+
+      try
+      {
+        bool compress = true;
+        item->file_->Read(item->content_, compress);
+
+        if (!compress ||
+            item->compressionLevel_ == 0)
+        {
+          // Nothing to be done by the compression threads
+          item->prepared_.Prepare(item->content_, 0);
+          next = State_Ready;
+        }
+      }
+      catch (OrthancException& e)
+      {
+        error = e.GetErrorCode();
+        next = State_Failure;
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception while reading a file for a ZIP archive";
+        error = ErrorCode_InternalError;
+        next = State_Failure;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+        item->state_ = next;
+        item->error_ = error;
+      }
+
+      that->changed_.notify_all();
+    }
+  }
+
+
+  void ZipStreamPipeline::CompressionThread(ZipStreamPipeline* that)
+  {
+    for (;;)
+    {
+      Item* item = NULL;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (!that->done_ &&
+               (item = that->Find(State_Read)) == NULL)
+        {
+          that->changed_.wait(lock);
+        }
+
+        if (that->done_)
+        {
+          return;
+        }
+
+        item->state_ = State_Compressing;
+      }
+
+      State next = State_Ready;
+      ErrorCode error = ErrorCode_Success;
+
+      try
+      {
+        item->prepared_.Prepare(item->content_, item->compressionLevel_);
+      }
+      catch (OrthancException& e)
+      {
+        error = e.GetErrorCode();
+        next = State_Failure;
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception while compressing a file for a ZIP archive";
+        error = ErrorCode_InternalError;
+        next = State_Failure;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+        item->state_ = next;
+        item->error_ = error;
+      }
+
+      that->changed_.notify_all();
+    }
+  }
+
+
+  void ZipStreamPipeline::WriteNext()
+  {
+    std::auto_ptr<Item> item;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      assert(!queue_.empty());
+
+      while (queue_.front()->state_ != State_Ready &&
+             queue_.front()->state_ != State_Failure)
+      {
+        changed_.wait(lock);
+      }
+
+      item.reset(queue_.front());
+      queue_.pop_front();
+    }
+
+    if (item->state_ == State_Failure)
+    {
+      throw OrthancException(item->error_);
+    }
+
+    writer_.WritePreparedFile(item->path_, item->prepared_);
+    item->file_->Complete();
+  }
+
+
+  void ZipStreamPipeline::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_ = true;
+    }
+
+    changed_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      if (threads_[i]->joinable())
+      {
+        threads_[i]->join();
+      }
+
+      delete threads_[i];
+    }
+
+    threads_.clear();
+
+    for (Queue::iterator it = queue_.begin(); it != queue_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    queue_.clear();
+  }
+
+
+  ZipStreamPipeline::ZipStreamPipeline(HierarchicalZipWriter& writer,
+                                       unsigned int readerThreads,
+                                       unsigned int compressionThreads,
+                                       unsigned int readAhead) :
+    writer_(writer),
+    readAhead_(readAhead),
+    done_(false)
+  {
+    if (readerThreads == 0 ||
+        compressionThreads == 0 ||
+        readAhead == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!writer.IsStreamed())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    try
+    {
+      for (unsigned int i = 0; i < readerThreads; i++)
+      {
+        threads_.push_back(new boost::thread(ReaderThread, this));
+      }
+
+      for (unsigned int i = 0; i < compressionThreads; i++)
+      {
+        threads_.push_back(new boost::thread(CompressionThread, this));
+      }
+    }
+    catch (...)
+    {
+      Stop();
+      throw;
+    }
+  }
+
+
+  ZipStreamPipeline::~ZipStreamPipeline()
+  {
+    Stop();
+  }
+
+
+  void ZipStreamPipeline::AddFile(const char* name,
+                                  IFile* file)
+  {
+    std::auto_ptr<IFile> protection(file);
+
+    if (file == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    std::auto_ptr<Item> item(new Item);
+    item->path_ = writer_.ReserveFile(name);
+    item->file_ = protection;
+    item->compressionLevel_ = writer_.GetCompressionLevel();
+
+    // Only the calling thread adds or removes files from the queue
+    while (queue_.size() >= readAhead_)
+    {
+      WriteNext();
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      queue_.push_back(item.release());
+    }
+
+    changed_.notify_all();
+  }
+
+
+  void ZipStreamPipeline::Flush()
+  {
+    while (!queue_.empty())
+    {
+      WriteNext();
+    }
+  }
+}
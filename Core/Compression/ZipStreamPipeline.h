@@ -0,0 +1,130 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "HierarchicalZipWriter.h"
+#include "../Enumerations.h"
+
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Pipeline that fills a streamed ZIP archive. A pool of reader
+   * threads loads the next files in advance, a pool of compression
+   * threads deflates them in parallel, and the calling thread writes
+   * them into the archive in the order they were added. The number
+   * of files that are loaded but not written yet is bounded by the
+   * "read-ahead", which bounds the memory usage.
+   **/
+  class ZipStreamPipeline : public boost::noncopyable
+  {
+  public:
+    class IFile : public boost::noncopyable
+    {
+    public:
+      virtual ~IFile()
+      {
+      }
+
+      // Invoked by one of the reader threads. Setting "compress" to
+      // "false" stores the file without compression.
+      virtual void Read(std::string& content,
+                        bool& compress) = 0;
+
+      // Invoked by the calling thread, in order, once the file has
+      // been written into the archive
+      virtual void Complete()
+      {
+      }
+    };
+
+  private:
+    enum State
+    {
+      State_Pending,
+      State_Reading,
+      State_Read,
+      State_Compressing,
+      State_Ready,
+      State_Failure
+    };
+
+    struct Item;
+
+    typedef std::deque<Item*>  Queue;
+
+    HierarchicalZipWriter&      writer_;
+    unsigned int                readAhead_;
+    boost::mutex                mutex_;
+    boost::condition_variable   changed_;
+    bool                        done_;
+    Queue                       queue_;
+    std::vector<boost::thread*> threads_;
+
+    Item* Find(State state);
+
+    void WriteNext();
+
+    void Stop();
+
+    static void ReaderThread(ZipStreamPipeline* that);
+
+    static void CompressionThread(ZipStreamPipeline* that);
+
+  public:
+    ZipStreamPipeline(HierarchicalZipWriter& writer,
+                      unsigned int readerThreads,
+                      unsigned int compressionThreads,
+                      unsigned int readAhead);
+
+    // Files that are not written yet are discarded
+    ~ZipStreamPipeline();
+
+    // Adds a file in the current directory of the writer, with its
+    // current compression level. This blocks while the read-ahead is
+    // full, writing the files that are ready. The pipeline takes
+    // the ownership of "file".
+    void AddFile(const char* name,
+                 IFile* file);
+
+    // Waits for all the files, and writes them into the archive.
+    // The error of the first file that could not be read or
+    // compressed is thrown as an exception.
+    void Flush();
+  };
+}
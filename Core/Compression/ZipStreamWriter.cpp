@@ -0,0 +1,735 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include "ZipStreamWriter.h"
+
+#include "../OrthancException.h"
+#include "../Logging.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+#include <zlib.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+
+/**
+ * Layout of the records, as specified in Section 4.3 of the
+ * "APPNOTE.TXT - .ZIP File Format Specification".
+ * https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+ **/
+static const uint32_t SIGNATURE_LOCAL_HEADER = 0x04034b50;
+static const uint32_t SIGNATURE_DATA_DESCRIPTOR = 0x08074b50;
+static const uint32_t SIGNATURE_CENTRAL_HEADER = 0x02014b50;
+static const uint32_t SIGNATURE_ZIP64_END_RECORD = 0x06064b50;
+static const uint32_t SIGNATURE_ZIP64_END_LOCATOR = 0x07064b50;
+static const uint32_t SIGNATURE_END_RECORD = 0x06054b50;
+
+static const uint16_t VERSION_DEFAULT = 20;
+static const uint16_t VERSION_ZIP64 = 45;
+static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+static const uint16_t METHOD_STORED = 0;
+static const uint16_t METHOD_DEFLATED = 8;
+static const uint16_t EXTRA_ZIP64 = 0x0001;
+
+static const size_t BUFFER_SIZE = 64 * 1024;
+
+static const char* const COMMENT = "Created by Orthanc";
+
+
+static void WriteUInt16(std::string& target,
+                        uint16_t value)
+{
+  target.push_back(static_cast<char>(value & 0xff));
+  target.push_back(static_cast<char>((value >> 8) & 0xff));
+}
+
+
+static void WriteUInt32(std::string& target,
+                        uint32_t value)
+{
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    target.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+
+static void WriteUInt64(std::string& target,
+                        uint64_t value)
+{
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    target.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+
+static void GetDosDateTime(uint16_t& time,
+                           uint16_t& date)
+{
+  using namespace boost::posix_time;
+  ptime now = second_clock::local_time();
+
+  boost::gregorian::date today = now.date();
+  time_duration sinceMidnight = now - ptime(today);
+
+  // The MS-DOS format has a resolution of 2 seconds, and starts in 1980
+  time = static_cast<uint16_t>((sinceMidnight.hours() << 11) |
+                               (sinceMidnight.minutes() << 5) |
+                               (sinceMidnight.seconds() / 2));
+
+  int year = (today.year() < 1980 ? 0 : today.year() - 1980);
+  date = static_cast<uint16_t>((year << 9) |
+                               (today.month() << 5) |
+                               today.day());
+}
+
+
+namespace Orthanc
+{
+  struct ZipStreamWriter::PImpl
+  {
+    z_stream  stream_;
+    bool      isInitialized_;
+    int       level_;
+    char      chunk_[BUFFER_SIZE];
+
+    PImpl() : isInitialized_(false), level_(0)
+    {
+      memset(&stream_, 0, sizeof(stream_));
+    }
+
+    ~PImpl()
+    {
+      if (isInitialized_)
+      {
+        deflateEnd(&stream_);
+      }
+    }
+
+    void Prepare(uint8_t level)
+    {
+      if (isInitialized_ &&
+          level_ == level)
+      {
+        if (deflateReset(&stream_) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+      else
+      {
+        if (isInitialized_)
+        {
+          deflateEnd(&stream_);
+          isInitialized_ = false;
+        }
+
+        memset(&stream_, 0, sizeof(stream_));
+
+        // A negative window size produces the raw deflate stream
+        // that is expected by the ZIP format (without zlib header)
+        if (deflateInit2(&stream_, level, Z_DEFLATED, -MAX_WBITS,
+                         8 /* default memory level */, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+
+        isInitialized_ = true;
+        level_ = level;
+      }
+    }
+  };
+
+
+  ZipStreamWriter::PreparedFile::PreparedFile() :
+    method_(METHOD_STORED),
+    crc32_(crc32(0L, Z_NULL, 0)),
+    uncompressedSize_(0)
+  {
+  }
+
+
+  void ZipStreamWriter::PreparedFile::Prepare(std::string& content,
+                                              uint8_t compressionLevel)
+  {
+    if (compressionLevel >= 10)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    // Both "crc32()" and "deflate()" take "uInt" sizes
+    static const size_t MAX_STEP = std::numeric_limits<int32_t>::max();
+
+    uncompressedSize_ = content.size();
+    crc32_ = crc32(0L, Z_NULL, 0);
+
+    for (size_t pos = 0; pos < content.size(); pos += MAX_STEP)
+    {
+      size_t step = std::min(MAX_STEP, content.size() - pos);
+      crc32_ = crc32(crc32_, reinterpret_cast<const Bytef*>(content.c_str() + pos),
+                     static_cast<uInt>(step));
+    }
+
+    if (compressionLevel == 0 ||
+        content.empty())
+    {
+      method_ = METHOD_STORED;
+      data_.swap(content);
+      content.clear();
+      return;
+    }
+
+    PImpl compressor;
+    compressor.Prepare(compressionLevel);
+    z_stream& stream = compressor.stream_;
+
+    data_.resize(static_cast<size_t>(deflateBound(&stream, content.size())));
+
+    size_t pos = 0;
+    size_t produced = 0;
+    int error;
+
+    do
+    {
+      size_t step = std::min(MAX_STEP, content.size() - pos);
+      bool finish = (pos + step == content.size());
+
+      size_t available = std::min(MAX_STEP, data_.size() - produced);
+
+      stream.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(content.c_str() + pos));
+      stream.avail_in = static_cast<uInt>(step);
+      stream.next_out = reinterpret_cast<Bytef*>(&data_[produced]);
+      stream.avail_out = static_cast<uInt>(available);
+
+      error = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (error != Z_OK &&
+          error != Z_STREAM_END)
+      {
+        LOG(ERROR) << "Error while compressing a file of a ZIP archive: " << error;
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      pos += step - stream.avail_in;
+      produced += available - stream.avail_out;
+    }
+    while (error != Z_STREAM_END);
+
+    data_.resize(produced);
+
+    if (data_.size() >= content.size())
+    {
+      // Not compressible: Store the file as such
+      method_ = METHOD_STORED;
+      data_.swap(content);
+    }
+    else
+    {
+      method_ = METHOD_DEFLATED;
+    }
+
+    content.clear();
+  }
+
+
+  void ZipStreamWriter::Emit(const void* data,
+                             size_t size)
+  {
+    if (size == 0)
+    {
+      return;
+    }
+
+    isStarted_ = true;
+
+    if (buffer_.size() + size > BUFFER_SIZE)
+    {
+      Flush();
+    }
+
+    if (size >= BUFFER_SIZE)
+    {
+      // Large blocks are directly sent, without copy
+      output_.Write(data, size);
+    }
+    else
+    {
+      buffer_.append(reinterpret_cast<const char*>(data), size);
+    }
+
+    position_ += size;
+  }
+
+
+  void ZipStreamWriter::Flush()
+  {
+    if (!buffer_.empty())
+    {
+      output_.Write(buffer_.c_str(), buffer_.size());
+      buffer_.clear();
+    }
+  }
+
+
+  void ZipStreamWriter::Deflate(const void* data,
+                                size_t size,
+                                bool finish)
+  {
+    z_stream& stream = pimpl_->stream_;
+
+    // "size" is at most "uInt" large, which is checked by the caller
+    stream.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+
+    for (;;)
+    {
+      stream.next_out = reinterpret_cast<Bytef*>(pimpl_->chunk_);
+      stream.avail_out = BUFFER_SIZE;
+
+      int error = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (error != Z_OK &&
+          error != Z_STREAM_END &&
+          error != Z_BUF_ERROR)
+      {
+        LOG(ERROR) << "Error while compressing a file of a ZIP archive: " << error;
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      size_t produced = BUFFER_SIZE - stream.avail_out;
+      Emit(pimpl_->chunk_, produced);
+      current_.compressedSize_ += produced;
+
+      if (finish ? 
+          error == Z_STREAM_END :
+          (stream.avail_in == 0 && stream.avail_out != 0))
+      {
+        return;
+      }
+    }
+  }
+
+
+  void ZipStreamWriter::FinishFile()
+  {
+    if (!isZip64_ &&
+        (current_.compressedSize_ > 0xffffffffu ||
+         current_.uncompressedSize_ > 0xffffffffu))
+    {
+      LOG(ERROR) << "File too large for a ZIP archive without ZIP64: " << current_.path_;
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    if (current_.flags_ & FLAG_DATA_DESCRIPTOR)
+    {
+      std::string descriptor;
+      WriteUInt32(descriptor, SIGNATURE_DATA_DESCRIPTOR);
+      WriteUInt32(descriptor, current_.crc32_);
+
+      if (isZip64_)
+      {
+        WriteUInt64(descriptor, current_.compressedSize_);
+        WriteUInt64(descriptor, current_.uncompressedSize_);
+      }
+      else
+      {
+        WriteUInt32(descriptor, static_cast<uint32_t>(current_.compressedSize_));
+        WriteUInt32(descriptor, static_cast<uint32_t>(current_.uncompressedSize_));
+      }
+
+      Emit(descriptor);
+    }
+
+    entries_.push_back(current_);
+    hasFileInZip_ = false;
+  }
+
+
+  void ZipStreamWriter::CloseFile()
+  {
+    if (hasFileInZip_)
+    {
+      if (current_.method_ == METHOD_DEFLATED)
+      {
+        Deflate(NULL, 0, true);
+      }
+
+      FinishFile();
+    }
+  }
+
+
+  ZipStreamWriter::ZipStreamWriter(IOutputStream& output) :
+    pimpl_(new PImpl),
+    output_(output),
+    isZip64_(false),
+    isStarted_(false),
+    isClosed_(false),
+    hasFileInZip_(false),
+    compressionLevel_(6),
+    position_(0)
+  {
+    buffer_.reserve(BUFFER_SIZE);
+  }
+
+
+  ZipStreamWriter::~ZipStreamWriter()
+  {
+    if (!isClosed_ &&
+        isStarted_)
+    {
+      LOG(WARNING) << "A streamed ZIP archive was not closed, it is left truncated";
+    }
+  }
+
+
+  void ZipStreamWriter::SetZip64(bool isZip64)
+  {
+    if (isStarted_)
+    {
+      LOG(ERROR) << "ZIP64 must be chosen before writing the first file of a streamed ZIP archive";
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    isZip64_ = isZip64;
+  }
+
+
+  void ZipStreamWriter::SetCompressionLevel(uint8_t level)
+  {
+    if (level >= 10)
+    {
+      LOG(ERROR) << "ZIP compression level must be between 0 (no compression) and 9 (highest compression)";
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    compressionLevel_ = level;
+  }
+
+
+  void ZipStreamWriter::StartFile(const char* path,
+                                  const PreparedFile* prepared)
+  {
+    if (isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    CloseFile();
+
+    size_t length = strlen(path);
+    if (length > 0xffffu)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!isZip64_ &&
+        (entries_.size() >= 0xffffu ||
+         position_ > 0xffffffffu))
+    {
+      LOG(ERROR) << "Too many files or too much data for a ZIP archive without ZIP64";
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    current_.path_.assign(path, length);
+    current_.offset_ = position_;
+    GetDosDateTime(current_.time_, current_.date_);
+
+    if (prepared == NULL)
+    {
+      // The CRC and the sizes are unknown at this point: They are
+      // set to zero, and will be provided by the data descriptor
+      current_.flags_ = FLAG_DATA_DESCRIPTOR;
+      current_.method_ = (compressionLevel_ == 0 ? METHOD_STORED : METHOD_DEFLATED);
+      current_.crc32_ = crc32(0L, Z_NULL, 0);
+      current_.compressedSize_ = 0;
+      current_.uncompressedSize_ = 0;
+    }
+    else
+    {
+      current_.flags_ = 0;
+      current_.method_ = prepared->method_;
+      current_.crc32_ = prepared->crc32_;
+      current_.compressedSize_ = prepared->data_.size();
+      current_.uncompressedSize_ = prepared->uncompressedSize_;
+    }
+
+    // With ZIP64, the sizes are redirected to the ZIP64 extra field,
+    // which also announces a data descriptor with 8-byte sizes
+    std::string header;
+    WriteUInt32(header, SIGNATURE_LOCAL_HEADER);
+    WriteUInt16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);
+    WriteUInt16(header, current_.flags_);
+    WriteUInt16(header, current_.method_);
+    WriteUInt16(header, current_.time_);
+    WriteUInt16(header, current_.date_);
+
+    if (prepared == NULL)
+    {
+      WriteUInt32(header, 0);
+    }
+    else
+    {
+      WriteUInt32(header, current_.crc32_);
+    }
+
+    if (isZip64_)
+    {
+      WriteUInt32(header, 0xffffffffu);
+      WriteUInt32(header, 0xffffffffu);
+    }
+    else if (prepared == NULL)
+    {
+      WriteUInt32(header, 0);
+      WriteUInt32(header, 0);
+    }
+    else
+    {
+      // Files larger than 4GB are rejected by FinishFile()
+      WriteUInt32(header, static_cast<uint32_t>(current_.compressedSize_));
+      WriteUInt32(header, static_cast<uint32_t>(current_.uncompressedSize_));
+    }
+
+    WriteUInt16(header, static_cast<uint16_t>(length));
+    WriteUInt16(header, isZip64_ ? 20 : 0);  // Length of the extra field
+    header += current_.path_;
+
+    if (isZip64_)
+    {
+      WriteUInt16(header, EXTRA_ZIP64);
+      WriteUInt16(header, 16);
+      WriteUInt64(header, prepared == NULL ? 0 : current_.uncompressedSize_);
+      WriteUInt64(header, prepared == NULL ? 0 : current_.compressedSize_);
+    }
+
+    Emit(header);
+
+    hasFileInZip_ = true;
+  }
+
+
+  void ZipStreamWriter::OpenFile(const char* path)
+  {
+    StartFile(path, NULL);
+
+    if (current_.method_ == METHOD_DEFLATED)
+    {
+      pimpl_->Prepare(compressionLevel_);
+    }
+  }
+
+
+  void ZipStreamWriter::WritePreparedFile(const char* path,
+                                          const PreparedFile& file)
+  {
+    if (!isZip64_ &&
+        (file.data_.size() > 0xffffffffu ||
+         file.uncompressedSize_ > 0xffffffffu))
+    {
+      LOG(ERROR) << "File too large for a ZIP archive without ZIP64: " << path;
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    StartFile(path, &file);
+    Emit(file.data_.empty() ? NULL : file.data_.c_str(), file.data_.size());
+    FinishFile();
+  }
+
+
+  void ZipStreamWriter::Write(const std::string& data)
+  {
+    if (data.size())
+    {
+      Write(&data[0], data.size());
+    }
+  }
+
+
+  void ZipStreamWriter::Write(const char* data, size_t length)
+  {
+    if (!hasFileInZip_)
+    {
+      LOG(ERROR) << "Call first OpenFile()";
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // Both "crc32()" and "deflate()" take "uInt" sizes
+    const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
+
+    while (length > 0)
+    {
+      size_t bytes = (length <= maxBytesInAStep ? length : maxBytesInAStep);
+
+      current_.crc32_ = crc32(current_.crc32_, reinterpret_cast<const Bytef*>(data),
+                              static_cast<uInt>(bytes));
+      current_.uncompressedSize_ += bytes;
+
+      if (current_.method_ == METHOD_DEFLATED)
+      {
+        Deflate(data, bytes, false);
+      }
+      else
+      {
+        Emit(data, bytes);
+        current_.compressedSize_ += bytes;
+      }
+
+      data += bytes;
+      length -= bytes;
+    }
+  }
+
+
+  void ZipStreamWriter::Close()
+  {
+    if (isClosed_)
+    {
+      return;
+    }
+
+    CloseFile();
+
+    const uint64_t centralDirectoryOffset = position_;
+
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+      const Entry& entry = entries_[i];
+
+      std::string header;
+      WriteUInt32(header, SIGNATURE_CENTRAL_HEADER);
+      WriteUInt16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);  // Made by MS-DOS
+      WriteUInt16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);
+      WriteUInt16(header, entry.flags_);
+      WriteUInt16(header, entry.method_);
+      WriteUInt16(header, entry.time_);
+      WriteUInt16(header, entry.date_);
+      WriteUInt32(header, entry.crc32_);
+
+      if (isZip64_)
+      {
+        WriteUInt32(header, 0xffffffffu);
+        WriteUInt32(header, 0xffffffffu);
+      }
+      else
+      {
+        WriteUInt32(header, static_cast<uint32_t>(entry.compressedSize_));
+        WriteUInt32(header, static_cast<uint32_t>(entry.uncompressedSize_));
+      }
+
+      WriteUInt16(header, static_cast<uint16_t>(entry.path_.size()));
+      WriteUInt16(header, isZip64_ ? 28 : 0);  // Length of the extra field
+      WriteUInt16(header, 0);  // Length of the comment
+      WriteUInt16(header, 0);  // Disk number
+      WriteUInt16(header, 0);  // Internal attributes
+      WriteUInt32(header, 0);  // External attributes
+      WriteUInt32(header, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(entry.offset_));
+      header += entry.path_;
+
+      if (isZip64_)
+      {
+        WriteUInt16(header, EXTRA_ZIP64);
+        WriteUInt16(header, 24);
+        WriteUInt64(header, entry.uncompressedSize_);
+        WriteUInt64(header, entry.compressedSize_);
+        WriteUInt64(header, entry.offset_);
+      }
+
+      Emit(header);
+    }
+
+    const uint64_t centralDirectorySize = position_ - centralDirectoryOffset;
+
+    std::string end;
+
+    if (isZip64_)
+    {
+      const uint64_t zip64EndOffset = position_;
+
+      WriteUInt32(end, SIGNATURE_ZIP64_END_RECORD);
+      WriteUInt64(end, 44);  // Size of the remaining of this record
+      WriteUInt16(end, VERSION_ZIP64);
+      WriteUInt16(end, VERSION_ZIP64);
+      WriteUInt32(end, 0);   // Number of this disk
+      WriteUInt32(end, 0);   // Disk with the central directory
+      WriteUInt64(end, entries_.size());
+      WriteUInt64(end, entries_.size());
+      WriteUInt64(end, centralDirectorySize);
+      WriteUInt64(end, centralDirectoryOffset);
+
+      WriteUInt32(end, SIGNATURE_ZIP64_END_LOCATOR);
+      WriteUInt32(end, 0);   // Disk with the ZIP64 end record
+      WriteUInt64(end, zip64EndOffset);
+      WriteUInt32(end, 1);   // Total number of disks
+
+      WriteUInt32(end, SIGNATURE_END_RECORD);
+      WriteUInt16(end, 0);
+      WriteUInt16(end, 0);
+      WriteUInt16(end, 0xffffu);
+      WriteUInt16(end, 0xffffu);
+      WriteUInt32(end, 0xffffffffu);
+      WriteUInt32(end, 0xffffffffu);
+    }
+    else
+    {
+      if (centralDirectoryOffset + centralDirectorySize > 0xffffffffu)
+      {
+        LOG(ERROR) << "Too much data for a ZIP archive without ZIP64";
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+
+      WriteUInt32(end, SIGNATURE_END_RECORD);
+      WriteUInt16(end, 0);   // Number of this disk
+      WriteUInt16(end, 0);   // Disk with the central directory
+      WriteUInt16(end, static_cast<uint16_t>(entries_.size()));
+      WriteUInt16(end, static_cast<uint16_t>(entries_.size()));
+      WriteUInt32(end, static_cast<uint32_t>(centralDirectorySize));
+      WriteUInt32(end, static_cast<uint32_t>(centralDirectoryOffset));
+    }
+
+    WriteUInt16(end, static_cast<uint16_t>(strlen(COMMENT)));
+    end += COMMENT;
+
+    Emit(end);
+    Flush();
+
+    entries_.clear();
+    isClosed_ = true;
+  }
+}
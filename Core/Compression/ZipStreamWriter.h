@@ -0,0 +1,212 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if !defined(ORTHANC_ENABLE_ZLIB)
+#  error The macro ORTHANC_ENABLE_ZLIB must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZLIB != 1
+#  error ZLIB support must be enabled to include this file
+#endif
+
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Writer of ZIP archives that never seeks in its output, so that
+   * the archive can be sent to a socket while it is being built. The
+   * CRC and the sizes of each file are only known once its content
+   * has been written, so they are stored in a data descriptor
+   * following the content (bit 3 of the general purpose flags), and
+   * in the central directory that is kept in memory until Close().
+   *
+   * As the local headers cannot be patched afterwards, ZIP64 must be
+   * chosen before the first file is opened. If Close() is not called
+   * (e.g. because of an exception), the archive is left truncated,
+   * which lets the client detect the failure.
+   **/
+  class ZipStreamWriter : public boost::noncopyable
+  {
+  public:
+    class IOutputStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IOutputStream()
+      {
+      }
+
+      virtual void Write(const void* data,
+                         size_t size) = 0;
+    };
+
+
+    /**
+     * Content of a file that is compressed ahead of time, possibly
+     * by another thread, and that is then written at once by
+     * WritePreparedFile(). As its CRC and its sizes are known, its
+     * local header does not need a data descriptor.
+     **/
+    class PreparedFile : public boost::noncopyable
+    {
+      friend class ZipStreamWriter;
+
+    private:
+      std::string  data_;
+      uint16_t     method_;
+      uint32_t     crc32_;
+      uint64_t     uncompressedSize_;
+
+    public:
+      PreparedFile();
+
+      // The "content" is consumed. Level 0 stores the file as such.
+      void Prepare(std::string& content,
+                   uint8_t compressionLevel);
+
+      uint64_t GetUncompressedSize() const
+      {
+        return uncompressedSize_;
+      }
+
+      uint64_t GetCompressedSize() const
+      {
+        return data_.size();
+      }
+    };
+
+  private:
+    struct PImpl;
+
+    struct Entry
+    {
+      std::string  path_;
+      uint16_t     flags_;
+      uint16_t     method_;
+      uint16_t     time_;
+      uint16_t     date_;
+      uint32_t     crc32_;
+      uint64_t     compressedSize_;
+      uint64_t     uncompressedSize_;
+      uint64_t     offset_;
+    };
+
+    boost::shared_ptr<PImpl> pimpl_;
+    IOutputStream&      output_;
+    bool                isZip64_;
+    bool                isStarted_;
+    bool                isClosed_;
+    bool                hasFileInZip_;
+    uint8_t             compressionLevel_;
+    uint64_t            position_;
+    std::vector<Entry>  entries_;
+    Entry               current_;
+    std::string         buffer_;
+
+    void Emit(const void* data,
+              size_t size);
+
+    void Emit(const std::string& data)
+    {
+      if (!data.empty())
+      {
+        Emit(data.c_str(), data.size());
+      }
+    }
+
+    void Flush();
+
+    void Deflate(const void* data,
+                 size_t size,
+                 bool finish);
+
+    void StartFile(const char* path,
+                   const PreparedFile* prepared);
+
+    void FinishFile();
+
+    void CloseFile();
+
+  public:
+    ZipStreamWriter(IOutputStream& output);
+
+    ~ZipStreamWriter();
+
+    void SetZip64(bool isZip64);
+
+    bool IsZip64() const
+    {
+      return isZip64_;
+    }
+
+    // Applies to the files that are opened afterwards. Level 0
+    // stores the files without compression.
+    void SetCompressionLevel(uint8_t level);
+
+    uint8_t GetCompressionLevel() const
+    {
+      return compressionLevel_;
+    }
+
+    void OpenFile(const char* path);
+
+    void Write(const char* data, size_t length);
+
+    void Write(const std::string& data);
+
+    void WritePreparedFile(const char* path,
+                           const PreparedFile& file);
+
+    // Writes the central directory, then flushes the output
+    void Close();
+
+    bool IsClosed() const
+    {
+      return isClosed_;
+    }
+
+    // Number of bytes of the archive that have been produced so far
+    uint64_t GetPosition() const
+    {
+      return position_;
+    }
+  };
+}
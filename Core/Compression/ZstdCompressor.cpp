@@ -0,0 +1,137 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZstdCompressor.h"
+
+#include "../OrthancException.h"
+#include "../Logging.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <zstd.h>
+
+namespace Orthanc
+{
+  void ZstdCompressor::SetCompressionLevel(int level)
+  {
+    if (level < 1 ||
+        level > ZSTD_maxCLevel())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    compressionLevel_ = level;
+  }
+
+
+  void ZstdCompressor::Compress(std::string& compressed,
+                                const void* uncompressed,
+                                size_t uncompressedSize)
+  {
+    if (uncompressedSize == 0)
+    {
+      compressed.clear();
+      return;
+    }
+
+    size_t bound = ZSTD_compressBound(uncompressedSize);
+    compressed.resize(sizeof(uint64_t) + bound);
+
+    size_t size = ZSTD_compress(&compressed[0] + sizeof(uint64_t), bound,
+                                uncompressed, uncompressedSize, compressionLevel_);
+
+    if (ZSTD_isError(size))
+    {
+      LOG(ERROR) << "Error in Zstandard compression: " << ZSTD_getErrorName(size);
+      compressed.clear();
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    uint64_t s = static_cast<uint64_t>(uncompressedSize);
+    memcpy(&compressed[0], &s, sizeof(uint64_t));
+    compressed.resize(sizeof(uint64_t) + size);
+  }
+
+
+  void ZstdCompressor::Uncompress(std::string& uncompressed,
+                                  const void* compressed,
+                                  size_t compressedSize)
+  {
+    if (compressedSize == 0)
+    {
+      uncompressed.clear();
+      return;
+    }
+
+    if (compressedSize < sizeof(uint64_t))
+    {
+      LOG(ERROR) << "The compressed buffer is ill-formed";
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    uint64_t uncompressedSize;
+    memcpy(&uncompressedSize, compressed, sizeof(uint64_t));
+
+    if (static_cast<uint64_t>(static_cast<size_t>(uncompressedSize)) != uncompressedSize)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    try
+    {
+      uncompressed.resize(static_cast<size_t>(uncompressedSize));
+    }
+    catch (...)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    if (uncompressedSize == 0)
+    {
+      return;
+    }
+
+    size_t size = ZSTD_decompress(&uncompressed[0], uncompressed.size(),
+                                  reinterpret_cast<const uint8_t*>(compressed) + sizeof(uint64_t),
+                                  compressedSize - sizeof(uint64_t));
+
+    if (ZSTD_isError(size) ||
+        size != uncompressed.size())
+    {
+      uncompressed.clear();
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+}
@@ -34,6 +34,7 @@
 #pragma once
 
 #include "../../Core/DicomFormat/DicomMap.h"
+#include "../../Core/OrthancException.h"
 
 #include <vector>
 #include <string>
@@ -54,5 +55,28 @@ namespace Orthanc
                         const std::string& remoteIp,
                         const std::string& remoteAet,
                         const std::string& calledAet) = 0;
+
+    /**
+     * Bit-preserving reception: If this method returns "true", the
+     * incoming dataset is written as is to the file "path" (together
+     * with its meta-header) while it is received, instead of being
+     * decoded in memory. The file is then given to "HandleFile()",
+     * that may move it elsewhere. The file is removed afterwards if
+     * it still exists.
+     **/
+    virtual bool CreateTemporaryFile(std::string& path)
+    {
+      return false;
+    }
+
+    virtual void HandleFile(const std::string& path,
+                            const DicomMap& dicomSummary,
+                            const Json::Value& dicomJson,
+                            const std::string& remoteIp,
+                            const std::string& remoteAet,
+                            const std::string& calledAet)
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
   };
 }
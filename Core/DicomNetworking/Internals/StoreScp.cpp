@@ -87,6 +87,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../DicomParsing/ToDcmtkBridge.h"
 #include "../../OrthancException.h"
 #include "../../Logging.h"
+#include "../../SystemToolbox.h"
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcmetinf.h>
@@ -108,8 +109,104 @@ namespace Orthanc
       const char* modality;
       const char* affectedSOPInstanceUID;
       uint32_t messageID;
+      const std::string* bitPreservingPath;   // NULL if the dataset is received in memory
     };
 
+
+    static void CheckSOPClassAndInstance(DcmDataset& dataset,
+                                         T_DIMSE_C_StoreRQ *req,
+                                         T_DIMSE_C_StoreRSP *rsp)
+    {
+      // check the image to make sure it is consistent, i.e. that its sopClass and sopInstance correspond
+      // to those mentioned in the request. If not, set the status in the response message variable.
+      DIC_UI sopClass;
+      DIC_UI sopInstance;
+
+      // which SOP class and SOP instance ?
+      if (!DU_findSOPClassAndInstanceInDataSet(&dataset, sopClass, sopInstance, /*opt_correctUIDPadding*/ OFFalse))
+      {
+        //LOG4CPP_ERROR(Internals::GetLogger(), "bad DICOM file: " << fileName);
+        rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+      }
+      else if (strcmp(sopClass, req->AffectedSOPClassUID) != 0)
+      {
+        rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+      }
+      else if (strcmp(sopInstance, req->AffectedSOPInstanceUID) != 0)
+      {
+        rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+      }
+    }
+
+
+    static void SignalStoreError(OrthancException& e,
+                                 const DicomMap& summary,
+                                 T_DIMSE_C_StoreRSP *rsp)
+    {
+      rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+
+      if (e.GetErrorCode() == ErrorCode_InexistentTag)
+      {
+        summary.LogMissingTagsForStore();
+      }
+      else
+      {
+        LOG(ERROR) << "Exception while storing DICOM: " << e.What();
+      }
+    }
+
+
+    static void StoreBitPreserving(StoreCallbackData& cbdata,
+                                   T_DIMSE_C_StoreRQ *req,
+                                   T_DIMSE_C_StoreRSP *rsp)
+    {
+      const std::string& path = *cbdata.bitPreservingPath;
+
+      DicomMap summary;
+      Json::Value dicomJson;
+
+      {
+        // Only parse the header of the received file: The values that
+        // are larger than "DCM_MaxReadLength" (such as the pixel data)
+        // are not loaded into memory
+        DcmFileFormat dicom;
+        if (!dicom.loadFile(path.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength).good())
+        {
+          LOG(ERROR) << "Cannot parse the received DICOM file: " << path;
+          rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+          return;
+        }
+
+        try
+        {
+          std::set<DicomTag> ignoreTagLength;
+          FromDcmtkBridge::ExtractDicomSummary(summary, *dicom.getDataset());
+          FromDcmtkBridge::ExtractDicomAsJson(dicomJson, *dicom.getDataset(), ignoreTagLength);
+        }
+        catch (...)
+        {
+          rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+          return;
+        }
+
+        CheckSOPClassAndInstance(*dicom.getDataset(), req, rsp);
+
+        // The file is closed at this point, before being moved
+      }
+
+      if (rsp->DimseStatus == STATUS_Success)
+      {
+        try
+        {
+          cbdata.handler->HandleFile(path, summary, dicomJson, *cbdata.remoteIp, cbdata.remoteAET, cbdata.calledAET);
+        }
+        catch (OrthancException& e)
+        {
+          SignalStoreError(e, summary, rsp);
+        }
+      }
+    }
+
     
     static void
     storeScpCallback(
@@ -140,9 +237,6 @@ namespace Orthanc
     {
       StoreCallbackData *cbdata = OFstatic_cast(StoreCallbackData *, callbackData);
 
-      DIC_UI sopClass;
-      DIC_UI sopInstance;
-
       // if this is the final call of this function, save the data which was received to a file
       // (note that we could also save the image somewhere else, put it in database, etc.)
       if (progress->state == DIMSE_StoreEnd)
@@ -157,9 +251,18 @@ namespace Orthanc
         // then the status will reflect this.  The callback function is still called to allow cleanup.
         //rsp->DimseStatus = STATUS_Success;
 
+        if (cbdata->bitPreservingPath != NULL)
+        {
+          // The dataset was directly written to the file by DCMTK
+          if (rsp->DimseStatus == STATUS_Success)
+          {
+            StoreBitPreserving(*cbdata, req, rsp);
+          }
+        }
+
         // we want to write the received information to a file only if this information
         // is present and the options opt_bitPreserving and opt_ignore are not set.
-        if ((imageDataSet != NULL) && (*imageDataSet != NULL))
+        else if ((imageDataSet != NULL) && (*imageDataSet != NULL))
         {
           DicomMap summary;
           Json::Value dicomJson;
@@ -183,43 +286,20 @@ namespace Orthanc
             rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
           }
 
-          // check the image to make sure it is consistent, i.e. that its sopClass and sopInstance correspond
-          // to those mentioned in the request. If not, set the status in the response message variable.
           if (rsp->DimseStatus == STATUS_Success)
           {
-            // which SOP class and SOP instance ?
-            if (!DU_findSOPClassAndInstanceInDataSet(*imageDataSet, sopClass, sopInstance, /*opt_correctUIDPadding*/ OFFalse))
-            {
-              //LOG4CPP_ERROR(Internals::GetLogger(), "bad DICOM file: " << fileName);
-              rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
-            }
-            else if (strcmp(sopClass, req->AffectedSOPClassUID) != 0)
-            {
-              rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
-            }
-            else if (strcmp(sopInstance, req->AffectedSOPInstanceUID) != 0)
+            CheckSOPClassAndInstance(**imageDataSet, req, rsp);
+          }
+
+          if (rsp->DimseStatus == STATUS_Success)
+          {
+            try
             {
-              rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+              cbdata->handler->Handle(buffer, summary, dicomJson, *cbdata->remoteIp, cbdata->remoteAET, cbdata->calledAET);
             }
-            else
+            catch (OrthancException& e)
             {
-              try
-              {
-                cbdata->handler->Handle(buffer, summary, dicomJson, *cbdata->remoteIp, cbdata->remoteAET, cbdata->calledAET);
-              }
-              catch (OrthancException& e)
-              {
-                rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
-
-                if (e.GetErrorCode() == ErrorCode_InexistentTag)
-                {
-                  summary.LogMissingTagsForStore();
-                }
-                else
-                {
-                  LOG(ERROR) << "Exception while storing DICOM: " << e.What();
-                }
-              }
+              SignalStoreError(e, summary, rsp);
             }
           }
         }
@@ -259,6 +339,10 @@ namespace Orthanc
 
     data.affectedSOPInstanceUID = req->AffectedSOPInstanceUID;
     data.messageID = req->MessageID;
+
+    std::string bitPreservingPath;
+    bool bitPreserving = handler.CreateTemporaryFile(bitPreservingPath);
+    data.bitPreservingPath = (bitPreserving ? &bitPreservingPath : NULL);
     if (assoc && assoc->params)
     {
       data.remoteAET = assoc->params->DULparams.callingAPTitle;
@@ -282,11 +366,29 @@ namespace Orthanc
     // define an address where the information which will be received over the network will be stored
     DcmDataset *dset = dcmff.getDataset();
 
-    cond = DIMSE_storeProvider(assoc, presID, req, NULL, /*opt_useMetaheader*/OFFalse, &dset,
+    // In bit-preserving mode, DCMTK writes the received dataset
+    // together with a meta-header to the file, without decoding it
+    cond = DIMSE_storeProvider(assoc, presID, req, 
+                               bitPreserving ? bitPreservingPath.c_str() : NULL, 
+                               /*opt_useMetaheader*/ bitPreserving ? OFTrue : OFFalse, &dset,
                                storeScpCallback, &data, 
                                /*opt_blockMode*/ DIMSE_BLOCKING, 
                                /*opt_dimse_timeout*/ 0);
 
+    if (bitPreserving &&
+        SystemToolbox::IsRegularFile(bitPreservingPath))
+    {
+      // The file was not moved to the storage area
+      try
+      {
+        SystemToolbox::RemoveFile(bitPreservingPath);
+      }
+      catch (OrthancException&)
+      {
+        LOG(ERROR) << "Cannot remove the temporary file: " << bitPreservingPath;
+      }
+    }
+
     // if some error occured, dump corresponding information and remove the outfile if necessary
     if (cond.bad())
     {
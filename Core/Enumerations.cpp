@@ -878,6 +878,28 @@ namespace Orthanc
   }
 
 
+  const char* EnumerationToString(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_None:
+        return "None";
+
+      case CompressionType_ZlibWithSize:
+        return "Zlib";
+
+      case CompressionType_Lz4WithSize:
+        return "Lz4";
+
+      case CompressionType_ZstdWithSize:
+        return "Zstd";
+
+      default: 
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   const char* EnumerationToString(ValueRepresentation vr)
   {
     switch (vr)
@@ -1433,6 +1455,31 @@ namespace Orthanc
   }
 
 
+  CompressionType StringToCompressionType(const std::string& compression)
+  {
+    if (compression == "None")
+    {
+      return CompressionType_None;
+    }
+    else if (compression == "Zlib")
+    {
+      return CompressionType_ZlibWithSize;
+    }
+    else if (compression == "Lz4")
+    {
+      return CompressionType_Lz4WithSize;
+    }
+    else if (compression == "Zstd")
+    {
+      return CompressionType_ZstdWithSize;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   unsigned int GetBytesPerPixel(PixelFormat format)
   {
     switch (format)
@@ -567,7 +567,24 @@ namespace Orthanc
      * buffer is non-empty, the buffer is compatible with the
      * "deflate" HTTP compression.
      **/
-    CompressionType_ZlibWithSize = 2
+    CompressionType_ZlibWithSize = 2,
+
+    /**
+     * Buffer that is compressed using the LZ4 block format, prefixed
+     * with a "uint64_t" (8 bytes) that encodes the size of the
+     * uncompressed buffer. If the compressed buffer is empty, its
+     * represents an empty uncompressed buffer. This format is
+     * internal to Orthanc.
+     **/
+    CompressionType_Lz4WithSize = 3,
+
+    /**
+     * Buffer that is compressed using Zstandard, prefixed with a
+     * "uint64_t" (8 bytes) that encodes the size of the uncompressed
+     * buffer. If the compressed buffer is empty, its represents an
+     * empty uncompressed buffer. This format is internal to Orthanc.
+     **/
+    CompressionType_ZstdWithSize = 4
   };
 
   enum FileContentType
@@ -622,6 +639,8 @@ namespace Orthanc
 
   const char* EnumerationToString(ValueRepresentation vr);
 
+  const char* EnumerationToString(CompressionType compression);
+
   Encoding StringToEncoding(const char* encoding);
 
   ResourceType StringToResourceType(const char* type);
@@ -638,6 +657,8 @@ namespace Orthanc
   ModalityManufacturer StringToModalityManufacturer(const std::string& manufacturer);
 
   DicomVersion StringToDicomVersion(const std::string& version);
+
+  CompressionType StringToCompressionType(const std::string& compression);
   
   unsigned int GetBytesPerPixel(PixelFormat format);
 
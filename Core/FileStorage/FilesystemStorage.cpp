@@ -110,14 +110,8 @@ namespace Orthanc
   }
 
 
-  void FilesystemStorage::Create(const std::string& uuid,
-                                 const void* content, 
-                                 size_t size,
-                                 FileContentType type)
+  boost::filesystem::path FilesystemStorage::PrepareCreation(const std::string& uuid) const
   {
-    LOG(INFO) << "Creating attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
-              << "\" type (size: " << (size / (1024 * 1024) + 1) << "MB)";
-
     boost::filesystem::path path;
     
     path = GetPath(uuid);
@@ -144,7 +138,69 @@ namespace Orthanc
       }
     }
 
-    SystemToolbox::WriteFile(content, size, path.string());
+    return path;
+  }
+
+
+  void FilesystemStorage::Create(const std::string& uuid,
+                                 const void* content, 
+                                 size_t size,
+                                 FileContentType type)
+  {
+    LOG(INFO) << "Creating attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
+              << "\" type (size: " << (size / (1024 * 1024) + 1) << "MB)";
+
+    SystemToolbox::WriteFile(content, size, PrepareCreation(uuid).string());
+  }
+
+
+  std::string FilesystemStorage::CreateTemporaryPath() const
+  {
+    // The name of the temporary files is not a valid UUID, so that
+    // they are ignored by "ListAllFiles()"
+    boost::filesystem::path path = root_ / "tmp";
+
+    if (!boost::filesystem::is_directory(path))
+    {
+      SystemToolbox::MakeDirectory(path.string());
+    }
+
+    path /= Toolbox::GenerateUuid() + ".tmp";
+
+#if BOOST_HAS_FILESYSTEM_V3 == 1
+    path.make_preferred();
+#endif
+
+    return path.string();
+  }
+
+
+  void FilesystemStorage::CreateFromFile(const std::string& uuid,
+                                         const std::string& path,
+                                         FileContentType type)
+  {
+    LOG(INFO) << "Moving file \"" << path << "\" to attachment \"" << uuid << "\" of \"" 
+              << GetDescriptionInternal(type) << "\" type";
+
+    boost::filesystem::path target = PrepareCreation(uuid);
+
+    try
+    {
+      boost::filesystem::rename(path, target);
+    }
+    catch (boost::filesystem::filesystem_error&)
+    {
+      // The source file is presumably on another filesystem
+      try
+      {
+        boost::filesystem::copy_file(path, target);
+        boost::filesystem::remove(path);
+      }
+      catch (boost::filesystem::filesystem_error&)
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+    }
   }
 
 
@@ -160,6 +216,19 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    LOG(INFO) << "Reading bytes " << start << "-" << end << " of attachment \"" << uuid
+              << "\" of \"" << GetDescriptionInternal(type) << "\" content type";
+
+    SystemToolbox::ReadFileRange(content, GetPath(uuid).string(), start, end);
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
@@ -60,6 +60,8 @@ namespace Orthanc
 
     boost::filesystem::path GetPath(const std::string& uuid) const;
 
+    boost::filesystem::path PrepareCreation(const std::string& uuid) const;
+
   public:
     explicit FilesystemStorage(std::string root);
 
@@ -72,9 +74,35 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type);
 
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
+
+    virtual bool HasEfficientReadRange()
+    {
+      return true;
+    }
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
 
+    // Returns the path to a new temporary file, that lies on the same
+    // filesystem as the attachments. The file itself is not created.
+    std::string CreateTemporaryPath() const;
+
+    // Moves an existing file into the storage area, which avoids any
+    // copy if the file lies on the same filesystem
+    void CreateFromFile(const std::string& uuid,
+                        const std::string& path,
+                        FileContentType type);
+
+    std::string GetAttachmentPath(const std::string& uuid) const
+    {
+      return GetPath(uuid).string();
+    }
+
     void ListAllFiles(std::set<std::string>& result) const;
 
     uintmax_t GetSize(const std::string& uuid) const;
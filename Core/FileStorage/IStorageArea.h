@@ -35,6 +35,7 @@
 
 #include "../Enumerations.h"
 
+#include <stdint.h>
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -56,6 +57,19 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type) = 0;
 
+    // Reads the bytes in [start, end[ of the file, without reading
+    // the whole file
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end) = 0;
+
+    // Whether "ReadRange()" is cheaper than reading the whole file
+    // (this is not the case of the plugins that only register the
+    // "read" callback)
+    virtual bool HasEfficientReadRange() = 0;
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
   };
@@ -0,0 +1,1333 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "PackedStorage.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+#include "../SystemToolbox.h"
+#include "../Toolbox.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#  include <io.h>
+#else
+#  include <errno.h>
+#  include <unistd.h>
+#endif
+
+
+static const char SEGMENT_MAGIC[] = "OPKSEG01";
+static const char INDEX_MAGIC[] = "OPKIDX01";
+static const char RECORD_MAGIC[] = "OPKR";
+
+static const size_t MAGIC_SIZE = 8;
+static const size_t RECORD_MAGIC_SIZE = 4;
+static const size_t UUID_SIZE = 36;
+
+// Magic, UUID, content type (32 bits), size (64 bits)
+static const size_t RECORD_HEADER_SIZE = RECORD_MAGIC_SIZE + UUID_SIZE + 4 + 8;
+
+// UUID, content type (32 bits), offset (64 bits), size (64 bits)
+static const size_t INDEX_ENTRY_SIZE = UUID_SIZE + 4 + 8 + 8;
+
+
+static void EncodeUInt32(uint8_t* target,
+                         uint32_t value)
+{
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    target[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+
+static void EncodeUInt64(uint8_t* target,
+                         uint64_t value)
+{
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    target[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+
+static uint32_t DecodeUInt32(const uint8_t* source)
+{
+  uint32_t value = 0;
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    value |= static_cast<uint32_t>(source[i]) << (8 * i);
+  }
+
+  return value;
+}
+
+
+static uint64_t DecodeUInt64(const uint8_t* source)
+{
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    value |= static_cast<uint64_t>(source[i]) << (8 * i);
+  }
+
+  return value;
+}
+
+
+// Makes the creation, the renaming and the removal of the files of a
+// directory durable (this is implicit on Windows)
+static void SyncDirectory(const boost::filesystem::path& directory)
+{
+#if !defined(_WIN32)
+  int fd = open(directory.string().c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw Orthanc::OrthancException(Orthanc::ErrorCode_FileStorageCannotWrite);
+  }
+
+  bool ok = (fsync(fd) == 0);
+  close(fd);
+
+  if (!ok)
+  {
+    throw Orthanc::OrthancException(Orthanc::ErrorCode_FileStorageCannotWrite);
+  }
+#endif
+}
+
+
+namespace Orthanc
+{
+  /**
+   * Segment file, that is accessed with positioned reads and writes.
+   * The accounting of the bytes is protected by the mutex of the
+   * storage area.
+   **/
+  class PackedStorage::Segment : public boost::noncopyable
+  {
+  private:
+    uint32_t                 number_;
+    boost::filesystem::path  tombstonesPath_;
+    int                      fd_;
+    uint64_t                 end_;          // Protected by "writerMutex_"
+    uint64_t                 flushed_;      // Protected by "writerMutex_"
+    uint64_t                 totalSize_;    // Size of all the records
+    uint64_t                 liveSize_;     // Size of the records that are not removed
+    bool                     sealed_;
+    boost::mutex             tombstonesMutex_;
+
+#if defined(_WIN32)
+    boost::mutex             mutex_;        // Seeking and reading is not atomic
+#endif
+
+  public:
+    Segment(uint32_t number,
+            const boost::filesystem::path& path,
+            const boost::filesystem::path& tombstonesPath,
+            bool create) :
+      number_(number),
+      tombstonesPath_(tombstonesPath),
+      end_(0),
+      flushed_(0),
+      totalSize_(0),
+      liveSize_(0),
+      sealed_(false)
+    {
+#if defined(_WIN32)
+      int flags = _O_RDWR | _O_BINARY | (create ? _O_CREAT | _O_EXCL : 0);
+      fd_ = _open(path.string().c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+      int flags = O_RDWR | (create ? O_CREAT | O_EXCL : 0);
+      fd_ = open(path.string().c_str(), flags, 0644);
+#endif
+
+      if (fd_ < 0)
+      {
+        LOG(ERROR) << "Cannot open the segment file: " << path;
+        throw OrthancException(create ? ErrorCode_FileStorageCannotWrite : ErrorCode_InexistentFile);
+      }
+    }
+
+    ~Segment()
+    {
+#if defined(_WIN32)
+      _close(fd_);
+#else
+      close(fd_);
+#endif
+    }
+
+    uint32_t GetNumber() const
+    {
+      return number_;
+    }
+
+    uint64_t GetEnd() const
+    {
+      return end_;
+    }
+
+    void SetEnd(uint64_t end)
+    {
+      end_ = end;
+    }
+
+    // End of the content that has been synchronized to the disk
+    uint64_t GetFlushed() const
+    {
+      return flushed_;
+    }
+
+    uint64_t GetTotalSize() const
+    {
+      return totalSize_;
+    }
+
+    uint64_t GetLiveSize() const
+    {
+      return liveSize_;
+    }
+
+    bool IsSealed() const
+    {
+      return sealed_;
+    }
+
+    void SetSealed()
+    {
+      sealed_ = true;
+    }
+
+    void AddRecord(uint64_t size,
+                   bool live)
+    {
+      totalSize_ += size;
+
+      if (live)
+      {
+        liveSize_ += size;
+      }
+    }
+
+    void RemoveRecord(uint64_t size)
+    {
+      assert(liveSize_ >= size);
+      liveSize_ -= size;
+    }
+
+    uint64_t GetFileSize()
+    {
+#if defined(_WIN32)
+      struct _stati64 s;
+      if (_fstati64(fd_, &s) != 0)
+#else
+      struct stat s;
+      if (fstat(fd_, &s) != 0)
+#endif
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+
+      return static_cast<uint64_t>(s.st_size);
+    }
+
+    void ReadAt(void* target,
+                size_t size,
+                uint64_t offset)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(target);
+
+#if defined(_WIN32)
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+#endif
+
+      while (size > 0)
+      {
+#if defined(_WIN32)
+        int chunk = (size > (1u << 30) ? (1 << 30) : static_cast<int>(size));
+        int count = _read(fd_, p, chunk);
+#else
+        ssize_t count = pread(fd_, p, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+        {
+          continue;
+        }
+#endif
+
+        if (count <= 0)
+        {
+          // Error, or unexpected end of file
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+
+        p += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+      }
+    }
+
+    void WriteAt(const void* source,
+                 size_t size,
+                 uint64_t offset)
+    {
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(source);
+
+#if defined(_WIN32)
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0)
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+#endif
+
+      while (size > 0)
+      {
+#if defined(_WIN32)
+        int chunk = (size > (1u << 30) ? (1 << 30) : static_cast<int>(size));
+        int count = _write(fd_, p, chunk);
+#else
+        ssize_t count = pwrite(fd_, p, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+        {
+          continue;
+        }
+#endif
+
+        if (count <= 0)
+        {
+          throw OrthancException(ErrorCode_FileStorageCannotWrite);
+        }
+
+        p += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+      }
+    }
+
+    void Truncate(uint64_t size)
+    {
+#if defined(_WIN32)
+      if (_chsize_s(fd_, static_cast<__int64>(size)) != 0)
+#else
+      if (ftruncate(fd_, static_cast<off_t>(size)) != 0)
+#endif
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+    }
+
+    void Flush()
+    {
+#if defined(_WIN32)
+      if (_commit(fd_) != 0)
+#else
+      if (fsync(fd_) != 0)
+#endif
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+
+      flushed_ = end_;
+    }
+
+    // The tombstones are synchronized to the disk one by one, as a
+    // lost tombstone would resurrect an attachment at the next startup
+    void AppendTombstone(const Key& key)
+    {
+      boost::mutex::scoped_lock lock(tombstonesMutex_);
+
+      bool created = !boost::filesystem::exists(tombstonesPath_);
+
+#if defined(_WIN32)
+      int fd = _open(tombstonesPath_.string().c_str(),
+                     _O_WRONLY | _O_BINARY | _O_APPEND | _O_CREAT, _S_IREAD | _S_IWRITE);
+#else
+      int fd = open(tombstonesPath_.string().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+
+      if (fd < 0)
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+
+#if defined(_WIN32)
+      bool ok = (_write(fd, key.uuid_, UUID_SIZE) == static_cast<int>(UUID_SIZE) &&
+                 _commit(fd) == 0);
+      _close(fd);
+#else
+      bool ok = (write(fd, key.uuid_, UUID_SIZE) == static_cast<ssize_t>(UUID_SIZE) &&
+                 fsync(fd) == 0);
+      close(fd);
+#endif
+
+      if (!ok)
+      {
+        throw OrthancException(ErrorCode_FileStorageCannotWrite);
+      }
+
+      if (created)
+      {
+        SyncDirectory(tombstonesPath_.parent_path());
+      }
+    }
+
+    // Lists the complete records, and truncates the incomplete
+    // record that might have been left by a crash at the end of the
+    // segment
+    void Scan(std::vector<Record>& records)
+    {
+      records.clear();
+
+      uint64_t fileSize = GetFileSize();
+      if (fileSize < MAGIC_SIZE)
+      {
+        // The segment was just created
+        Truncate(0);
+        WriteAt(SEGMENT_MAGIC, MAGIC_SIZE, 0);
+        end_ = MAGIC_SIZE;
+        return;
+      }
+
+      char magic[MAGIC_SIZE];
+      ReadAt(magic, MAGIC_SIZE, 0);
+      if (memcmp(magic, SEGMENT_MAGIC, MAGIC_SIZE) != 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      uint64_t offset = MAGIC_SIZE;
+
+      while (offset + RECORD_HEADER_SIZE <= fileSize)
+      {
+        uint8_t header[RECORD_HEADER_SIZE];
+        ReadAt(header, RECORD_HEADER_SIZE, offset);
+
+        std::string uuid(reinterpret_cast<const char*>(header) + RECORD_MAGIC_SIZE, UUID_SIZE);
+        uint64_t size = DecodeUInt64(header + RECORD_MAGIC_SIZE + UUID_SIZE + 4);
+
+        if (memcmp(header, RECORD_MAGIC, RECORD_MAGIC_SIZE) != 0 ||
+            !Toolbox::IsUuid(uuid) ||
+            size > fileSize - offset - RECORD_HEADER_SIZE)
+        {
+          break;
+        }
+
+        Location location;
+        location.segment_ = number_;
+        location.offset_ = offset;
+        location.size_ = size;
+        location.type_ = static_cast<FileContentType>(DecodeUInt32(header + RECORD_MAGIC_SIZE + UUID_SIZE));
+        records.push_back(Record(Key(uuid), location));
+
+        offset += RECORD_HEADER_SIZE + size;
+      }
+
+      if (offset != fileSize)
+      {
+        LOG(WARNING) << "Removing an incomplete record at the end of segment " << number_
+                     << " of the storage area (" << (fileSize - offset) << " bytes)";
+        Truncate(offset);
+      }
+
+      end_ = offset;
+    }
+  };
+
+
+  PackedStorage::Key::Key(const std::string& uuid)
+  {
+    if (!Toolbox::IsUuid(uuid))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    memcpy(uuid_, uuid.c_str(), UUID_SIZE);
+  }
+
+
+  bool PackedStorage::Key::operator< (const Key& other) const
+  {
+    return memcmp(uuid_, other.uuid_, UUID_SIZE) < 0;
+  }
+
+
+  boost::filesystem::path PackedStorage::GetSegmentPath(uint32_t segment,
+                                                        const char* extension) const
+  {
+    char name[32];
+    sprintf(name, "segment-%08u.%s", segment, extension);
+
+    boost::filesystem::path path = root_ / name;
+
+#if BOOST_HAS_FILESYSTEM_V3 == 1
+    path.make_preferred();
+#endif
+
+    return path;
+  }
+
+
+  bool PackedStorage::ReadIndexFile(std::vector<Record>& records,
+                                    uint32_t segment) const
+  {
+    records.clear();
+
+    boost::filesystem::path path = GetSegmentPath(segment, "idx");
+    if (!SystemToolbox::IsRegularFile(path.string()))
+    {
+      return false;
+    }
+
+    std::string content;
+    SystemToolbox::ReadFile(content, path.string());
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(content.c_str());
+
+    if (content.size() < MAGIC_SIZE + 8 ||
+        memcmp(p, INDEX_MAGIC, MAGIC_SIZE) != 0)
+    {
+      return false;
+    }
+
+    uint64_t count = DecodeUInt64(p + MAGIC_SIZE);
+    if (count != (content.size() - MAGIC_SIZE - 8) / INDEX_ENTRY_SIZE ||
+        (content.size() - MAGIC_SIZE - 8) % INDEX_ENTRY_SIZE != 0)
+    {
+      return false;
+    }
+
+    records.reserve(static_cast<size_t>(count));
+    p += MAGIC_SIZE + 8;
+
+    for (uint64_t i = 0; i < count; i++, p += INDEX_ENTRY_SIZE)
+    {
+      std::string uuid(reinterpret_cast<const char*>(p), UUID_SIZE);
+      if (!Toolbox::IsUuid(uuid))
+      {
+        records.clear();
+        return false;
+      }
+
+      Location location;
+      location.segment_ = segment;
+      location.type_ = static_cast<FileContentType>(DecodeUInt32(p + UUID_SIZE));
+      location.offset_ = DecodeUInt64(p + UUID_SIZE + 4);
+      location.size_ = DecodeUInt64(p + UUID_SIZE + 12);
+      records.push_back(Record(Key(uuid), location));
+    }
+
+    return true;
+  }
+
+
+  void PackedStorage::WriteIndexFile(uint32_t segment,
+                                     const std::vector<Record>& records) const
+  {
+    std::string content;
+    content.resize(MAGIC_SIZE + 8 + records.size() * INDEX_ENTRY_SIZE);
+
+    uint8_t* p = reinterpret_cast<uint8_t*>(&content[0]);
+    memcpy(p, INDEX_MAGIC, MAGIC_SIZE);
+    EncodeUInt64(p + MAGIC_SIZE, records.size());
+    p += MAGIC_SIZE + 8;
+
+    for (size_t i = 0; i < records.size(); i++, p += INDEX_ENTRY_SIZE)
+    {
+      memcpy(p, records[i].key_.uuid_, UUID_SIZE);
+      EncodeUInt32(p + UUID_SIZE, static_cast<uint32_t>(records[i].location_.type_));
+      EncodeUInt64(p + UUID_SIZE + 4, records[i].location_.offset_);
+      EncodeUInt64(p + UUID_SIZE + 12, records[i].location_.size_);
+    }
+
+    // Write to a temporary file, then rename, so that an incomplete
+    // index file is never read
+    boost::filesystem::path path = GetSegmentPath(segment, "idx");
+    boost::filesystem::path tmp = GetSegmentPath(segment, "idx.tmp");
+
+    SystemToolbox::WriteFile(content, tmp.string());
+
+    try
+    {
+      boost::filesystem::rename(tmp, path);
+    }
+    catch (boost::filesystem::filesystem_error&)
+    {
+      throw OrthancException(ErrorCode_FileStorageCannotWrite);
+    }
+
+    SyncDirectory(root_);
+  }
+
+
+  void PackedStorage::AddToIndex(const Record& record)
+  {
+    const uint64_t size = RECORD_HEADER_SIZE + record.location_.size_;
+
+    Index::iterator found = index_.find(record.key_);
+    if (found != index_.end())
+    {
+      // The compaction of a segment was interrupted after this record
+      // was copied: Keep the most recent copy, and remove the older one
+      LOG(INFO) << "Removing a duplicate of attachment " << record.key_.ToString()
+                << " from segment " << found->second.segment_;
+
+      Segments::iterator older = segments_.find(found->second.segment_);
+      assert(older != segments_.end());
+
+      older->second->RemoveRecord(RECORD_HEADER_SIZE + found->second.size_);
+      older->second->AppendTombstone(record.key_);
+      index_.erase(found);
+    }
+
+    Segments::iterator segment = segments_.find(record.location_.segment_);
+    assert(segment != segments_.end());
+    segment->second->AddRecord(size, true);
+
+    index_[record.key_] = record.location_;
+  }
+
+
+  void PackedStorage::ApplyTombstones(uint32_t segment)
+  {
+    boost::filesystem::path path = GetSegmentPath(segment, "del");
+    if (!SystemToolbox::IsRegularFile(path.string()))
+    {
+      return;
+    }
+
+    std::string content;
+    SystemToolbox::ReadFile(content, path.string());
+
+    SegmentPtr target = segments_[segment];
+
+    // An incomplete tombstone at the end of the file is ignored
+    for (size_t pos = 0; pos + UUID_SIZE <= content.size(); pos += UUID_SIZE)
+    {
+      std::string uuid = content.substr(pos, UUID_SIZE);
+      if (!Toolbox::IsUuid(uuid))
+      {
+        continue;
+      }
+
+      Index::iterator found = index_.find(Key(uuid));
+      if (found != index_.end() &&
+          found->second.segment_ == segment)
+      {
+        target->RemoveRecord(RECORD_HEADER_SIZE + found->second.size_);
+        index_.erase(found);
+      }
+    }
+  }
+
+
+  void PackedStorage::LoadSegment(uint32_t segment,
+                                  bool isLast)
+  {
+    SegmentPtr s(new Segment(segment, GetSegmentPath(segment, "dat"),
+                             GetSegmentPath(segment, "del"), false));
+    segments_[segment] = s;
+
+    std::vector<Record> records;
+
+    if (ReadIndexFile(records, segment))
+    {
+      // Sealed segment, which is never appended again
+      s->SetEnd(s->GetFileSize());
+      s->SetSealed();
+    }
+    else
+    {
+      s->Scan(records);
+
+      if (isLast)
+      {
+        // This segment is the active one
+        active_ = s;
+        activeRecords_ = records;
+      }
+      else
+      {
+        // The index file is missing
+        WriteIndexFile(segment, records);
+        s->SetSealed();
+      }
+    }
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+      AddToIndex(records[i]);
+    }
+
+    ApplyTombstones(segment);
+  }
+
+
+  void PackedStorage::Load()
+  {
+    namespace fs = boost::filesystem;
+
+    SystemToolbox::MakeDirectory(root_.string());
+
+    std::set<uint32_t> segments;
+    std::set<uint32_t> orphans;
+
+    for (fs::directory_iterator it(root_), end; it != end; ++it)
+    {
+      std::string name = it->path().filename().string();
+
+      unsigned int segment;
+      char extension[8];
+      if (name.size() > 17 &&
+          sscanf(name.c_str(), "segment-%8u.%7s", &segment, extension) == 2)
+      {
+        if (std::string(extension) == "dat")
+        {
+          segments.insert(segment);
+        }
+        else
+        {
+          orphans.insert(segment);
+        }
+      }
+    }
+
+    // Remove the index and the tombstones of the segments that were
+    // being removed by the compaction
+    for (std::set<uint32_t>::const_iterator it = orphans.begin(); it != orphans.end(); ++it)
+    {
+      if (segments.find(*it) == segments.end())
+      {
+        RemoveSegmentFiles(*it);
+      }
+
+      nextSegment_ = std::max(nextSegment_, *it + 1);
+    }
+
+    for (std::set<uint32_t>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+    {
+      std::set<uint32_t>::const_iterator next = it;
+      ++next;
+      LoadSegment(*it, next == segments.end());
+
+      nextSegment_ = std::max(nextSegment_, *it + 1);
+    }
+
+    LOG(WARNING) << "Packed storage area: " << index_.size() << " attachments in "
+                 << segments_.size() << " segments";
+  }
+
+
+  void PackedStorage::SealActiveSegment()
+  {
+    // "writerMutex_" must be locked
+    assert(active_.get() != NULL);
+
+    active_->Flush();
+    WriteIndexFile(active_->GetNumber(), activeRecords_);
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      active_->SetSealed();
+    }
+
+    active_.reset();
+    activeRecords_.clear();
+  }
+
+
+  void PackedStorage::OpenNewSegment()
+  {
+    // "writerMutex_" must be locked, which protects "nextSegment_"
+    assert(active_.get() == NULL);
+
+    const uint32_t number = nextSegment_;
+    nextSegment_++;
+
+    SegmentPtr segment(new Segment(number, GetSegmentPath(number, "dat"),
+                                   GetSegmentPath(number, "del"), true));
+    segment->WriteAt(SEGMENT_MAGIC, MAGIC_SIZE, 0);
+    segment->SetEnd(MAGIC_SIZE);
+    SyncDirectory(root_);
+
+    boost::mutex::scoped_lock lock(mutex_);
+    segments_[number] = segment;
+    active_ = segment;
+    activeRecords_.clear();
+  }
+
+
+  PackedStorage::Location PackedStorage::Append(const Key& key,
+                                                const void* content,
+                                                size_t size,
+                                                FileContentType type)
+  {
+    // "writerMutex_" must be locked
+
+    if (active_.get() != NULL &&
+        !activeRecords_.empty() &&
+        active_->GetEnd() + RECORD_HEADER_SIZE + size > maximumSegmentSize_)
+    {
+      SealActiveSegment();
+    }
+
+    if (active_.get() == NULL)
+    {
+      OpenNewSegment();
+    }
+
+    Location location;
+    location.segment_ = active_->GetNumber();
+    location.offset_ = active_->GetEnd();
+    location.size_ = size;
+    location.type_ = type;
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, RECORD_MAGIC_SIZE);
+    memcpy(header + RECORD_MAGIC_SIZE, key.uuid_, UUID_SIZE);
+    EncodeUInt32(header + RECORD_MAGIC_SIZE + UUID_SIZE, static_cast<uint32_t>(type));
+    EncodeUInt64(header + RECORD_MAGIC_SIZE + UUID_SIZE + 4, size);
+
+    try
+    {
+      active_->WriteAt(header, RECORD_HEADER_SIZE, location.offset_);
+
+      if (size > 0)
+      {
+        active_->WriteAt(content, size, location.offset_ + RECORD_HEADER_SIZE);
+      }
+    }
+    catch (OrthancException&)
+    {
+      // Don't leave an incomplete record (e.g. if the disk is full)
+      try
+      {
+        active_->Truncate(location.offset_);
+      }
+      catch (OrthancException&)
+      {
+      }
+
+      throw;
+    }
+
+    active_->SetEnd(location.offset_ + RECORD_HEADER_SIZE + size);
+    activeRecords_.push_back(Record(key, location));
+
+    return location;
+  }
+
+
+  void PackedStorage::Insert(const Key& key,
+                             const Location& location)
+  {
+    // "mutex_" must be locked
+    segments_[location.segment_]->AddRecord(RECORD_HEADER_SIZE + location.size_, true);
+    index_[key] = location;
+  }
+
+
+  bool PackedStorage::HasGarbage(const Segment& segment) const
+  {
+    // "mutex_" must be locked
+    return (compactionRatio_ > 0 &&
+            segment.IsSealed() &&
+            segment.GetTotalSize() > 0 &&
+            (segment.GetTotalSize() - segment.GetLiveSize()) * 100 >=
+            segment.GetTotalSize() * compactionRatio_);
+  }
+
+
+  void PackedStorage::RemoveSegmentFiles(uint32_t segment)
+  {
+    // The data is removed first, as the index and the tombstones
+    // without data are ignored at the next startup
+    const char* EXTENSIONS[] = { "dat", "idx", "del", "idx.tmp" };
+
+    for (size_t i = 0; i < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); i++)
+    {
+      try
+      {
+        boost::filesystem::remove(GetSegmentPath(segment, EXTENSIONS[i]));
+      }
+      catch (boost::filesystem::filesystem_error& e)
+      {
+        LOG(ERROR) << "Cannot remove a file of segment " << segment
+                   << " of the storage area: " << e.what();
+        return;
+      }
+    }
+  }
+
+
+  bool PackedStorage::CompactOneSegment()
+  {
+    boost::mutex::scoped_lock compactionLock(compactionRunning_);
+
+    SegmentPtr segment;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (Segments::const_iterator it = segments_.begin(); it != segments_.end(); ++it)
+      {
+        if (HasGarbage(*it->second))
+        {
+          segment = it->second;
+          break;
+        }
+      }
+    }
+
+    if (segment.get() == NULL)
+    {
+      return false;
+    }
+
+    const uint32_t number = segment->GetNumber();
+
+    std::vector<Record> records;
+    if (!ReadIndexFile(records, number))
+    {
+      // Sealed segments always have an index file, unless it has been
+      // removed in the meantime
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    LOG(INFO) << "Compacting segment " << number << " of the storage area";
+
+    uint64_t copied = 0;
+
+    for (size_t i = 0; i < records.size() && !done_; i++)
+    {
+      const Key& key = records[i].key_;
+      const Location& source = records[i].location_;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        Index::const_iterator found = index_.find(key);
+        if (found == index_.end() ||
+            found->second.segment_ != number ||
+            found->second.offset_ != source.offset_)
+        {
+          // This attachment has been removed
+          continue;
+        }
+      }
+
+      std::string content;
+      content.resize(static_cast<size_t>(source.size_));
+      if (!content.empty())
+      {
+        segment->ReadAt(&content[0], content.size(), source.offset_ + RECORD_HEADER_SIZE);
+      }
+
+      boost::mutex::scoped_lock writerLock(writerMutex_);
+      Location target = Append(key, content.empty() ? NULL : content.c_str(), content.size(), source.type_);
+
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Index::iterator found = index_.find(key);
+      if (found != index_.end() &&
+          found->second.segment_ == number &&
+          found->second.offset_ == source.offset_)
+      {
+        segment->RemoveRecord(RECORD_HEADER_SIZE + source.size_);
+        Insert(key, target);
+        copied += source.size_;
+      }
+      else
+      {
+        // The attachment has been removed during the copy
+        segments_[target.segment_]->AddRecord(RECORD_HEADER_SIZE + target.size_, false);
+        segments_[target.segment_]->AppendTombstone(key);
+      }
+    }
+
+    {
+      // The copied records must reach the disk before their source
+      // is removed (the segments that were sealed in the meantime
+      // have been flushed by SealActiveSegment())
+      boost::mutex::scoped_lock writerLock(writerMutex_);
+
+      if (active_.get() != NULL)
+      {
+        active_->Flush();
+      }
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (segment->GetLiveSize() != 0)
+      {
+        // Interrupted by the destructor
+        return false;
+      }
+
+      segments_.erase(number);
+    }
+
+    RemoveSegmentFiles(number);
+
+    LOG(INFO) << "Segment " << number << " of the storage area has been compacted ("
+              << copied << " bytes copied)";
+
+    return true;
+  }
+
+
+  void PackedStorage::CompactionThread(PackedStorage* that)
+  {
+    while (!that->done_)
+    {
+      bool compacted = false;
+
+      try
+      {
+        compacted = that->CompactOneSegment();
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error while compacting the storage area: " << e.What();
+      }
+
+      if (!compacted)
+      {
+        boost::mutex::scoped_lock lock(that->compactionMutex_);
+        if (!that->done_)
+        {
+          that->compactionWakeup_.timed_wait(lock, boost::posix_time::seconds(10));
+        }
+      }
+    }
+  }
+
+
+  PackedStorage::PackedStorage(const std::string& root,
+                               uint64_t maximumSegmentSize) :
+    root_(root),
+    maximumSegmentSize_(maximumSegmentSize),
+    compactionRatio_(50),
+    nextSegment_(1),
+    done_(false)
+  {
+    if (maximumSegmentSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    Load();
+
+    compactionThread_ = boost::thread(CompactionThread, this);
+  }
+
+
+  PackedStorage::~PackedStorage()
+  {
+    {
+      boost::mutex::scoped_lock lock(compactionMutex_);
+      done_ = true;
+      compactionWakeup_.notify_one();
+    }
+
+    if (compactionThread_.joinable())
+    {
+      compactionThread_.join();
+    }
+  }
+
+
+  void PackedStorage::SetCompactionRatio(unsigned int percent)
+  {
+    if (percent > 100)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      compactionRatio_ = percent;
+    }
+
+    boost::mutex::scoped_lock lock(compactionMutex_);
+    compactionWakeup_.notify_one();
+  }
+
+
+  void PackedStorage::Compact()
+  {
+    while (CompactOneSegment())
+    {
+    }
+  }
+
+
+  void PackedStorage::Create(const std::string& uuid,
+                             const void* content, 
+                             size_t size,
+                             FileContentType type)
+  {
+    LOG(INFO) << "Creating attachment \"" << uuid << "\" of type " << static_cast<int>(type)
+              << " in the packed storage area (size: " << (size / (1024 * 1024) + 1) << "MB)";
+
+    Key key(uuid);
+
+    boost::mutex::scoped_lock writerLock(writerMutex_);
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (index_.find(key) != index_.end())
+      {
+        // Extremely unlikely case: This Uuid has already been created
+        // in the past.
+        throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    Location location = Append(key, content, size, type);
+
+    boost::mutex::scoped_lock lock(mutex_);
+    Insert(key, location);
+  }
+
+
+  void PackedStorage::LookupRecord(SegmentPtr& segment,
+                                   Location& location,
+                                   const std::string& uuid)
+  {
+    Key key(uuid);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Index::const_iterator found = index_.find(key);
+    if (found == index_.end())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    location = found->second;
+    segment = segments_[location.segment_];
+  }
+
+
+  void PackedStorage::Read(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type)
+  {
+    LOG(INFO) << "Reading attachment \"" << uuid << "\" of type " << static_cast<int>(type)
+              << " from the packed storage area";
+
+    SegmentPtr segment;
+    Location location;
+    LookupRecord(segment, location, uuid);
+
+    // The segment cannot be closed while it is read, even if it is
+    // compacted in the meantime
+    content.resize(static_cast<size_t>(location.size_));
+    if (!content.empty())
+    {
+      segment->ReadAt(&content[0], content.size(), location.offset_ + RECORD_HEADER_SIZE);
+    }
+  }
+
+
+  void PackedStorage::ReadRange(std::string& content,
+                                const std::string& uuid,
+                                FileContentType type,
+                                uint64_t start,
+                                uint64_t end)
+  {
+    LOG(INFO) << "Reading bytes " << start << "-" << end << " of attachment \"" << uuid
+              << "\" of type " << static_cast<int>(type) << " from the packed storage area";
+
+    SegmentPtr segment;
+    Location location;
+    LookupRecord(segment, location, uuid);
+
+    if (start > end ||
+        end > location.size_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    content.resize(static_cast<size_t>(end - start));
+    if (!content.empty())
+    {
+      segment->ReadAt(&content[0], content.size(), location.offset_ + RECORD_HEADER_SIZE + start);
+    }
+  }
+
+
+  void PackedStorage::Remove(const std::string& uuid,
+                             FileContentType type)
+  {
+    LOG(INFO) << "Deleting attachment \"" << uuid << "\" of type " << static_cast<int>(type)
+              << " from the packed storage area";
+
+    Key key(uuid);
+
+    SegmentPtr segment;
+    bool compact;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Index::iterator found = index_.find(key);
+      if (found == index_.end())
+      {
+        // Ignore the error, as in "FilesystemStorage"
+        return;
+      }
+
+      segment = segments_[found->second.segment_];
+      segment->RemoveRecord(RECORD_HEADER_SIZE + found->second.size_);
+      index_.erase(found);
+
+      compact = HasGarbage(*segment);
+    }
+
+    segment->AppendTombstone(key);
+
+    if (compact)
+    {
+      boost::mutex::scoped_lock lock(compactionMutex_);
+      compactionWakeup_.notify_one();
+    }
+  }
+
+
+  void PackedStorage::ListAllFiles(std::set<std::string>& result)
+  {
+    result.clear();
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (Index::const_iterator it = index_.begin(); it != index_.end(); ++it)
+    {
+      result.insert(it->first.ToString());
+    }
+  }
+
+
+  uint64_t PackedStorage::GetSize(const std::string& uuid)
+  {
+    Key key(uuid);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Index::const_iterator found = index_.find(key);
+    if (found == index_.end())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    return found->second.size_;
+  }
+
+
+  void PackedStorage::Clear()
+  {
+    boost::mutex::scoped_lock compactionLock(compactionRunning_);
+    boost::mutex::scoped_lock writerLock(writerMutex_);
+
+    std::vector<uint32_t> segments;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (Segments::const_iterator it = segments_.begin(); it != segments_.end(); ++it)
+      {
+        segments.push_back(it->first);
+      }
+
+      index_.clear();
+      segments_.clear();
+    }
+
+    active_.reset();
+    activeRecords_.clear();
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+      RemoveSegmentFiles(segments[i]);
+    }
+  }
+
+
+  uint64_t PackedStorage::GetUnflushedSize()
+  {
+    boost::mutex::scoped_lock writerLock(writerMutex_);
+
+    if (active_.get() == NULL)
+    {
+      return 0;
+    }
+    else
+    {
+      return active_->GetEnd() - active_->GetFlushed();
+    }
+  }
+
+
+  void PackedStorage::GetStatistics(unsigned int& segmentsCount,
+                                    uint64_t& liveSize,
+                                    uint64_t& garbageSize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    segmentsCount = static_cast<unsigned int>(segments_.size());
+    liveSize = 0;
+    garbageSize = 0;
+
+    for (Segments::const_iterator it = segments_.begin(); it != segments_.end(); ++it)
+    {
+      liveSize += it->second->GetLiveSize();
+      garbageSize += it->second->GetTotalSize() - it->second->GetLiveSize();
+    }
+  }
+}
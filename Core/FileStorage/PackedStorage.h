@@ -0,0 +1,241 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class PackedStorage cannot be used in sandboxed environments
+#endif
+
+#include "IStorageArea.h"
+
+#include <stdint.h>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Storage area that appends the attachments to large segment files
+   * ("segment-XXXXXXXX.dat"), instead of creating one file per
+   * attachment. This avoids the exhaustion of the inodes and the
+   * per-file overhead of the filesystem with huge numbers of small
+   * attachments.
+   *
+   * Each record of a segment starts with a header that contains the
+   * UUID, the content type and the size of the attachment, so that
+   * the segments are self-describing. Once a segment is full, it is
+   * sealed by writing the list of its records into an index file
+   * ("segment-XXXXXXXX.idx"), which avoids scanning it at startup.
+   * The removed attachments are recorded as tombstones in a
+   * per-segment file ("segment-XXXXXXXX.del"). A background thread
+   * compacts the sealed segments that mostly contain removed
+   * attachments, by copying their live records to the active segment.
+   *
+   * The location of all the attachments is kept in memory (about 100
+   * bytes per attachment). The reads are positioned reads that are
+   * not serialized, whereas the writes are appended one at a time.
+   **/
+  class PackedStorage : public IStorageArea
+  {
+  private:
+    class Segment;
+    typedef boost::shared_ptr<Segment>  SegmentPtr;
+
+    struct Key
+    {
+      char  uuid_[36];
+
+      explicit Key(const std::string& uuid);
+
+      std::string ToString() const
+      {
+        return std::string(uuid_, sizeof(uuid_));
+      }
+
+      bool operator< (const Key& other) const;
+    };
+
+    struct Location
+    {
+      uint32_t         segment_;
+      uint64_t         offset_;   // Offset of the record header
+      uint64_t         size_;
+      FileContentType  type_;
+    };
+
+    struct Record
+    {
+      Key       key_;
+      Location  location_;
+
+      Record(const Key& key,
+             const Location& location) :
+        key_(key),
+        location_(location)
+      {
+      }
+    };
+
+    typedef std::map<Key, Location>         Index;
+    typedef std::map<uint32_t, SegmentPtr>  Segments;
+
+    boost::filesystem::path  root_;
+    uint64_t                 maximumSegmentSize_;
+    unsigned int             compactionRatio_;
+
+    // Protects "index_" and "segments_"
+    boost::mutex             mutex_;
+    Index                    index_;
+    Segments                 segments_;
+
+    // Serializes the appends to the active segment (must be locked
+    // before "mutex_")
+    boost::mutex             writerMutex_;
+    SegmentPtr               active_;
+    std::vector<Record>      activeRecords_;   // Content of the future index file
+
+    // Number of the next segment to be created (protected by
+    // "writerMutex_"). The numbers are never reused, as the files of
+    // a compacted segment are removed once "mutex_" is released.
+    uint32_t                 nextSegment_;
+
+    bool                     done_;
+    boost::thread            compactionThread_;
+    boost::mutex             compactionMutex_;
+    boost::condition_variable  compactionWakeup_;
+    boost::mutex             compactionRunning_;   // Must be locked before "writerMutex_"
+
+    boost::filesystem::path GetSegmentPath(uint32_t segment,
+                                           const char* extension) const;
+
+    void Load();
+
+    void LoadSegment(uint32_t segment,
+                     bool isLast);
+
+    bool ReadIndexFile(std::vector<Record>& records,
+                       uint32_t segment) const;
+
+    void WriteIndexFile(uint32_t segment,
+                        const std::vector<Record>& records) const;
+
+    void AddToIndex(const Record& record);
+
+    void ApplyTombstones(uint32_t segment);
+
+    void SealActiveSegment();
+
+    void OpenNewSegment();
+
+    Location Append(const Key& key,
+                    const void* content,
+                    size_t size,
+                    FileContentType type);
+
+    void Insert(const Key& key,
+                const Location& location);
+
+    void LookupRecord(SegmentPtr& segment,
+                      Location& location,
+                      const std::string& uuid);
+
+    bool HasGarbage(const Segment& segment) const;
+
+    bool CompactOneSegment();
+
+    void RemoveSegmentFiles(uint32_t segment);
+
+    static void CompactionThread(PackedStorage* that);
+
+  public:
+    PackedStorage(const std::string& root,
+                  uint64_t maximumSegmentSize);
+
+    virtual ~PackedStorage();
+
+    // Percentage of the bytes of a sealed segment that must belong to
+    // removed attachments for the segment to be compacted (a value of
+    // "0" disables the compaction)
+    void SetCompactionRatio(unsigned int percent);
+
+    // Compacts all the segments whose ratio of garbage is above the
+    // threshold, without waiting for the background thread
+    void Compact();
+
+    virtual void Create(const std::string& uuid,
+                        const void* content, 
+                        size_t size,
+                        FileContentType type);
+
+    virtual void Read(std::string& content,
+                      const std::string& uuid,
+                      FileContentType type);
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
+
+    virtual bool HasEfficientReadRange()
+    {
+      return true;
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type);
+
+    void ListAllFiles(std::set<std::string>& result);
+
+    uint64_t GetSize(const std::string& uuid);
+
+    void Clear();
+
+    // Number of bytes appended to the active segment that are not
+    // synchronized to the disk yet
+    uint64_t GetUnflushedSize();
+
+    void GetStatistics(unsigned int& segmentsCount,
+                       uint64_t& liveSize,
+                       uint64_t& garbageSize);
+  };
+}
@@ -37,7 +37,21 @@
 #include "../Compression/ZlibCompressor.h"
 #include "../OrthancException.h"
 #include "../Toolbox.h"
-#include "../Toolbox.h"
+
+#include <memory>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#if !defined(ORTHANC_ENABLE_LZ4) || !defined(ORTHANC_ENABLE_ZSTD)
+#  error The macros ORTHANC_ENABLE_LZ4 and ORTHANC_ENABLE_ZSTD must be defined
+#endif
+
+#if ORTHANC_ENABLE_LZ4 == 1
+#  include "../Compression/Lz4Compressor.h"
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Compression/ZstdCompressor.h"
+#endif
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
 #  include "../HttpServer/HttpStreamTranscoder.h"
@@ -45,6 +59,49 @@
 
 namespace Orthanc
 {
+  IBufferCompressor* StorageAccessor::CreateCompressor(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_ZlibWithSize:
+        return new ZlibCompressor;
+
+#if ORTHANC_ENABLE_LZ4 == 1
+      case CompressionType_Lz4WithSize:
+        return new Lz4Compressor;
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+      case CompressionType_ZstdWithSize:
+        return new ZstdCompressor;
+#endif
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  bool StorageAccessor::IsCompressionSupported(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_None:
+      case CompressionType_ZlibWithSize:
+        return true;
+
+      case CompressionType_Lz4WithSize:
+        return (ORTHANC_ENABLE_LZ4 == 1);
+
+      case CompressionType_ZstdWithSize:
+        return (ORTHANC_ENABLE_ZSTD == 1);
+
+      default:
+        return false;
+    }
+  }
+
+
   FileInfo StorageAccessor::Write(const void* data,
                                   size_t size,
                                   FileContentType type,
@@ -53,6 +110,8 @@ namespace Orthanc
   {
     std::string uuid = Toolbox::GenerateUuid();
 
+    compressionDuration_ = 0;
+
     std::string md5;
 
     if (storeMd5)
@@ -68,12 +127,16 @@ namespace Orthanc
         return FileInfo(uuid, type, size, md5);
       }
 
-      case CompressionType_ZlibWithSize:
+      default:
       {
-        ZlibCompressor zlib;
+        std::auto_ptr<IBufferCompressor> compressor(CreateCompressor(compression));
 
         std::string compressed;
-        zlib.Compress(compressed, data, size);
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        compressor->Compress(compressed, data, size);
+        compressionDuration_ = static_cast<uint64_t>
+          ((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds());
 
         std::string compressedMD5;
       
@@ -92,11 +155,8 @@ namespace Orthanc
         }
 
         return FileInfo(uuid, type, size, md5,
-                        CompressionType_ZlibWithSize, compressed.size(), compressedMD5);
+                        compression, compressed.size(), compressedMD5);
       }
-
-      default:
-        throw OrthancException(ErrorCode_NotImplemented);
     }
   }
 
@@ -112,20 +172,15 @@ namespace Orthanc
         break;
       }
 
-      case CompressionType_ZlibWithSize:
+      default:
       {
-        ZlibCompressor zlib;
+        std::auto_ptr<IBufferCompressor> compressor(CreateCompressor(info.GetCompressionType()));
 
         std::string compressed;
         area_.Read(compressed, info.GetUuid(), info.GetContentType());
-        IBufferCompressor::Uncompress(content, zlib, compressed);
+        IBufferCompressor::Uncompress(content, *compressor, compressed);
         break;
       }
-
-      default:
-      {
-        throw OrthancException(ErrorCode_NotImplemented);
-      }
     }
 
     // TODO Check the validity of the uncompressed MD5?
@@ -147,11 +202,10 @@ namespace Orthanc
 
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
-  void StorageAccessor::SetupSender(BufferHttpSender& sender,
+  void StorageAccessor::SetupSender(HttpFileSender& sender,
                                     const FileInfo& info,
                                     const std::string& mime)
   {
-    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
     sender.SetContentType(mime);
 
     const char* extension;
@@ -176,11 +230,47 @@ namespace Orthanc
 
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  FilesystemHttpSender* StorageAccessor::CreateFilesystemSender(const FileInfo& info,
+                                                                const std::string& mime)
+  {
+    // The uncompressed attachments of the filesystem storage are
+    // streamed from the file, without being loaded into memory
+    FilesystemStorage* storage = dynamic_cast<FilesystemStorage*>(&area_);
+
+    if (storage == NULL ||
+        info.GetCompressionType() != CompressionType_None)
+    {
+      return NULL;
+    }
+
+    std::auto_ptr<FilesystemHttpSender> sender(new FilesystemHttpSender(*storage, info.GetUuid()));
+    SetupSender(*sender, info, mime);
+    return sender.release();
+  }
+
+
   void StorageAccessor::AnswerFile(HttpOutput& output,
                                    const FileInfo& info,
                                    const std::string& mime)
   {
+    std::auto_ptr<FilesystemHttpSender> file(CreateFilesystemSender(info, mime));
+    if (file.get() != NULL)
+    {
+      output.Answer(*file);
+      return;
+    }
+
+    if (info.GetCompressionType() == CompressionType_None)
+    {
+      // Only the requested ranges are read from the storage area
+      StorageAreaHttpSender sender(area_, info.GetUuid(), info.GetContentType(), info.GetCompressedSize());
+      SetupSender(sender, info, mime);
+      output.Answer(sender);
+      return;
+    }
+
     BufferHttpSender sender;
+    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
     SetupSender(sender, info, mime);
   
     HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
@@ -194,7 +284,24 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
+    std::auto_ptr<FilesystemHttpSender> file(CreateFilesystemSender(info, mime));
+    if (file.get() != NULL)
+    {
+      output.AnswerStream(*file);
+      return;
+    }
+
+    if (info.GetCompressionType() == CompressionType_None)
+    {
+      // Only the requested ranges are read from the storage area
+      StorageAreaHttpSender sender(area_, info.GetUuid(), info.GetContentType(), info.GetCompressedSize());
+      SetupSender(sender, info, mime);
+      output.AnswerStream(sender);
+      return;
+    }
+
     BufferHttpSender sender;
+    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
     SetupSender(sender, info, mime);
   
     HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
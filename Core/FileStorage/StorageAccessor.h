@@ -51,9 +51,12 @@
 
 #include "IStorageArea.h"
 #include "FileInfo.h"
+#include "../Compression/IBufferCompressor.h"
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
 #  include "../HttpServer/BufferHttpSender.h"
+#  include "../HttpServer/FilesystemHttpSender.h"
+#  include "../HttpServer/StorageAreaHttpSender.h"
 #  include "../RestApi/RestApiOutput.h"
 #endif
 
@@ -69,18 +72,38 @@ namespace Orthanc
   {
   private:
     IStorageArea&  area_;
+    uint64_t       compressionDuration_;
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
-    void SetupSender(BufferHttpSender& sender,
+    void SetupSender(HttpFileSender& sender,
                      const FileInfo& info,
                      const std::string& mime);
+
+    FilesystemHttpSender* CreateFilesystemSender(const FileInfo& info,
+                                                 const std::string& mime);
 #endif
 
   public:
-    StorageAccessor(IStorageArea& area) : area_(area)
+    StorageAccessor(IStorageArea& area) : 
+      area_(area),
+      compressionDuration_(0)
+    {
+    }
+
+    // Time spent (in microseconds) by the codec during the last call
+    // to "Write()", excluding the hashing and the storage area
+    uint64_t GetLastCompressionDuration() const
     {
+      return compressionDuration_;
     }
 
+    // Creates the codec that corresponds to a compressed type of
+    // attachment. Throws "NotImplemented" if this codec was not
+    // enabled at build time.
+    static IBufferCompressor* CreateCompressor(CompressionType compression);
+
+    static bool IsCompressionSupported(CompressionType compression);
+
     FileInfo Write(const void* data,
                    size_t size,
                    FileContentType type,
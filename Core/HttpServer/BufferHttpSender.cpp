@@ -42,24 +42,30 @@ namespace Orthanc
   BufferHttpSender::BufferHttpSender() :
     position_(0), 
     chunkSize_(0),
-    currentChunkSize_(0)
+    currentChunkSize_(0),
+    hasRange_(false),
+    rangeEnd_(0)
   {
   }
 
 
   bool BufferHttpSender::ReadNextChunk()
   {
-    assert(position_ + currentChunkSize_ <= buffer_.size());
+    const size_t end = (hasRange_ ? rangeEnd_ : buffer_.size());
+
+    assert(end <= buffer_.size());
+    assert(position_ + currentChunkSize_ <= end);
 
     position_ += currentChunkSize_;
 
-    if (position_ == buffer_.size())
+    if (position_ == end)
     {
+      currentChunkSize_ = 0;
       return false;
     }
     else
     {
-      currentChunkSize_ = buffer_.size() - position_;
+      currentChunkSize_ = end - position_;
 
       if (chunkSize_ != 0 &&
           currentChunkSize_ > chunkSize_)
@@ -82,4 +88,22 @@ namespace Orthanc
   {
     return currentChunkSize_;
   }
+
+
+  bool BufferHttpSender::SetRange(uint64_t start,
+                                  uint64_t end)
+  {
+    if (start > end ||
+        end > buffer_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    hasRange_ = true;
+    position_ = static_cast<size_t>(start);
+    rangeEnd_ = static_cast<size_t>(end);
+    currentChunkSize_ = 0;
+
+    return true;
+  }
 }
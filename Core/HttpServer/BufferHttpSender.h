@@ -43,6 +43,8 @@ namespace Orthanc
     size_t       position_;
     size_t       chunkSize_;
     size_t       currentChunkSize_;
+    bool         hasRange_;
+    size_t       rangeEnd_;
 
   public:
     BufferHttpSender();
@@ -79,5 +81,8 @@ namespace Orthanc
     virtual const char* GetChunkContent();
 
     virtual size_t GetChunkSize();
+
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
   };
 }
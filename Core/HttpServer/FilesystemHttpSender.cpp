@@ -33,15 +33,62 @@
 #include "../PrecompiledHeaders.h"
 #include "FilesystemHttpSender.h"
 
+#include "../Logging.h"
 #include "../OrthancException.h"
 
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 static const size_t  CHUNK_SIZE = 64 * 1024;   // Use 64KB chunks
 
+// Size of the memory-mapped windows, which must be a multiple of the
+// page size. This bounds the address space that is used by each
+// download, independently of the size of the file.
+static const size_t  MAPPING_SIZE = 16 * 1024 * 1024;
+
 namespace Orthanc
 {
-  void FilesystemHttpSender::Initialize(const boost::filesystem::path& path)
+  void FilesystemHttpSender::Initialize(const boost::filesystem::path& path,
+                                        bool memoryMapped)
   {
     SetContentFilename(path.filename().string());
+
+    size_ = 0;
+    position_ = 0;
+    end_ = 0;
+    chunkSize_ = 0;
+    fd_ = -1;
+    mapping_ = NULL;
+    mappingSize_ = 0;
+    mappingOffset_ = 0;
+
+#if !defined(_WIN32)
+    if (memoryMapped)
+    {
+      fd_ = open(path.string().c_str(), O_RDONLY);
+    }
+
+    if (fd_ >= 0)
+    {
+      struct stat s;
+      if (fstat(fd_, &s) == 0)
+      {
+        size_ = static_cast<uint64_t>(s.st_size);
+        end_ = size_;
+        return;
+      }
+
+      close(fd_);
+      fd_ = -1;
+    }
+#else
+    (void) memoryMapped;
+#endif
+
     file_.open(path.string().c_str(), std::ifstream::binary);
 
     if (!file_.is_open())
@@ -51,27 +98,140 @@ namespace Orthanc
 
     file_.seekg(0, file_.end);
     size_ = file_.tellg();
+    end_ = size_;
     file_.seekg(0, file_.beg);
   }
 
 
+  void FilesystemHttpSender::Unmap()
+  {
+#if !defined(_WIN32)
+    if (mapping_ != NULL)
+    {
+      munmap(mapping_, mappingSize_);
+      mapping_ = NULL;
+      mappingSize_ = 0;
+    }
+#endif
+  }
+
+
+  FilesystemHttpSender::~FilesystemHttpSender()
+  {
+#if !defined(_WIN32)
+    Unmap();
+
+    if (fd_ >= 0)
+    {
+      close(fd_);
+    }
+#endif
+  }
+
+
   bool FilesystemHttpSender::ReadNextChunk()
   {
+    if (position_ >= end_)
+    {
+      Unmap();
+      chunkSize_ = 0;
+      return false;
+    }
+
+    uint64_t remaining = end_ - position_;
+
+#if !defined(_WIN32)
+    if (fd_ >= 0)
+    {
+      // Map the next window of the file, after releasing the previous
+      // one. The offset of the mapping must be a multiple of the page
+      // size, which is not the case after SetRange().
+      Unmap();
+
+      static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+      uint64_t offset = position_ - position_ % pageSize;
+      size_t skipped = static_cast<size_t>(position_ - offset);
+
+      size_t size = (remaining + skipped < MAPPING_SIZE ?
+                     static_cast<size_t>(remaining) + skipped : MAPPING_SIZE);
+
+      void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd_, static_cast<off_t>(offset));
+      if (mapping == MAP_FAILED)
+      {
+        LOG(ERROR) << "Cannot map a file into memory";
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+#if defined(MADV_SEQUENTIAL)
+      madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+
+      mapping_ = mapping;
+      mappingSize_ = size;
+      mappingOffset_ = skipped;
+      chunkSize_ = size - skipped;
+      position_ += chunkSize_;
+
+      return true;
+    }
+#endif
+
     if (chunk_.size() == 0)
     {
       chunk_.resize(CHUNK_SIZE);
     }
 
-    file_.read(&chunk_[0], chunk_.size());
+    size_t size = (remaining < CHUNK_SIZE ? static_cast<size_t>(remaining) : CHUNK_SIZE);
+    file_.read(&chunk_[0], size);
 
-    if ((file_.flags() & std::istream::failbit) ||
-        file_.gcount() < 0)
+    if (file_.gcount() != static_cast<std::streamsize>(size))
     {
       throw OrthancException(ErrorCode_CorruptedFile);
     }
 
-    chunkSize_ = static_cast<size_t>(file_.gcount());
+    chunkSize_ = size;
+    position_ += size;
+
+    return true;
+  }
+
+
+  bool FilesystemHttpSender::SetRange(uint64_t start,
+                                      uint64_t end)
+  {
+    if (start > end ||
+        end > size_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (fd_ < 0)
+    {
+      file_.clear();
+      file_.seekg(static_cast<std::streamoff>(start), file_.beg);
+
+      if (!file_.good())
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    position_ = start;
+    end_ = end;
+
+    return true;
+  }
+
 
-    return chunkSize_ > 0;
+  const char* FilesystemHttpSender::GetChunkContent()
+  {
+    if (mapping_ != NULL)
+    {
+      return reinterpret_cast<const char*>(mapping_) + mappingOffset_;
+    }
+    else
+    {
+      return chunk_.c_str();
+    }
   }
 }
@@ -40,31 +40,57 @@
 
 namespace Orthanc
 {
+  /**
+   * Streams a file to the HTTP client without loading it into
+   * memory, by chunks of 64KB. On POSIX systems, the attachments of
+   * the storage area are memory-mapped by windows of fixed size, so
+   * that the chunks are sent directly from the page cache. This is
+   * only done for the attachments, as they are never modified once
+   * created (truncating a mapped file would crash the server).
+   **/
   class FilesystemHttpSender : public HttpFileSender
   {
   private:
     std::ifstream    file_;
     uint64_t         size_;
+    uint64_t         position_;
+    uint64_t         end_;
     std::string      chunk_;
     size_t           chunkSize_;
 
-    void Initialize(const boost::filesystem::path& path);
+    // Memory mapping (POSIX only)
+    int              fd_;
+    void*            mapping_;
+    size_t           mappingSize_;
+    size_t           mappingOffset_;
+
+    void Initialize(const boost::filesystem::path& path,
+                    bool memoryMapped);
+
+    void Unmap();
 
   public:
     explicit FilesystemHttpSender(const std::string& path)
     {
-      Initialize(path);
+      Initialize(path, false);
     }
 
     explicit FilesystemHttpSender(const boost::filesystem::path& path)
     {
-      Initialize(path);
+      Initialize(path, false);
     }
 
     FilesystemHttpSender(const FilesystemStorage& storage,
                          const std::string& uuid)
     {
-      Initialize(storage.GetPath(uuid));
+      Initialize(storage.GetPath(uuid), true);
+    }
+
+    virtual ~FilesystemHttpSender();
+
+    bool IsMemoryMapped() const
+    {
+      return fd_ >= 0;
     }
 
     /**
@@ -78,14 +104,14 @@ namespace Orthanc
 
     virtual bool ReadNextChunk();
 
-    virtual const char* GetChunkContent()
-    {
-      return chunk_.c_str();
-    }
+    virtual const char* GetChunkContent();
 
     virtual size_t GetChunkSize()
     {
       return chunkSize_;
     }
+
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
   };
 }
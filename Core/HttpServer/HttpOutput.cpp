@@ -39,10 +39,12 @@
 #include "../Toolbox.h"
 #include "../Compression/GzipCompressor.h"
 #include "../Compression/ZlibCompressor.h"
+#include "HttpToolbox.h"
 
 #include <iostream>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <boost/lexical_cast.hpp>
 
 
@@ -156,7 +158,8 @@ namespace Orthanc
       }
     }
 
-    if (state_ == State_WritingMultipart)
+    if (state_ == State_WritingMultipart ||
+        state_ == State_WritingStream)
     {
       throw OrthancException(ErrorCode_InternalError);
     }
@@ -183,13 +186,23 @@ namespace Orthanc
         s += *it;
       }
 
-      if (status_ != HttpStatus_200_Ok)
+      if (status_ != HttpStatus_200_Ok &&
+          status_ != HttpStatus_206_PartialContent)
       {
         hasContentLength_ = false;
       }
 
-      uint64_t contentLength = (hasContentLength_ ? contentLength_ : length);
-      s += "Content-Length: " + boost::lexical_cast<std::string>(contentLength) + "\r\n\r\n";
+      if (status_ == HttpStatus_304_NotModified)
+      {
+        // A "304 Not Modified" answer never has a body, and its
+        // "Content-Length" would refer to the unmodified content
+        s += "\r\n";
+      }
+      else
+      {
+        uint64_t contentLength = (hasContentLength_ ? contentLength_ : length);
+        s += "Content-Length: " + boost::lexical_cast<std::string>(contentLength) + "\r\n\r\n";
+      }
 
       stream_.Send(true, s.c_str(), s.size());
       state_ = State_WritingBody;
@@ -243,6 +256,10 @@ namespace Orthanc
         LOG(ERROR) << "Cannot invoke CloseBody() with multipart outputs";
         throw OrthancException(ErrorCode_BadSequenceOfCalls);
 
+      case State_WritingStream:
+        LOG(ERROR) << "Cannot invoke CloseBody() with streamed outputs";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+
       case State_Done:
         return;  // Ignore
 
@@ -279,6 +296,97 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::AddCachingHeaders(HttpCompression compression)
+  {
+    if (!vary_.empty())
+    {
+      stateMachine_.AddHeader("Vary", vary_);
+    }
+
+    if (entityTag_.empty())
+    {
+      return;
+    }
+
+    // A strong entity tag must differ between the content encodings
+    std::string tag = entityTag_;
+
+    switch (compression)
+    {
+      case HttpCompression_None:
+        break;
+
+      case HttpCompression_Gzip:
+        tag += "-gzip";
+        break;
+
+      case HttpCompression_Deflate:
+        tag += "-deflate";
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    stateMachine_.AddHeader("ETag", "\"" + tag + "\"");
+
+    if (!cacheControl_.empty())
+    {
+      stateMachine_.AddHeader("Cache-Control", cacheControl_);
+    }
+  }
+
+
+  bool HttpOutput::SetEntityTag(const std::string& tag,
+                                const std::string& cacheControl)
+  {
+    if (tag.empty() ||
+        tag.find('"') != std::string::npos)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    entityTag_ = tag;
+    cacheControl_ = cacheControl;
+
+    if (requestedEntityTags_.empty())
+    {
+      return false;
+    }
+
+    // The client may have received the content with HTTP compression,
+    // which does not change the content itself
+    static const char* const SUFFIXES[] = { "", "-gzip", "-deflate" };
+
+    for (size_t i = 0; i < sizeof(SUFFIXES) / sizeof(SUFFIXES[0]); i++)
+    {
+      std::string candidate = tag + SUFFIXES[i];
+
+      if (HttpToolbox::MatchEntityTag(requestedEntityTags_, candidate))
+      {
+        stateMachine_.ClearHeaders();
+        stateMachine_.SetHttpStatus(HttpStatus_304_NotModified);
+        stateMachine_.AddHeader("ETag", "\"" + candidate + "\"");
+
+        if (!vary_.empty())
+        {
+          stateMachine_.AddHeader("Vary", vary_);
+        }
+
+        if (!cacheControl.empty())
+        {
+          stateMachine_.AddHeader("Cache-Control", cacheControl);
+        }
+
+        stateMachine_.SendBody(NULL, 0);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   void HttpOutput::SendMethodNotAllowed(const std::string& allowed)
   {
     stateMachine_.ClearHeaders();
@@ -327,6 +435,7 @@ namespace Orthanc
   {
     if (length == 0)
     {
+      AddCachingHeaders(HttpCompression_None);
       AnswerEmpty();
       return;
     }
@@ -335,6 +444,7 @@ namespace Orthanc
 
     if (compression == HttpCompression_None)
     {
+      AddCachingHeaders(HttpCompression_None);
       stateMachine_.SetContentLength(length);
       stateMachine_.SendBody(buffer, length);
       return;
@@ -371,10 +481,12 @@ namespace Orthanc
     // The body is empty, do not use HTTP compression
     if (compressed.size() == 0)
     {
+      AddCachingHeaders(HttpCompression_None);
       AnswerEmpty();
     }
     else
     {
+      AddCachingHeaders(compression);
       stateMachine_.AddHeader("Content-Encoding", encoding);
       stateMachine_.SetContentLength(compressed.size());
       stateMachine_.SendBody(compressed.c_str(), compressed.size());
@@ -535,6 +647,85 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::StateMachine::StartStream(const std::string& contentType)
+  {
+    if (state_ != State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (status_ != HttpStatus_200_Ok)
+    {
+      SendBody(NULL, 0);
+      return;
+    }
+
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+
+    if (keepAlive_)
+    {
+      header += "Connection: keep-alive\r\n";
+    }
+    else
+    {
+      header += "Connection: close\r\n";
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      header += *it;
+    }
+
+    // The body is sent using the chunked transfer encoding, whose
+    // terminating chunk lets the client distinguish between a
+    // complete answer and a connection that was interrupted
+    header += ("Content-Type: " + contentType + "\r\n"
+               "Cache-Control: no-cache\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n");
+
+    stream_.Send(true, header.c_str(), header.size());
+    state_ = State_WritingStream;
+  }
+
+
+  void HttpOutput::StateMachine::SendStreamItem(const void* item,
+                                                size_t length)
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (length > 0)
+    {
+      // An empty chunk would signal the end of the body
+      char size[32];
+      sprintf(size, "%lx\r\n", static_cast<unsigned long>(length));
+
+      stream_.Send(false, size, strlen(size));
+      stream_.Send(false, item, length);
+      stream_.Send(false, "\r\n", 2);
+    }
+  }
+
+
+  void HttpOutput::StateMachine::CloseStream()
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    static const char LAST_CHUNK[] = "0\r\n\r\n";
+    stream_.Send(false, LAST_CHUNK, sizeof(LAST_CHUNK) - 1);
+
+    state_ = State_Done;
+  }
+
+
   void HttpOutput::Answer(IHttpStreamAnswer& stream)
   {
     HttpCompression compression = stream.SetupHttpCompression(isGzipAllowed_, isDeflateAllowed_);
@@ -556,7 +747,7 @@ namespace Orthanc
         throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    stateMachine_.SetContentLength(stream.GetContentLength());
+    AddCachingHeaders(compression);
 
     std::string contentType = stream.GetContentType();
     if (contentType.empty())
@@ -564,21 +755,146 @@ namespace Orthanc
       contentType = "application/octet-stream";
     }
 
-    stateMachine_.SetContentType(contentType.c_str());
-
     std::string filename;
     if (stream.HasContentFilename(filename))
     {
       SetContentFilename(filename.c_str());
     }
 
+    const uint64_t length = stream.GetContentLength();
+
+    if (compression == HttpCompression_None)
+    {
+      std::list<HttpToolbox::Range> ranges;
+      if (!requestedRange_.empty() &&
+          HttpToolbox::ParseRanges(ranges, requestedRange_, length))
+      {
+        if (ranges.empty())
+        {
+          stateMachine_.SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+          stateMachine_.AddHeader("Content-Range", "bytes */" + boost::lexical_cast<std::string>(length));
+          stateMachine_.SendBody(NULL, 0);
+          return;
+        }
+
+        if (AnswerRanges(stream, ranges, length, contentType))
+        {
+          return;
+        }
+      }
+
+      if (stream.SetRange(0, length))
+      {
+        stateMachine_.AddHeader("Accept-Ranges", "bytes");
+      }
+    }
+
+    stateMachine_.SetContentLength(length);
+    stateMachine_.SetContentType(contentType.c_str());
+    SendChunks(stream);
+    stateMachine_.CloseBody();
+  }
+
+
+  void HttpOutput::SendChunks(IHttpStreamAnswer& stream)
+  {
     while (stream.ReadNextChunk())
     {
       stateMachine_.SendBody(stream.GetChunkContent(),
                              stream.GetChunkSize());
     }
+  }
+
+
+  static std::string FormatContentRange(const HttpToolbox::Range& range,
+                                        uint64_t length)
+  {
+    return ("bytes " + boost::lexical_cast<std::string>(range.first) + "-" +
+            boost::lexical_cast<std::string>(range.second - 1) + "/" +
+            boost::lexical_cast<std::string>(length));
+  }
+
+
+  bool HttpOutput::AnswerRanges(IHttpStreamAnswer& stream,
+                                const std::list<HttpToolbox::Range>& ranges,
+                                uint64_t length,
+                                const std::string& contentType)
+  {
+    assert(!ranges.empty());
+
+    if (ranges.size() == 1)
+    {
+      const HttpToolbox::Range& range = ranges.front();
+      if (!stream.SetRange(range.first, range.second))
+      {
+        return false;
+      }
+
+      stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+      stateMachine_.AddHeader("Accept-Ranges", "bytes");
+      stateMachine_.AddHeader("Content-Range", FormatContentRange(range, length));
+      stateMachine_.SetContentLength(range.second - range.first);
+      stateMachine_.SetContentType(contentType.c_str());
+      SendChunks(stream);
+      stateMachine_.CloseBody();
+      return true;
+    }
+
+    // Several ranges are sent as "multipart/byteranges" (RFC 7233,
+    // Appendix A). As the ranges can overlap, the full content is
+    // sent instead if they are larger than the content itself.
+    uint64_t total = 0;
+    for (std::list<HttpToolbox::Range>::const_iterator
+           it = ranges.begin(); it != ranges.end(); ++it)
+    {
+      total += it->second - it->first;
+    }
+
+    if (total > length ||
+        !stream.SetRange(ranges.front().first, ranges.front().second))
+    {
+      return false;
+    }
+
+    const std::string boundary = Toolbox::GenerateUuid() + "-" + Toolbox::GenerateUuid();
+
+    std::vector<std::string> headers;
+    headers.reserve(ranges.size());
+
+    for (std::list<HttpToolbox::Range>::const_iterator
+           it = ranges.begin(); it != ranges.end(); ++it)
+    {
+      headers.push_back((headers.empty() ? "" : "\r\n") + std::string("--") + boundary + "\r\n" +
+                        "Content-Type: " + contentType + "\r\n" +
+                        "Content-Range: " + FormatContentRange(*it, length) + "\r\n\r\n");
+      total += headers.back().size();
+    }
+
+    const std::string trailer = "\r\n--" + boundary + "--\r\n";
+    total += trailer.size();
+
+    stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+    stateMachine_.AddHeader("Accept-Ranges", "bytes");
+    stateMachine_.SetContentLength(total);
+    stateMachine_.SetContentType(("multipart/byteranges; boundary=" + boundary).c_str());
+
+    size_t i = 0;
+    for (std::list<HttpToolbox::Range>::const_iterator
+           it = ranges.begin(); it != ranges.end(); ++it, i++)
+    {
+      if (i > 0 &&
+          !stream.SetRange(it->first, it->second))
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      stateMachine_.SendBody(headers[i].c_str(), headers[i].size());
+      SendChunks(stream);
+    }
 
+    stateMachine_.SendBody(trailer.c_str(), trailer.size());
     stateMachine_.CloseBody();
+    return true;
   }
 
 }
@@ -57,6 +57,7 @@ namespace Orthanc
         State_WritingHeader,      
         State_WritingBody,
         State_WritingMultipart,
+        State_WritingStream,
         State_Done
       };
 
@@ -107,6 +108,13 @@ namespace Orthanc
 
       void CloseMultipart();
 
+      void StartStream(const std::string& contentType);
+
+      void SendStreamItem(const void* item,
+                          size_t length);
+
+      void CloseStream();
+
       void CloseBody();
 
       State GetState() const
@@ -118,9 +126,24 @@ namespace Orthanc
     StateMachine stateMachine_;
     bool         isDeflateAllowed_;
     bool         isGzipAllowed_;
+    std::string  requestedRange_;
+    std::string  requestedEntityTags_;
+    std::string  entityTag_;
+    std::string  cacheControl_;
+    std::string  vary_;
 
     HttpCompression GetPreferredCompression(size_t bodySize) const;
 
+    void AddCachingHeaders(HttpCompression compression);
+
+    void SendChunks(IHttpStreamAnswer& stream);
+
+    // Ranges are given as [start, end[ (cf. "HttpToolbox::ParseRanges()")
+    bool AnswerRanges(IHttpStreamAnswer& stream,
+                      const std::list< std::pair<uint64_t, uint64_t> >& ranges,
+                      uint64_t length,
+                      const std::string& contentType);
+
   public:
     HttpOutput(IHttpOutputStream& stream,
                bool isKeepAlive) : 
@@ -150,6 +173,56 @@ namespace Orthanc
       return isGzipAllowed_;
     }
 
+    // Value of the "Range" header of a GET request, that is honored
+    // by Answer(IHttpStreamAnswer&) if the answer can skip bytes
+    void SetRequestedRange(const std::string& range)
+    {
+      requestedRange_ = range;
+    }
+
+    const std::string& GetRequestedRange() const
+    {
+      return requestedRange_;
+    }
+
+    // Value of the "If-None-Match" header of a GET request, that is
+    // checked by SetEntityTag()
+    void SetRequestedEntityTags(const std::string& tags)
+    {
+      requestedEntityTags_ = tags;
+    }
+
+    const std::string& GetRequestedEntityTags() const
+    {
+      return requestedEntityTags_;
+    }
+
+    // Request headers that were used to select the representation of
+    // the answer (e.g. "Accept"), sent as the "Vary" header of the
+    // successful answers and of "304 Not Modified". Must be called
+    // before SetEntityTag().
+    void SetVary(const std::string& headers)
+    {
+      vary_ = headers;
+    }
+
+    const std::string& GetVary() const
+    {
+      return vary_;
+    }
+
+    /**
+     * Conditional GET: Declares the strong entity tag (without its
+     * double quotes) and the "Cache-Control" policy of the answer
+     * that is about to be sent. These headers are only added to a
+     * successful answer, with a suffix in the tag if the body is
+     * sent with HTTP compression. Returns "true" iff the tag matches
+     * the "If-None-Match" header of the request, in which case "304
+     * Not Modified" has been sent and no other answer must be given.
+     **/
+    bool SetEntityTag(const std::string& tag,
+                      const std::string& cacheControl);
+
     void SendStatus(HttpStatus status,
 		    const char* message,
 		    size_t messageSize);
@@ -223,6 +296,30 @@ namespace Orthanc
       return stateMachine_.GetState() == StateMachine::State_WritingMultipart;
     }
 
+    // Streamed answers have no "Content-Length": Their body is sent
+    // with the chunked transfer encoding, and is only complete once
+    // CloseStream() has been invoked
+    void StartStream(const std::string& contentType)
+    {
+      stateMachine_.StartStream(contentType);
+    }
+
+    void SendStreamItem(const void* item,
+                        size_t length)
+    {
+      stateMachine_.SendStreamItem(item, length);
+    }
+
+    void CloseStream()
+    {
+      stateMachine_.CloseStream();
+    }
+
+    bool IsWritingStream() const
+    {
+      return stateMachine_.GetState() == StateMachine::State_WritingStream;
+    }
+
     void Answer(IHttpStreamAnswer& stream);
   };
 }
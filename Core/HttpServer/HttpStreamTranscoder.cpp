@@ -37,6 +37,14 @@
 #include "../OrthancException.h"
 #include "../Compression/ZlibCompressor.h"
 
+#if ORTHANC_ENABLE_LZ4 == 1
+#  include "../Compression/Lz4Compressor.h"
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Compression/ZstdCompressor.h"
+#endif
+
 #include <string.h>   // For memcpy()
 #include <cassert>
 
@@ -97,16 +105,21 @@ namespace Orthanc
     else
     {
       // TODO Use stream-based zlib decoding to reduce memory usage
-      std::string compressed;
-      ReadSource(compressed);
+      ZlibCompressor compressor;
+      return UncompressSource(compressor);
+    }
+  }
 
-      uncompressed_.reset(new BufferHttpSender);
 
-      ZlibCompressor compressor;
-      IBufferCompressor::Uncompress(uncompressed_->GetBuffer(), compressor, compressed);
+  HttpCompression HttpStreamTranscoder::UncompressSource(IBufferCompressor& compressor)
+  {
+    std::string compressed;
+    ReadSource(compressed);
 
-      return HttpCompression_None;
-    }
+    uncompressed_.reset(new BufferHttpSender);
+    IBufferCompressor::Uncompress(uncompressed_->GetBuffer(), compressor, compressed);
+
+    return HttpCompression_None;
   }
 
 
@@ -128,6 +141,25 @@ namespace Orthanc
       case CompressionType_ZlibWithSize:
         return SetupZlibCompression(deflateAllowed);
 
+      // The codecs below are not supported by the HTTP clients, so
+      // the attachment is uncompressed in memory
+
+#if ORTHANC_ENABLE_LZ4 == 1
+      case CompressionType_Lz4WithSize:
+      {
+        Lz4Compressor compressor;
+        return UncompressSource(compressor);
+      }
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+      case CompressionType_ZstdWithSize:
+      {
+        ZstdCompressor compressor;
+        return UncompressSource(compressor);
+      }
+#endif
+
       default:
         throw OrthancException(ErrorCode_NotImplemented);
     }
@@ -248,4 +280,30 @@ namespace Orthanc
       return static_cast<size_t>(source_.GetChunkSize() - currentChunkOffset_);
     }
   }
+
+
+  bool HttpStreamTranscoder::SetRange(uint64_t start,
+                                      uint64_t end)
+  {
+    if (!ready_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (uncompressed_.get() != NULL)
+    {
+      return uncompressed_->SetRange(start, end);
+    }
+    else if (bytesToSkip_ == 0)
+    {
+      // The source is sent as such
+      return source_.SetRange(start, end);
+    }
+    else
+    {
+      // The ranges of a "deflate" stream refer to the compressed
+      // bytes, which is not supported
+      return false;
+    }
+  }
 }
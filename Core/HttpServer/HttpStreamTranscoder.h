@@ -34,6 +34,7 @@
 #pragma once
 
 #include "BufferHttpSender.h"
+#include "../Compression/IBufferCompressor.h"
 
 #include <memory>  // For std::auto_ptr
 
@@ -55,6 +56,8 @@ namespace Orthanc
 
     HttpCompression SetupZlibCompression(bool deflateAllowed);
 
+    HttpCompression UncompressSource(IBufferCompressor& compressor);
+
   public:
     HttpStreamTranscoder(IHttpStreamAnswer& source,
                          CompressionType compression) : 
@@ -88,5 +91,8 @@ namespace Orthanc
     virtual const char* GetChunkContent();
 
     virtual size_t GetChunkSize();
+
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
   };
 }
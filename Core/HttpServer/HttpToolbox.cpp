@@ -225,6 +225,145 @@ namespace Orthanc
   }
 
 
+  static bool ParseRangeBoundary(uint64_t& target,
+                                 const std::string& s)
+  {
+    if (s.empty() ||
+        s.size() > 19)  // Avoid overflows of 64-bit integers
+    {
+      return false;
+    }
+
+    target = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+      if (s[i] < '0' || s[i] > '9')
+      {
+        return false;
+      }
+
+      target = target * 10 + static_cast<uint64_t>(s[i] - '0');
+    }
+
+    return true;
+  }
+
+
+  bool HttpToolbox::ParseRanges(std::list<Range>& ranges,
+                                const std::string& header,
+                                uint64_t size)
+  {
+    ranges.clear();
+
+    std::string s = Toolbox::StripSpaces(header);
+    if (s.size() < 6 ||
+        s.substr(0, 6) != "bytes=")
+    {
+      return false;
+    }
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, s.substr(6), ',');
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+
+      size_t dash = token.find('-');
+      if (dash == std::string::npos)
+      {
+        return false;
+      }
+
+      std::string first = Toolbox::StripSpaces(token.substr(0, dash));
+      std::string last = Toolbox::StripSpaces(token.substr(dash + 1));
+      uint64_t start, end;
+
+      if (first.empty())
+      {
+        // Suffix range: "-500" are the last 500 bytes
+        uint64_t length;
+        if (!ParseRangeBoundary(length, last))
+        {
+          return false;
+        }
+
+        if (length == 0)
+        {
+          continue;  // Not satisfiable
+        }
+
+        start = (length >= size ? 0 : size - length);
+        end = size;
+      }
+      else
+      {
+        if (!ParseRangeBoundary(start, first))
+        {
+          return false;
+        }
+
+        if (last.empty())
+        {
+          end = size;
+        }
+        else if (!ParseRangeBoundary(end, last) ||
+                 end < start)
+        {
+          return false;
+        }
+        else
+        {
+          // The last byte position is inclusive in the header
+          end = (end >= size ? size : end + 1);
+        }
+      }
+
+      if (start < size &&
+          start < end)
+      {
+        ranges.push_back(std::make_pair(start, end));
+      }
+    }
+
+    return true;
+  }
+
+
+  bool HttpToolbox::MatchEntityTag(const std::string& header,
+                                   const std::string& tag)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, header, ',');
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+
+      if (token == "*")
+      {
+        return true;
+      }
+
+      if (token.size() >= 2 &&
+          token.substr(0, 2) == "W/")
+      {
+        token = token.substr(2);
+      }
+
+      if (token.size() == tag.size() + 2 &&
+          token[0] == '"' &&
+          token[token.size() - 1] == '"' &&
+          token.compare(1, tag.size(), tag) == 0)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   bool HttpToolbox::SimpleGet(std::string& result,
                               IHttpHandler& handler,
                               RequestOrigin origin,
@@ -35,6 +35,8 @@
 
 #include "IHttpHandler.h"
 
+#include <list>
+
 namespace Orthanc
 {
   class HttpToolbox
@@ -61,6 +63,29 @@ namespace Orthanc
     static void CompileGetArguments(IHttpHandler::Arguments& compiled,
                                     const IHttpHandler::GetArguments& source);
 
+    // Byte range, with "first" included and "second" excluded
+    typedef std::pair<uint64_t, uint64_t>  Range;
+
+    /**
+     * Parses the value of a "Range" header (RFC 7233), given the size
+     * of the full content. Returns "false" if the syntax is invalid,
+     * in which case the header must be ignored. The ranges that
+     * start after the end of the content are dropped: An empty
+     * "ranges" means that the request cannot be satisfied.
+     **/
+    static bool ParseRanges(std::list<Range>& ranges,
+                            const std::string& header,
+                            uint64_t size);
+
+    /**
+     * Tells whether the value of a "If-None-Match" header (RFC 7232)
+     * lists the given entity tag, which is given without its double
+     * quotes. As required for this header, the weak comparison is
+     * used ("W/" prefixes are ignored), and "*" matches any tag.
+     **/
+    static bool MatchEntityTag(const std::string& header,
+                               const std::string& tag);
+
     static bool SimpleGet(std::string& result,
                           IHttpHandler& handler,
                           RequestOrigin origin,
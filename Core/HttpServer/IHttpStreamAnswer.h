@@ -63,5 +63,17 @@ namespace Orthanc
     virtual const char* GetChunkContent() = 0;
 
     virtual size_t GetChunkSize() = 0;
+
+    // Restricts the next chunks to the bytes in [start, end[ of the
+    // content. This is only invoked on uncompressed answers, either
+    // before the first chunk is read, or once all the chunks of the
+    // previous range have been read (for "multipart/byteranges").
+    // Returns "false" if the answer cannot skip bytes, in which case
+    // the full content is sent.
+    virtual bool SetRange(uint64_t /*start*/,
+                          uint64_t /*end*/)
+    {
+      return false;
+    }
   };
 }
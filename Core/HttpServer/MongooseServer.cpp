@@ -59,6 +59,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
 
 #if !defined(ORTHANC_ENABLE_SSL)
 #  error The macro ORTHANC_ENABLE_SSL must be defined
@@ -323,6 +325,116 @@ namespace Orthanc
 
 
 
+  static bool IsMultipartPost(const IHttpHandler::Arguments& headers)
+  {
+    IHttpHandler::Arguments::const_iterator ct = headers.find("content-type");
+    return (ct != headers.end() &&
+            ct->second.size() >= multipartLength &&
+            !memcmp(ct->second.c_str(), multipart, multipartLength));
+  }
+
+
+  static bool LookupContentLength(uint64_t& length,
+                                  const IHttpHandler::Arguments& headers)
+  {
+    IHttpHandler::Arguments::const_iterator cs = headers.find("content-length");
+    if (cs == headers.end())
+    {
+      return false;
+    }
+
+    try
+    {
+      int64_t value = boost::lexical_cast<int64_t>(cs->second);
+      if (value < 0)
+      {
+        return false;
+      }
+
+      length = static_cast<uint64_t>(value);
+      return true;
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return false;
+    }
+  }
+
+
+  static PostDataStatus ReadBodyToFile(const std::string& path,
+                                       struct mg_connection *connection,
+                                       uint64_t length,
+                                       size_t bufferSize)
+  {
+    boost::filesystem::ofstream f;
+    f.open(path, std::ofstream::out | std::ofstream::binary);
+    if (!f.good())
+    {
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    // The memory that is used by the upload is bounded by the size
+    // of this buffer, whatever the size of the body
+    std::string buffer;
+    buffer.resize(bufferSize);
+
+    while (length > 0)
+    {
+      size_t toRead = (length < bufferSize ? static_cast<size_t>(length) : bufferSize);
+
+      int r = mg_read(connection, &buffer[0], toRead);
+      if (r <= 0)
+      {
+        return PostDataStatus_Failure;
+      }
+
+      assert(static_cast<size_t>(r) <= toRead);
+
+      f.write(buffer.c_str(), r);
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+
+      length -= r;
+    }
+
+    f.close();
+
+    return PostDataStatus_Success;
+  }
+
+
+  namespace
+  {
+    // Removes the uploaded file, unless it has been moved elsewhere
+    // by the upload handler
+    class UploadFileRemover : public boost::noncopyable
+    {
+    private:
+      const std::string& path_;
+
+    public:
+      explicit UploadFileRemover(const std::string& path) :
+        path_(path)
+      {
+      }
+
+      ~UploadFileRemover()
+      {
+        try
+        {
+          boost::filesystem::remove(path_);
+        }
+        catch (boost::filesystem::filesystem_error&)
+        {
+          LOG(ERROR) << "Cannot remove the uploaded file: " << path_;
+        }
+      }
+    };
+  }
+
+
   static PostDataStatus ParseMultipartPost(std::string &completedFile,
                                            struct mg_connection *connection,
                                            const IHttpHandler::Arguments& headers,
@@ -633,6 +745,23 @@ namespace Orthanc
       ConfigureHttpCompression(output, headers);
     }
 
+    if (!strcmp(request->request_method, "GET"))
+    {
+      // Byte ranges, that allow to resume interrupted downloads
+      IHttpHandler::Arguments::const_iterator range = headers.find("range");
+      if (range != headers.end())
+      {
+        output.SetRequestedRange(range->second);
+      }
+
+      // Conditional requests, that allow to revalidate the cached answers
+      IHttpHandler::Arguments::const_iterator tags = headers.find("if-none-match");
+      if (tags != headers.end())
+      {
+        output.SetRequestedEntityTags(tags->second);
+      }
+    }
+
 
     // Extract the GET arguments
     IHttpHandler::GetArguments argumentsGET;
@@ -689,6 +818,54 @@ namespace Orthanc
     }
 
 
+    // Decompose the URI into its components
+    UriComponents uri;
+    try
+    {
+      Toolbox::SplitUriComponents(uri, request->uri);
+    }
+    catch (OrthancException&)
+    {
+      output.SendStatus(HttpStatus_400_BadRequest);
+      return;
+    }
+
+
+    LOG(INFO) << EnumerationToString(method) << " " << Toolbox::FlattenUri(uri);
+
+
+    // Write the large bodies of PUT and POST to a file, if the upload
+    // handler accepts them
+
+    IHttpUploadHandler* uploadHandler = server.GetUploadHandler();
+    if ((method == HttpMethod_Post ||
+         method == HttpMethod_Put) &&
+        uploadHandler != NULL &&
+        server.GetUploadBufferSize() > 0)
+    {
+      uint64_t length;
+      std::string path;
+
+      if (LookupContentLength(length, headers) &&
+          length > server.GetUploadBufferSize() &&
+          !IsMultipartPost(headers) &&
+          uploadHandler->CreateUploadFile(path, method, uri, headers))
+      {
+        UploadFileRemover remover(path);
+
+        if (ReadBodyToFile(path, connection, length, server.GetUploadBufferSize()) != PostDataStatus_Success)
+        {
+          output.SendStatus(HttpStatus_400_BadRequest);
+          return;
+        }
+
+        uploadHandler->HandleUpload(output, RequestOrigin_RestApi, remoteIp, username.c_str(),
+                                    method, uri, headers, path);
+        return;
+      }
+    }
+
+
     // Extract the body of the request for PUT and POST
 
     // TODO Avoid unneccessary memcopy of the body
@@ -739,21 +916,6 @@ namespace Orthanc
     }
 
 
-    // Decompose the URI into its components
-    UriComponents uri;
-    try
-    {
-      Toolbox::SplitUriComponents(uri, request->uri);
-    }
-    catch (OrthancException&)
-    {
-      output.SendStatus(HttpStatus_400_BadRequest);
-      return;
-    }
-
-
-    LOG(INFO) << EnumerationToString(method) << " " << Toolbox::FlattenUri(uri);
-
     bool found = false;
 
     if (server.HasHandler())
@@ -769,6 +931,37 @@ namespace Orthanc
   }
 
 
+  static void ForceConnectionClose(const struct mg_request_info *request)
+  {
+    /**
+     * Neither Mongoose nor Civetweb can be asked to close a connection
+     * from a request handler. However, their keep-alive logic checks
+     * the "Connection" header of the request once the handler has
+     * returned: Overriding it closes the connection.
+     **/
+    static char CONNECTION[] = "Connection";
+    static char CLOSE[] = "close";
+
+    struct mg_request_info* info = const_cast<struct mg_request_info*>(request);
+
+    for (int i = 0; i < info->num_headers; i++)
+    {
+      if (boost::iequals(info->http_headers[i].name, CONNECTION))
+      {
+        info->http_headers[i].value = CLOSE;
+        return;
+      }
+    }
+
+    if (info->num_headers < static_cast<int>(sizeof(info->http_headers) / sizeof(info->http_headers[0])))
+    {
+      info->http_headers[info->num_headers].name = CONNECTION;
+      info->http_headers[info->num_headers].value = CLOSE;
+      info->num_headers++;
+    }
+  }
+
+
   static void ProtectedCallback(struct mg_connection *connection,
                                 const struct mg_request_info *request)
   {
@@ -854,6 +1047,17 @@ namespace Orthanc
           // was already set by the HTTP handler.
         }
       }
+
+      if (output.IsWritingStream())
+      {
+        // A streamed answer has no "Content-Length", and was
+        // interrupted before its terminating chunk. The connection
+        // must be closed, otherwise the client would wait for the
+        // next chunk, and the server would read the next request
+        // from a connection in an unknown state.
+        LOG(ERROR) << "Interrupted streamed HTTP answer, closing the connection";
+        ForceConnectionClose(request);
+      }
     }
     catch (...)
     {
@@ -917,6 +1121,8 @@ namespace Orthanc
     keepAlive_ = false;
     httpCompression_ = true;
     exceptionFormatter_ = NULL;
+    uploadHandler_ = NULL;
+    uploadBufferSize_ = 0;
 
 #if ORTHANC_ENABLE_SSL == 1
     // Check for the Heartbleed exploit
@@ -1089,6 +1295,20 @@ namespace Orthanc
   }
 
 
+  void MongooseServer::SetUploadHandler(IHttpUploadHandler& handler)
+  {
+    Stop();
+    uploadHandler_ = &handler;
+  }
+
+
+  void MongooseServer::SetUploadBufferSize(size_t size)
+  {
+    Stop();
+    uploadBufferSize_ = size;
+  }
+
+
   bool MongooseServer::IsValidBasicHttpAuthentication(const std::string& basic) const
   {
     return registeredUsers_.find(basic) != registeredUsers_.end();
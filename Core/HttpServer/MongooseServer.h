@@ -48,6 +48,7 @@
 
 
 #include "IIncomingHttpRequestFilter.h"
+#include "IHttpUploadHandler.h"
 
 #include "../OrthancException.h"
 
@@ -96,6 +97,8 @@ namespace Orthanc
     bool keepAlive_;
     bool httpCompression_;
     IHttpExceptionFormatter* exceptionFormatter_;
+    IHttpUploadHandler* uploadHandler_;
+    size_t uploadBufferSize_;
   
     bool IsRunning() const;
 
@@ -188,5 +191,22 @@ namespace Orthanc
     {
       return exceptionFormatter_;
     }
+
+    IHttpUploadHandler* GetUploadHandler() const
+    {
+      return uploadHandler_;
+    }
+
+    void SetUploadHandler(IHttpUploadHandler& handler);
+
+    size_t GetUploadBufferSize() const
+    {
+      return uploadBufferSize_;
+    }
+
+    // The bodies that are larger than this size are given to the
+    // upload handler in chunks of this size (0 means that the bodies
+    // are always read into memory)
+    void SetUploadBufferSize(size_t size);
   };
 }
@@ -0,0 +1,127 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "StorageAreaHttpSender.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+
+namespace Orthanc
+{
+  static const size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;  // 4MB
+
+
+
+  StorageAreaHttpSender::StorageAreaHttpSender(IStorageArea& area,
+                                               const std::string& uuid,
+                                               FileContentType type,
+                                               uint64_t size) :
+    area_(area),
+    uuid_(uuid),
+    type_(type),
+    size_(size),
+    start_(0),
+    end_(size),
+    chunkSize_(DEFAULT_CHUNK_SIZE)
+  {
+  }
+
+
+  void StorageAreaHttpSender::SetChunkSize(size_t size)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    chunkSize_ = size;
+  }
+
+
+  bool StorageAreaHttpSender::ReadNextChunk()
+  {
+    if (start_ == end_)
+    {
+      chunk_.clear();
+      return false;
+    }
+
+    if (area_.HasEfficientReadRange())
+    {
+      const uint64_t end = std::min(end_, start_ + static_cast<uint64_t>(chunkSize_));
+      area_.ReadRange(chunk_, uuid_, type_, start_, end);
+      start_ = end;
+    }
+    else if (start_ == 0 &&
+             end_ == size_)
+    {
+      // The whole range is read at once, as the storage area does
+      // not support efficient partial reads
+      area_.Read(chunk_, uuid_, type_);
+
+      if (chunk_.size() != size_)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      start_ = end_;
+    }
+    else
+    {
+      area_.ReadRange(chunk_, uuid_, type_, start_, end_);
+      start_ = end_;
+    }
+
+    return true;
+  }
+
+
+  bool StorageAreaHttpSender::SetRange(uint64_t start,
+                                       uint64_t end)
+  {
+    if (start > end ||
+        end > size_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    start_ = start;
+    end_ = end;
+    chunk_.clear();
+
+    return true;
+  }
+}
@@ -0,0 +1,98 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "HttpFileSender.h"
+#include "../FileStorage/IStorageArea.h"
+
+namespace Orthanc
+{
+  /**
+   * Sends an uncompressed attachment of an arbitrary storage area
+   * (e.g. the packed storage area, or a storage area provided by a
+   * plugin). The content is only read once the first chunk is
+   * requested, so that the ranges of a HTTP "Range" request are read
+   * from the storage area without reading the whole file. If the
+   * storage area supports efficient partial reads, the content is
+   * read by bounded chunks, which bounds the memory that is used by
+   * each download.
+   **/
+  class StorageAreaHttpSender : public HttpFileSender
+  {
+  private:
+    IStorageArea&    area_;
+    std::string      uuid_;
+    FileContentType  type_;
+    uint64_t         size_;
+    uint64_t         start_;   // Start of the next chunk
+    uint64_t         end_;
+    size_t           chunkSize_;
+    std::string      chunk_;
+
+  public:
+    StorageAreaHttpSender(IStorageArea& area,
+                          const std::string& uuid,
+                          FileContentType type,
+                          uint64_t size);
+
+    // Maximum size of the chunks if the storage area supports
+    // efficient partial reads (defaults to 4MB)
+    void SetChunkSize(size_t size);
+
+    /**
+     * Implementation of the IHttpStreamAnswer interface.
+     **/
+
+    virtual uint64_t GetContentLength()
+    {
+      return size_;
+    }
+
+    virtual bool ReadNextChunk();
+
+    virtual const char* GetChunkContent()
+    {
+      return chunk_.c_str();
+    }
+
+    virtual size_t GetChunkSize()
+    {
+      return chunk_.size();
+    }
+
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end);
+  };
+}
@@ -130,6 +130,62 @@ namespace Orthanc
     alreadySent_ = true;
   }
 
+  void RestApiOutput::SetContentFilename(const std::string& filename)
+  {
+    CheckStatus();
+    output_.SetContentFilename(filename.c_str());
+  }
+
+  void RestApiOutput::SetVary(const std::string& headers)
+  {
+    CheckStatus();
+    output_.SetVary(headers);
+  }
+
+  bool RestApiOutput::SetEntityTag(const std::string& tag,
+                                   const std::string& cacheControl)
+  {
+    CheckStatus();
+
+    if (method_ != HttpMethod_Get)
+    {
+      return false;
+    }
+
+    if (output_.SetEntityTag(tag, cacheControl))
+    {
+      alreadySent_ = true;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  void RestApiOutput::StartStream(const std::string& contentType)
+  {
+    CheckStatus();
+    output_.StartStream(contentType);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::SendStreamItem(const std::string& item)
+  {
+    output_.SendStreamItem(item.empty() ? NULL : item.c_str(), item.size());
+  }
+
+  void RestApiOutput::SendStreamItem(const void* item,
+                                     size_t length)
+  {
+    output_.SendStreamItem(item, length);
+  }
+
+  void RestApiOutput::CloseStream()
+  {
+    output_.CloseStream();
+  }
+
   void RestApiOutput::Redirect(const std::string& path)
   {
     CheckStatus();
@@ -144,7 +200,8 @@ namespace Orthanc
     if (status != HttpStatus_400_BadRequest &&
         status != HttpStatus_403_Forbidden &&
         status != HttpStatus_500_InternalServerError &&
-        status != HttpStatus_415_UnsupportedMediaType)
+        status != HttpStatus_415_UnsupportedMediaType &&
+        status != HttpStatus_503_ServiceUnavailable)
     {
       throw OrthancException(ErrorCode_BadHttpStatusInRest);
     }
@@ -81,6 +81,25 @@ namespace Orthanc
                       size_t length,
                       const std::string& contentType);
 
+    void SetContentFilename(const std::string& filename);
+
+    // Content negotiation (cf. HttpOutput::SetVary())
+    void SetVary(const std::string& headers);
+
+    // Conditional GET (cf. HttpOutput::SetEntityTag()). Returns
+    // "true" iff the answer has been sent as "304 Not Modified".
+    bool SetEntityTag(const std::string& tag,
+                      const std::string& cacheControl);
+
+    void StartStream(const std::string& contentType);
+
+    void SendStreamItem(const std::string& item);
+
+    void SendStreamItem(const void* item,
+                        size_t length);
+
+    void CloseStream();
+
     void SignalError(HttpStatus status);
 
     void SignalError(HttpStatus status,
@@ -46,7 +46,10 @@
 
 #if defined(__APPLE__) && defined(__MACH__)
 #  include <mach-o/dyld.h> /* _NSGetExecutablePath */
+#  include <mach/mach_time.h>  /* mach_absolute_time */
 #  include <limits.h>      /* PATH_MAX */
+#else
+#  include <time.h>        /* clock_gettime */
 #endif
 
 
@@ -236,6 +239,52 @@ namespace Orthanc
   }
 
 
+  void SystemToolbox::ReadFileRange(std::string& content,
+                                    const std::string& path,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!IsRegularFile(path))
+    {
+      LOG(ERROR) << "The path does not point to a regular file: " << path;
+      throw OrthancException(ErrorCode_RegularFileExpected);
+    }
+
+    boost::filesystem::ifstream f;
+    f.open(path, std::ifstream::in | std::ifstream::binary);
+    if (!f.good())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    std::streamsize size = GetStreamSize(f);
+    if (size < 0 ||
+        static_cast<uint64_t>(size) < end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    content.resize(static_cast<size_t>(end - start));
+    if (!content.empty())
+    {
+      f.seekg(static_cast<std::streamoff>(start), std::ios::beg);
+      f.read(&content[0], content.size());
+
+      if (f.gcount() != static_cast<std::streamsize>(content.size()))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    f.close();
+  }
+
+
   void SystemToolbox::WriteFile(const void* content,
                                 size_t size,
                                 const std::string& path)
@@ -560,4 +609,34 @@ namespace Orthanc
     sprintf(s, "%02d%02d%02d.%06d", tm.tm_hour, tm.tm_min, tm.tm_sec, 0);
     time.assign(s);
   }
+
+
+  uint64_t SystemToolbox::GetMonotonicMicroseconds()
+  {
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+    if (!QueryPerformanceCounter(&counter) ||
+        !QueryPerformanceFrequency(&frequency))
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    return (static_cast<uint64_t>(counter.QuadPart / frequency.QuadPart) * 1000000 +
+            static_cast<uint64_t>(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+
+#elif defined(__APPLE__) && defined(__MACH__)
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom / 1000;
+
+#else
+    struct timespec t;
+    if (clock_gettime(CLOCK_MONOTONIC, &t) != 0)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    return static_cast<uint64_t>(t.tv_sec) * 1000000 + static_cast<uint64_t>(t.tv_nsec) / 1000;
+#endif
+  }
 }
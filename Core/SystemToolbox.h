@@ -64,6 +64,12 @@ namespace Orthanc
                     const std::string& path,
                     size_t headerSize);
 
+    // Reads the bytes in [start, end[ of the file
+    void ReadFileRange(std::string& content,
+                       const std::string& path,
+                       uint64_t start,
+                       uint64_t end);
+
     void WriteFile(const void* content,
                    size_t size,
                    const std::string& path);
@@ -98,5 +104,9 @@ namespace Orthanc
     void GetNowDicom(std::string& date,
                      std::string& time,
                      bool utc);
+
+    // Clock that is not affected by the changes of the system time,
+    // whose origin is arbitrary (only use it to measure durations)
+    uint64_t GetMonotonicMicroseconds();
   }
 }
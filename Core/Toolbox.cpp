@@ -44,6 +44,7 @@
 #include <boost/uuid/sha1.hpp>
  
 #include <string>
+#include <istream>
 #include <stdint.h>
 #include <string.h>
 #include <algorithm>
@@ -399,6 +400,21 @@ namespace Orthanc
   }
 
 
+  static void FinishMD5(std::string& result,
+                        md5_state_s& state)
+  {
+    md5_byte_t actualHash[16];
+    md5_finish(&state, actualHash);
+
+    result.resize(32);
+    for (unsigned int i = 0; i < 16; i++)
+    {
+      result[2 * i] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] / 16));
+      result[2 * i + 1] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] % 16));
+    }
+  }
+
+
   void Toolbox::ComputeMD5(std::string& result,
                            const void* data,
                            size_t size)
@@ -413,15 +429,38 @@ namespace Orthanc
                  static_cast<int>(size));
     }
 
-    md5_byte_t actualHash[16];
-    md5_finish(&state, actualHash);
+    FinishMD5(result, state);
+  }
 
-    result.resize(32);
-    for (unsigned int i = 0; i < 16; i++)
+
+  void Toolbox::ComputeMD5(std::string& result,
+                           std::istream& source)
+  {
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    md5_state_s state;
+    md5_init(&state);
+
+    std::vector<char> chunk(CHUNK_SIZE);
+
+    while (source.good())
     {
-      result[2 * i] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] / 16));
-      result[2 * i + 1] = GetHexadecimalCharacter(static_cast<uint8_t>(actualHash[i] % 16));
+      source.read(&chunk[0], CHUNK_SIZE);
+
+      if (source.gcount() > 0)
+      {
+        md5_append(&state, 
+                   reinterpret_cast<const md5_byte_t*>(&chunk[0]), 
+                   static_cast<int>(source.gcount()));
+      }
     }
+
+    if (source.bad())
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    FinishMD5(result, state);
   }
 #endif
 
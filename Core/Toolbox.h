@@ -38,6 +38,7 @@
 #include <stdint.h>
 #include <vector>
 #include <string>
+#include <iosfwd>
 #include <json/json.h>
 
 
@@ -129,6 +130,11 @@ namespace Orthanc
     void ComputeMD5(std::string& result,
                     const void* data,
                     size_t size);
+
+    // The stream is read by chunks, which avoids loading large files
+    // into memory
+    void ComputeMD5(std::string& result,
+                    std::istream& source);
 #endif
 
     void ComputeSHA1(std::string& result,
@@ -0,0 +1,417 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ArchiveCache.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+#include "../Core/SystemToolbox.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <memory>
+
+
+namespace Orthanc
+{
+  // Bound on the number of finished archives, to avoid an unbounded
+  // growth of the cache because of the failed or empty archives
+  static const size_t MAX_FINISHED_ARCHIVES = 1000;
+
+
+  static const char* EnumerationToString(ArchiveCache::State state)
+  {
+    switch (state)
+    {
+      case ArchiveCache::State_Running:
+        return "Running";
+
+      case ArchiveCache::State_Success:
+        return "Success";
+
+      case ArchiveCache::State_Failure:
+        return "Failure";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  ArchiveCache::Entry* ArchiveCache::LookupEntry(const std::string& id)
+  {
+    Entries::iterator found = entries_.find(id);
+    if (found == entries_.end())
+    {
+      return NULL;
+    }
+    else
+    {
+      assert(found->second != NULL);
+      return found->second;
+    }
+  }
+
+
+  void ArchiveCache::RemoveInternal(const std::string& id)
+  {
+    // Mutex must be locked
+
+    Entries::iterator found = entries_.find(id);
+    if (found == entries_.end())
+    {
+      return;
+    }
+
+    Entry* entry = found->second;
+    assert(entry != NULL);
+
+    Keys::iterator key = keys_.find(entry->key_);
+    if (key != keys_.end() &&
+        key->second == id)
+    {
+      keys_.erase(key);
+    }
+
+    if (finished_.Contains(id))
+    {
+      finished_.Invalidate(id);
+      assert(currentSize_ >= entry->size_);
+      currentSize_ -= entry->size_;
+    }
+
+    if (entry->state_ == State_Running)
+    {
+      assert(runningSize_ >= entry->expectedSize_);
+      runningSize_ -= entry->expectedSize_;
+    }
+
+    // The temporary file is removed as soon as the last pending
+    // download releases its reference
+    delete entry;
+    entries_.erase(found);
+  }
+
+
+  void ArchiveCache::MakeRoom()
+  {
+    // Mutex must be locked. The most recently used archive is never
+    // removed, even if it is larger than the maximum size.
+
+    while (finished_.GetSize() > 1 &&
+           (currentSize_ > maximumSize_ ||
+            finished_.GetSize() > MAX_FINISHED_ARCHIVES))
+    {
+      std::string oldest = finished_.GetOldest();
+      LOG(INFO) << "Removing archive " << oldest << " from the cache of archives";
+      RemoveInternal(oldest);
+    }
+  }
+
+
+  void ArchiveCache::Finish(const std::string& id,
+                            State state,
+                            ErrorCode error,
+                            const File& file)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* entry = LookupEntry(id);
+    if (entry == NULL)
+    {
+      // The archive was removed while being created
+      return;
+    }
+
+    if (entry->state_ != State_Running)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    assert(runningSize_ >= entry->expectedSize_);
+    runningSize_ -= entry->expectedSize_;
+
+    entry->state_ = state;
+    entry->error_ = error;
+
+    if (state == State_Success)
+    {
+      if (file.get() == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      entry->file_ = file;
+      entry->size_ = SystemToolbox::GetFileSize(file->GetPath());
+      entry->completed_ = entry->total_;
+    }
+    else
+    {
+      // A failed archive must not be returned to further requests
+      // for the same content
+      Keys::iterator key = keys_.find(entry->key_);
+      if (key != keys_.end() &&
+          key->second == id)
+      {
+        keys_.erase(key);
+      }
+    }
+
+    finished_.Add(id);
+    currentSize_ += entry->size_;
+
+    MakeRoom();
+  }
+
+
+  ArchiveCache::ArchiveCache() :
+    maximumSize_(1024 * 1024 * 1024),  // 1GB by default
+    currentSize_(0),
+    runningSize_(0)
+  {
+  }
+
+
+  ArchiveCache::~ArchiveCache()
+  {
+    for (Entries::iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void ArchiveCache::SetMaximumSize(uint64_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSize_ = size;
+    MakeRoom();
+  }
+
+
+  uint64_t ArchiveCache::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maximumSize_;
+  }
+
+
+  ArchiveCache::Registration ArchiveCache::Register(std::string& id,
+                                                    const std::string& key,
+                                                    const std::string& filename,
+                                                    uint64_t expectedSize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Keys::const_iterator existing = keys_.find(key);
+    if (existing != keys_.end())
+    {
+      id = existing->second;
+
+      if (finished_.Contains(id))
+      {
+        finished_.MakeMostRecent(id);
+      }
+
+      return Registration_Existing;
+    }
+
+    if (runningSize_ > 0 &&
+        runningSize_ + expectedSize > maximumSize_)
+    {
+      return Registration_Rejected;
+    }
+
+    if (entries_.find(id) != entries_.end())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    std::auto_ptr<Entry> entry(new Entry);
+    entry->key_ = key;
+    entry->filename_ = filename;
+    entry->creationTime_ = SystemToolbox::GetNowIsoString(false);
+    entry->state_ = State_Running;
+    entry->error_ = ErrorCode_Success;
+    entry->completed_ = 0;
+    entry->total_ = 0;
+    entry->size_ = 0;
+    entry->expectedSize_ = expectedSize;
+
+    entries_[id] = entry.release();
+    keys_[key] = id;
+    runningSize_ += expectedSize;
+
+    return Registration_Created;
+  }
+
+
+  bool ArchiveCache::SetProgress(const std::string& id,
+                                 unsigned int completedInstances,
+                                 unsigned int totalInstances)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* entry = LookupEntry(id);
+    if (entry == NULL)
+    {
+      return false;
+    }
+
+    if (entry->state_ == State_Running)
+    {
+      entry->completed_ = completedInstances;
+      entry->total_ = totalInstances;
+    }
+
+    return true;
+  }
+
+
+  void ArchiveCache::SetSuccess(const std::string& id,
+                                const File& file)
+  {
+    Finish(id, State_Success, ErrorCode_Success, file);
+  }
+
+
+  void ArchiveCache::SetFailure(const std::string& id,
+                                ErrorCode error)
+  {
+    Finish(id, State_Failure, error, File());
+  }
+
+
+  bool ArchiveCache::GetStatus(Json::Value& target,
+                               const std::string& id)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    const Entry* entry = LookupEntry(id);
+    if (entry == NULL)
+    {
+      return false;
+    }
+
+    target = Json::objectValue;
+    target["ID"] = id;
+    target["State"] = EnumerationToString(entry->state_);
+    target["CreationTime"] = entry->creationTime_;
+    target["Filename"] = entry->filename_;
+    target["CompletedInstances"] = entry->completed_;
+    target["TotalInstances"] = entry->total_;
+
+    if (entry->total_ == 0)
+    {
+      target["Progress"] = (entry->state_ == State_Success ? 100 : 0);
+    }
+    else
+    {
+      target["Progress"] = static_cast<unsigned int>(
+        100.0f * static_cast<float>(entry->completed_) / static_cast<float>(entry->total_));
+    }
+
+    if (entry->state_ == State_Success)
+    {
+      target["Size"] = boost::lexical_cast<std::string>(entry->size_);
+    }
+    else if (entry->state_ == State_Failure)
+    {
+      target["ErrorCode"] = static_cast<int>(entry->error_);
+      target["ErrorDescription"] = EnumerationToString(entry->error_);
+    }
+
+    return true;
+  }
+
+
+  bool ArchiveCache::GetArchive(State& state,
+                                File& file,
+                                std::string& filename,
+                                const std::string& id)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    const Entry* entry = LookupEntry(id);
+    if (entry == NULL)
+    {
+      return false;
+    }
+
+    state = entry->state_;
+    filename = entry->filename_;
+
+    if (state == State_Success)
+    {
+      file = entry->file_;
+      finished_.MakeMostRecent(id);
+    }
+    else
+    {
+      file.reset();
+    }
+
+    return true;
+  }
+
+
+  bool ArchiveCache::Remove(const std::string& id)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (entries_.find(id) == entries_.end())
+    {
+      return false;
+    }
+    else
+    {
+      RemoveInternal(id);
+      return true;
+    }
+  }
+
+
+  void ArchiveCache::ListArchives(std::list<std::string>& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target.clear();
+    for (Entries::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      target.push_back(it->first);
+    }
+  }
+}
@@ -0,0 +1,163 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/Enumerations.h"
+#include "../Core/TemporaryFile.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/value.h>
+#include <list>
+#include <map>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Archives (ZIP files and DICOMDIR media) that are created in the
+   * background by the jobs of the scheduler, and that are kept in
+   * temporary files so that they can be downloaded (and resumed)
+   * afterwards. Besides their ID, the archives are indexed by a key
+   * that identifies their content (the requested resources together
+   * with their last update), so that concurrent requests for the same
+   * content share a single archive. The total size of the finished
+   * archives is bounded: The least recently used are removed first,
+   * but the most recent one is always kept. The expected size of the
+   * running archives is bounded by the same budget, the first running
+   * archive being always accepted.
+   **/
+  class ArchiveCache : public boost::noncopyable
+  {
+  public:
+    typedef boost::shared_ptr<TemporaryFile>  File;
+
+    enum State
+    {
+      State_Running,
+      State_Success,
+      State_Failure
+    };
+
+    enum Registration
+    {
+      Registration_Created,   // A new running archive was created
+      Registration_Existing,  // The same content is running or available
+      Registration_Rejected   // The running archives exceed the budget
+    };
+
+  private:
+    struct Entry
+    {
+      std::string   key_;
+      std::string   filename_;
+      std::string   creationTime_;
+      State         state_;
+      ErrorCode     error_;
+      unsigned int  completed_;
+      unsigned int  total_;
+      File          file_;
+      uint64_t      size_;
+      uint64_t      expectedSize_;
+    };
+
+    typedef std::map<std::string, Entry*>       Entries;
+    typedef std::map<std::string, std::string>  Keys;
+
+    boost::mutex                          mutex_;
+    Entries                               entries_;
+    Keys                                  keys_;
+    LeastRecentlyUsedIndex<std::string>   finished_;
+    uint64_t                              maximumSize_;
+    uint64_t                              currentSize_;
+    uint64_t                              runningSize_;   // Expected size of the running archives
+
+    Entry* LookupEntry(const std::string& id);
+
+    void RemoveInternal(const std::string& id);
+
+    void MakeRoom();
+
+    void Finish(const std::string& id,
+                State state,
+                ErrorCode error,
+                const File& file);
+
+  public:
+    ArchiveCache();
+
+    ~ArchiveCache();
+
+    void SetMaximumSize(uint64_t size);
+
+    uint64_t GetMaximumSize();
+
+    // If an archive with the same key is being created or is
+    // available, its ID is stored in "id". Otherwise, a running
+    // archive with the given "id" is created, unless the expected
+    // size of the running archives would exceed the maximum size.
+    Registration Register(std::string& id,
+                          const std::string& key,
+                          const std::string& filename,
+                          uint64_t expectedSize);
+
+    // Returns "false" if the archive has been removed in the meantime
+    bool SetProgress(const std::string& id,
+                     unsigned int completedInstances,
+                     unsigned int totalInstances);
+
+    void SetSuccess(const std::string& id,
+                    const File& file);
+
+    void SetFailure(const std::string& id,
+                    ErrorCode error);
+
+    bool GetStatus(Json::Value& target,
+                   const std::string& id);
+
+    // Returns "false" if the archive is unknown. "file" is only set
+    // if the archive was successfully created.
+    bool GetArchive(State& state,
+                    File& file,
+                    std::string& filename,
+                    const std::string& id);
+
+    bool Remove(const std::string& id);
+
+    void ListArchives(std::list<std::string>& target);
+  };
+}
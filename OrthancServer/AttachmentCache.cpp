@@ -0,0 +1,285 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "AttachmentCache.h"
+
+#include "../Core/OrthancException.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  class AttachmentCache::Shard : public boost::noncopyable
+  {
+  private:
+    boost::mutex  mutex_;
+    LeastRecentlyUsedIndex<std::string, Content>  index_;
+    uint64_t      size_;
+    uint64_t      maximumSize_;
+    uint64_t      hits_;
+    uint64_t      misses_;
+    uint64_t      evictions_;
+
+    // The mutex must be locked
+    void RemoveOldest()
+    {
+      Content content;
+      index_.RemoveOldest(content);
+
+      assert(size_ >= content->size());
+      size_ -= content->size();
+      evictions_ ++;
+    }
+
+    // The mutex must be locked
+    void Shrink()
+    {
+      while (size_ > maximumSize_)
+      {
+        RemoveOldest();
+      }
+    }
+
+  public:
+    Shard() :
+      size_(0),
+      maximumSize_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0)
+    {
+    }
+
+    void SetMaximumSize(uint64_t size)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      maximumSize_ = size;
+      Shrink();
+    }
+
+    bool IsCacheable(uint64_t size)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return size <= maximumSize_;
+    }
+
+    bool Lookup(Content& content,
+                const std::string& uuid)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (maximumSize_ == 0)
+      {
+        return false;
+      }
+
+      if (index_.Contains(uuid, content))
+      {
+        index_.MakeMostRecent(uuid);
+        hits_ ++;
+        return true;
+      }
+      else
+      {
+        misses_ ++;
+        return false;
+      }
+    }
+
+    void Add(const std::string& uuid,
+             const Content& content)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (content->size() > maximumSize_ ||
+          index_.Contains(uuid))
+      {
+        return;
+      }
+
+      index_.Add(uuid, content);
+      size_ += content->size();
+      Shrink();
+    }
+
+    void Invalidate(const std::string& uuid)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (index_.Contains(uuid))
+      {
+        Content content = index_.Invalidate(uuid);
+        assert(size_ >= content->size());
+        size_ -= content->size();
+      }
+    }
+
+    void Clear()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (!index_.IsEmpty())
+      {
+        index_.RemoveOldest();
+      }
+
+      size_ = 0;
+    }
+
+    void AddStatistics(uint64_t& size,
+                       uint64_t& maximumSize,
+                       uint64_t& count,
+                       uint64_t& hits,
+                       uint64_t& misses,
+                       uint64_t& evictions)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      size += size_;
+      maximumSize += maximumSize_;
+      count += index_.GetSize();
+      hits += hits_;
+      misses += misses_;
+      evictions += evictions_;
+    }
+  };
+
+
+  AttachmentCache::Shard& AttachmentCache::GetShard(const std::string& uuid)
+  {
+    // FNV-1a hash of the UUID
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < uuid.size(); i++)
+    {
+      hash = (hash ^ static_cast<uint8_t>(uuid[i])) * 16777619u;
+    }
+
+    return *shards_[hash % shards_.size()];
+  }
+
+
+  AttachmentCache::AttachmentCache(size_t countShards)
+  {
+    if (countShards == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    shards_.resize(countShards);
+    for (size_t i = 0; i < countShards; i++)
+    {
+      shards_[i] = new Shard;
+    }
+  }
+
+
+  AttachmentCache::~AttachmentCache()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      delete shards_[i];
+    }
+  }
+
+
+  void AttachmentCache::SetMaximumSize(uint64_t size)
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i]->SetMaximumSize(size / shards_.size());
+    }
+  }
+
+
+  bool AttachmentCache::IsCacheable(const std::string& uuid,
+                                    uint64_t size)
+  {
+    return GetShard(uuid).IsCacheable(size);
+  }
+
+
+  bool AttachmentCache::Lookup(Content& content,
+                               const std::string& uuid)
+  {
+    return GetShard(uuid).Lookup(content, uuid);
+  }
+
+
+  void AttachmentCache::Add(const std::string& uuid,
+                            const Content& content)
+  {
+    if (content.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    GetShard(uuid).Add(uuid, content);
+  }
+
+
+  void AttachmentCache::Invalidate(const std::string& uuid)
+  {
+    GetShard(uuid).Invalidate(uuid);
+  }
+
+
+  void AttachmentCache::Clear()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i]->Clear();
+    }
+  }
+
+
+  void AttachmentCache::GetStatistics(uint64_t& size,
+                                      uint64_t& maximumSize,
+                                      uint64_t& count,
+                                      uint64_t& hits,
+                                      uint64_t& misses,
+                                      uint64_t& evictions)
+  {
+    size = 0;
+    maximumSize = 0;
+    count = 0;
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i]->AddStatistics(size, maximumSize, count, hits, misses, evictions);
+    }
+  }
+}
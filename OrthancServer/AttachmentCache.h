@@ -0,0 +1,100 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * In-memory cache of the uncompressed content of the attachments,
+   * indexed by the UUID of the attachment in the storage area. As a
+   * given UUID always corresponds to the same content, the cached
+   * buffers are immutable and can be shared between threads without
+   * copy. The cache is bounded by a number of bytes, and is split
+   * into shards (each with its own mutex and its own least recently
+   * used index) so that the concurrent readers seldom contend.
+   **/
+  class AttachmentCache : public boost::noncopyable
+  {
+  public:
+    typedef boost::shared_ptr<const std::string>  Content;
+
+  private:
+    class Shard;
+
+    std::vector<Shard*>  shards_;
+
+    Shard& GetShard(const std::string& uuid);
+
+  public:
+    explicit AttachmentCache(size_t countShards = 16);
+
+    ~AttachmentCache();
+
+    // A size of 0 disables the cache. The budget is evenly split
+    // between the shards, so a single attachment that is larger than
+    // "size / countShards" is never cached.
+    void SetMaximumSize(uint64_t size);
+
+    // Tells whether an attachment of the given size would fit in
+    // the cache, which avoids a useless copy if it would not
+    bool IsCacheable(const std::string& uuid,
+                     uint64_t size);
+
+    bool Lookup(Content& content,
+                const std::string& uuid);
+
+    void Add(const std::string& uuid,
+             const Content& content);
+
+    void Invalidate(const std::string& uuid);
+
+    void Clear();
+
+    void GetStatistics(uint64_t& size,
+                       uint64_t& maximumSize,
+                       uint64_t& count,
+                       uint64_t& hits,
+                       uint64_t& misses,
+                       uint64_t& evictions);
+  };
+}
@@ -0,0 +1,477 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "BinaryDicomAsJson.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+
+#include <string.h>
+
+namespace Orthanc
+{
+  namespace
+  {
+    enum ValueType
+    {
+      ValueType_Null = 0,
+      ValueType_False = 1,
+      ValueType_True = 2,
+      ValueType_Integer = 3,          // Zigzag varint
+      ValueType_UnsignedInteger = 4,  // Varint
+      ValueType_Real = 5,             // IEEE 754, 8 bytes, little-endian
+      ValueType_String = 6,           // Varint length, then the bytes
+      ValueType_InternedString = 7,   // Index in "INTERNED_STRINGS" (1 byte)
+      ValueType_Array = 8,            // Varint count, then the values
+      ValueType_Object = 9            // Varint count, then the keys and values
+    };
+
+    // WARNING: This table is part of the storage format, only append to it
+    static const char* const INTERNED_STRINGS[] = {
+      "Name",
+      "Type",
+      "Value",
+      "String",
+      "Null",
+      "TooLong",
+      "Sequence",
+      "Binary"
+    };
+
+    static const size_t INTERNED_STRINGS_COUNT = sizeof(INTERNED_STRINGS) / sizeof(INTERNED_STRINGS[0]);
+
+    static const char MAGIC[] = { '\0', 'O', 'J', 'B' };
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_SIZE = sizeof(MAGIC) + 1;
+
+    // Protection against the stack overflows on corrupted documents
+    static const unsigned int MAX_DEPTH = 256;
+
+
+    class Writer : public boost::noncopyable
+    {
+    private:
+      std::string&  target_;
+
+    public:
+      Writer(std::string& target) :
+        target_(target)
+      {
+      }
+
+      void WriteByte(uint8_t value)
+      {
+        target_.push_back(static_cast<char>(value));
+      }
+
+      void WriteVarint(uint64_t value)
+      {
+        while (value >= 0x80)
+        {
+          WriteByte(static_cast<uint8_t>(value & 0x7f) | 0x80);
+          value >>= 7;
+        }
+
+        WriteByte(static_cast<uint8_t>(value));
+      }
+
+      void WriteString(const std::string& value)
+      {
+        for (size_t i = 0; i < INTERNED_STRINGS_COUNT; i++)
+        {
+          if (value == INTERNED_STRINGS[i])
+          {
+            WriteByte(ValueType_InternedString);
+            WriteByte(static_cast<uint8_t>(i));
+            return;
+          }
+        }
+
+        WriteByte(ValueType_String);
+        WriteVarint(value.size());
+        target_.append(value);
+      }
+
+      void WriteValue(const Json::Value& value)
+      {
+        switch (value.type())
+        {
+          case Json::nullValue:
+            WriteByte(ValueType_Null);
+            break;
+
+          case Json::booleanValue:
+            WriteByte(value.asBool() ? ValueType_True : ValueType_False);
+            break;
+
+          case Json::intValue:
+          {
+            int64_t v = value.asInt64();
+            WriteByte(ValueType_Integer);
+            WriteVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+            break;
+          }
+
+          case Json::uintValue:
+            WriteByte(ValueType_UnsignedInteger);
+            WriteVarint(value.asUInt64());
+            break;
+
+          case Json::realValue:
+          {
+            double d = value.asDouble();
+            uint64_t v;
+            memcpy(&v, &d, sizeof(v));
+
+            WriteByte(ValueType_Real);
+            for (unsigned int i = 0; i < 8; i++)
+            {
+              WriteByte(static_cast<uint8_t>((v >> (8 * i)) & 0xff));
+            }
+            break;
+          }
+
+          case Json::stringValue:
+            WriteString(value.asString());
+            break;
+
+          case Json::arrayValue:
+            WriteByte(ValueType_Array);
+            WriteVarint(value.size());
+
+            for (Json::Value::ArrayIndex i = 0; i < value.size(); i++)
+            {
+              WriteValue(value[i]);
+            }
+            break;
+
+          case Json::objectValue:
+          {
+            Json::Value::Members members = value.getMemberNames();
+
+            WriteByte(ValueType_Object);
+            WriteVarint(members.size());
+
+            for (size_t i = 0; i < members.size(); i++)
+            {
+              WriteString(members[i]);
+              WriteValue(value[members[i]]);
+            }
+            break;
+          }
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+    };
+
+
+    class Reader : public boost::noncopyable
+    {
+    private:
+      const uint8_t*  data_;
+      size_t          size_;
+      size_t          position_;
+
+      static void ThrowCorrupted()
+      {
+        LOG(ERROR) << "Corrupted binary DICOM-as-JSON summary";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+    public:
+      Reader(const uint8_t* data,
+             size_t size,
+             size_t position) :
+        data_(data),
+        size_(size),
+        position_(position)
+      {
+      }
+
+      size_t GetPosition() const
+      {
+        return position_;
+      }
+
+      bool IsDone() const
+      {
+        return position_ == size_;
+      }
+
+      uint8_t ReadByte()
+      {
+        if (position_ >= size_)
+        {
+          ThrowCorrupted();
+        }
+
+        return data_[position_++];
+      }
+
+      uint64_t ReadVarint()
+      {
+        uint64_t value = 0;
+
+        for (unsigned int shift = 0; shift < 64; shift += 7)
+        {
+          uint8_t b = ReadByte();
+          value |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+          if ((b & 0x80) == 0)
+          {
+            return value;
+          }
+        }
+
+        ThrowCorrupted();
+        return 0;  // Unreachable
+      }
+
+      size_t ReadSize()
+      {
+        uint64_t size = ReadVarint();
+
+        // No item is smaller than one byte
+        if (size > size_ - position_)
+        {
+          ThrowCorrupted();
+        }
+
+        return static_cast<size_t>(size);
+      }
+
+      void ReadStringPayload(std::string& target,
+                             uint8_t type)
+      {
+        if (type == ValueType_InternedString)
+        {
+          uint8_t index = ReadByte();
+          if (index >= INTERNED_STRINGS_COUNT)
+          {
+            ThrowCorrupted();
+          }
+
+          target.assign(INTERNED_STRINGS[index]);
+        }
+        else if (type == ValueType_String)
+        {
+          size_t length = ReadSize();
+          target.assign(reinterpret_cast<const char*>(data_) + position_, length);
+          position_ += length;
+        }
+        else
+        {
+          ThrowCorrupted();
+        }
+      }
+
+      void ReadString(std::string& target)
+      {
+        ReadStringPayload(target, ReadByte());
+      }
+
+      void ReadValue(Json::Value& target,
+                     unsigned int depth)
+      {
+        if (depth > MAX_DEPTH)
+        {
+          ThrowCorrupted();
+        }
+
+        uint8_t type = ReadByte();
+
+        switch (type)
+        {
+          case ValueType_Null:
+            target = Json::nullValue;
+            break;
+
+          case ValueType_False:
+            target = false;
+            break;
+
+          case ValueType_True:
+            target = true;
+            break;
+
+          case ValueType_Integer:
+          {
+            uint64_t v = ReadVarint();
+            target = static_cast<Json::Int64>((v >> 1) ^ (~(v & 1) + 1));
+            break;
+          }
+
+          case ValueType_UnsignedInteger:
+            target = static_cast<Json::UInt64>(ReadVarint());
+            break;
+
+          case ValueType_Real:
+          {
+            uint64_t v = 0;
+            for (unsigned int i = 0; i < 8; i++)
+            {
+              v |= static_cast<uint64_t>(ReadByte()) << (8 * i);
+            }
+
+            double d;
+            memcpy(&d, &v, sizeof(d));
+            target = d;
+            break;
+          }
+
+          case ValueType_String:
+          case ValueType_InternedString:
+          {
+            std::string s;
+            ReadStringPayload(s, type);
+            target = s;
+            break;
+          }
+
+          case ValueType_Array:
+          {
+            size_t count = ReadSize();
+
+            target = Json::arrayValue;
+            target.resize(static_cast<Json::Value::ArrayIndex>(count));
+
+            for (size_t i = 0; i < count; i++)
+            {
+              ReadValue(target[static_cast<Json::Value::ArrayIndex>(i)], depth + 1);
+            }
+            break;
+          }
+
+          case ValueType_Object:
+          {
+            size_t count = ReadSize();
+
+            target = Json::objectValue;
+
+            for (size_t i = 0; i < count; i++)
+            {
+              std::string key;
+              ReadString(key);
+              ReadValue(target[key], depth + 1);
+            }
+            break;
+          }
+
+          default:
+            ThrowCorrupted();
+        }
+      }
+    };
+  }
+
+
+  bool BinaryDicomAsJson::IsBinary(const void* data,
+                                   size_t size)
+  {
+    return (size >= HEADER_SIZE &&
+            memcmp(data, MAGIC, sizeof(MAGIC)) == 0 &&
+            reinterpret_cast<const uint8_t*>(data) [sizeof(MAGIC)] == VERSION);
+  }
+
+
+  void BinaryDicomAsJson::Encode(std::string& target,
+                                 const Json::Value& source)
+  {
+    if (source.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    target.assign(MAGIC, sizeof(MAGIC));
+    target.push_back(static_cast<char>(VERSION));
+
+    Json::Value::Members members = source.getMemberNames();
+
+    Writer writer(target);
+    writer.WriteVarint(members.size());
+
+    std::string value;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+      value.clear();
+      Writer valueWriter(value);
+      valueWriter.WriteValue(source[members[i]]);
+
+      writer.WriteString(members[i]);
+      writer.WriteVarint(value.size());
+      target.append(value);
+    }
+  }
+
+
+  void BinaryDicomAsJson::Decode(Json::Value& target,
+                                 const void* data,
+                                 size_t size)
+  {
+    if (!IsBinary(data, size))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    Reader reader(reinterpret_cast<const uint8_t*>(data), size, HEADER_SIZE);
+
+    target = Json::objectValue;
+
+    size_t count = reader.ReadSize();
+
+    for (size_t i = 0; i < count; i++)
+    {
+      std::string key;
+      reader.ReadString(key);
+
+      size_t length = reader.ReadSize();
+      size_t end = reader.GetPosition() + length;
+
+      reader.ReadValue(target[key], 0);
+
+      if (reader.GetPosition() != end)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+    }
+
+    if (!reader.IsDone())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+  }
+}
@@ -0,0 +1,85 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Compact binary encoding of the "DICOM-as-JSON" summaries, as an
+   * alternative to the styled JSON text. The encoding is lossless
+   * (the decoded JSON is identical to the encoded one), and is
+   * structured as follows (all the integers are unsigned LEB128
+   * varints, unless stated otherwise):
+   *
+   *   document := magic ("\0OJB") version (1 byte) count record*
+   *   record   := key length value
+   *   value    := type (1 byte) payload
+   *
+   * where "key" is a string value (e.g. "0010,0010") and "length" is
+   * the number of bytes of the "value" of the record, which is
+   * checked while decoding. The keys and the strings that are common
+   * in the summaries ("Name", "Type", "Value", "String",
+   * "Sequence"...) are stored as 1-byte references.
+   **/
+  class BinaryDicomAsJson : public boost::noncopyable
+  {
+  public:
+    static bool IsBinary(const void* data,
+                         size_t size);
+
+    static bool IsBinary(const std::string& content)
+    {
+      return IsBinary(content.empty() ? NULL : content.c_str(), content.size());
+    }
+
+    // "source" must be a JSON object
+    static void Encode(std::string& target,
+                       const Json::Value& source);
+
+    static void Decode(Json::Value& target,
+                       const void* data,
+                       size_t size);
+
+    static void Decode(Json::Value& target,
+                       const std::string& content)
+    {
+      Decode(target, content.empty() ? NULL : content.c_str(), content.size());
+    }
+  };
+}
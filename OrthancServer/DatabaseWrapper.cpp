@@ -41,6 +41,7 @@
 
 #include <stdio.h>
 #include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
 
 namespace Orthanc
 {
@@ -123,6 +124,84 @@ namespace Orthanc
       }
     };
 
+    class MatchDicomValue : public SQLite::IScalarFunction
+    {
+    private:
+      // Cache of the last wildcard that was converted to a regular
+      // expression, as the same wildcard is typically matched
+      // against all the rows of the "MainDicomTags" table
+      bool          hasPattern_;
+      std::string   wildcard_;
+      boost::regex  pattern_;
+
+    public:
+      MatchDicomValue() : hasPattern_(false)
+      {
+      }
+
+      virtual const char* GetName() const
+      {
+        return "MatchDicomValue";
+      }
+
+      virtual unsigned int GetCardinality() const
+      {
+        return 4;
+      }
+
+      virtual void Compute(SQLite::FunctionContext& context)
+      {
+        if (context.IsNullValue(3))
+        {
+          context.SetIntResult(0);
+          return;
+        }
+
+        IdentifierConstraintType type = static_cast<IdentifierConstraintType>(context.GetIntValue(0));
+        bool caseSensitive = (context.GetIntValue(1) != 0);
+        std::string expected = context.GetStringValue(2);
+
+        std::string value = context.GetStringValue(3);
+        if (!caseSensitive)
+        {
+          value = Toolbox::ToUpperCaseWithAccents(value);
+        }
+
+        bool match;
+        switch (type)
+        {
+          case IdentifierConstraintType_Equal:
+            match = (value == expected);
+            break;
+
+          case IdentifierConstraintType_SmallerOrEqual:
+            match = (value <= expected);
+            break;
+
+          case IdentifierConstraintType_GreaterOrEqual:
+            match = (value >= expected);
+            break;
+
+          case IdentifierConstraintType_Wildcard:
+            if (!hasPattern_ ||
+                wildcard_ != expected)
+            {
+              pattern_ = boost::regex(Toolbox::WildcardToRegularExpression(expected));
+              wildcard_ = expected;
+              hasPattern_ = true;
+            }
+
+            match = boost::regex_match(value, pattern_);
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        context.SetIntResult(match ? 1 : 0);
+      }
+    };
+
     class SignalRemainingAncestor : public SQLite::IScalarFunction
     {
     private:
@@ -260,7 +339,10 @@ namespace Orthanc
     listener_(NULL), 
     base_(db_),
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    path_(path),
+    readOnly_(false),
+    concurrentReaders_(false)
   {
     db_.Open(path);
   }
@@ -269,31 +351,125 @@ namespace Orthanc
     listener_(NULL), 
     base_(db_),
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    readOnly_(false),
+    concurrentReaders_(false)
   {
     db_.OpenInMemory();
   }
 
+  DatabaseWrapper::DatabaseWrapper(const std::string& path,
+                                   bool readOnly) : 
+    listener_(NULL), 
+    base_(db_),
+    signalRemainingAncestor_(NULL),
+    version_(0),
+    path_(path),
+    readOnly_(readOnly),
+    concurrentReaders_(false)
+  {
+    db_.Open(path);
+  }
+
+  void DatabaseWrapper::SetConcurrentReaders(bool enabled)
+  {
+    if (enabled && path_.empty())
+    {
+      LOG(WARNING) << "Concurrent readers are not available for an in-memory SQLite database";
+      concurrentReaders_ = false;
+    }
+    else
+    {
+      concurrentReaders_ = enabled;
+    }
+  }
+
+
+  static void ExecuteUpgradeScript(SQLite::Connection& db,
+                                   EmbeddedResources::FileResourceId script)
+  {
+    std::string upgrade;
+    EmbeddedResources::GetFileResource(upgrade, script);
+    db.BeginTransaction();
+    db.Execute(upgrade);
+    db.CommitTransaction();    
+  }
+
+
+  static void InstallExtension(SQLite::Connection& db,
+                               bool readOnly,
+                               const char* table,
+                               const char* description,
+                               EmbeddedResources::FileResourceId script)
+  {
+    if (!db.DoesTableExist(table))
+    {
+      if (readOnly)
+      {
+        throw OrthancException(ErrorCode_Database);
+      }
+
+      LOG(WARNING) << "Installing " << description << " in the database, this might take some time";
+      ExecuteUpgradeScript(db, script);
+    }
+  }
+
+
   void DatabaseWrapper::Open()
   {
     db_.Execute("PRAGMA ENCODING=\"UTF-8\";");
 
-    // Performance tuning of SQLite with PRAGMAs
-    // http://www.sqlite.org/pragma.html
-    db_.Execute("PRAGMA SYNCHRONOUS=NORMAL;");
-    db_.Execute("PRAGMA JOURNAL_MODE=WAL;");
-    db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
-    db_.Execute("PRAGMA WAL_AUTOCHECKPOINT=1000;");
-    //db_.Execute("PRAGMA TEMP_STORE=memory");
+    if (readOnly_)
+    {
+      // This connection is only used to read the database, while
+      // another connection is writing to it. Wait for at most 10
+      // seconds if the database is temporarily locked (e.g. by a
+      // checkpoint of the WAL journal).
+      db_.Execute("PRAGMA QUERY_ONLY=1;");
+      db_.Execute("PRAGMA BUSY_TIMEOUT=10000;");
+    }
+    else
+    {
+      // Performance tuning of SQLite with PRAGMAs
+      // http://www.sqlite.org/pragma.html
+      db_.Execute("PRAGMA SYNCHRONOUS=NORMAL;");
+      db_.Execute("PRAGMA JOURNAL_MODE=WAL;");
+
+      if (concurrentReaders_)
+      {
+        db_.Execute("PRAGMA LOCKING_MODE=NORMAL;");
+        db_.Execute("PRAGMA BUSY_TIMEOUT=10000;");
+      }
+      else
+      {
+        db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+      }
+
+      db_.Execute("PRAGMA WAL_AUTOCHECKPOINT=1000;");
+      //db_.Execute("PRAGMA TEMP_STORE=memory");
+    }
 
     if (!db_.DoesTableExist("GlobalProperties"))
     {
+      if (readOnly_)
+      {
+        throw OrthancException(ErrorCode_Database);
+      }
+
       LOG(INFO) << "Creating the database";
       std::string query;
       EmbeddedResources::GetFileResource(query, EmbeddedResources::PREPARE_DATABASE);
       db_.Execute(query);
     }
 
+    // The aggregated statistics and the list of the deleted files are
+    // specific to the SQLite back-end, and do not change the version
+    // of the DB schema
+    InstallExtension(db_, readOnly_, "ResourceStatistics", "the statistics",
+                     EmbeddedResources::UPGRADE_DATABASE_STATISTICS);
+    InstallExtension(db_, readOnly_, "DeletedFiles", "the list of the deleted files",
+                     EmbeddedResources::UPGRADE_DATABASE_DELETED_FILES);
+
     // Check the version of the database
     std::string tmp;
     if (!LookupGlobalProperty(tmp, GlobalProperty_DatabaseSchemaVersion))
@@ -320,17 +496,8 @@ namespace Orthanc
 
     signalRemainingAncestor_ = new Internals::SignalRemainingAncestor;
     db_.Register(signalRemainingAncestor_);
-  }
 
-
-  static void ExecuteUpgradeScript(SQLite::Connection& db,
-                                   EmbeddedResources::FileResourceId script)
-  {
-    std::string upgrade;
-    EmbeddedResources::GetFileResource(upgrade, script);
-    db.BeginTransaction();
-    db.Execute(upgrade);
-    db.CommitTransaction();    
+    db_.Register(new Internals::MatchDicomValue);
   }
 
 
@@ -385,6 +552,20 @@ namespace Orthanc
   }
 
 
+  IDatabaseWrapper* DatabaseWrapper::OpenReadOnlyConnection()
+  {
+    if (readOnly_ ||
+        !concurrentReaders_)
+    {
+      return NULL;
+    }
+
+    std::auto_ptr<DatabaseWrapper> reader(new DatabaseWrapper(path_, true));
+    reader->Open();
+    return reader.release();
+  }
+
+
   void DatabaseWrapper::SetListener(IDatabaseListener& listener)
   {
     listener_ = &listener;
@@ -447,6 +628,179 @@ namespace Orthanc
   }
 
 
+  uint64_t DatabaseWrapper::GetTotalCompressedSize()
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT compressedSize FROM GlobalStatistics");
+    s.Run();
+    return static_cast<uint64_t>(s.ColumnInt64(0));
+  }
+
+    
+  uint64_t DatabaseWrapper::GetTotalUncompressedSize()
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT uncompressedSize FROM GlobalStatistics");
+    s.Run();
+    return static_cast<uint64_t>(s.ColumnInt64(0));
+  }
+
+
+  uint64_t DatabaseWrapper::GetResourceCount(ResourceType resourceType)
+  {
+    std::string column;
+
+    switch (resourceType)
+    {
+      case ResourceType_Patient:
+        column = "countPatients";
+        break;
+
+      case ResourceType_Study:
+        column = "countStudies";
+        break;
+
+      case ResourceType_Series:
+        column = "countSeries";
+        break;
+
+      case ResourceType_Instance:
+        column = "countInstances";
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    // The column name cannot be bound as a parameter, hence the
+    // dynamic statement (which is not cached)
+    SQLite::Statement s(db_, "SELECT " + column + " FROM GlobalStatistics");
+
+    if (!s.Step())
+    {
+      return 0;
+    }
+    else
+    {
+      return static_cast<uint64_t>(s.ColumnInt64(0));
+    }
+  }
+
+
+  bool DatabaseWrapper::GetResourceStatistics(/* out */ uint64_t& compressedSize, 
+                                              /* out */ uint64_t& uncompressedSize, 
+                                              /* out */ unsigned int& countStudies, 
+                                              /* out */ unsigned int& countSeries, 
+                                              /* out */ unsigned int& countInstances, 
+                                              int64_t id)
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT countStudies, countSeries, countInstances, compressedSize, "
+                        "uncompressedSize FROM ResourceStatistics WHERE id=?");
+    s.BindInt64(0, id);
+
+    if (!s.Step())
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    countStudies = static_cast<unsigned int>(s.ColumnInt(0));
+    countSeries = static_cast<unsigned int>(s.ColumnInt(1));
+    countInstances = static_cast<unsigned int>(s.ColumnInt(2));
+    compressedSize = static_cast<uint64_t>(s.ColumnInt64(3));
+    uncompressedSize = static_cast<uint64_t>(s.ColumnInt64(4));
+    return true;
+  }
+
+
+  bool DatabaseWrapper::GetDeletedFiles(std::list<FileInfo>& target,
+                                        uint32_t maxResults)
+  {
+    target.clear();
+
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT uuid, fileType, compressedSize FROM DeletedFiles ORDER BY rowid LIMIT ?");
+    s.BindInt64(0, maxResults);
+
+    while (s.Step())
+    {
+      target.push_back(FileInfo(s.ColumnString(0),
+                                static_cast<FileContentType>(s.ColumnInt(1)),
+                                static_cast<uint64_t>(s.ColumnInt64(2)), ""));
+    }
+
+    return true;
+  }
+
+
+  void DatabaseWrapper::ClearDeletedFile(const std::string& uuid)
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM DeletedFiles WHERE uuid=?");
+    s.BindString(0, uuid);
+    s.Run();
+  }
+
+
+  void DatabaseWrapper::PostponeDeletedFile(const std::string& uuid)
+  {
+    // Replacing the row gives it a new rowid, that is larger than
+    // that of all the other rows
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "INSERT OR REPLACE INTO DeletedFiles "
+                        "SELECT uuid, fileType, compressedSize FROM DeletedFiles WHERE uuid=?");
+    s.BindString(0, uuid);
+    s.Run();
+  }
+
+
+  static uint32_t PruneLog(SQLite::Connection& db,
+                           SQLite::Statement& s,
+                           uint64_t maxCount,
+                           const std::string& minDate,
+                           uint32_t maxResults)
+  {
+    s.BindInt64(0, maxResults);
+    s.BindInt(1, maxCount > 0 ? 1 : 0);
+    s.BindInt64(2, static_cast<int64_t>(maxCount));
+    s.BindString(3, minDate);
+    s.Run();
+
+    return static_cast<uint32_t>(db.GetLastChangeCount());
+  }
+
+
+  // Only the oldest entries are considered, which keeps the cost of
+  // each call bounded by "maxResults", as the dates increase with the
+  // sequence numbers. The comparison "date < ''" is always false.
+
+  bool DatabaseWrapper::PruneChanges(uint32_t& removed /*out*/,
+                                     uint64_t maxCount,
+                                     const std::string& minDate,
+                                     uint32_t maxResults)
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "DELETE FROM Changes WHERE seq IN "
+                        "(SELECT seq FROM Changes ORDER BY seq LIMIT ?) AND "
+                        "seq < (SELECT MAX(seq) FROM Changes) AND "
+                        "((? AND seq <= (SELECT MAX(seq) FROM Changes) - ?) OR date < ?)");
+    removed = PruneLog(db_, s, maxCount, minDate, maxResults);
+    return true;
+  }
+
+
+  bool DatabaseWrapper::PruneExportedResources(uint32_t& removed /*out*/,
+                                               uint64_t maxCount,
+                                               const std::string& minDate,
+                                               uint32_t maxResults)
+  {
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "DELETE FROM ExportedResources WHERE seq IN "
+                        "(SELECT seq FROM ExportedResources ORDER BY seq LIMIT ?) AND "
+                        "seq < (SELECT MAX(seq) FROM ExportedResources) AND "
+                        "((? AND seq <= (SELECT MAX(seq) FROM ExportedResources) - ?) OR date < ?)");
+    removed = PruneLog(db_, s, maxCount, minDate, maxResults);
+    return true;
+  }
+
+
   void DatabaseWrapper::GetChanges(std::list<ServerIndexChange>& target /*out*/,
                                    bool& done /*out*/,
                                    int64_t since,
@@ -59,14 +59,31 @@ namespace Orthanc
     DatabaseWrapperBase base_;
     Internals::SignalRemainingAncestor* signalRemainingAncestor_;
     unsigned int version_;
+    std::string path_;
+    bool readOnly_;
+    bool concurrentReaders_;
 
     void ClearTable(const std::string& tableName);
 
+    DatabaseWrapper(const std::string& path,
+                    bool readOnly);
+
   public:
     DatabaseWrapper(const std::string& path);
 
     DatabaseWrapper();
 
+    // Must be invoked before "Open()". If enabled, the SQLite file is
+    // not locked in exclusive mode, which allows other connections
+    // from "OpenReadOnlyConnection()" to read the database while
+    // this connection is writing to it (thanks to the WAL journal).
+    void SetConcurrentReaders(bool enabled);
+
+    bool HasConcurrentReaders() const
+    {
+      return concurrentReaders_;
+    }
+
     virtual void Open();
 
     virtual void Close()
@@ -235,20 +252,30 @@ namespace Orthanc
       base_.GetLastExportedResource(target);
     }
 
-    virtual uint64_t GetTotalCompressedSize()
-    {
-      return base_.GetTotalCompressedSize();
-    }
+    virtual bool PruneChanges(uint32_t& removed /*out*/,
+                              uint64_t maxCount,
+                              const std::string& minDate,
+                              uint32_t maxResults);
+
+    virtual bool PruneExportedResources(uint32_t& removed /*out*/,
+                                        uint64_t maxCount,
+                                        const std::string& minDate,
+                                        uint32_t maxResults);
+
+    // The 3 following methods read the "GlobalStatistics" table
+    // that is maintained by the triggers of "UpgradeStatistics.sql"
+    virtual uint64_t GetTotalCompressedSize();
     
-    virtual uint64_t GetTotalUncompressedSize()
-    {
-      return base_.GetTotalUncompressedSize();
-    }
+    virtual uint64_t GetTotalUncompressedSize();
 
-    virtual uint64_t GetResourceCount(ResourceType resourceType)
-    {
-      return base_.GetResourceCount(resourceType);
-    }
+    virtual uint64_t GetResourceCount(ResourceType resourceType);
+
+    virtual bool GetResourceStatistics(/* out */ uint64_t& compressedSize, 
+                                       /* out */ uint64_t& uncompressedSize, 
+                                       /* out */ unsigned int& countStudies, 
+                                       /* out */ unsigned int& countSeries, 
+                                       /* out */ unsigned int& countInstances, 
+                                       int64_t id);
 
     virtual void GetAllInternalIds(std::list<int64_t>& target,
                                    ResourceType resourceType)
@@ -331,9 +358,35 @@ namespace Orthanc
       base_.LookupIdentifier(result, level, tag, type, value);
     }
 
+    virtual bool LookupMainDicomTag(std::list<int64_t>& result,
+                                    ResourceType level,
+                                    const DicomTag& tag,
+                                    IdentifierConstraintType type,
+                                    const std::string& value,
+                                    bool caseSensitive)
+    {
+      base_.LookupMainDicomTag(result, level, tag, type, value, caseSensitive);
+      return true;
+    }
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id);
 
+    virtual bool GetDeletedFiles(std::list<FileInfo>& target,
+                                 uint32_t maxResults);
+
+    virtual void ClearDeletedFile(const std::string& uuid);
+
+    virtual void PostponeDeletedFile(const std::string& uuid);
+
+    virtual bool ExpandResources(std::list<ExpandedResource>& target,
+                                 const std::list<std::string>& publicIds,
+                                 ResourceType level)
+    {
+      base_.ExpandResources(target, publicIds, level);
+      return true;
+    }
+
     virtual unsigned int GetDatabaseVersion()
     {
       return version_;
@@ -342,6 +395,8 @@ namespace Orthanc
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea);
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection();
+
 
 
     /**
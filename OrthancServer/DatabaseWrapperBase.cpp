@@ -34,8 +34,11 @@
 #include "PrecompiledHeadersServer.h"
 #include "DatabaseWrapperBase.h"
 
+#include "../Core/Toolbox.h"
+
 #include <stdio.h>
 #include <memory>
+#include <vector>
 
 namespace Orthanc
 {
@@ -728,4 +731,228 @@ namespace Orthanc
       target.push_back(s->ColumnInt64(0));
     }    
   }
+
+
+  void DatabaseWrapperBase::LookupMainDicomTag(std::list<int64_t>& target,
+                                               ResourceType level,
+                                               const DicomTag& tag,
+                                               IdentifierConstraintType type,
+                                               const std::string& value,
+                                               bool caseSensitive)
+  {
+    static const char* COMMON = ("SELECT m.id FROM MainDicomTags AS m, Resources AS r WHERE "
+                                 "m.id = r.internalId AND r.resourceType=? AND "
+                                 "m.tagGroup=? AND m.tagElement=? AND ");
+
+    std::auto_ptr<SQLite::Statement> s;
+
+    if (caseSensitive &&
+        type != IdentifierConstraintType_Wildcard)
+    {
+      // The comparison of UTF-8 strings by SQLite (BINARY collation)
+      // is the same as the one of "std::string"
+      switch (type)
+      {
+        case IdentifierConstraintType_GreaterOrEqual:
+          s.reset(new SQLite::Statement(db_, std::string(COMMON) + "m.value>=?"));
+          break;
+
+        case IdentifierConstraintType_SmallerOrEqual:
+          s.reset(new SQLite::Statement(db_, std::string(COMMON) + "m.value<=?"));
+          break;
+
+        case IdentifierConstraintType_Equal:
+        default:
+          s.reset(new SQLite::Statement(db_, std::string(COMMON) + "m.value=?"));
+          break;
+      }
+
+      s->BindString(3, value);
+    }
+    else
+    {
+      // Neither "GLOB" nor "LIKE" match the semantics of the DICOM
+      // wildcards together with the case-insensitive comparisons
+      s.reset(new SQLite::Statement(db_, std::string(COMMON) + "MatchDicomValue(?, ?, ?, m.value)"));
+      s->BindInt(3, type);
+      s->BindInt(4, caseSensitive ? 1 : 0);
+      s->BindString(5, caseSensitive ? value : Toolbox::ToUpperCaseWithAccents(value));
+    }
+
+    assert(s.get() != NULL);
+
+    s->BindInt(0, level);
+    s->BindInt(1, tag.GetGroup());
+    s->BindInt(2, tag.GetElement());
+
+    target.clear();
+
+    while (s->Step())
+    {
+      target.push_back(s->ColumnInt64(0));
+    }    
+  }
+
+
+  // Upper bound on the number of resources that are expanded by one
+  // set of queries, as the number of parameters in the "IN (...)"
+  // clauses must remain below "SQLITE_MAX_VARIABLE_NUMBER" (999)
+  static const size_t MAX_EXPANDED_RESOURCES = 500;
+
+
+  static std::string FormatPlaceholders(size_t count)
+  {
+    std::string s;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      s += (i == 0 ? "?" : ", ?");
+    }
+
+    return s;
+  }
+
+
+  static void BindInternalIds(SQLite::Statement& s,
+                              int firstParameter,
+                              const std::vector<int64_t>& ids)
+  {
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      s.BindInt64(firstParameter + static_cast<int>(i), ids[i]);
+    }
+  }
+
+
+  static void ExpandResourcesChunk(std::list<ExpandedResource>& target,
+                                   SQLite::Connection& db,
+                                   const std::vector<std::string>& publicIds,
+                                   ResourceType level)
+  {
+    typedef std::map<int64_t, ExpandedResource*>  Index;
+
+    std::list<ExpandedResource> chunk;
+    std::vector<int64_t> ids;
+    Index index;
+
+    {
+      SQLite::Statement s(db, "SELECT r.internalId, r.publicId, p.publicId FROM Resources AS r "
+                          "LEFT JOIN Resources AS p ON p.internalId = r.parentId "
+                          "WHERE r.resourceType=? AND r.publicId IN (" + 
+                          FormatPlaceholders(publicIds.size()) + ")");
+      s.BindInt(0, level);
+      for (size_t i = 0; i < publicIds.size(); i++)
+      {
+        s.BindString(1 + static_cast<int>(i), publicIds[i]);
+      }
+
+      while (s.Step())
+      {
+        chunk.push_back(ExpandedResource(s.ColumnInt64(0), level, s.ColumnString(1)));
+        if (!s.ColumnIsNull(2))
+        {
+          chunk.back().SetParentId(s.ColumnString(2));
+        }
+
+        ids.push_back(s.ColumnInt64(0));
+        index[s.ColumnInt64(0)] = &chunk.back();
+      }
+    }
+
+    if (ids.empty())
+    {
+      return;
+    }
+
+    const std::string in = "IN (" + FormatPlaceholders(ids.size()) + ")";
+
+    if (level != ResourceType_Instance)
+    {
+      SQLite::Statement s(db, "SELECT parentId, publicId FROM Resources WHERE parentId " + in);
+      BindInternalIds(s, 0, ids);
+
+      while (s.Step())
+      {
+        index[s.ColumnInt64(0)]->GetChildren().push_back(s.ColumnString(1));
+      }
+    }
+
+    {
+      SQLite::Statement s(db, "SELECT id, tagGroup, tagElement, value FROM MainDicomTags WHERE id " + in);
+      BindInternalIds(s, 0, ids);
+
+      while (s.Step())
+      {
+        DicomTag tag(static_cast<uint16_t>(s.ColumnInt(1)),
+                     static_cast<uint16_t>(s.ColumnInt(2)));
+        index[s.ColumnInt64(0)]->GetMainDicomTags()[tag] = s.ColumnString(3);
+      }
+    }
+
+    {
+      SQLite::Statement s(db, "SELECT id, type, value FROM Metadata WHERE id " + in);
+      BindInternalIds(s, 0, ids);
+
+      while (s.Step())
+      {
+        MetadataType type = static_cast<MetadataType>(s.ColumnInt(1));
+        index[s.ColumnInt64(0)]->GetMetadata()[type] = s.ColumnString(2);
+      }
+    }
+
+    if (level == ResourceType_Instance)
+    {
+      SQLite::Statement s(db, "SELECT id, uuid, uncompressedSize FROM AttachedFiles "
+                          "WHERE fileType=? AND id " + in);
+      s.BindInt(0, FileContentType_Dicom);
+      BindInternalIds(s, 1, ids);
+
+      while (s.Step())
+      {
+        index[s.ColumnInt64(0)]->SetDicomFile(s.ColumnString(1),
+                                               static_cast<uint64_t>(s.ColumnInt64(2)));
+      }
+    }
+
+    if (level == ResourceType_Series)
+    {
+      SQLite::Statement s(db, "SELECT r.parentId, m.value FROM Resources AS r "
+                          "INNER JOIN Metadata AS m ON m.id = r.internalId "
+                          "WHERE m.type=? AND r.parentId " + in);
+      s.BindInt(0, MetadataType_Instance_IndexInSeries);
+      BindInternalIds(s, 1, ids);
+
+      while (s.Step())
+      {
+        index[s.ColumnInt64(0)]->GetChildrenIndexInSeries().push_back(s.ColumnString(1));
+      }
+    }
+
+    target.splice(target.end(), chunk);
+  }
+
+
+  void DatabaseWrapperBase::ExpandResources(std::list<ExpandedResource>& target,
+                                            const std::list<std::string>& publicIds,
+                                            ResourceType level)
+  {
+    target.clear();
+
+    std::list<std::string>::const_iterator it = publicIds.begin();
+
+    while (it != publicIds.end())
+    {
+      std::vector<std::string> chunk;
+      chunk.reserve(MAX_EXPANDED_RESOURCES);
+
+      while (it != publicIds.end() &&
+             chunk.size() < MAX_EXPANDED_RESOURCES)
+      {
+        chunk.push_back(*it);
+        ++it;
+      }
+
+      ExpandResourcesChunk(target, db_, chunk, level);
+    }
+  }
 }
@@ -38,6 +38,7 @@
 #include "../Core/Enumerations.h"
 #include "../Core/FileStorage/FileInfo.h"
 #include "../Core/SQLite/Connection.h"
+#include "../OrthancServer/ExpandedResource.h"
 #include "../OrthancServer/ExportedResource.h"
 #include "../OrthancServer/ServerIndexChange.h"
 #include "ServerEnumerations.h"
@@ -199,6 +200,20 @@ namespace Orthanc
                           const DicomTag& tag,
                           IdentifierConstraintType type,
                           const std::string& value);
+
+    // The "MatchDicomValue" SQL function must have been registered
+    // in the connection for the case-insensitive and the wildcard
+    // constraints
+    void LookupMainDicomTag(std::list<int64_t>& result,
+                            ResourceType level,
+                            const DicomTag& tag,
+                            IdentifierConstraintType type,
+                            const std::string& value,
+                            bool caseSensitive);
+
+    void ExpandResources(std::list<ExpandedResource>& target,
+                         const std::list<std::string>& publicIds,
+                         ResourceType level);
   };
 }
 
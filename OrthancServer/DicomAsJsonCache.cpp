@@ -0,0 +1,162 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "DicomAsJsonCache.h"
+
+#include "../Core/OrthancException.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  void DicomAsJsonCache::MakeRoom()
+  {
+    while (currentSize_ > maximumSize_)
+    {
+      Entry oldest;
+      index_.RemoveOldest(oldest);
+
+      assert(currentSize_ >= oldest.size_);
+      currentSize_ -= oldest.size_;
+    }
+  }
+
+
+  DicomAsJsonCache::DicomAsJsonCache() :
+    currentSize_(0),
+    maximumSize_(0),
+    generation_(0),
+    hits_(0),
+    misses_(0)
+  {
+  }
+
+
+  void DicomAsJsonCache::SetMaximumSize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSize_ = size;
+    MakeRoom();
+  }
+
+
+  uint64_t DicomAsJsonCache::GetGeneration()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return generation_;
+  }
+
+
+  bool DicomAsJsonCache::Lookup(Content& content,
+                                const std::string& instancePublicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (maximumSize_ == 0)
+    {
+      return false;
+    }
+
+    Entry entry;
+    if (index_.Contains(instancePublicId, entry))
+    {
+      index_.MakeMostRecent(instancePublicId);
+      content = entry.content_;
+      hits_ ++;
+      return true;
+    }
+    else
+    {
+      misses_ ++;
+      return false;
+    }
+  }
+
+
+  void DicomAsJsonCache::Add(const std::string& instancePublicId,
+                             const Content& content,
+                             size_t size,
+                             uint64_t generation)
+  {
+    if (content.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (generation != generation_ ||
+        size > maximumSize_ ||
+        index_.Contains(instancePublicId))
+    {
+      return;
+    }
+
+    index_.Add(instancePublicId, Entry(content, size));
+    currentSize_ += size;
+    MakeRoom();
+  }
+
+
+  void DicomAsJsonCache::Invalidate(const std::string& instancePublicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    generation_ ++;
+
+    if (index_.Contains(instancePublicId))
+    {
+      Entry entry = index_.Invalidate(instancePublicId);
+
+      assert(currentSize_ >= entry.size_);
+      currentSize_ -= entry.size_;
+    }
+  }
+
+
+  void DicomAsJsonCache::GetStatistics(size_t& size,
+                                       size_t& maximumSize,
+                                       size_t& count,
+                                       uint64_t& hits,
+                                       uint64_t& misses)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    size = currentSize_;
+    maximumSize = maximumSize_;
+    count = index_.GetSize();
+    hits = hits_;
+    misses = misses_;
+  }
+}
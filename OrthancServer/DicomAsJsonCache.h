@@ -0,0 +1,120 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/value.h>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Memory-bounded cache of the parsed "DICOM-as-JSON" summaries of
+   * the instances, indexed by the public ID of the instance. The
+   * cached trees are immutable, and are shared with the callers
+   * through reference counting. The size of an entry is estimated
+   * from the size of its serialized JSON.
+   *
+   * As in PublicIdCache, each invalidation increments a generation
+   * counter, and a summary is only added if no instance was
+   * invalidated since the beginning of its read: A reader working
+   * on an instance that is concurrently deleted (then possibly
+   * stored again with other tags) cannot insert an outdated entry.
+   **/
+  class DicomAsJsonCache : public boost::noncopyable
+  {
+  public:
+    typedef boost::shared_ptr<const Json::Value>  Content;
+
+  private:
+    struct Entry
+    {
+      Content  content_;
+      size_t   size_;
+
+      Entry() :
+        size_(0)
+      {
+      }
+
+      Entry(const Content& content,
+            size_t size) :
+        content_(content),
+        size_(size)
+      {
+      }
+    };
+
+    boost::mutex  mutex_;
+    LeastRecentlyUsedIndex<std::string, Entry>  index_;
+    size_t        currentSize_;
+    size_t        maximumSize_;
+    uint64_t      generation_;
+    uint64_t      hits_;
+    uint64_t      misses_;
+
+    // The mutex must be locked
+    void MakeRoom();
+
+  public:
+    DicomAsJsonCache();
+
+    // A size of 0 disables the cache
+    void SetMaximumSize(size_t size);
+
+    uint64_t GetGeneration();
+
+    bool Lookup(Content& content,
+                const std::string& instancePublicId);
+
+    // "generation" must have been read by "GetGeneration()" before
+    // the summary was read from the storage area
+    void Add(const std::string& instancePublicId,
+             const Content& content,
+             size_t size,
+             uint64_t generation);
+
+    void Invalidate(const std::string& instancePublicId);
+
+    void GetStatistics(size_t& size,
+                       size_t& maximumSize,
+                       size_t& count,
+                       uint64_t& hits,
+                       uint64_t& misses);
+  };
+}
@@ -36,6 +36,7 @@
 
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/Logging.h"
+#include "../Core/SystemToolbox.h"
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
@@ -51,37 +52,87 @@ namespace Orthanc
   }
 
 
+  void DicomInstanceToStore::ReadBufferFromFile()
+  {
+    if (!buffer_.HasContent() &&
+        !path_.empty())
+    {
+      buffer_.Allocate();
+      SystemToolbox::ReadFile(buffer_.GetContent(), path_);
+    }
+  }
+
+
   void DicomInstanceToStore::ComputeMissingInformation()
   {
-    if (buffer_.HasContent() &&
+    if ((buffer_.HasContent() || !path_.empty()) &&
         summary_.HasContent() &&
         json_.HasContent())
     {
-      // Fine, everything is available
+      // Fine, everything is available (the content of a DICOM file
+      // stored on the filesystem is only read on demand)
       return; 
     }
     
+    if (!buffer_.HasContent() &&
+        !parsed_.HasContent() &&
+        !path_.empty())
+    {
+      // Only parse the header of the file: The values that are larger
+      // than "DCM_MaxReadLength" (such as the pixel data) are not
+      // loaded into memory
+      DcmFileFormat dicom;
+      if (!dicom.loadFile(path_.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength).good())
+      {
+        LOG(ERROR) << "Cannot parse the DICOM file: " << path_;
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      if (!summary_.HasContent())
+      {
+        summary_.Allocate();
+        FromDcmtkBridge::ExtractDicomSummary(summary_.GetContent(), *dicom.getDataset());
+      }
+
+      if (!json_.HasContent())
+      {
+        json_.Allocate();
+
+        std::set<DicomTag> ignoreTagLength;
+        FromDcmtkBridge::ExtractDicomAsJson(json_.GetContent(), *dicom.getDataset(), ignoreTagLength);
+      }
+
+      return;
+    }
+
     if (!buffer_.HasContent())
     {
-      if (!parsed_.HasContent())
+      if (!path_.empty())
       {
-        if (!summary_.HasContent())
+        ReadBufferFromFile();
+      }
+      else
+      {
+        if (!parsed_.HasContent())
         {
-          throw OrthancException(ErrorCode_NotImplemented);
+          if (!summary_.HasContent())
+          {
+            throw OrthancException(ErrorCode_NotImplemented);
+          }
+          else
+          {
+            parsed_.TakeOwnership(new ParsedDicomFile(summary_.GetConstContent()));
+          }                                
         }
-        else
-        {
-          parsed_.TakeOwnership(new ParsedDicomFile(summary_.GetConstContent()));
-        }                                
-      }
 
-      // Serialize the parsed DICOM file
-      buffer_.Allocate();
-      if (!FromDcmtkBridge::SaveToMemoryBuffer(buffer_.GetContent(), 
-                                               *parsed_.GetContent().GetDcmtkObject().getDataset()))
-      {
-        LOG(ERROR) << "Unable to serialize a DICOM file to a memory buffer";
-        throw OrthancException(ErrorCode_InternalError);
+        // Serialize the parsed DICOM file
+        buffer_.Allocate();
+        if (!FromDcmtkBridge::SaveToMemoryBuffer(buffer_.GetContent(), 
+                                                 *parsed_.GetContent().GetDcmtkObject().getDataset()))
+        {
+          LOG(ERROR) << "Unable to serialize a DICOM file to a memory buffer";
+          throw OrthancException(ErrorCode_InternalError);
+        }
       }
     }
 
@@ -125,6 +176,7 @@ namespace Orthanc
   const char* DicomInstanceToStore::GetBufferData()
   {
     ComputeMissingInformation();
+    ReadBufferFromFile();
     
     if (!buffer_.HasContent())
     {
@@ -145,6 +197,7 @@ namespace Orthanc
   size_t DicomInstanceToStore::GetBufferSize()
   {
     ComputeMissingInformation();
+    ReadBufferFromFile();
     
     if (!buffer_.HasContent())
     {
@@ -280,8 +333,26 @@ namespace Orthanc
   {
     ComputeMissingInformation();
 
+    bool ok;
     DicomMap header;
-    if (DicomMap::ParseDicomMetaInformation(header, GetBufferData(), GetBufferSize()))
+
+    if (!buffer_.HasContent() &&
+        !path_.empty())
+    {
+      // Only read the beginning of the file, that contains the DICOM
+      // meta-information, instead of loading the whole file
+      static const size_t HEADER_SIZE = 64 * 1024;
+
+      std::string start;
+      SystemToolbox::ReadHeader(start, path_, HEADER_SIZE);
+      ok = DicomMap::ParseDicomMetaInformation(header, start.empty() ? NULL : start.c_str(), start.size());
+    }
+    else
+    {
+      ok = DicomMap::ParseDicomMetaInformation(header, GetBufferData(), GetBufferSize());
+    }
+
+    if (ok)
     {
       const DicomValue* value = header.TestAndGetValue(DICOM_TAG_TRANSFER_SYNTAX_UID);
       if (value != NULL &&
@@ -144,6 +144,7 @@ namespace Orthanc
     SmartContainer<ParsedDicomFile>  parsed_;
     SmartContainer<DicomMap>  summary_;
     SmartContainer<Json::Value>  json_;
+    std::string  path_;
 
     RequestOrigin origin_;
     std::string remoteIp_;
@@ -154,6 +155,8 @@ namespace Orthanc
 
     void ComputeMissingInformation();
 
+    void ReadBufferFromFile();
+
   public:
     DicomInstanceToStore() : origin_(RequestOrigin_Unknown)
     {
@@ -184,6 +187,24 @@ namespace Orthanc
       buffer_.SetConstReference(dicom);
     }
 
+    // The DICOM file is stored on the filesystem, and is only read
+    // into memory if its content is actually needed (e.g. if the
+    // summary or the JSON version were not provided)
+    void SetFile(const std::string& path)
+    {
+      path_ = path;
+    }
+
+    bool HasFile() const
+    {
+      return !path_.empty();
+    }
+
+    const std::string& GetFilePath() const
+    {
+      return path_;
+    }
+
     void SetParsedDicomFile(ParsedDicomFile& parsed)
     {
       parsed_.SetReference(parsed);
@@ -0,0 +1,189 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "ServerEnumerations.h"
+#include "../Core/DicomFormat/DicomTag.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * This class gathers the information about one resource that is
+   * needed to expand it in the REST API (parent, children, main DICOM
+   * tags, metadata...). It is filled by the batched lookups of the
+   * database, or by the lookups on individual resources.
+   **/
+  class ExpandedResource
+  {
+  private:
+    int64_t                              internalId_;
+    ResourceType                         type_;
+    std::string                          publicId_;
+    std::string                          parentId_;
+    std::list<std::string>               children_;
+    std::map<DicomTag, std::string>      mainDicomTags_;
+    std::map<MetadataType, std::string>  metadata_;
+    bool                                 hasDicomFile_;
+    std::string                          dicomFileUuid_;
+    uint64_t                             dicomFileSize_;
+    std::list<std::string>               childrenIndexInSeries_;
+
+  public:
+    ExpandedResource(int64_t internalId,
+                     ResourceType type,
+                     const std::string& publicId) :
+      internalId_(internalId),
+      type_(type),
+      publicId_(publicId),
+      hasDicomFile_(false),
+      dicomFileSize_(0)
+    {
+    }
+
+    int64_t GetInternalId() const
+    {
+      return internalId_;
+    }
+
+    ResourceType GetResourceType() const
+    {
+      return type_;
+    }
+
+    const std::string& GetPublicId() const
+    {
+      return publicId_;
+    }
+
+    // Public ID of the parent resource (empty for patients)
+    const std::string& GetParentId() const
+    {
+      return parentId_;
+    }
+
+    void SetParentId(const std::string& parentId)
+    {
+      parentId_ = parentId;
+    }
+
+    // Public IDs of the children resources
+    std::list<std::string>& GetChildren()
+    {
+      return children_;
+    }
+
+    const std::list<std::string>& GetChildren() const
+    {
+      return children_;
+    }
+
+    std::map<DicomTag, std::string>& GetMainDicomTags()
+    {
+      return mainDicomTags_;
+    }
+
+    const std::map<DicomTag, std::string>& GetMainDicomTags() const
+    {
+      return mainDicomTags_;
+    }
+
+    std::map<MetadataType, std::string>& GetMetadata()
+    {
+      return metadata_;
+    }
+
+    const std::map<MetadataType, std::string>& GetMetadata() const
+    {
+      return metadata_;
+    }
+
+    bool LookupMetadata(std::string& value,
+                        MetadataType type) const
+    {
+      std::map<MetadataType, std::string>::const_iterator found = metadata_.find(type);
+
+      if (found == metadata_.end())
+      {
+        return false;
+      }
+      else
+      {
+        value = found->second;
+        return true;
+      }
+    }
+
+    // Only filled for instances
+    void SetDicomFile(const std::string& uuid,
+                      uint64_t uncompressedSize)
+    {
+      hasDicomFile_ = true;
+      dicomFileUuid_ = uuid;
+      dicomFileSize_ = uncompressedSize;
+    }
+
+    bool HasDicomFile() const
+    {
+      return hasDicomFile_;
+    }
+
+    const std::string& GetDicomFileUuid() const
+    {
+      return dicomFileUuid_;
+    }
+
+    uint64_t GetDicomFileSize() const
+    {
+      return dicomFileSize_;
+    }
+
+    // Only filled for series: The "IndexInSeries" metadata of the
+    // child instances that have one (needed to compute the status of
+    // the series)
+    std::list<std::string>& GetChildrenIndexInSeries()
+    {
+      return childrenIndexInSeries_;
+    }
+
+    const std::list<std::string>& GetChildrenIndexInSeries() const
+    {
+      return childrenIndexInSeries_;
+    }
+  };
+}
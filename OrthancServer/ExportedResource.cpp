@@ -41,7 +41,7 @@ namespace Orthanc
   void ExportedResource::Format(Json::Value& item) const
   {
     item = Json::objectValue;
-    item["Seq"] = static_cast<int>(seq_);
+    item["Seq"] = static_cast<Json::Int64>(seq_);
     item["ResourceType"] = EnumerationToString(resourceType_);
     item["ID"] = publicId_;
     item["Path"] = GetBasePath(resourceType_, publicId_);
@@ -38,6 +38,7 @@
 #include "../Core/FileStorage/IStorageArea.h"
 #include "../Core/FileStorage/FileInfo.h"
 #include "IDatabaseListener.h"
+#include "ExpandedResource.h"
 #include "ExportedResource.h"
 
 #include <list>
@@ -81,9 +82,40 @@ namespace Orthanc
 
     virtual bool HasFlushToDisk() const = 0;
 
+    /**
+     * Batched version of the lookups that are needed to expand a list
+     * of resources of the given level in the REST API, with a fixed
+     * number of queries. The public IDs that do not correspond to a
+     * resource of this level are ignored, and the order of "target"
+     * is unspecified. Returns "false" if the database engine does not
+     * support such batched lookups, in which case the caller must
+     * look up each resource individually.
+     **/
+    virtual bool ExpandResources(std::list<ExpandedResource>& target,
+                                 const std::list<std::string>& publicIds,
+                                 ResourceType level) = 0;
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id) = 0;
 
+    /**
+     * Reads the files whose attachments were removed from the index,
+     * but that are still to be removed from the storage area. This
+     * list is persistent, and is updated within the transaction that
+     * removes the attachments. Returns "false" if the database engine
+     * does not maintain such a list, in which case the files must be
+     * removed once the transaction is committed.
+     **/
+    virtual bool GetDeletedFiles(std::list<FileInfo>& target,
+                                 uint32_t maxResults) = 0;
+
+    // Signals that the file was removed from the storage area
+    virtual void ClearDeletedFile(const std::string& uuid) = 0;
+
+    // Moves a file that could not be removed from the storage area at
+    // the end of the list that is read by "GetDeletedFiles()"
+    virtual void PostponeDeletedFile(const std::string& uuid) = 0;
+
     virtual void GetAllInternalIds(std::list<int64_t>& target,
                                    ResourceType resourceType) = 0;
 
@@ -115,6 +147,26 @@ namespace Orthanc
 
     virtual void GetLastExportedResource(std::list<ExportedResource>& target /*out*/) = 0;
 
+    /**
+     * Removes at most "maxResults" of the oldest entries of the
+     * "Changes" log, among those that are not part of the
+     * "maxCount" most recent sequence numbers (0 disables this
+     * criterion), or whose date is before "minDate" (an empty string
+     * disables this criterion). The most recent change is always
+     * kept, so that the last sequence number is still known. Returns
+     * "false" if the database engine cannot prune its logs.
+     **/
+    virtual bool PruneChanges(uint32_t& removed /*out*/,
+                              uint64_t maxCount,
+                              const std::string& minDate,
+                              uint32_t maxResults) = 0;
+
+    // Same as "PruneChanges()", for the log of the exported resources
+    virtual bool PruneExportedResources(uint32_t& removed /*out*/,
+                                        uint64_t maxCount,
+                                        const std::string& minDate,
+                                        uint32_t maxResults) = 0;
+
     virtual void GetMainDicomTags(DicomMap& map,
                                   int64_t id) = 0;
 
@@ -124,6 +176,19 @@ namespace Orthanc
 
     virtual ResourceType GetResourceType(int64_t resourceId) = 0;
 
+    /**
+     * Reads the aggregated statistics about the subtree of the given
+     * resource, the resource itself being included in the counters.
+     * Returns "false" if the database engine does not maintain such
+     * statistics, in which case the caller must walk the subtree.
+     **/
+    virtual bool GetResourceStatistics(/* out */ uint64_t& compressedSize, 
+                                       /* out */ uint64_t& uncompressedSize, 
+                                       /* out */ unsigned int& countStudies, 
+                                       /* out */ unsigned int& countSeries, 
+                                       /* out */ unsigned int& countInstances, 
+                                       int64_t id) = 0;
+
     virtual uint64_t GetTotalCompressedSize() = 0;
     
     virtual uint64_t GetTotalUncompressedSize() = 0;
@@ -156,6 +221,22 @@ namespace Orthanc
                                   IdentifierConstraintType type,
                                   const std::string& value) = 0;
 
+    /**
+     * Lists the resources of the given level whose main DICOM tag
+     * satisfies the constraint. Contrarily to "LookupIdentifier()",
+     * the value is not normalized: The comparison is exact if
+     * "caseSensitive" is true, and is done after the conversion of
+     * both sides by "Toolbox::ToUpperCaseWithAccents()" otherwise.
+     * Returns "false" if the database engine cannot evaluate such
+     * constraints, in which case the caller must filter by itself.
+     **/
+    virtual bool LookupMainDicomTag(std::list<int64_t>& result,
+                                    ResourceType level,
+                                    const DicomTag& tag,
+                                    IdentifierConstraintType type,
+                                    const std::string& value,
+                                    bool caseSensitive) = 0;
+
     virtual bool LookupMetadata(std::string& target,
                                 int64_t id,
                                 MetadataType type) = 0;
@@ -200,5 +281,13 @@ namespace Orthanc
 
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea) = 0;
+
+    /**
+     * Opens an additional, read-only connection to the same
+     * database, that can be used concurrently with this one. Returns
+     * NULL if the database engine does not support this feature. The
+     * returned object is already opened.
+     **/
+    virtual IDatabaseWrapper* OpenReadOnlyConnection() = 0;
   };
 }
@@ -145,8 +145,8 @@ namespace Orthanc
     for (std::list<std::string>::const_iterator
            it = instances.begin(); it != instances.end(); ++it)
     {
-      Json::Value dicom;
-      context.ReadDicomAsJson(dicom, *it);
+      DicomAsJsonCache::Content summary = context.ReadSharedDicomAsJson(*it);
+      const Json::Value& dicom = *summary;
 
       if (dicom.isMember(formatted))
       {
@@ -639,14 +639,28 @@ namespace Orthanc
     assert(resources.size() == instances.size());
     bool complete = true;
 
+    // If the database has evaluated all the constraints, each
+    // candidate is a match, and the limit on the number of results
+    // can be checked before reading its DICOM-as-JSON
+    const bool isExact = !finder.HasUnoptimizedConstraints();
+
     for (size_t i = 0; i < instances.size(); i++)
     {
+      if (isExact &&
+          maxResults != 0 &&
+          answers.GetSize() >= maxResults)
+      {
+        complete = false;
+        break;
+      }
+
       // TODO - Don't read the full JSON from the disk if only "main
       // DICOM tags" are to be returned
-      Json::Value dicom;
-      context_.ReadDicomAsJson(dicom, instances[i]);
+      DicomAsJsonCache::Content summary = context_.ReadSharedDicomAsJson(instances[i]);
+      const Json::Value& dicom = *summary;
       
-      if (finder.IsMatch(dicom))
+      if (isExact ||
+          finder.IsMatch(dicom))
       {
         if (maxResults != 0 &&
             answers.GetSize() >= maxResults)
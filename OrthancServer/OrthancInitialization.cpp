@@ -45,6 +45,7 @@
 #include "../Core/OrthancException.h"
 #include "../Core/Toolbox.h"
 #include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/FileStorage/PackedStorage.h"
 
 #include "ServerEnumerations.h"
 #include "DatabaseWrapper.h"
@@ -1011,7 +1012,13 @@ namespace Orthanc
     {
     }
 
-    return new DatabaseWrapper(indexDirectory.string() + "/index");
+    std::auto_ptr<DatabaseWrapper> db(new DatabaseWrapper(indexDirectory.string() + "/index"));
+
+    // Release the exclusive lock on the SQLite file if the lookups
+    // are allowed to run through additional read-only connections
+    db->SetConcurrentReaders(Configuration::GetGlobalUnsignedIntegerParameter("ConcurrentDatabaseReaders", 0) > 0);
+
+    return db.release();
   }
 
 
@@ -1019,13 +1026,13 @@ namespace Orthanc
   {
     // Anonymous namespace to avoid clashes between compilation modules
 
-    class FilesystemStorageWithoutDicom : public IStorageArea
+    class StorageWithoutDicom : public IStorageArea
     {
     private:
-      FilesystemStorage storage_;
+      std::auto_ptr<IStorageArea> storage_;
 
     public:
-      FilesystemStorageWithoutDicom(const std::string& path) : storage_(path)
+      StorageWithoutDicom(IStorageArea* storage) : storage_(storage)
       {
       }
 
@@ -1036,7 +1043,7 @@ namespace Orthanc
       {
         if (type != FileContentType_Dicom)
         {
-          storage_.Create(uuid, content, size, type);
+          storage_->Create(uuid, content, size, type);
         }
       }
 
@@ -1046,7 +1053,23 @@ namespace Orthanc
       {
         if (type != FileContentType_Dicom)
         {
-          storage_.Read(content, uuid, type);
+          storage_->Read(content, uuid, type);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        if (type != FileContentType_Dicom)
+        {
+          storage_->ReadRange(content, uuid, type, start, end);
         }
         else
         {
@@ -1054,12 +1077,17 @@ namespace Orthanc
         }
       }
 
+      virtual bool HasEfficientReadRange()
+      {
+        return storage_->HasEfficientReadRange();
+      }
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
         if (type != FileContentType_Dicom)
         {
-          storage_.Remove(uuid, type);
+          storage_->Remove(uuid, type);
         }
       }
     };
@@ -1073,14 +1101,30 @@ namespace Orthanc
     boost::filesystem::path storageDirectory = Configuration::InterpretStringParameterAsPath(storageDirectoryStr);
     LOG(WARNING) << "Storage directory: " << storageDirectory;
 
+    std::auto_ptr<IStorageArea> storage;
+
+    if (Configuration::GetGlobalBoolParameter("PackedStorage", false))
+    {
+      uint64_t segmentSize = static_cast<uint64_t>
+        (Configuration::GetGlobalUnsignedIntegerParameter("PackedStorageSegmentSize", 1024)) * 1024 * 1024;
+
+      std::auto_ptr<PackedStorage> packed(new PackedStorage(storageDirectory.string(), segmentSize));
+      packed->SetCompactionRatio(Configuration::GetGlobalUnsignedIntegerParameter("PackedStorageCompactionRatio", 50));
+      storage.reset(packed.release());
+    }
+    else
+    {
+      storage.reset(new FilesystemStorage(storageDirectory.string()));
+    }
+
     if (Configuration::GetGlobalBoolParameter("StoreDicom", true))
     {
-      return new FilesystemStorage(storageDirectory.string());
+      return storage.release();
     }
     else
     {
       LOG(WARNING) << "The DICOM files will not be stored, Orthanc running in index-only mode";
-      return new FilesystemStorageWithoutDicom(storageDirectory.string());
+      return new StorageWithoutDicom(storage.release());
     }
   }
 
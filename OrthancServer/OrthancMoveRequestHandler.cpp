@@ -96,13 +96,12 @@ namespace Orthanc
 
         const std::string& id = instances_[position_++];
 
-        std::string dicom;
-        context_.ReadDicom(dicom, id);
+        AttachmentCache::Content dicom = context_.ReadDicom(id);
 
         {
           ReusableDicomUserConnection::Locker locker
             (context_.GetReusableDicomUserConnection(), localAet_, remote_);
-          locker.GetConnection().Store(dicom, originatorAet_, originatorId_);
+          locker.GetConnection().Store(*dicom, originatorAet_, originatorId_);
         }
 
         return Status_Success;
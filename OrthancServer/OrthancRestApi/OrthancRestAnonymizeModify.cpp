@@ -102,9 +102,13 @@ namespace Orthanc
   {
     std::string id = call.GetUriComponent("id", "");
 
-    ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), id);
+    std::auto_ptr<ParsedDicomFile> modified;
+
+    {
+      ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), id);
+      modified.reset(locker.GetDicom().Clone(true));
+    }
 
-    std::auto_ptr<ParsedDicomFile> modified(locker.GetDicom().Clone(true));
     modification.Apply(*modified);
     modified->Answer(call.GetOutput());
   }
@@ -163,6 +167,11 @@ namespace Orthanc
        **/
 
       std::auto_ptr<ParsedDicomFile> modified(original.Clone(true));
+
+      // Release the original instance, so that other threads can
+      // access it while the modified instance is being stored
+      locker.reset(NULL);
+
       modification.Apply(*modified);
 
       DicomInstanceToStore toStore;
@@ -39,12 +39,12 @@
 
 namespace Orthanc
 {
-  void OrthancRestApi::AnswerStoredResource(RestApiPostCall& call,
+  void OrthancRestApi::FormatStoredResource(Json::Value& result,
                                             const std::string& publicId,
                                             ResourceType resourceType,
-                                            StoreStatus status) const
+                                            StoreStatus status)
   {
-    Json::Value result = Json::objectValue;
+    result = Json::objectValue;
 
     if (status != StoreStatus_Failure)
     {
@@ -53,6 +53,16 @@ namespace Orthanc
     }
 
     result["Status"] = EnumerationToString(status);
+  }
+
+
+  void OrthancRestApi::AnswerStoredResource(RestApiPostCall& call,
+                                            const std::string& publicId,
+                                            ResourceType resourceType,
+                                            StoreStatus status) const
+  {
+    Json::Value result;
+    FormatStoredResource(result, publicId, resourceType, status);
     call.GetOutput().AnswerJson(result);
   }
 
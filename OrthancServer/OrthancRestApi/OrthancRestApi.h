@@ -96,5 +96,10 @@ namespace Orthanc
                               const std::string& publicId,
                               ResourceType resourceType,
                               StoreStatus status) const;
+
+    static void FormatStoredResource(Json::Value& result,
+                                     const std::string& publicId,
+                                     ResourceType resourceType,
+                                     StoreStatus status);
   };
 }
@@ -37,11 +37,17 @@
 #include "../../Core/DicomParsing/DicomDirWriter.h"
 #include "../../Core/FileStorage/StorageAccessor.h"
 #include "../../Core/Compression/HierarchicalZipWriter.h"
+#include "../../Core/Compression/ZipStreamPipeline.h"
 #include "../../Core/HttpServer/FilesystemHttpSender.h"
 #include "../../Core/Logging.h"
 #include "../../Core/TemporaryFile.h"
+#include "../OrthancInitialization.h"
+#include "../Scheduler/ServerJob.h"
 #include "../ServerContext.h"
+#include "../StorageCompressionAdvisor.h"
 
+#include <fstream>
+#include <set>
 #include <stdio.h>
 
 #if defined(_MSC_VER)
@@ -424,11 +430,216 @@ namespace Orthanc
     };
 
 
+    class ArchiveOutputStream : public ZipStreamWriter::IOutputStream
+    {
+    private:
+      RestApiOutput&  output_;
+      std::string     filename_;
+      bool            isStarted_;
+
+    public:
+      ArchiveOutputStream(RestApiOutput& output,
+                          const std::string& filename) :
+        output_(output),
+        filename_(filename),
+        isStarted_(false)
+      {
+      }
+
+      virtual void Write(const void* data,
+                         size_t size)
+      {
+        if (!isStarted_)
+        {
+          // The HTTP header is only sent together with the first
+          // bytes of the archive, so that the errors that occur
+          // while reading the first instances are still reported
+          // with a proper HTTP status
+          output_.SetContentFilename(filename_);
+          output_.StartStream("application/zip");
+          isStarted_ = true;
+        }
+
+        output_.SendStreamItem(data, size);
+      }
+
+      void Close()
+      {
+        if (isStarted_)
+        {
+          output_.CloseStream();
+        }
+      }
+    };
+
+
+    class FileOutputStream : public ZipStreamWriter::IOutputStream
+    {
+    private:
+      std::ofstream  file_;
+
+    public:
+      FileOutputStream(const std::string& path)
+      {
+        file_.open(path.c_str(), std::ofstream::out | std::ofstream::binary);
+        if (!file_.good())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+
+      virtual void Write(const void* data,
+                         size_t size)
+      {
+        file_.write(reinterpret_cast<const char*>(data), size);
+        if (!file_.good())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+
+      void Close()
+      {
+        file_.close();
+        if (file_.fail())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+    };
+
+
+    // Progress of an archive that is created in the background
+    class ArchiveProgress : public boost::noncopyable
+    {
+    private:
+      ArchiveCache&  cache_;
+      std::string    id_;
+      unsigned int   completed_;
+      unsigned int   total_;
+
+      void Update()
+      {
+        if (!cache_.SetProgress(id_, completed_, total_))
+        {
+          // The archive was deleted by the user: Stop its creation
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
+
+    public:
+      ArchiveProgress(ArchiveCache& cache,
+                      const std::string& id) :
+        cache_(cache),
+        id_(id),
+        completed_(0),
+        total_(0)
+      {
+      }
+
+      void SetTotal(unsigned int total)
+      {
+        total_ = total;
+        Update();
+      }
+
+      void SignalInstanceCompleted()
+      {
+        completed_ ++;
+        Update();
+      }
+    };
+
+
+    class ArchivePipeline : public ZipStreamPipeline
+    {
+    private:
+      bool              storeCompressedDicom_;
+      ArchiveProgress*  progress_;
+
+    public:
+      ArchivePipeline(HierarchicalZipWriter& writer,
+                      ArchiveProgress* progress) :
+        ZipStreamPipeline(writer, 
+                          std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("ArchiveReaderThreads", 4)),
+                          std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("ArchiveCompressionThreads", 4)),
+                          std::max(1u, Configuration::GetGlobalUnsignedIntegerParameter("ArchiveReadAhead", 16))),
+        storeCompressedDicom_(Configuration::GetGlobalBoolParameter("ArchiveStoreCompressedDicom", true)),
+        progress_(progress)
+      {
+      }
+
+      bool IsStoreCompressedDicom() const
+      {
+        return storeCompressedDicom_;
+      }
+
+      void SignalInstanceCompleted()
+      {
+        if (progress_ != NULL)
+        {
+          progress_->SignalInstanceCompleted();
+        }
+      }
+    };
+
+
+    class InstanceFile : public ZipStreamPipeline::IFile
+    {
+    private:
+      ServerContext&    context_;
+      FileInfo          dicom_;
+      ArchivePipeline&  pipeline_;
+
+      static bool IsCompressedDicom(const std::string& content)
+      {
+        DicomMap header;
+        if (DicomMap::ParseDicomMetaInformation(header, content.empty() ? NULL : content.c_str(), content.size()))
+        {
+          const DicomValue* value = header.TestAndGetValue(DICOM_TAG_TRANSFER_SYNTAX_UID);
+          return (value != NULL &&
+                  !value->IsBinary() &&
+                  !value->IsNull() &&
+                  StorageCompressionAdvisor::IsCompressedTransferSyntax(Toolbox::StripSpaces(value->GetContent())));
+        }
+        else
+        {
+          return false;
+        }
+      }
+
+    public:
+      InstanceFile(ServerContext& context,
+                   const FileInfo& dicom,
+                   ArchivePipeline& pipeline) :
+        context_(context),
+        dicom_(dicom),
+        pipeline_(pipeline)
+      {
+      }
+
+      virtual void Read(std::string& content,
+                        bool& compress)
+      {
+        context_.ReadAttachment(content, dicom_);
+
+        // Deflating JPEG, JPEG-LS, JPEG 2000... pixel data is a waste of CPU
+        compress = !(pipeline_.IsStoreCompressedDicom() && IsCompressedDicom(content));
+      }
+
+      virtual void Complete()
+      {
+        pipeline_.SignalInstanceCompleted();
+      }
+    };
+
+
     class ArchiveWriterVisitor : public IArchiveVisitor
     {
     private:
       HierarchicalZipWriter&  writer_;
-      ServerContext&            context_;
+      ArchivePipeline&        pipeline_;
+      ServerContext&          context_;
       char                    instanceFormat_[24];
       unsigned int            countInstances_;
 
@@ -450,8 +661,10 @@ namespace Orthanc
 
     public:
       ArchiveWriterVisitor(HierarchicalZipWriter& writer,
+                           ArchivePipeline& pipeline,
                            ServerContext& context) :
         writer_(writer),
+        pipeline_(pipeline),
         context_(context),
         countInstances_(0)
       {
@@ -524,66 +737,77 @@ namespace Orthanc
       virtual void AddInstance(const std::string& instanceId,
                                const FileInfo& dicom)
       {
-        std::string content;
-        context_.ReadAttachment(content, dicom);
-
         char filename[24];
         snprintf(filename, sizeof(filename) - 1, instanceFormat_, countInstances_);
         countInstances_ ++;
 
-        writer_.OpenFile(filename);
-        writer_.Write(content);
+        // The instance is read and compressed by the threads of the pipeline
+        pipeline_.AddFile(filename, new InstanceFile(context_, dicom, pipeline_));
       }
 
-      static void Apply(RestApiOutput& output,
+      static void Apply(HierarchicalZipWriter& writer,
                         ServerContext& context,
-                        ArchiveIndex& archive,
-                        const std::string& filename)
+                        const ArchiveIndex& archive,
+                        ArchiveProgress* progress)
       {
-        archive.Expand(context.GetIndex());
-
-        StatisticsVisitor stats;
-        archive.Apply(stats);
-
-        const bool isZip64 = IsZip64Required(stats.GetUncompressedSize(), stats.GetInstancesCount());
+        ArchivePipeline pipeline(writer, progress);
+        ArchiveWriterVisitor v(writer, pipeline, context);
+        archive.Apply(v);
+        pipeline.Flush();
+      }
+    };
 
-        // Create a RAII for the temporary file to manage the ZIP file
-        TemporaryFile tmp;
+    
+    class MediaWriterVisitor : public IArchiveVisitor
+    {
+    private:
+      class MediaFile : public InstanceFile
+      {
+      private:
+        DicomDirWriter&                 dicomDir_;
+        std::string                     filename_;
+        std::auto_ptr<ParsedDicomFile>  parsed_;
+
+      public:
+        MediaFile(ServerContext& context,
+                  const FileInfo& dicom,
+                  ArchivePipeline& pipeline,
+                  DicomDirWriter& dicomDir,
+                  const std::string& filename) :
+          InstanceFile(context, dicom, pipeline),
+          dicomDir_(dicomDir),
+          filename_(filename)
+        {
+        }
 
+        virtual void Read(std::string& content,
+                          bool& compress)
         {
-          // Create a ZIP writer
-          HierarchicalZipWriter writer(tmp.GetPath().c_str());
-          writer.SetZip64(isZip64);
+          InstanceFile::Read(content, compress);
 
-          ArchiveWriterVisitor v(writer, context);
-          archive.Apply(v);
+          // Parsing is done by the reader threads too
+          parsed_.reset(new ParsedDicomFile(content));
         }
 
-        // Prepare the sending of the ZIP file
-        FilesystemHttpSender sender(tmp.GetPath());
-        sender.SetContentType("application/zip");
-        sender.SetContentFilename(filename);
-
-        // Send the ZIP
-        output.AnswerStream(sender);
+        virtual void Complete()
+        {
+          // The DICOMDIR is filled in the order of the instances
+          dicomDir_.Add("IMAGES", filename_, *parsed_);
+          parsed_.reset(NULL);
 
-        // The temporary file is automatically removed thanks to the RAII
-      }
-    };
+          InstanceFile::Complete();
+        }
+      };
 
-    
-    class MediaWriterVisitor : public IArchiveVisitor
-    {
-    private:
-      HierarchicalZipWriter&  writer_;
+      ArchivePipeline&        pipeline_;
       DicomDirWriter          dicomDir_;
       ServerContext&          context_;
       unsigned int            countInstances_;
 
     public:
-      MediaWriterVisitor(HierarchicalZipWriter& writer,
+      MediaWriterVisitor(ArchivePipeline& pipeline,
                          ServerContext& context) :
-        writer_(writer),
+        pipeline_(pipeline),
         context_(context),
         countInstances_(0)
       {
@@ -610,126 +834,342 @@ namespace Orthanc
         // characters (some systems wrongly use 8.3, but this does not
         // conform to the standard)."
         std::string filename = "IM" + boost::lexical_cast<std::string>(countInstances_);
-        writer_.OpenFile(filename.c_str());
-
-        std::string content;
-        context_.ReadAttachment(content, dicom);
-        writer_.Write(content);
-
-        ParsedDicomFile parsed(content);
-        dicomDir_.Add("IMAGES", filename, parsed);
+        pipeline_.AddFile(filename.c_str(), new MediaFile(context_, dicom, pipeline_, dicomDir_, filename));
 
         countInstances_ ++;
       }
 
-      static void Apply(RestApiOutput& output,
+      static void Apply(HierarchicalZipWriter& writer,
                         ServerContext& context,
-                        ArchiveIndex& archive,
-                        const std::string& filename,
-                        bool enableExtendedSopClass)
+                        const ArchiveIndex& archive,
+                        bool enableExtendedSopClass,
+                        ArchiveProgress* progress)
       {
-        archive.Expand(context.GetIndex());
-
-        StatisticsVisitor stats;
-        archive.Apply(stats);
+        writer.OpenDirectory("IMAGES");
 
-        const bool isZip64 = IsZip64Required(stats.GetUncompressedSize(), stats.GetInstancesCount());
-
-        // Create a RAII for the temporary file to manage the ZIP file
-        TemporaryFile tmp;
+        std::string s;
 
         {
-          // Create a ZIP writer
-          HierarchicalZipWriter writer(tmp.GetPath().c_str());
-          writer.SetZip64(isZip64);
-          writer.OpenDirectory("IMAGES");
-
           // Create a DICOMDIR writer
-          MediaWriterVisitor v(writer, context);
+          ArchivePipeline pipeline(writer, progress);
+          MediaWriterVisitor v(pipeline, context);
 
           // Request type-3 arguments to be added to the DICOMDIR
           v.dicomDir_.EnableExtendedSopClass(enableExtendedSopClass);
 
           archive.Apply(v);
+          pipeline.Flush();
 
-          // Add the DICOMDIR
-          writer.CloseDirectory();
-          writer.OpenFile("DICOMDIR");
-          std::string s;
           v.EncodeDicomDir(s);
-          writer.Write(s);
         }
 
-        // Prepare the sending of the ZIP file
-        FilesystemHttpSender sender(tmp.GetPath());
-        sender.SetContentType("application/zip");
-        sender.SetContentFilename(filename);
+        // Add the DICOMDIR
+        writer.CloseDirectory();
+        writer.OpenFile("DICOMDIR");
+        writer.Write(s);
+      }
+    };
+
+
+    enum ArchiveType
+    {
+      ArchiveType_Zip,
+      ArchiveType_Media,
+      ArchiveType_MediaExtended
+    };
+
+
+    // "archive" must have been expanded
+    static void WriteArchive(ZipStreamWriter::IOutputStream& stream,
+                             ServerContext& context,
+                             const ArchiveIndex& archive,
+                             ArchiveType type,
+                             ArchiveProgress* progress)
+    {
+      StatisticsVisitor stats;
+      archive.Apply(stats);
+
+      if (progress != NULL)
+      {
+        progress->SetTotal(stats.GetInstancesCount());
+      }
+
+      // As the local headers of the streamed ZIP file cannot be
+      // modified afterwards, ZIP64 is chosen from the statistics
+      HierarchicalZipWriter writer(stream);
+      writer.SetZip64(IsZip64Required(stats.GetUncompressedSize(), stats.GetInstancesCount()));
+
+      switch (type)
+      {
+        case ArchiveType_Zip:
+          ArchiveWriterVisitor::Apply(writer, context, archive, progress);
+          break;
+
+        case ArchiveType_Media:
+          MediaWriterVisitor::Apply(writer, context, archive, false, progress);
+          break;
+
+        case ArchiveType_MediaExtended:
+          MediaWriterVisitor::Apply(writer, context, archive, true, progress);
+          break;
 
-        // Send the ZIP
-        output.AnswerStream(sender);
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      writer.Close();
+    }
+
+
+    class CreateArchiveCommand : public IServerCommand
+    {
+    private:
+      ServerContext&               context_;
+      std::string                  id_;
+      std::auto_ptr<ArchiveIndex>  archive_;
+      ArchiveType                  type_;
 
-        // The temporary file is automatically removed thanks to the RAII
+    public:
+      CreateArchiveCommand(ServerContext& context,
+                           const std::string& id,
+                           ArchiveIndex* archive,  // Takes ownership
+                           ArchiveType type) :
+        context_(context),
+        id_(id),
+        archive_(archive),
+        type_(type)
+      {
+      }
+
+      virtual bool Apply(ListOfStrings& outputs,
+                         const ListOfStrings& inputs)
+      {
+        ArchiveCache& cache = context_.GetArchiveCache();
+
+        // The cache must always be notified of the end of the job,
+        // otherwise the archive would be reported as running forever
+        try
+        {
+          ArchiveCache::File file(new TemporaryFile("zip"));
+
+          {
+            FileOutputStream stream(file->GetPath());
+            ArchiveProgress progress(cache, id_);
+            WriteArchive(stream, context_, *archive_, type_, &progress);
+            stream.Close();
+          }
+
+          LOG(INFO) << "Archive " << id_ << " has been created";
+          cache.SetSuccess(id_, file);
+          return true;
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot create archive " << id_ << ": " << e.What();
+          cache.SetFailure(id_, e.GetErrorCode());
+        }
+        catch (std::bad_alloc&)
+        {
+          LOG(ERROR) << "Not enough memory to create archive " << id_;
+          cache.SetFailure(id_, ErrorCode_NotEnoughMemory);
+        }
+        catch (...)
+        {
+          LOG(ERROR) << "Native exception while creating archive " << id_;
+          cache.SetFailure(id_, ErrorCode_InternalError);
+        }
+
+        return false;
       }
     };
   }
 
 
-  static bool AddResourcesOfInterest(ArchiveIndex& archive,
-                                     RestApiPostCall& call)
+  static void StreamArchive(RestApiOutput& output,
+                            ServerContext& context,
+                            ArchiveIndex& archive,
+                            ArchiveType type,
+                            const std::string& filename)
   {
-    ServerIndex& index = OrthancRestApi::GetIndex(call);
+    archive.Expand(context.GetIndex());
 
-    Json::Value resources;
-    if (call.ParseJsonRequest(resources) &&
-        resources.type() == Json::arrayValue)
+    // The ZIP file is directly streamed to the HTTP client, as it is
+    // being created
+    ArchiveOutputStream stream(output, filename);
+    WriteArchive(stream, context, archive, type, NULL);
+    stream.Close();
+  }
+
+
+  static std::string ComputeArchiveKey(ServerIndex& index,
+                                       const std::set<std::string>& resources,
+                                       const StatisticsVisitor& stats,
+                                       ArchiveType type)
+  {
+    // The content of the archive is identified by the requested
+    // resources together with their last update (instances are never
+    // modified). The statistics catch the deleted instances.
+    std::string s = (boost::lexical_cast<std::string>(type) + "|" +
+                     boost::lexical_cast<std::string>(stats.GetInstancesCount()) + "|" +
+                     boost::lexical_cast<std::string>(stats.GetUncompressedSize()));
+
+    for (std::set<std::string>::const_iterator
+           it = resources.begin(); it != resources.end(); ++it)
     {
-      for (Json::Value::ArrayIndex i = 0; i < resources.size(); i++)
+      std::string lastUpdate;
+      if (!index.LookupMetadata(lastUpdate, *it, MetadataType_LastUpdate))
       {
-        if (resources[i].type() != Json::stringValue)
-        {
-          return false;   // Bad request
-        }
+        lastUpdate.clear();
+      }
+
+      s += "|" + *it + "=" + lastUpdate;
+    }
 
-        ResourceIdentifiers resource(index, resources[i].asString());
-        archive.Add(index, resource);
+    std::string key;
+    Toolbox::ComputeSHA1(key, s);
+    return key;
+  }
+
+
+  static void SubmitArchive(RestApiPostCall& call,
+                            std::auto_ptr<ArchiveIndex>& archive,
+                            const std::set<std::string>& resources,
+                            ArchiveType type,
+                            const std::string& filename)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    ArchiveCache& cache = context.GetArchiveCache();
+
+    archive->Expand(context.GetIndex());
+
+    StatisticsVisitor stats;
+    archive->Apply(stats);
+
+    const std::string key = ComputeArchiveKey(context.GetIndex(), resources, stats, type);
+
+    // The identifier of the archive is the one of its job, unless
+    // an archive with the same content already exists. The
+    // uncompressed size of the instances bounds the size of the
+    // archive, which is reserved in the cache while it is created.
+    ServerJob job;
+    std::string id = job.GetId();
+
+    ArchiveCache::Registration registration = cache.Register(id, key, filename, stats.GetUncompressedSize());
+
+    if (registration == ArchiveCache::Registration_Rejected)
+    {
+      LOG(WARNING) << "Too many archives are being created, rejecting a new one";
+      call.GetOutput().SignalError(HttpStatus_503_ServiceUnavailable);
+      return;
+    }
+    else if (registration == ArchiveCache::Registration_Created)
+    {
+      job.AddCommand(new CreateArchiveCommand(context, id, archive.release(), type));
+      job.SetDescription("HTTP request: Creation of archive " + id);
+
+      try
+      {
+        context.GetScheduler().Submit(job);
+      }
+      catch (...)
+      {
+        cache.Remove(id);
+        throw;
       }
+    }
+    else
+    {
+      LOG(INFO) << "Reusing archive " << id << " for the same content";
+    }
 
-      return true;
+    Json::Value answer = Json::objectValue;
+    answer["ID"] = id;
+    answer["Path"] = "/archives/" + id;
+    call.GetOutput().AnswerJson(answer);
+  }
+
+
+  static bool AddResourcesOfInterest(ArchiveIndex& archive,
+                                     std::set<std::string>& resources,
+                                     bool& asynchronous,
+                                     RestApiPostCall& call)
+  {
+    ServerIndex& index = OrthancRestApi::GetIndex(call);
+
+    // The body is either the list of the resources of interest, or
+    // an object with the "Resources" and "Asynchronous" fields
+    Json::Value request;
+    if (!call.ParseJsonRequest(request))
+    {
+      return false;
+    }
+
+    Json::Value items;
+    if (request.type() == Json::arrayValue)
+    {
+      items = request;
+      asynchronous = false;
+    }
+    else if (request.type() == Json::objectValue &&
+             request.isMember("Resources") &&
+             request["Resources"].type() == Json::arrayValue)
+    {
+      items = request["Resources"];
+      asynchronous = Toolbox::GetJsonBooleanField(request, "Asynchronous", false);
     }
     else
     {
       return false;
     }
+
+    for (Json::Value::ArrayIndex i = 0; i < items.size(); i++)
+    {
+      if (items[i].type() != Json::stringValue)
+      {
+        return false;   // Bad request
+      }
+
+      ResourceIdentifiers resource(index, items[i].asString());
+      archive.Add(index, resource);
+      resources.insert(items[i].asString());
+    }
+
+    return true;
   }
 
 
-  static void CreateBatchArchive(RestApiPostCall& call)
+  static void CreateBatch(RestApiPostCall& call,
+                          ArchiveType type)
   {
-    ArchiveIndex archive(ResourceType_Patient);  // root
+    std::auto_ptr<ArchiveIndex> archive(new ArchiveIndex(ResourceType_Patient));  // root
+    std::set<std::string> resources;
+    bool asynchronous;
 
-    if (AddResourcesOfInterest(archive, call))
+    if (AddResourcesOfInterest(*archive, resources, asynchronous, call))
     {
-      ArchiveWriterVisitor::Apply(call.GetOutput(),
-                                  OrthancRestApi::GetContext(call),
-                                  archive,
-                                  "Archive.zip");
+      if (asynchronous)
+      {
+        SubmitArchive(call, archive, resources, type, "Archive.zip");
+      }
+      else
+      {
+        StreamArchive(call.GetOutput(), OrthancRestApi::GetContext(call),
+                      *archive, type, "Archive.zip");
+      }
     }
+  }
+
+
+  static void CreateBatchArchive(RestApiPostCall& call)
+  {
+    CreateBatch(call, ArchiveType_Zip);
   }  
 
   
   template <bool Extended>
   static void CreateBatchMedia(RestApiPostCall& call)
   {
-    ArchiveIndex archive(ResourceType_Patient);  // root
-
-    if (AddResourcesOfInterest(archive, call))
-    {
-      MediaWriterVisitor::Apply(call.GetOutput(),
-                                OrthancRestApi::GetContext(call),
-                                archive,
-                                "Archive.zip",
-                                Extended);
-    }
+    CreateBatch(call, Extended ? ArchiveType_MediaExtended : ArchiveType_Media);
   }  
 
 
@@ -743,10 +1183,8 @@ namespace Orthanc
     ArchiveIndex archive(ResourceType_Patient);  // root
     archive.Add(OrthancRestApi::GetIndex(call), resource);
 
-    ArchiveWriterVisitor::Apply(call.GetOutput(),
-                                OrthancRestApi::GetContext(call),
-                                archive,
-                                id + ".zip");
+    StreamArchive(call.GetOutput(), OrthancRestApi::GetContext(call),
+                  archive, ArchiveType_Zip, id + ".zip");
   }
 
 
@@ -760,11 +1198,75 @@ namespace Orthanc
     ArchiveIndex archive(ResourceType_Patient);  // root
     archive.Add(OrthancRestApi::GetIndex(call), resource);
 
-    MediaWriterVisitor::Apply(call.GetOutput(),
-                              OrthancRestApi::GetContext(call),
-                              archive,
-                              id + ".zip",
-                              call.HasArgument("extended"));
+    StreamArchive(call.GetOutput(), OrthancRestApi::GetContext(call), archive,
+                  call.HasArgument("extended") ? ArchiveType_MediaExtended : ArchiveType_Media,
+                  id + ".zip");
+  }
+
+
+  static void ListArchives(RestApiGetCall& call)
+  {
+    std::list<std::string> archives;
+    OrthancRestApi::GetContext(call).GetArchiveCache().ListArchives(archives);
+
+    Json::Value answer = Json::arrayValue;
+    for (std::list<std::string>::const_iterator
+           it = archives.begin(); it != archives.end(); ++it)
+    {
+      answer.append(*it);
+    }
+
+    call.GetOutput().AnswerJson(answer);
+  }
+
+
+  static void GetArchiveStatus(RestApiGetCall& call)
+  {
+    Json::Value status;
+    if (OrthancRestApi::GetContext(call).GetArchiveCache().GetStatus(status, call.GetUriComponent("id", "")))
+    {
+      call.GetOutput().AnswerJson(status);
+    }
+  }
+
+
+  static void DownloadArchive(RestApiGetCall& call)
+  {
+    ArchiveCache::State state;
+    ArchiveCache::File file;
+    std::string filename;
+
+    if (OrthancRestApi::GetContext(call).GetArchiveCache().GetArchive(state, file, filename, call.GetUriComponent("id", "")))
+    {
+      if (state != ArchiveCache::State_Success)
+      {
+        // The archive is still being created, or its creation failed
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      // The temporary file is kept alive until the end of the
+      // download, even if the archive is removed from the cache
+      // meanwhile. The sender can be seeked, so "Range" requests are
+      // allowed to resume interrupted downloads.
+      FilesystemHttpSender sender(file->GetPath());
+      sender.SetContentType("application/zip");
+      sender.SetContentFilename(filename);
+      call.GetOutput().AnswerStream(sender);
+    }
+  }
+
+
+  static void DeleteArchive(RestApiDeleteCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    std::string id = call.GetUriComponent("id", "");
+
+    if (context.GetArchiveCache().Remove(id))
+    {
+      // A running job notices the removal at its next instance
+      context.GetScheduler().Cancel(id);
+      call.GetOutput().AnswerBuffer("", "text/plain");
+    }
   }
 
 
@@ -781,5 +1283,10 @@ namespace Orthanc
     Register("/tools/create-archive", CreateBatchArchive);
     Register("/tools/create-media", CreateBatchMedia<false>);
     Register("/tools/create-media-extended", CreateBatchMedia<true>);
+
+    Register("/archives", ListArchives);
+    Register("/archives/{id}", GetArchiveStatus);
+    Register("/archives/{id}", DeleteArchive);
+    Register("/archives/{id}/archive", DownloadArchive);
   }
 }
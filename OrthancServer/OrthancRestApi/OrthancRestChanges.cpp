@@ -35,6 +35,7 @@
 #include "OrthancRestApi.h"
 
 #include "../ServerContext.h"
+#include "../../Core/Logging.h"
 
 namespace Orthanc
 {
@@ -71,11 +72,42 @@ namespace Orthanc
     }
   }
 
+  static void GetChangesFilters(std::set<ChangeType>& changeTypes,
+                                std::set<ResourceType>& levels,
+                                const RestApiGetCall& call)
+  {
+    // The filters are comma-separated lists, e.g. "?type=StableStudy,StableSeries&level=Study"
+    std::vector<std::string> tokens;
+
+    Toolbox::TokenizeString(tokens, call.GetArgument("type", ""), ',');
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+      if (!token.empty())
+      {
+        changeTypes.insert(StringToChangeType(token));
+      }
+    }
+
+    Toolbox::TokenizeString(tokens, call.GetArgument("level", ""), ',');
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+      if (!token.empty())
+      {
+        levels.insert(StringToResourceType(token.c_str()));
+      }
+    }
+  }
+
+
   static void GetChanges(RestApiGetCall& call)
   {
+    // Maximum duration of a long polling (in seconds)
+    static const unsigned int MAX_WAIT = 60;
+
     ServerContext& context = OrthancRestApi::GetContext(call);
 
-    //std::string filter = GetArgument(getArguments, "filter", "");
     int64_t since;
     unsigned int limit;
     bool last;
@@ -85,16 +117,175 @@ namespace Orthanc
     if (last)
     {
       context.GetIndex().GetLastChange(result);
+      call.GetOutput().AnswerJson(result);
+      return;
     }
-    else
+
+    std::set<ChangeType> changeTypes;
+    std::set<ResourceType> levels;
+    GetChangesFilters(changeTypes, levels, call);
+
+    unsigned int wait = boost::lexical_cast<unsigned int>(call.GetArgument("wait", "0"));
+    if (wait > MAX_WAIT)
+    {
+      wait = MAX_WAIT;
+    }
+
+    const boost::posix_time::ptime deadline = (boost::posix_time::microsec_clock::universal_time() +
+                                               boost::posix_time::seconds(wait));
+
+    // The number of changes is read before the query, so that no
+    // change can be missed while waiting
+    uint64_t count = context.GetChangesCount();
+    context.GetIndex().GetChanges(result, since, limit, changeTypes, levels);
+
+    // Long polling: Wait for new changes if all the changes have
+    // been scanned without finding a match
+    while (result["Changes"].size() == 0 &&
+           result["Done"].asBool())
     {
-      context.GetIndex().GetChanges(result, since, limit);
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      if (now >= deadline ||
+          !context.WaitForChanges(count, (deadline - now).total_milliseconds()))
+      {
+        break;
+      }
+
+      since = result["Last"].asInt64();
+      context.GetIndex().GetChanges(result, since, limit, changeTypes, levels);
     }
 
     call.GetOutput().AnswerJson(result);
   }
 
 
+  namespace
+  {
+    // Registers a client of the stream of changes for the lifetime
+    // of the HTTP request
+    class ChangesStreamClient : public boost::noncopyable
+    {
+    private:
+      ServerContext& context_;
+      bool           accepted_;
+
+    public:
+      ChangesStreamClient(ServerContext& context) :
+        context_(context),
+        accepted_(context.AddChangesStreamClient())
+      {
+      }
+
+      ~ChangesStreamClient()
+      {
+        if (accepted_)
+        {
+          context_.RemoveChangesStreamClient();
+        }
+      }
+
+      bool IsAccepted() const
+      {
+        return accepted_;
+      }
+    };
+  }
+
+
+  static void StreamChanges(RestApiGetCall& call)
+  {
+    static const unsigned int MAX_RESULTS = 100;
+
+    // Period of the comments that are sent to keep the connection
+    // open, and to detect the clients that have left (in milliseconds)
+    static const unsigned int HEARTBEAT = 15000;
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    ChangesStreamClient client(context);
+    if (!client.IsAccepted())
+    {
+      LOG(WARNING) << "Too many clients of the stream of changes, rejecting a new one";
+      call.GetOutput().SignalError(HttpStatus_503_ServiceUnavailable);
+      return;
+    }
+
+    std::set<ChangeType> changeTypes;
+    std::set<ResourceType> levels;
+    GetChangesFilters(changeTypes, levels, call);
+
+    uint64_t count = context.GetChangesCount();
+
+    // By default, only stream the changes that occur from now on
+    int64_t since;
+    if (call.HasArgument("since"))
+    {
+      since = boost::lexical_cast<int64_t>(call.GetArgument("since", ""));
+    }
+    else
+    {
+      Json::Value last;
+      context.GetIndex().GetLastChange(last);
+      since = last["Last"].asInt64();
+    }
+
+    // Server-sent events, one event per change (each connection
+    // occupies one HTTP thread for as long as it is open)
+    call.GetOutput().StartStream("text/event-stream");
+
+    try
+    {
+      Json::FastWriter writer;
+
+      for (;;)
+      {
+        Json::Value changes;
+        context.GetIndex().GetChanges(changes, since, MAX_RESULTS, changeTypes, levels);
+
+        std::string events;
+        for (Json::Value::ArrayIndex i = 0; i < changes["Changes"].size(); i++)
+        {
+          const Json::Value& change = changes["Changes"][i];
+          events += ("id: " + boost::lexical_cast<std::string>(change["Seq"].asInt64()) + "\n" +
+                     "event: change\n" +
+                     "data: " + writer.write(change) + "\n");
+        }
+
+        if (!events.empty())
+        {
+          call.GetOutput().SendStreamItem(events);
+        }
+
+        since = changes["Last"].asInt64();
+
+        if (changes["Done"].asBool() &&
+            !context.WaitForChanges(count, HEARTBEAT))
+        {
+          if (context.IsChangesFeedClosed())
+          {
+            break;
+          }
+
+          call.GetOutput().SendStreamItem(": heartbeat\n\n");
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      if (e.GetErrorCode() == ErrorCode_NetworkProtocol)
+      {
+        LOG(INFO) << "A client of the stream of changes has left";
+      }
+      else
+      {
+        LOG(ERROR) << "Error in the stream of changes: " << e.What();
+      }
+    }
+
+    call.GetOutput().CloseStream();
+  }
+
+
   static void DeleteChanges(RestApiDeleteCall& call)
   {
     OrthancRestApi::GetIndex(call).DeleteChanges();
@@ -138,6 +329,7 @@ namespace Orthanc
   {
     Register("/changes", GetChanges);
     Register("/changes", DeleteChanges);
+    Register("/changes/stream", StreamChanges);
     Register("/exports", GetExports);
     Register("/exports", DeleteExports);
   }
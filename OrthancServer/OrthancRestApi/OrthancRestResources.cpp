@@ -37,9 +37,12 @@
 #include "../../Core/Compression/GzipCompressor.h"
 #include "../../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../../Core/DicomParsing/Internals/DicomImageDecoder.h"
+#include "../../Core/FileStorage/StorageAccessor.h"
 #include "../../Core/HttpServer/HttpContentNegociation.h"
 #include "../../Core/Logging.h"
 #include "../OrthancInitialization.h"
+#include "../Scheduler/ChangeCompressionCommand.h"
+#include "../Scheduler/ConvertDicomAsJsonCommand.h"
 #include "../Search/LookupResource.h"
 #include "../ServerContext.h"
 #include "../ServerToolbox.h"
@@ -94,18 +97,16 @@ namespace Orthanc
   {
     Json::Value answer = Json::arrayValue;
 
-    for (std::list<std::string>::const_iterator
-           resource = resources.begin(); resource != resources.end(); ++resource)
+    if (expand)
     {
-      if (expand)
-      {
-        Json::Value item;
-        if (index.LookupResource(item, *resource, level))
-        {
-          answer.append(item);
-        }
-      }
-      else
+      // Batched lookup of the whole list, instead of one lookup per
+      // resource
+      index.LookupResources(answer, resources, level);
+    }
+    else
+    {
+      for (std::list<std::string>::const_iterator
+             resource = resources.begin(); resource != resources.end(); ++resource)
       {
         answer.append(*resource);
       }
@@ -131,14 +132,19 @@ namespace Orthanc
         throw OrthancException(ErrorCode_BadRequest);
       }
 
-      if (!call.HasArgument("since"))
+      // The first page of the list is returned if "since" is missing
+      size_t since, limit;
+      try
       {
-        LOG(ERROR) << "Missing \"since\" argument for GET request against: " << call.FlattenUri();
+        since = boost::lexical_cast<size_t>(call.GetArgument("since", "0"));
+        limit = boost::lexical_cast<size_t>(call.GetArgument("limit", ""));
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        LOG(ERROR) << "Bad value for \"since\" or \"limit\" in GET request against: " << call.FlattenUri();
         throw OrthancException(ErrorCode_BadRequest);
       }
 
-      size_t since = boost::lexical_cast<size_t>(call.GetArgument("since", ""));
-      size_t limit = boost::lexical_cast<size_t>(call.GetArgument("limit", ""));
       index.GetAllUuids(result, resourceType, since, limit);
     }
     else
@@ -209,13 +215,56 @@ namespace Orthanc
 
 
   // Get information about a single instance ----------------------------------
+
+  /**
+   * Conditional GET on the answers that only depend on one attachment
+   * of an instance: They never change as long as this attachment is
+   * not replaced, which gives its UUID to the entity tag. The
+   * "variant" distinguishes the answers that also depend on the HTTP
+   * headers of the request. Only the index is read. Returns "true"
+   * iff "304 Not Modified" has been sent.
+   **/
+  static bool IsNotModified(RestApiGetCall& call,
+                            const std::string& publicId,
+                            FileContentType type,
+                            const std::string& variant)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    FileInfo info;
+    if (!context.GetIndex().LookupAttachment(info, publicId, type))
+    {
+      return false;  // The handler will report the missing resource
+    }
+
+    std::string tag;
+    Toolbox::ComputeSHA1(tag, publicId + "|" + info.GetUuid() + "|" + variant);
+
+    std::string cacheControl;
+    if (context.GetHttpCacheMaxAge() == 0)
+    {
+      cacheControl = "no-cache";
+    }
+    else
+    {
+      cacheControl = ("max-age=" + boost::lexical_cast<std::string>(context.GetHttpCacheMaxAge()) +
+                      ", immutable");
+    }
+
+    return call.GetOutput().SetEntityTag(tag, cacheControl);
+  }
+
  
   static void GetInstanceFile(RestApiGetCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     std::string publicId = call.GetUriComponent("id", "");
-    context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_Dicom);
+
+    if (!IsNotModified(call, publicId, FileContentType_Dicom, ""))
+    {
+      context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_Dicom);
+    }
   }
 
 
@@ -225,12 +274,11 @@ namespace Orthanc
 
     std::string publicId = call.GetUriComponent("id", "");
 
-    std::string dicom;
-    context.ReadDicom(dicom, publicId);
+    AttachmentCache::Content dicom = context.ReadDicom(publicId);
 
     std::string target;
     call.BodyToString(target);
-    SystemToolbox::WriteFile(dicom, target);
+    SystemToolbox::WriteFile(*dicom, target);
 
     call.GetOutput().AnswerBuffer("{}", "application/json");
   }
@@ -245,14 +293,26 @@ namespace Orthanc
 
     std::set<DicomTag> ignoreTagLength;
     ParseSetOfTags(ignoreTagLength, call, "ignore-length");
+
+    // The tags are read from the DICOM file if "ignore-length" is
+    // present, and from the DICOM-as-JSON summary otherwise
+    if (IsNotModified(call, publicId, ignoreTagLength.empty() ?
+                      FileContentType_DicomAsJson : FileContentType_Dicom, ""))
+    {
+      return;
+    }
     
-    if (simplify ||
-        !ignoreTagLength.empty())
+    if (!ignoreTagLength.empty())
     {
       Json::Value full;
       context.ReadDicomAsJson(full, publicId, ignoreTagLength);
       AnswerDicomAsJson(call, full, simplify);
     }
+    else if (simplify)
+    {
+      DicomAsJsonCache::Content full = context.ReadSharedDicomAsJson(publicId);
+      AnswerDicomAsJson(call, *full, simplify);
+    }
     else
     {
       // This path allows to avoid the JSON decoding if no
@@ -417,6 +477,15 @@ namespace Orthanc
       return;
     }
 
+    // The encoding of the image is negotiated with the "Accept" header
+    call.GetOutput().SetVary("Accept");
+
+    if (IsNotModified(call, call.GetUriComponent("id", ""), FileContentType_Dicom,
+                      call.GetHttpHeader("accept", "")))
+    {
+      return;
+    }
+
     bool invert = false;
     std::auto_ptr<ImageAccessor> decoded;
 
@@ -427,10 +496,8 @@ namespace Orthanc
 #if ORTHANC_ENABLE_PLUGINS == 1
       if (context.GetPlugins().HasCustomImageDecoder())
       {
-        // TODO create a cache of file
-        std::string dicomContent;
-        context.ReadDicom(dicomContent, publicId);
-        decoded.reset(context.GetPlugins().DecodeUnsafe(dicomContent.c_str(), dicomContent.size(), frame));
+        AttachmentCache::Content dicomContent = context.ReadDicom(publicId);
+        decoded.reset(context.GetPlugins().DecodeUnsafe(dicomContent->c_str(), dicomContent->size(), frame));
 
         /**
          * Note that we call "DecodeUnsafe()": We do not fallback to
@@ -445,7 +512,7 @@ namespace Orthanc
           // TODO Optimize this lookup for photometric interpretation:
           // It should be implemented by the plugin to avoid parsing
           // twice the DICOM file
-          ParsedDicomFile parsed(dicomContent);
+          ParsedDicomFile parsed(*dicomContent);
           
           PhotometricInterpretation photometric;
           if (parsed.LookupPhotometricInterpretation(photometric))
@@ -520,8 +587,7 @@ namespace Orthanc
     }
 
     std::string publicId = call.GetUriComponent("id", "");
-    std::string dicomContent;
-    context.ReadDicom(dicomContent, publicId);
+    AttachmentCache::Content dicomContent = context.ReadDicom(publicId);
 
 #if ORTHANC_ENABLE_PLUGINS == 1
     IDicomImageDecoder& decoder = context.GetPlugins();
@@ -529,7 +595,7 @@ namespace Orthanc
     DefaultDicomImageDecoder decoder;  // This is Orthanc's built-in decoder
 #endif
 
-    std::auto_ptr<ImageAccessor> decoded(decoder.Decode(dicomContent.c_str(), dicomContent.size(), frame));
+    std::auto_ptr<ImageAccessor> decoded(decoder.Decode(dicomContent->c_str(), dicomContent->size(), frame));
 
     std::string result;
     decoded->ToMatlabString(result);
@@ -554,6 +620,11 @@ namespace Orthanc
     }
 
     std::string publicId = call.GetUriComponent("id", "");
+    if (IsNotModified(call, publicId, FileContentType_Dicom, ""))
+    {
+      return;
+    }
+
     std::string raw, mime;
 
     {
@@ -850,7 +921,8 @@ namespace Orthanc
       }
       else
       {
-        context.ReadAttachment(data, publicId, StringToContentType(name), true);        
+        // Bypass the attachment cache to check the actual storage area
+        context.ReadAttachment(data, info);
         Toolbox::ComputeMD5(actualMD5, data);
         ok = (actualMD5 == info.GetUncompressedMD5());
       }
@@ -941,6 +1013,166 @@ namespace Orthanc
   }
 
 
+  static void ChangeStorageCompression(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request;
+    if (!call.ParseJsonRequest(request) ||
+        request.type() != Json::objectValue ||
+        !request.isMember("Compression") ||
+        request["Compression"].type() != Json::stringValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    CompressionType compression = StringToCompressionType(request["Compression"].asString());
+    if (!StorageAccessor::IsCompressionSupported(compression))
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    std::set<FileContentType> contentTypes;
+    if (request.isMember("ContentTypes"))
+    {
+      const Json::Value& types = request["ContentTypes"];
+      if (types.type() != Json::arrayValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      for (Json::Value::ArrayIndex i = 0; i < types.size(); i++)
+      {
+        if (types[i].type() != Json::stringValue)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        contentTypes.insert(StringToContentType(types[i].asString()));
+      }
+    }
+    else
+    {
+      contentTypes.insert(FileContentType_Dicom);
+      contentTypes.insert(FileContentType_DicomAsJson);
+    }
+
+    bool asynchronous = Toolbox::GetJsonBooleanField(request, "Asynchronous", true);
+
+    std::list<std::string> instances;
+    context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+
+    Json::Value answer = Json::objectValue;
+    answer["Instances"] = static_cast<unsigned int>(instances.size());
+
+    if (instances.empty() ||
+        contentTypes.empty())
+    {
+      call.GetOutput().AnswerJson(answer);
+      return;
+    }
+
+    // The instances are converted by batches, so as to report the
+    // progress of the job
+    static const size_t BATCH_SIZE = 100;
+
+    ServerJob job;
+    ServerCommandInstance* command = NULL;
+    size_t count = 0;
+
+    for (std::list<std::string>::const_iterator 
+           it = instances.begin(); it != instances.end(); ++it, count++)
+    {
+      if (count % BATCH_SIZE == 0)
+      {
+        command = &job.AddCommand(new ChangeCompressionCommand(context, contentTypes, compression));
+      }
+
+      command->AddInput(*it);
+    }
+
+    job.SetDescription("HTTP request: Change the compression of the storage area to \"" +
+                       std::string(EnumerationToString(compression)) + "\"");
+
+    if (asynchronous)
+    {
+      context.GetScheduler().Submit(job);
+      answer["ID"] = job.GetId();
+      call.GetOutput().AnswerJson(answer);
+    }
+    else if (context.GetScheduler().SubmitAndWait(job))
+    {
+      call.GetOutput().AnswerJson(answer);
+    }
+    else
+    {
+      call.GetOutput().SignalError(HttpStatus_500_InternalServerError);
+    }
+  }
+
+
+  static void ConvertDicomAsJson(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request;
+    if (!call.ParseJsonRequest(request) ||
+        request.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    bool asynchronous = Toolbox::GetJsonBooleanField(request, "Asynchronous", true);
+
+    std::list<std::string> instances;
+    context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+
+    Json::Value answer = Json::objectValue;
+    answer["Instances"] = static_cast<unsigned int>(instances.size());
+
+    if (instances.empty())
+    {
+      call.GetOutput().AnswerJson(answer);
+      return;
+    }
+
+    static const size_t BATCH_SIZE = 100;
+
+    ServerJob job;
+    ServerCommandInstance* command = NULL;
+    size_t count = 0;
+
+    for (std::list<std::string>::const_iterator 
+           it = instances.begin(); it != instances.end(); ++it, count++)
+    {
+      if (count % BATCH_SIZE == 0)
+      {
+        command = &job.AddCommand(new ConvertDicomAsJsonCommand(context));
+      }
+
+      command->AddInput(*it);
+    }
+
+    job.SetDescription(std::string("HTTP request: Convert the DICOM-as-JSON summaries to the ") +
+                       (context.IsBinaryDicomAsJson() ? "binary" : "JSON") + " format");
+
+    if (asynchronous)
+    {
+      context.GetScheduler().Submit(job);
+      answer["ID"] = job.GetId();
+      call.GetOutput().AnswerJson(answer);
+    }
+    else if (context.GetScheduler().SubmitAndWait(job))
+    {
+      call.GetOutput().AnswerJson(answer);
+    }
+    else
+    {
+      call.GetOutput().SignalError(HttpStatus_500_InternalServerError);
+    }
+  }
+
+
   static void IsAttachmentCompressed(RestApiGetCall& call)
   {
     FileInfo info;
@@ -1322,18 +1554,28 @@ namespace Orthanc
     for (Instances::const_iterator it = instances.begin();
          it != instances.end(); ++it)
     {
-      Json::Value full;
-      context.ReadDicomAsJson(full, *it, ignoreTagLength);
+      DicomAsJsonCache::Content full;
+
+      if (ignoreTagLength.empty())
+      {
+        full = context.ReadSharedDicomAsJson(*it);
+      }
+      else
+      {
+        std::auto_ptr<Json::Value> tags(new Json::Value);
+        context.ReadDicomAsJson(*tags, *it, ignoreTagLength);
+        full.reset(tags.release());
+      }
 
       if (simplify)
       {
         Json::Value simplified;
-        ServerToolbox::SimplifyTags(simplified, full, DicomToJsonFormat_Human);
+        ServerToolbox::SimplifyTags(simplified, *full, DicomToJsonFormat_Human);
         result[*it] = simplified;
       }
       else
       {
-        result[*it] = full;
+        result[*it] = *full;
       }
     }
     
@@ -1411,13 +1653,12 @@ namespace Orthanc
     std::string publicId = call.GetUriComponent("id", "");
     bool simplify = call.HasArgument("simplify");
 
-    std::string dicomContent;
-    context.ReadDicom(dicomContent, publicId);
+    AttachmentCache::Content dicomContent = context.ReadDicom(publicId);
 
     // TODO Consider using "DicomMap::ParseDicomMetaInformation()" to
     // speed up things here
 
-    ParsedDicomFile dicom(dicomContent);
+    ParsedDicomFile dicom(*dicomContent);
 
     Json::Value header;
     dicom.HeaderToJson(header, DicomToJsonFormat_Full);
@@ -1445,6 +1686,7 @@ namespace Orthanc
              instance = instances.begin(); instance != instances.end(); ++instance)
       {
         index.DeleteAttachment(*instance, FileContentType_DicomAsJson);
+        OrthancRestApi::GetContext(call).InvalidateDicomAsJson(*instance);
       }
     }
 
@@ -1536,6 +1778,8 @@ namespace Orthanc
     Register("/{resourceType}/{id}/attachments/{name}/uncompress", ChangeAttachmentCompression<CompressionType_None>);
     Register("/{resourceType}/{id}/attachments/{name}/verify-md5", VerifyAttachment);
 
+    Register("/tools/change-storage-compression", ChangeStorageCompression);
+    Register("/tools/convert-dicom-as-json", ConvertDicomAsJson);
     Register("/tools/invalidate-tags", InvalidateTags);
     Register("/tools/lookup", Lookup);
     Register("/tools/find", Find);
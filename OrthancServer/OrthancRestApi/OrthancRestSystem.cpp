@@ -91,6 +91,10 @@ namespace Orthanc
   {
     Json::Value result = Json::objectValue;
     OrthancRestApi::GetIndex(call).ComputeStatistics(result);
+    OrthancRestApi::GetContext(call).GetCompressionAdvisor().Format(result["StorageCompression"]);
+    OrthancRestApi::GetContext(call).GetAttachmentCacheStatistics(result["AttachmentCache"]);
+    OrthancRestApi::GetContext(call).GetDicomCacheStatistics(result["DicomCache"]);
+    OrthancRestApi::GetContext(call).GetDicomAsJsonCacheStatistics(result["DicomAsJsonCache"]);
     call.GetOutput().AnswerJson(result);
   }
 
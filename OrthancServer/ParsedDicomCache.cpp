@@ -0,0 +1,202 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ParsedDicomCache.h"
+
+#include "../Core/OrthancException.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  void ParsedDicomCache::MakeRoom()
+  {
+    while (currentSize_ > maximumSize_ &&
+           index_.GetSize() > 1)
+    {
+      EntryPointer oldest;
+      index_.RemoveOldest(oldest);
+
+      assert(currentSize_ >= oldest->size_);
+      currentSize_ -= oldest->size_;
+    }
+  }
+
+
+  ParsedDicomCache::EntryPointer ParsedDicomCache::Acquire(const std::string& instancePublicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    EntryPointer entry;
+
+    if (index_.Contains(instancePublicId, entry))
+    {
+      index_.MakeMostRecent(instancePublicId);
+      hits_ ++;
+    }
+    else
+    {
+      // Insert an empty entry, that will be filled by the first
+      // thread that locks it
+      entry.reset(new Entry);
+      index_.Add(instancePublicId, entry);
+      misses_ ++;
+    }
+
+    return entry;
+  }
+
+
+  void ParsedDicomCache::Load(const std::string& instancePublicId,
+                              const EntryPointer& entry)
+  {
+    // The mutex of the entry must be locked, but not the mutex of
+    // the cache, so that parsing does not block the other threads
+    size_t size = 0;
+    std::auto_ptr<ParsedDicomFile> dicom(provider_.Provide(size, instancePublicId));
+
+    if (dicom.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    entry->dicom_.reset(dicom.release());
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    EntryPointer current;
+    if (index_.Contains(instancePublicId, current) &&
+        current == entry)
+    {
+      entry->size_ = size;
+      currentSize_ += size;
+      MakeRoom();
+    }
+    else
+    {
+      // The entry has been evicted or invalidated during its loading:
+      // It is only owned by the accessors
+    }
+  }
+
+
+  void ParsedDicomCache::Discard(const std::string& instancePublicId,
+                                 const EntryPointer& entry)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    EntryPointer current;
+    if (index_.Contains(instancePublicId, current) &&
+        current == entry)
+    {
+      index_.Invalidate(instancePublicId);
+
+      assert(currentSize_ >= entry->size_);
+      currentSize_ -= entry->size_;
+    }
+  }
+
+
+  ParsedDicomCache::Accessor::Accessor(ParsedDicomCache& cache,
+                                       const std::string& instancePublicId) :
+    entry_(cache.Acquire(instancePublicId))
+  {
+    boost::unique_lock<boost::mutex> lock(entry_->mutex_);
+    lock_.swap(lock);
+
+    if (entry_->dicom_.get() == NULL)
+    {
+      // Either this entry was just created, or its loading by
+      // another thread has failed
+      try
+      {
+        cache.Load(instancePublicId, entry_);
+      }
+      catch (...)
+      {
+        cache.Discard(instancePublicId, entry_);
+        throw;
+      }
+    }
+  }
+
+
+  ParsedDicomCache::ParsedDicomCache(IProvider& provider,
+                                     size_t maximumSize) :
+    provider_(provider),
+    currentSize_(0),
+    maximumSize_(maximumSize),
+    hits_(0),
+    misses_(0)
+  {
+  }
+
+
+  void ParsedDicomCache::SetMaximumSize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSize_ = size;
+    MakeRoom();
+  }
+
+
+  void ParsedDicomCache::Invalidate(const std::string& instancePublicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (index_.Contains(instancePublicId))
+    {
+      EntryPointer entry = index_.Invalidate(instancePublicId);
+
+      assert(currentSize_ >= entry->size_);
+      currentSize_ -= entry->size_;
+    }
+  }
+
+
+  void ParsedDicomCache::GetStatistics(size_t& size,
+                                       size_t& maximumSize,
+                                       size_t& count,
+                                       uint64_t& hits,
+                                       uint64_t& misses)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    size = currentSize_;
+    maximumSize = maximumSize_;
+    count = index_.GetSize();
+    hits = hits_;
+    misses = misses_;
+  }
+}
@@ -0,0 +1,141 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/DicomParsing/ParsedDicomFile.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Cache of the parsed DICOM instances, bounded by an estimate of
+   * their size in memory. The index of the cache is protected by a
+   * global mutex that is only held during the lookups, whereas each
+   * entry has its own mutex that serializes the accesses to its
+   * DCMTK object (which is not thread-safe). Different instances can
+   * therefore be used concurrently, and an instance that is being
+   * parsed only blocks the threads that are waiting for it.
+   *
+   * The entries are reference-counted: An entry that is evicted or
+   * invalidated while in use is only released once its last accessor
+   * is destroyed.
+   **/
+  class ParsedDicomCache : public boost::noncopyable
+  {
+  public:
+    class IProvider : public boost::noncopyable
+    {
+    public:
+      virtual ~IProvider()
+      {
+      }
+
+      // "size" must receive an estimate of the memory that is used
+      // by the parsed DICOM instance
+      virtual ParsedDicomFile* Provide(size_t& size,
+                                       const std::string& instancePublicId) = 0;
+    };
+
+  private:
+    class Entry : public boost::noncopyable
+    {
+    public:
+      boost::mutex                    mutex_;
+      std::auto_ptr<ParsedDicomFile>  dicom_;   // Protected by "mutex_"
+      size_t                          size_;    // Protected by the cache mutex
+
+      Entry() :
+        size_(0)
+      {
+      }
+    };
+
+    typedef boost::shared_ptr<Entry>  EntryPointer;
+
+    IProvider&     provider_;
+    boost::mutex   mutex_;
+    LeastRecentlyUsedIndex<std::string, EntryPointer>  index_;
+    size_t         currentSize_;
+    size_t         maximumSize_;
+    uint64_t       hits_;
+    uint64_t       misses_;
+
+    // The mutex must be locked
+    void MakeRoom();
+
+    EntryPointer Acquire(const std::string& instancePublicId);
+
+    void Load(const std::string& instancePublicId,
+              const EntryPointer& entry);
+
+    void Discard(const std::string& instancePublicId,
+                 const EntryPointer& entry);
+
+  public:
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      EntryPointer                    entry_;
+      boost::unique_lock<boost::mutex>  lock_;
+
+    public:
+      Accessor(ParsedDicomCache& cache,
+               const std::string& instancePublicId);
+
+      ParsedDicomFile& GetDicom()
+      {
+        return *entry_->dicom_;
+      }
+    };
+
+    ParsedDicomCache(IProvider& provider,
+                     size_t maximumSize);
+
+    // The most recently used entry is always kept, even if it is
+    // larger than the maximum size
+    void SetMaximumSize(size_t size);
+
+    void Invalidate(const std::string& instancePublicId);
+
+    void GetStatistics(size_t& size,
+                       size_t& maximumSize,
+                       size_t& count,
+                       uint64_t& hits,
+                       uint64_t& misses);
+  };
+}
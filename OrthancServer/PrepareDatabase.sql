@@ -121,6 +121,12 @@ BEGIN
 END;
 
 
+-- The tables and triggers maintaining the aggregated statistics
+-- ("ResourceStatistics" and "GlobalStatistics") and the list of the
+-- deleted files ("DeletedFiles") are installed by the
+-- "UpgradeStatistics.sql" and "UpgradeDeletedFiles.sql" scripts,
+-- that are run at the opening of the database
+
 -- Set the version of the database schema
 -- The "1" corresponds to the "GlobalProperty_DatabaseSchemaVersion" enumeration
 INSERT INTO GlobalProperties VALUES (1, "6");
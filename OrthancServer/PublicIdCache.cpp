@@ -0,0 +1,216 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "PublicIdCache.h"
+
+namespace Orthanc
+{
+  PublicIdCache::PublicIdCache() :
+    maximumSize_(0),
+    generation_(0),
+    hits_(0),
+    misses_(0)
+  {
+  }
+
+
+  void PublicIdCache::SetMaximumSize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    maximumSize_ = size;
+
+    while (index_.GetSize() > maximumSize_)
+    {
+      index_.RemoveOldest();
+    }
+  }
+
+
+  uint64_t PublicIdCache::GetGeneration()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return generation_;
+  }
+
+
+  bool PublicIdCache::Lookup(int64_t& internalId,
+                             ResourceType& type,
+                             const std::string& publicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (maximumSize_ == 0)
+    {
+      return false;
+    }
+
+    Entry entry;
+    if (index_.Contains(publicId, entry))
+    {
+      index_.MakeMostRecent(publicId);
+      internalId = entry.GetInternalId();
+      type = entry.GetResourceType();
+      hits_++;
+      return true;
+    }
+    else
+    {
+      misses_++;
+      return false;
+    }
+  }
+
+
+  bool PublicIdCache::LookupParent(int64_t& parentId,
+                                   std::string& parentPublicId,
+                                   const std::string& publicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (maximumSize_ == 0)
+    {
+      return false;
+    }
+
+    Entry entry;
+    if (index_.Contains(publicId, entry) &&
+        entry.HasParent())
+    {
+      index_.MakeMostRecent(publicId);
+      parentId = entry.GetParentId();
+      parentPublicId = entry.GetParentPublicId();
+      hits_++;
+      return true;
+    }
+    else
+    {
+      misses_++;
+      return false;
+    }
+  }
+
+
+  void PublicIdCache::AddInternal(const std::string& publicId,
+                                  const Entry& entry,
+                                  uint64_t generation)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (maximumSize_ == 0 ||
+        generation != generation_)
+    {
+      return;
+    }
+
+    Entry previous;
+    if (index_.Contains(publicId, previous))
+    {
+      if (entry.HasParent() &&
+          !previous.HasParent())
+      {
+        index_.MakeMostRecent(publicId, entry);
+      }
+
+      return;
+    }
+
+    while (index_.GetSize() >= maximumSize_)
+    {
+      index_.RemoveOldest();
+    }
+
+    index_.Add(publicId, entry);
+  }
+
+
+  void PublicIdCache::Add(const std::string& publicId,
+                          int64_t internalId,
+                          ResourceType type,
+                          uint64_t generation)
+  {
+    AddInternal(publicId, Entry(internalId, type), generation);
+  }
+
+
+  void PublicIdCache::Add(const std::string& publicId,
+                          int64_t internalId,
+                          ResourceType type,
+                          int64_t parentId,
+                          const std::string& parentPublicId,
+                          uint64_t generation)
+  {
+    AddInternal(publicId, Entry(internalId, type, parentId, parentPublicId), generation);
+  }
+
+
+  void PublicIdCache::Invalidate(const std::string& publicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    generation_++;
+
+    if (index_.Contains(publicId))
+    {
+      index_.Invalidate(publicId);
+    }
+  }
+
+
+  void PublicIdCache::Clear()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    generation_++;
+
+    while (!index_.IsEmpty())
+    {
+      index_.RemoveOldest();
+    }
+  }
+
+
+  void PublicIdCache::GetStatistics(size_t& size,
+                                    size_t& maximumSize,
+                                    uint64_t& hits,
+                                    uint64_t& misses)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    size = index_.GetSize();
+    maximumSize = maximumSize_;
+    hits = hits_;
+    misses = misses_;
+  }
+}
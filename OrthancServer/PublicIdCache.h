@@ -0,0 +1,179 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "ServerEnumerations.h"
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  /**
+   * In-memory index mapping the public ID of a resource to its
+   * internal ID in the database, that avoids most of the SQL lookups
+   * against the "publicId" column. The index is bounded by a maximum
+   * number of entries, the least recently used entries being dropped.
+   *
+   * Each deletion of a resource increments a generation counter. An
+   * entry that was read from the database is only added if no
+   * resource was deleted since the beginning of the read, which
+   * prevents a concurrent reader working on an older snapshot of the
+   * database from reinserting a deleted resource.
+   *
+   * The entries also record the parent of the resources if it is
+   * known, which avoids the SQL lookups when walking up the
+   * patient/study/series/instance hierarchy.
+   **/
+  class PublicIdCache : public boost::noncopyable
+  {
+  private:
+    class Entry
+    {
+    private:
+      int64_t       internalId_;
+      ResourceType  type_;
+      int64_t       parentId_;   // -1 if the parent is unknown
+      std::string   parentPublicId_;
+
+    public:
+      Entry() :
+        internalId_(-1),
+        type_(ResourceType_Instance),
+        parentId_(-1)
+      {
+      }
+
+      Entry(int64_t internalId,
+            ResourceType type) :
+        internalId_(internalId),
+        type_(type),
+        parentId_(-1)
+      {
+      }
+
+      Entry(int64_t internalId,
+            ResourceType type,
+            int64_t parentId,
+            const std::string& parentPublicId) :
+        internalId_(internalId),
+        type_(type),
+        parentId_(parentId),
+        parentPublicId_(parentPublicId)
+      {
+      }
+
+      int64_t GetInternalId() const
+      {
+        return internalId_;
+      }
+
+      ResourceType GetResourceType() const
+      {
+        return type_;
+      }
+
+      bool HasParent() const
+      {
+        return parentId_ != -1;
+      }
+
+      int64_t GetParentId() const
+      {
+        return parentId_;
+      }
+
+      const std::string& GetParentPublicId() const
+      {
+        return parentPublicId_;
+      }
+    };
+
+    void AddInternal(const std::string& publicId,
+                     const Entry& entry,
+                     uint64_t generation);
+
+    boost::mutex  mutex_;
+    LeastRecentlyUsedIndex<std::string, Entry>  index_;
+    size_t        maximumSize_;
+    uint64_t      generation_;
+    uint64_t      hits_;
+    uint64_t      misses_;
+
+  public:
+    PublicIdCache();
+
+    // A size of 0 disables the cache
+    void SetMaximumSize(size_t size);
+
+    uint64_t GetGeneration();
+
+    bool Lookup(int64_t& internalId,
+                ResourceType& type,
+                const std::string& publicId);
+
+    // Returns "false" if the resource is not cached, or if its parent
+    // is not known by the cache
+    bool LookupParent(int64_t& parentId,
+                      std::string& parentPublicId,
+                      const std::string& publicId);
+
+    // "generation" must have been read by "GetGeneration()" before
+    // the lookup in the database has started
+    void Add(const std::string& publicId,
+             int64_t internalId,
+             ResourceType type,
+             uint64_t generation);
+
+    // Same as above, but also records the parent of the resource,
+    // which completes the entry if the resource is already cached
+    // without its parent (the parent of a resource never changes)
+    void Add(const std::string& publicId,
+             int64_t internalId,
+             ResourceType type,
+             int64_t parentId,
+             const std::string& parentPublicId,
+             uint64_t generation);
+
+    void Invalidate(const std::string& publicId);
+
+    void Clear();
+
+    void GetStatistics(size_t& size,
+                       size_t& maximumSize,
+                       uint64_t& hits,
+                       uint64_t& misses);
+  };
+}
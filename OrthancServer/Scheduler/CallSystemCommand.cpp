@@ -59,11 +59,10 @@ namespace Orthanc
 
       try
       {
-        std::string dicom;
-        context_.ReadDicom(dicom, *it);
+        AttachmentCache::Content dicom = context_.ReadDicom(*it);
 
         TemporaryFile tmp;
-        tmp.Write(dicom);
+        tmp.Write(*dicom);
 
         std::vector<std::string> args = arguments_;
         args.push_back(tmp.GetPath());
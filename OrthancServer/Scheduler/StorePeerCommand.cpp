@@ -63,7 +63,7 @@ namespace Orthanc
 
       try
       {
-        context_.ReadDicom(client.GetBody(), *it);
+        context_.ReadAttachment(client.GetBody(), *it, FileContentType_Dicom, true);
 
         std::string answer;
         if (!client.Apply(answer))
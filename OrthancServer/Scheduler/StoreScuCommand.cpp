@@ -72,10 +72,9 @@ namespace Orthanc
 
       try
       {
-        std::string dicom;
-        context_.ReadDicom(dicom, *it);
+        AttachmentCache::Content dicom = context_.ReadDicom(*it);
 
-        locker.GetConnection().Store(dicom, moveOriginatorAET_, moveOriginatorID_);
+        locker.GetConnection().Store(*dicom, moveOriginatorAET_, moveOriginatorID_);
 
         // Only chain with other commands if this command succeeds
         outputs.push_back(*it);
@@ -49,6 +49,14 @@ namespace Orthanc
     virtual void Setup(LookupIdentifierQuery& lookup,
                        const DicomTag& tag) const = 0;
 
+    // Lists the resources whose main DICOM tag satisfies this
+    // constraint. Returns "false" if the database engine cannot
+    // evaluate it, in which case "Match()" must be used.
+    virtual bool LookupMainDicomTag(std::list<int64_t>& result,
+                                    IDatabaseWrapper& database,
+                                    ResourceType level,
+                                    const DicomTag& tag) const = 0;
+
     virtual bool Match(const std::string& value) const = 0;
 
     virtual std::string Format() const = 0;
@@ -63,6 +63,30 @@ namespace Orthanc
   }
 
 
+  bool ListConstraint::LookupMainDicomTag(std::list<int64_t>& result,
+                                          IDatabaseWrapper& database,
+                                          ResourceType level,
+                                          const DicomTag& tag) const
+  {
+    result.clear();
+
+    for (std::set<std::string>::const_iterator
+           it = allowedValues_.begin(); it != allowedValues_.end(); ++it)
+    {
+      std::list<int64_t> tmp;
+      if (!database.LookupMainDicomTag(tmp, level, tag, IdentifierConstraintType_Equal,
+                                       *it, isCaseSensitive_))
+      {
+        return false;
+      }
+
+      result.splice(result.end(), tmp);
+    }
+
+    return true;
+  }
+
+
   bool ListConstraint::Match(const std::string& value) const
   {
     std::string s;
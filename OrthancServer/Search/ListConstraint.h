@@ -67,6 +67,11 @@ namespace Orthanc
     virtual void Setup(LookupIdentifierQuery& lookup,
                        const DicomTag& tag) const;
 
+    virtual bool LookupMainDicomTag(std::list<int64_t>& result,
+                                    IDatabaseWrapper& database,
+                                    ResourceType level,
+                                    const DicomTag& tag) const;
+
     virtual bool Match(const std::string& value) const;
 
     virtual std::string Format() const;
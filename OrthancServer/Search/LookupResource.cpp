@@ -42,6 +42,10 @@
 
 namespace Orthanc
 {
+  // Below this number of candidates, the constraints on the main
+  // DICOM tags are evaluated in memory rather than by the database
+  static const size_t MAX_CANDIDATES_FOR_LOCAL_FILTERING = 100;
+
   LookupResource::Level::Level(ResourceType level) : level_(level)
   {
     const DicomTag* tags = NULL;
@@ -63,6 +67,22 @@ namespace Orthanc
         mainTags_.insert(tags[i]);
       }
     }    
+
+    if (level == ResourceType_Study)
+    {
+      // The main DICOM tags of the patient are duplicated at the
+      // study level (since db v6), so that they can be looked up
+      // without reading the DICOM-as-JSON files
+      DicomMap::LoadMainDicomTags(tags, size, ResourceType_Patient);
+    
+      for (size_t i = 0; i < size; i++)
+      {
+        if (identifiers_.find(tags[i]) == identifiers_.end())
+        {
+          mainTags_.insert(tags[i]);
+        }
+      }    
+    }
   }
 
   LookupResource::Level::~Level()
@@ -233,9 +253,60 @@ namespace Orthanc
       printf("=> %d\n", source.size());
       }*/
 
-    // Secondly, filter using the main DICOM tags
-    if (!identifiersConstraints_.empty() ||
-        !mainTagsConstraints_.empty())
+    // Secondly, filter using the main DICOM tags. The identifier
+    // constraints are re-applied, as their "Setup" method is less
+    // restrictive than their "Match" method.
+    std::vector<Constraints::const_iterator>  remaining;
+    
+    if (candidates.IsRestricted() &&
+        candidates.GetSize() <= MAX_CANDIDATES_FOR_LOCAL_FILTERING)
+    {
+      // Few candidates are left, it is faster to filter them one by one
+      for (Constraints::const_iterator it = identifiersConstraints_.begin(); 
+           it != identifiersConstraints_.end(); ++it)
+      {
+        remaining.push_back(it);
+      }
+
+      for (Constraints::const_iterator it = mainTagsConstraints_.begin(); 
+           it != mainTagsConstraints_.end(); ++it)
+      {
+        remaining.push_back(it);
+      }
+    }
+    else
+    {
+      // Evaluate the constraints by the database engine, if possible
+      for (Constraints::const_iterator it = identifiersConstraints_.begin(); 
+           it != identifiersConstraints_.end(); ++it)
+      {
+        std::list<int64_t> matching;
+        if (it->second->LookupMainDicomTag(matching, database, level_, it->first))
+        {
+          candidates.Intersect(matching);
+        }
+        else
+        {
+          remaining.push_back(it);
+        }
+      }
+
+      for (Constraints::const_iterator it = mainTagsConstraints_.begin(); 
+           it != mainTagsConstraints_.end(); ++it)
+      {
+        std::list<int64_t> matching;
+        if (it->second->LookupMainDicomTag(matching, database, level_, it->first))
+        {
+          candidates.Intersect(matching);
+        }
+        else
+        {
+          remaining.push_back(it);
+        }
+      }
+    }
+
+    if (!remaining.empty())
     {
       std::list<int64_t>  source;
       candidates.Flatten(source);
@@ -250,21 +321,9 @@ namespace Orthanc
 
         bool match = true;
 
-        // Re-apply the identifier constraints, as their "Setup"
-        // method is less restrictive than their "Match" method
-        for (Constraints::const_iterator it = identifiersConstraints_.begin(); 
-             match && it != identifiersConstraints_.end(); ++it)
+        for (size_t i = 0; match && i < remaining.size(); i++)
         {
-          if (!Match(tags, it->first, *it->second))
-          {
-            match = false;
-          }
-        }
-
-        for (Constraints::const_iterator it = mainTagsConstraints_.begin(); 
-             match && it != mainTagsConstraints_.end(); ++it)
-        {
-          if (!Match(tags, it->first, *it->second))
+          if (!Match(tags, remaining[i]->first, *remaining[i]->second))
           {
             match = false;
           }
@@ -282,6 +341,32 @@ namespace Orthanc
 
 
 
+  bool LookupResource::HasConstraints() const
+  {
+    if (!unoptimizedConstraints_.empty() ||
+        modalitiesInStudy_.get() != NULL)
+    {
+      return true;
+    }
+
+    for (Levels::const_iterator it = levels_.begin(); it != levels_.end(); ++it)
+    {
+      if (it->second->HasConstraints())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  bool LookupResource::HasUnoptimizedConstraints() const
+  {
+    return !unoptimizedConstraints_.empty();
+  }
+
+
   bool LookupResource::IsMatch(const Json::Value& dicomAsJson) const
   {
     for (Constraints::const_iterator it = unoptimizedConstraints_.begin(); 
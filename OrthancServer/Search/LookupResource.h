@@ -62,6 +62,12 @@ namespace Orthanc
       bool Add(const DicomTag& tag,
                std::auto_ptr<IFindConstraint>& constraint);
 
+      bool HasConstraints() const
+      {
+        return (!identifiersConstraints_.empty() ||
+                !mainTagsConstraints_.empty());
+      }
+
       void Apply(SetOfResources& candidates,
                  IDatabaseWrapper& database) const;
     };
@@ -103,6 +109,14 @@ namespace Orthanc
     void FindCandidates(std::list<int64_t>& result,
                         IDatabaseWrapper& database) const;
 
+    // If this method returns "false", the lookup matches all the
+    // resources of its level
+    bool HasConstraints() const;
+
+    // If this method returns "false", all the constraints have been
+    // evaluated by "FindCandidates()", and "IsMatch()" is not needed
+    bool HasUnoptimizedConstraints() const;
+
     bool IsMatch(const Json::Value& dicomAsJson) const;
   };
 }
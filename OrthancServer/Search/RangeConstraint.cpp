@@ -36,6 +36,9 @@
 
 #include "../../Core/Toolbox.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace Orthanc
 {
   RangeConstraint::RangeConstraint(const std::string& lower,
@@ -71,6 +74,49 @@ namespace Orthanc
   }
 
 
+  bool RangeConstraint::LookupMainDicomTag(std::list<int64_t>& result,
+                                           IDatabaseWrapper& database,
+                                           ResourceType level,
+                                           const DicomTag& tag) const
+  {
+    result.clear();
+
+    if (lower_.empty() &&
+        upper_.empty())
+    {
+      // Consistent with "Match()"
+      return true;
+    }
+
+    if (upper_.empty())
+    {
+      return database.LookupMainDicomTag(result, level, tag, IdentifierConstraintType_GreaterOrEqual,
+                                         lower_, isCaseSensitive_);
+    }
+
+    if (lower_.empty())
+    {
+      return database.LookupMainDicomTag(result, level, tag, IdentifierConstraintType_SmallerOrEqual,
+                                         upper_, isCaseSensitive_);
+    }
+
+    std::list<int64_t> a, b;
+    if (!database.LookupMainDicomTag(a, level, tag, IdentifierConstraintType_GreaterOrEqual,
+                                     lower_, isCaseSensitive_) ||
+        !database.LookupMainDicomTag(b, level, tag, IdentifierConstraintType_SmallerOrEqual,
+                                     upper_, isCaseSensitive_))
+    {
+      return false;
+    }
+
+    a.sort();
+    b.sort();
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+
+    return true;
+  }
+
+
   bool RangeConstraint::Match(const std::string& value) const
   {
     std::string v;
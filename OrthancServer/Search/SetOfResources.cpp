@@ -69,6 +69,19 @@ namespace Orthanc
   }
 
 
+  size_t SetOfResources::GetSize() const
+  {
+    if (resources_.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      return resources_->size();
+    }
+  }
+
+
   void SetOfResources::GoDown()
   {
     if (level_ == ResourceType_Instance)
@@ -63,6 +63,15 @@ namespace Orthanc
       return level_;
     }
 
+    // Returns "false" iff. all the resources of this level are part
+    // of the set (i.e. no constraint has been applied yet)
+    bool IsRestricted() const
+    {
+      return resources_.get() != NULL;
+    }
+
+    size_t GetSize() const;
+
     void Intersect(const std::list<int64_t>& resources);
 
     void GoDown();
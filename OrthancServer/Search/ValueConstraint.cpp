@@ -61,6 +61,16 @@ namespace Orthanc
     lookup.AddConstraint(tag, IdentifierConstraintType_Equal, value_);
   }
 
+  bool ValueConstraint::LookupMainDicomTag(std::list<int64_t>& result,
+                                           IDatabaseWrapper& database,
+                                           ResourceType level,
+                                           const DicomTag& tag) const
+  {
+    return database.LookupMainDicomTag(result, level, tag, IdentifierConstraintType_Equal,
+                                       value_, isCaseSensitive_);
+  }
+
+
   bool ValueConstraint::Match(const std::string& value) const
   {
     if (isCaseSensitive_)
@@ -93,6 +93,15 @@ namespace Orthanc
     lookup.AddConstraint(tag, IdentifierConstraintType_Wildcard, pimpl_->wildcard_);
   }
 
+  bool WildcardConstraint::LookupMainDicomTag(std::list<int64_t>& result,
+                                              IDatabaseWrapper& database,
+                                              ResourceType level,
+                                              const DicomTag& tag) const
+  {
+    return database.LookupMainDicomTag(result, level, tag, IdentifierConstraintType_Wildcard,
+                                       pimpl_->wildcard_, pimpl_->isCaseSensitive_);
+  }
+
   std::string WildcardConstraint::Format() const
   {
     return pimpl_->wildcard_;
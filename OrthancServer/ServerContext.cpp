@@ -34,15 +34,21 @@
 #include "PrecompiledHeadersServer.h"
 #include "ServerContext.h"
 
+#include "../Core/FileStorage/FilesystemStorage.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/HttpServer/HttpStreamTranscoder.h"
 #include "../Core/Logging.h"
+#include "../Core/SystemToolbox.h"
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
+#include "BinaryDicomAsJson.h"
 #include "ServerToolbox.h"
 #include "OrthancInitialization.h"
 
 #include <EmbeddedResources.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <dcmtk/dcmdata/dcfilefo.h>
 
 
@@ -56,9 +62,7 @@
 #include "Search/LookupResource.h"
 
 
-#define ENABLE_DICOM_CACHE  1
-
-static const size_t DICOM_CACHE_SIZE = 2;
+static const size_t DICOM_CACHE_SIZE = 128 * 1024 * 1024;  // 128 MB
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -114,10 +118,17 @@ namespace Orthanc
 
   ServerContext::ServerContext(IDatabaseWrapper& database,
                                IStorageArea& area) :
+    changesFeedCount_(0),
+    changesFeedClosed_(false),
+    changesStreamClients_(0),
+    maxChangesStreamClients_(0),
     index_(*this, database),
     area_(area),
-    compressionEnabled_(false),
+    defaultCompression_(CompressionType_None),
     storeMD5_(true),
+    bitPreservingStoreScp_(false),
+    binaryDicomAsJson_(false),
+    httpCacheMaxAge_(0),
     provider_(*this),
     dicomCache_(provider_, DICOM_CACHE_SIZE),
     scheduler_(Configuration::GetGlobalUnsignedIntegerParameter("LimitJobs", 10)),
@@ -160,6 +171,8 @@ namespace Orthanc
 
       done_ = true;
 
+      CloseChangesFeed();
+
       if (changeThread_.joinable())
       {
         changeThread_.join();
@@ -181,13 +194,112 @@ namespace Orthanc
     else
       LOG(WARNING) << "Disk compression is disabled";
 
-    compressionEnabled_ = enabled;
+    defaultCompression_ = (enabled ? CompressionType_ZlibWithSize : CompressionType_None);
+    compressionPolicy_.clear();
+  }
+
+
+  bool ServerContext::IsCompressionEnabled() const
+  {
+    if (defaultCompression_ != CompressionType_None)
+    {
+      return true;
+    }
+
+    for (CompressionPolicy::const_iterator it = compressionPolicy_.begin();
+         it != compressionPolicy_.end(); ++it)
+    {
+      if (it->second != CompressionType_None)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  static void CheckCompressionSupported(CompressionType compression)
+  {
+    if (!StorageAccessor::IsCompressionSupported(compression))
+    {
+      LOG(ERROR) << "This compression is not supported by this build of Orthanc: " 
+                 << EnumerationToString(compression);
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  void ServerContext::SetDefaultCompression(CompressionType compression)
+  {
+    CheckCompressionSupported(compression);
+    defaultCompression_ = compression;
+  }
+
+
+  void ServerContext::SetCompression(FileContentType type,
+                                     CompressionType compression)
+  {
+    CheckCompressionSupported(compression);
+
+    LOG(WARNING) << "Compression of the attachments of type \"" << EnumerationToString(type)
+                 << "\": " << EnumerationToString(compression);
+
+    compressionPolicy_[type] = compression;
+  }
+
+
+  CompressionType ServerContext::GetCompression(FileContentType type) const
+  {
+    CompressionPolicy::const_iterator found = compressionPolicy_.find(type);
+
+    if (found == compressionPolicy_.end())
+    {
+      return defaultCompression_;
+    }
+    else
+    {
+      return found->second;
+    }
+  }
+
+
+  void ServerContext::SetBitPreservingStoreScp(bool enabled)
+  {
+    if (enabled)
+    {
+      LOG(WARNING) << "The C-STORE SCP stores the received DICOM files as is (bit-preserving mode)";
+    }
+
+    bitPreservingStoreScp_ = enabled;
+  }
+
+
+  bool ServerContext::CreateTemporaryStorageFile(std::string& path)
+  {
+    if (GetCompression(FileContentType_Dicom) != CompressionType_None)
+    {
+      return false;
+    }
+
+    // The temporary file can only be moved into the storage area if
+    // the attachments are stored on the filesystem by Orthanc itself
+    // (i.e. not by a storage area plugin)
+    FilesystemStorage* storage = dynamic_cast<FilesystemStorage*>(&area_);
+    if (storage == NULL)
+    {
+      return false;
+    }
+
+    path = storage->CreateTemporaryPath();
+    return true;
   }
 
 
   void ServerContext::RemoveFile(const std::string& fileUuid,
                                  FileContentType type)
   {
+    attachmentCache_.Invalidate(fileUuid);
     area_.Remove(fileUuid, type);
   }
 
@@ -237,13 +349,66 @@ namespace Orthanc
         return StoreStatus_FilteredOut;
       }
 
-      // TODO Should we use "gzip" instead?
-      CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+      CompressionType dicomCompression = GetCompression(FileContentType_Dicom);
+      CompressionType jsonCompression = GetCompression(FileContentType_DicomAsJson);
+
+      const bool dicomCompressionRequested = (dicomCompression != CompressionType_None);
+
+      std::string transferSyntax;
+      if (dicomCompressionRequested)
+      {
+        if (!dicom.LookupTransferSyntax(transferSyntax))
+        {
+          transferSyntax.clear();
+        }
+
+        dicomCompression = compressionAdvisor_.Select(transferSyntax, dicomCompression,
+                                                      dicom.GetBufferData(), dicom.GetBufferSize());
+      }
+
+      FileInfo dicomInfo;
+      uint64_t compressionDuration = 0;
+      FilesystemStorage* storage = dynamic_cast<FilesystemStorage*>(&area_);
 
-      FileInfo dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
-                                          FileContentType_Dicom, compression, storeMD5_);
-      FileInfo jsonInfo = accessor.Write(dicom.GetJson().toStyledString(), 
-                                         FileContentType_DicomAsJson, compression, storeMD5_);
+      if (dicom.HasFile() &&
+          dicomCompression == CompressionType_None &&
+          storage != NULL)
+      {
+        // The DICOM file has been received into a temporary file of
+        // the storage area: Move it as the attachment, without
+        // reading it into memory
+        const std::string uuid = Toolbox::GenerateUuid();
+        uint64_t size = SystemToolbox::GetFileSize(dicom.GetFilePath());
+
+        std::string md5;
+        if (storeMD5_)
+        {
+          boost::filesystem::ifstream f(dicom.GetFilePath(), std::ios::in | std::ios::binary);
+          if (!f.good())
+          {
+            throw OrthancException(ErrorCode_InexistentFile);
+          }
+
+          Toolbox::ComputeMD5(md5, f);
+        }
+
+        storage->CreateFromFile(uuid, dicom.GetFilePath(), FileContentType_Dicom);
+        dicomInfo = FileInfo(uuid, FileContentType_Dicom, size, md5);
+
+        // The listeners can still access the content of the file
+        dicom.SetFile(storage->GetAttachmentPath(uuid));
+      }
+      else
+      {
+        dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
+                                   FileContentType_Dicom, dicomCompression, storeMD5_);
+        compressionDuration = accessor.GetLastCompressionDuration();
+      }
+
+      std::string summary;
+      FormatDicomAsJson(summary, dicom.GetJson());
+
+      FileInfo jsonInfo = accessor.Write(summary, FileContentType_DicomAsJson, jsonCompression, storeMD5_);
 
       ServerIndex::Attachments attachments;
       attachments.push_back(dicomInfo);
@@ -263,16 +428,25 @@ namespace Orthanc
                                                   it->second));
       }
             
-      if (status != StoreStatus_Success)
-      {
-        accessor.Remove(dicomInfo);
-        accessor.Remove(jsonInfo);
-      }
-
       switch (status)
       {
         case StoreStatus_Success:
           LOG(INFO) << "New instance stored";
+
+          // Only the instances that were actually kept feed the
+          // statistics of the compression advisor
+          if (dicomCompressionRequested)
+          {
+            if (dicomInfo.GetCompressionType() == CompressionType_None)
+            {
+              compressionAdvisor_.RecordRaw(transferSyntax, dicomInfo.GetUncompressedSize());
+            }
+            else
+            {
+              compressionAdvisor_.RecordCompressed(transferSyntax, dicomInfo.GetUncompressedSize(),
+                                                   dicomInfo.GetCompressedSize(), compressionDuration);
+            }
+          }
           break;
 
         case StoreStatus_AlreadyStored:
@@ -308,6 +482,16 @@ namespace Orthanc
         }
       }
 
+      if (status != StoreStatus_Success)
+      {
+        // The attachments are only removed once the listeners have
+        // run, as a duplicate instance that was received into a file
+        // is read lazily from its attachment, without loading it
+        // into memory
+        accessor.Remove(dicomInfo);
+        accessor.Remove(jsonInfo);
+      }
+
       return status;
     }
     catch (OrthancException& e)
@@ -332,8 +516,35 @@ namespace Orthanc
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    StorageAccessor accessor(area_);
-    accessor.AnswerFile(output, attachment, GetFileContentMime(content));
+    if (content == FileContentType_DicomAsJson)
+    {
+      // The summary might be stored with the binary encoding, which
+      // is converted back to JSON for the clients
+      std::string summary;
+      ReadDicomAsJson(summary, resourceId);
+      output.AnswerBuffer(summary, GetFileContentMime(content));
+      return;
+    }
+
+    AttachmentCache::Content cached;
+    if (attachmentCache_.Lookup(cached, attachment.GetUuid()) ||
+        (attachment.GetCompressionType() != CompressionType_None &&
+         attachmentCache_.IsCacheable(attachment.GetUuid(), attachment.GetUncompressedSize())))
+    {
+      // Cache hit, or compressed attachment that is worth keeping
+      // uncompressed in the cache for the next requests
+      if (cached.get() == NULL)
+      {
+        cached = ReadAndCacheAttachment(attachment);
+      }
+
+      output.AnswerBuffer(*cached, GetFileContentMime(content));
+    }
+    else
+    {
+      StorageAccessor accessor(area_);
+      accessor.AnswerFile(output, attachment, GetFileContentMime(content));
+    }
   }
 
 
@@ -395,18 +606,17 @@ namespace Orthanc
     {
       // The "DICOM as JSON" summary is not available from the Orthanc
       // store (most probably deleted), reconstruct it from the DICOM file
-      std::string dicom;
-      ReadDicom(dicom, instancePublicId);
+      AttachmentCache::Content dicom = ReadDicom(instancePublicId);
 
       LOG(INFO) << "Reconstructing the missing DICOM-as-JSON summary for instance: "
                 << instancePublicId;
     
-      ParsedDicomFile parsed(dicom);
+      ParsedDicomFile parsed(*dicom);
 
       Json::Value summary;
       parsed.DatasetToJson(summary);
 
-      result = summary.toStyledString();
+      FormatDicomAsJson(result, summary);
 
       if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
                          result.c_str(), result.size()))
@@ -425,6 +635,13 @@ namespace Orthanc
     if (ignoreTagLength.empty())
     {
       ReadDicomAsJsonInternal(result, instancePublicId);
+
+      if (BinaryDicomAsJson::IsBinary(result))
+      {
+        Json::Value tmp;
+        BinaryDicomAsJson::Decode(tmp, result);
+        result = tmp.toStyledString();
+      }
     }
     else
     {
@@ -441,25 +658,108 @@ namespace Orthanc
   {
     if (ignoreTagLength.empty())
     {
-      std::string tmp;
-      ReadDicomAsJsonInternal(tmp, instancePublicId);
+      result = *ReadSharedDicomAsJson(instancePublicId);
+    }
+    else
+    {
+      // The "DicomAsJson" attachment might have stored some tags as
+      // "too long". We are forced to re-parse the DICOM file.
+      AttachmentCache::Content dicom = ReadDicom(instancePublicId);
+
+      ParsedDicomFile parsed(*dicom);
+      parsed.DatasetToJson(result, ignoreTagLength);
+    }
+  }
+
+
+  DicomAsJsonCache::Content ServerContext::ReadSharedDicomAsJson(const std::string& instancePublicId)
+  {
+    DicomAsJsonCache::Content cached;
+    if (dicomAsJsonCache_.Lookup(cached, instancePublicId))
+    {
+      return cached;
+    }
+
+    uint64_t generation = dicomAsJsonCache_.GetGeneration();
+
+    std::string tmp;
+    ReadDicomAsJsonInternal(tmp, instancePublicId);
+
+    std::auto_ptr<Json::Value> parsed(new Json::Value);
+
+    if (BinaryDicomAsJson::IsBinary(tmp))
+    {
+      BinaryDicomAsJson::Decode(*parsed, tmp);
+    }
+    else
+    {
+      Json::Reader reader;
+      if (!reader.parse(tmp, *parsed))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    DicomAsJsonCache::Content content(parsed.release());
+    dicomAsJsonCache_.Add(instancePublicId, content, tmp.size(), generation);
+
+    return content;
+  }
+
+
+  void ServerContext::FormatDicomAsJson(std::string& target,
+                                        const Json::Value& summary) const
+  {
+    if (binaryDicomAsJson_)
+    {
+      BinaryDicomAsJson::Encode(target, summary);
+    }
+    else
+    {
+      target = summary.toStyledString();
+    }
+  }
+
 
+  bool ServerContext::ConvertDicomAsJson(const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    std::string content;
+    ReadAttachment(content, attachment);
+
+    if (BinaryDicomAsJson::IsBinary(content) == binaryDicomAsJson_)
+    {
+      return false;
+    }
+
+    Json::Value summary;
+    if (binaryDicomAsJson_)
+    {
       Json::Reader reader;
-      if (!reader.parse(tmp, result))
+      if (!reader.parse(content, summary))
       {
         throw OrthancException(ErrorCode_CorruptedFile);
       }
     }
     else
     {
-      // The "DicomAsJson" attachment might have stored some tags as
-      // "too long". We are forced to re-parse the DICOM file.
-      std::string dicom;
-      ReadDicom(dicom, instancePublicId);
+      BinaryDicomAsJson::Decode(summary, content);
+    }
 
-      ParsedDicomFile parsed(dicom);
-      parsed.DatasetToJson(result, ignoreTagLength);
+    FormatDicomAsJson(content, summary);
+
+    if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
+                       content.empty() ? NULL : content.c_str(), content.size()))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
     }
+
+    return true;
   }
 
 
@@ -477,7 +777,15 @@ namespace Orthanc
 
     if (uncompressIfNeeded)
     {
-      ReadAttachment(result, attachment);
+      AttachmentCache::Content cached;
+      if (attachmentCache_.Lookup(cached, attachment.GetUuid()))
+      {
+        result = *cached;
+      }
+      else
+      {
+        ReadAttachment(result, attachment);
+      }
     }
     else
     {
@@ -497,31 +805,125 @@ namespace Orthanc
   }
 
 
-  IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
+  AttachmentCache::Content ServerContext::ReadAndCacheAttachment(const FileInfo& attachment)
   {
-    std::string content;
-    context_.ReadDicom(content, instancePublicId);
-    return new ParsedDicomFile(content);
+    std::auto_ptr<std::string> buffer(new std::string);
+    ReadAttachment(*buffer, attachment);
+
+    // A reader that has looked up the attachment before its deletion
+    // might add it back to the cache after its invalidation: This
+    // entry is never accessed again, and is eventually evicted as the
+    // least recently used one
+    AttachmentCache::Content content(buffer.release());
+    attachmentCache_.Add(attachment.GetUuid(), content);
+
+    return content;
   }
 
 
-  ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
-                                                    const std::string& instancePublicId) : 
-    that_(that),
-    lock_(that_.dicomCacheMutex_)
+  AttachmentCache::Content ServerContext::ReadSharedAttachment(const std::string& instancePublicId,
+                                                               FileContentType content)
   {
-#if ENABLE_DICOM_CACHE == 0
-    static std::auto_ptr<IDynamicObject> p;
-    p.reset(provider_.Provide(instancePublicId));
-    dicom_ = dynamic_cast<ParsedDicomFile*>(p.get());
-#else
-    dicom_ = &dynamic_cast<ParsedDicomFile&>(that_.dicomCache_.Access(instancePublicId));
-#endif
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, content))
+    {
+      LOG(WARNING) << "Unable to read attachment " << EnumerationToString(content) << " of instance " << instancePublicId;
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    AttachmentCache::Content cached;
+    if (attachmentCache_.Lookup(cached, attachment.GetUuid()))
+    {
+      return cached;
+    }
+    else
+    {
+      return ReadAndCacheAttachment(attachment);
+    }
   }
 
 
-  ServerContext::DicomCacheLocker::~DicomCacheLocker()
+  void ServerContext::SetAttachmentCacheSize(uint64_t size)
   {
+    attachmentCache_.SetMaximumSize(size);
+
+    if (size > 0)
+    {
+      LOG(WARNING) << "Cache of the attachments: at most " << (size / (1024 * 1024)) << " MB";
+    }
+  }
+
+
+  void ServerContext::GetAttachmentCacheStatistics(Json::Value& target)
+  {
+    uint64_t size, maximumSize, count, hits, misses, evictions;
+    attachmentCache_.GetStatistics(size, maximumSize, count, hits, misses, evictions);
+
+    target = Json::objectValue;
+    target["Size"] = boost::lexical_cast<std::string>(size);
+    target["MaximumSize"] = boost::lexical_cast<std::string>(maximumSize);
+    target["Count"] = boost::lexical_cast<std::string>(count);
+    target["Hits"] = boost::lexical_cast<std::string>(hits);
+    target["Misses"] = boost::lexical_cast<std::string>(misses);
+    target["Evictions"] = boost::lexical_cast<std::string>(evictions);
+
+    if (hits + misses > 0)
+    {
+      target["HitRatio"] = static_cast<float>(hits) / static_cast<float>(hits + misses);
+    }
+  }
+
+
+  ParsedDicomFile* ServerContext::DicomCacheProvider::Provide(size_t& size,
+                                                              const std::string& instancePublicId)
+  {
+    AttachmentCache::Content content = context_.ReadSharedAttachment(instancePublicId, FileContentType_Dicom);
+
+    // The DCMTK object is roughly as large as the DICOM file
+    size = content->size();
+    return new ParsedDicomFile(*content);
+  }
+
+
+  void ServerContext::SetDicomCacheSize(size_t size)
+  {
+    dicomCache_.SetMaximumSize(size);
+  }
+
+
+  void ServerContext::SetDicomAsJsonCacheSize(size_t size)
+  {
+    dicomAsJsonCache_.SetMaximumSize(size);
+  }
+
+
+  void ServerContext::GetDicomAsJsonCacheStatistics(Json::Value& target)
+  {
+    size_t size, maximumSize, count;
+    uint64_t hits, misses;
+    dicomAsJsonCache_.GetStatistics(size, maximumSize, count, hits, misses);
+
+    target = Json::objectValue;
+    target["Size"] = boost::lexical_cast<std::string>(size);
+    target["MaximumSize"] = boost::lexical_cast<std::string>(maximumSize);
+    target["Count"] = boost::lexical_cast<std::string>(count);
+    target["Hits"] = boost::lexical_cast<std::string>(hits);
+    target["Misses"] = boost::lexical_cast<std::string>(misses);
+  }
+
+
+  void ServerContext::GetDicomCacheStatistics(Json::Value& target)
+  {
+    size_t size, maximumSize, count;
+    uint64_t hits, misses;
+    dicomCache_.GetStatistics(size, maximumSize, count, hits, misses);
+
+    target = Json::objectValue;
+    target["Size"] = boost::lexical_cast<std::string>(size);
+    target["MaximumSize"] = boost::lexical_cast<std::string>(maximumSize);
+    target["Count"] = boost::lexical_cast<std::string>(count);
+    target["Hits"] = boost::lexical_cast<std::string>(hits);
+    target["Misses"] = boost::lexical_cast<std::string>(misses);
   }
 
 
@@ -539,11 +941,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Adding attachment " << EnumerationToString(attachmentType) << " to resource " << resourceId;
     
-    // TODO Should we use "gzip" instead?
-    CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
-
     StorageAccessor accessor(area_);
-    FileInfo attachment = accessor.Write(data, size, attachmentType, compression, storeMD5_);
+    FileInfo attachment = accessor.Write(data, size, attachmentType, GetCompression(attachmentType), storeMD5_);
 
     StoreStatus status = index_.AddAttachment(attachment, resourceId);
     if (status != StoreStatus_Success)
@@ -553,6 +952,11 @@ namespace Orthanc
     }
     else
     {
+      if (attachmentType == FileContentType_DicomAsJson)
+      {
+        dicomAsJsonCache_.Invalidate(resourceId);
+      }
+
       return true;
     }
   }
@@ -565,7 +969,6 @@ namespace Orthanc
     if (expectedType == ResourceType_Instance)
     {
       // remove the file from the DicomCache
-      boost::mutex::scoped_lock lock(dicomCacheMutex_);
       dicomCache_.Invalidate(uuid);
     }
 
@@ -575,7 +978,107 @@ namespace Orthanc
 
   void ServerContext::SignalChange(const ServerIndexChange& change)
   {
+    if (change.GetResourceType() == ResourceType_Instance &&
+        (change.GetChangeType() == ChangeType_Deleted ||
+         change.GetChangeType() == ChangeType_UpdatedAttachment))
+    {
+      // The instance might be stored again with other tags, or its
+      // attachments might have been replaced. This covers the
+      // instances that are deleted together with their parent, or
+      // by the recycling.
+      dicomCache_.Invalidate(change.GetPublicId());
+      dicomAsJsonCache_.Invalidate(change.GetPublicId());
+    }
+
     pendingChanges_.Enqueue(change.Clone());
+
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    changesFeedCount_++;
+    changesFeedSignaled_.notify_all();
+  }
+
+
+  uint64_t ServerContext::GetChangesCount()
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    return changesFeedCount_;
+  }
+
+
+  bool ServerContext::WaitForChanges(uint64_t& count,
+                                     unsigned int timeout)
+  {
+    const boost::system_time deadline = (boost::get_system_time() + 
+                                         boost::posix_time::milliseconds(timeout));
+
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+
+    while (!changesFeedClosed_ &&
+           changesFeedCount_ == count)
+    {
+      if (!changesFeedSignaled_.timed_wait(lock, deadline))
+      {
+        break;
+      }
+    }
+
+    if (changesFeedClosed_ ||
+        changesFeedCount_ == count)
+    {
+      return false;
+    }
+    else
+    {
+      count = changesFeedCount_;
+      return true;
+    }
+  }
+
+
+  void ServerContext::CloseChangesFeed()
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    changesFeedClosed_ = true;
+    changesFeedSignaled_.notify_all();
+  }
+
+
+  bool ServerContext::IsChangesFeedClosed()
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    return changesFeedClosed_;
+  }
+
+
+  void ServerContext::SetMaximumChangesStreamClients(unsigned int count)
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    maxChangesStreamClients_ = count;
+  }
+
+
+  bool ServerContext::AddChangesStreamClient()
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+
+    if (maxChangesStreamClients_ != 0 &&
+        changesStreamClients_ >= maxChangesStreamClients_)
+    {
+      return false;
+    }
+    else
+    {
+      changesStreamClients_++;
+      return true;
+    }
+  }
+
+
+  void ServerContext::RemoveChangesStreamClient()
+  {
+    boost::mutex::scoped_lock lock(changesFeedMutex_);
+    assert(changesStreamClients_ > 0);
+    changesStreamClients_--;
   }
 
 
@@ -649,6 +1152,14 @@ namespace Orthanc
   {
     result.clear();
 
+    if (!lookup.HasUnoptimizedConstraints())
+    {
+      // All the constraints are evaluated by the database, no need
+      // to read the DICOM-as-JSON of the candidates
+      GetIndex().FindResources(result, lookup, since, limit);
+      return;
+    }
+
     std::vector<std::string> resources, instances;
     GetIndex().FindCandidates(resources, instances, lookup);
 
@@ -657,8 +1168,8 @@ namespace Orthanc
     size_t skipped = 0;
     for (size_t i = 0; i < instances.size(); i++)
     {
-      Json::Value dicom;
-      ReadDicomAsJson(dicom, instances[i]);
+      DicomAsJsonCache::Content summary = ReadSharedDicomAsJson(instances[i]);
+      const Json::Value& dicom = *summary;
       
       if (lookup.IsMatch(dicom))
       {
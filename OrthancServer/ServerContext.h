@@ -34,19 +34,23 @@
 #pragma once
 
 #include "../Core/MultiThreading/SharedMessageQueue.h"
-#include "../Core/Cache/MemoryCache.h"
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/FileStorage/IStorageArea.h"
 #include "../Core/Lua/LuaContext.h"
 #include "../Core/RestApi/RestApiOutput.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
+#include "ArchiveCache.h"
+#include "AttachmentCache.h"
+#include "DicomAsJsonCache.h"
 #include "DicomInstanceToStore.h"
 #include "../Core/DicomNetworking/ReusableDicomUserConnection.h"
 #include "IServerListener.h"
 #include "LuaScripting.h"
+#include "ParsedDicomCache.h"
 #include "../Core/DicomParsing/ParsedDicomFile.h"
 #include "Scheduler/ServerScheduler.h"
 #include "ServerIndex.h"
+#include "StorageCompressionAdvisor.h"
 #include "OrthancHttpHandler.h"
 
 #include <boost/filesystem.hpp>
@@ -63,7 +67,7 @@ namespace Orthanc
   class ServerContext
   {
   private:
-    class DicomCacheProvider : public ICachePageProvider
+    class DicomCacheProvider : public ParsedDicomCache::IProvider
     {
     private:
       ServerContext& context_;
@@ -73,7 +77,8 @@ namespace Orthanc
       {
       }
       
-      virtual IDynamicObject* Provide(const std::string& id);
+      virtual ParsedDicomFile* Provide(size_t& size,
+                                       const std::string& instancePublicId);
     };
 
     class ServerListener
@@ -109,16 +114,39 @@ namespace Orthanc
     void ReadDicomAsJsonInternal(std::string& result,
                                  const std::string& instancePublicId);
 
+    AttachmentCache::Content ReadAndCacheAttachment(const FileInfo& attachment);
+
+    // Notification of the clients that wait for new changes. These
+    // members are declared before "index_", that can signal changes
+    // from its constructor.
+    boost::mutex changesFeedMutex_;
+    boost::condition_variable changesFeedSignaled_;
+    uint64_t changesFeedCount_;
+    bool changesFeedClosed_;
+    unsigned int changesStreamClients_;
+    unsigned int maxChangesStreamClients_;
+
     ServerIndex index_;
     IStorageArea& area_;
 
-    bool compressionEnabled_;
+    // Compression of the attachments, depending on their type. This
+    // policy is set once, before the servers are started.
+    typedef std::map<FileContentType, CompressionType>  CompressionPolicy;
+
+    CompressionType defaultCompression_;
+    CompressionPolicy compressionPolicy_;
+    StorageCompressionAdvisor compressionAdvisor_;
+    AttachmentCache attachmentCache_;
+    DicomAsJsonCache dicomAsJsonCache_;
     bool storeMD5_;
+    bool bitPreservingStoreScp_;
+    bool binaryDicomAsJson_;
+    unsigned int httpCacheMaxAge_;
     
     DicomCacheProvider provider_;
-    boost::mutex dicomCacheMutex_;
-    MemoryCache dicomCache_;
+    ParsedDicomCache dicomCache_;
     ReusableDicomUserConnection scu_;
+    ArchiveCache archiveCache_;  // Must outlive the jobs of the scheduler
     ServerScheduler scheduler_;
 
     LuaScripting lua_;
@@ -139,22 +167,23 @@ namespace Orthanc
     OrthancHttpHandler  httpHandler_;
 
   public:
+    // Gives an exclusive access to one parsed DICOM instance. The
+    // other instances can be accessed concurrently by other threads.
     class DicomCacheLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
-      ParsedDicomFile *dicom_;
-      boost::mutex::scoped_lock lock_;
+      ParsedDicomCache::Accessor accessor_;
 
     public:
       DicomCacheLocker(ServerContext& that,
-                       const std::string& instancePublicId);
-
-      ~DicomCacheLocker();
+                       const std::string& instancePublicId) :
+        accessor_(that.dicomCache_, instancePublicId)
+      {
+      }
 
       ParsedDicomFile& GetDicom()
       {
-        return *dicom_;
+        return accessor_.GetDicom();
       }
     };
 
@@ -168,13 +197,71 @@ namespace Orthanc
       return index_;
     }
 
+    // Sets the compression of all the types of attachments to
+    // "zlib" (if enabled) or to "none" (if disabled)
     void SetCompressionEnabled(bool enabled);
 
-    bool IsCompressionEnabled() const
+    // Returns "true" iff at least one type of attachment is compressed
+    bool IsCompressionEnabled() const;
+
+    void SetDefaultCompression(CompressionType compression);
+
+    void SetCompression(FileContentType type,
+                        CompressionType compression);
+
+    CompressionType GetCompression(FileContentType type) const;
+
+    // Skips the compression of the DICOM files that would not
+    // benefit from it, and keeps the related statistics
+    StorageCompressionAdvisor& GetCompressionAdvisor()
+    {
+      return compressionAdvisor_;
+    }
+
+    // If enabled, the DICOM instances received by the C-STORE SCP
+    // are written to a temporary file, that is directly moved into
+    // the storage area, without being re-encoded by DCMTK
+    void SetBitPreservingStoreScp(bool enabled);
+
+    bool IsBitPreservingStoreScp() const
+    {
+      return bitPreservingStoreScp_;
+    }
+
+    // If enabled, the "DICOM-as-JSON" summaries are written to the
+    // storage area with the compact binary encoding
+    void SetBinaryDicomAsJson(bool enabled)
+    {
+      binaryDicomAsJson_ = enabled;
+    }
+
+    bool IsBinaryDicomAsJson() const
+    {
+      return binaryDicomAsJson_;
+    }
+
+    // Number of seconds during which the HTTP clients can reuse the
+    // immutable answers about the instances without revalidating
+    // them (0 means that they must always be revalidated)
+    void SetHttpCacheMaxAge(unsigned int seconds)
+    {
+      httpCacheMaxAge_ = seconds;
+    }
+
+    unsigned int GetHttpCacheMaxAge() const
     {
-      return compressionEnabled_;
+      return httpCacheMaxAge_;
     }
 
+    // Serializes a "DICOM-as-JSON" summary for the storage area
+    void FormatDicomAsJson(std::string& target,
+                           const Json::Value& summary) const;
+
+    // Creates the path to a temporary file, that can be moved as is
+    // into the storage area by "Store()". Returns "false" if this is
+    // not possible (storage compression, or storage area plugin).
+    bool CreateTemporaryStorageFile(std::string& path);
+
     void RemoveFile(const std::string& fileUuid,
                     FileContentType type);
 
@@ -216,21 +303,61 @@ namespace Orthanc
       ReadDicomAsJson(result, instancePublicId, ignoreTagLength);
     }
 
-    void ReadDicom(std::string& dicom,
-                   const std::string& instancePublicId)
+    // Returns the parsed "DICOM-as-JSON" summary, that is shared with
+    // the cache of the summaries and must not be modified
+    DicomAsJsonCache::Content ReadSharedDicomAsJson(const std::string& instancePublicId);
+
+    void InvalidateDicomAsJson(const std::string& instancePublicId)
+    {
+      dicomAsJsonCache_.Invalidate(instancePublicId);
+    }
+
+    // Rewrites the "DICOM-as-JSON" attachment of one instance with
+    // the encoding that is currently configured. Returns "false" if
+    // the attachment was already encoded this way.
+    bool ConvertDicomAsJson(const std::string& instancePublicId);
+
+    // The DICOM file is shared with the attachment cache, without copy
+    AttachmentCache::Content ReadDicom(const std::string& instancePublicId)
     {
-      ReadAttachment(dicom, instancePublicId, FileContentType_Dicom, true);
+      return ReadSharedAttachment(instancePublicId, FileContentType_Dicom);
     }
     
-    // TODO CACHING MECHANISM AT THIS POINT
+    // The uncompressed attachments are copied from the attachment
+    // cache if they are found there, but this method does not fill
+    // the cache, as the caller owns the result: Prefer
+    // "ReadSharedAttachment()". The raw attachments are always read
+    // from the storage area.
     void ReadAttachment(std::string& result,
                         const std::string& instancePublicId,
                         FileContentType content,
                         bool uncompressIfNeeded);
-    
+
+    // Same as "ReadAttachment()", but returns the buffer that is
+    // shared with the attachment cache, without copying it
+    AttachmentCache::Content ReadSharedAttachment(const std::string& instancePublicId,
+                                                  FileContentType content);
+
+    // Bypasses the attachment cache
     void ReadAttachment(std::string& result,
                         const FileInfo& attachment);
 
+    // Maximum number of bytes in the attachment cache (0 to disable it)
+    void SetAttachmentCacheSize(uint64_t size);
+
+    void GetAttachmentCacheStatistics(Json::Value& target);
+
+    // Maximum memory used by the parsed DICOM instances (in bytes)
+    void SetDicomCacheSize(size_t size);
+
+    void GetDicomCacheStatistics(Json::Value& target);
+
+    // Maximum memory used by the parsed "DICOM-as-JSON" summaries (in
+    // bytes of serialized JSON, 0 to disable the cache)
+    void SetDicomAsJsonCacheSize(size_t size);
+
+    void GetDicomAsJsonCacheStatistics(Json::Value& target);
+
     void SetStoreMD5ForAttachments(bool storeMD5);
 
     bool IsStoreMD5ForAttachments() const
@@ -248,12 +375,42 @@ namespace Orthanc
       return scheduler_;
     }
 
+    ArchiveCache& GetArchiveCache()
+    {
+      return archiveCache_;
+    }
+
     bool DeleteResource(Json::Value& target,
                         const std::string& uuid,
                         ResourceType expectedType);
 
     void SignalChange(const ServerIndexChange& change);
 
+    // Number of changes that have been signaled so far
+    uint64_t GetChangesCount();
+
+    // Waits for at most "timeout" milliseconds for a change to be
+    // signaled after the "count" first ones. Returns "false" on
+    // timeout, or if the feed of the changes is closed. On success,
+    // "count" is updated.
+    bool WaitForChanges(uint64_t& count,
+                        unsigned int timeout);
+
+    // Wakes up the clients that wait for changes, and prevents them
+    // from waiting again (used before stopping the HTTP server)
+    void CloseChangesFeed();
+
+    bool IsChangesFeedClosed();
+
+    // Bounds the number of concurrent clients of "/changes/stream",
+    // as each of them occupies one HTTP thread (0 means no limit)
+    void SetMaximumChangesStreamClients(unsigned int count);
+
+    // Returns "false" if the maximum number of clients is reached
+    bool AddChangesStreamClient();
+
+    void RemoveChangesStreamClient();
+
     SharedArchive& GetQueryRetrieveArchive()
     {
       return queryRetrieveArchive_;
@@ -317,6 +317,85 @@ namespace Orthanc
     }
   }
 
+
+  ChangeType StringToChangeType(const std::string& type)
+  {
+    if (type == "CompletedSeries")
+    {
+      return ChangeType_CompletedSeries;
+    }
+    else if (type == "NewInstance")
+    {
+      return ChangeType_NewInstance;
+    }
+    else if (type == "NewPatient")
+    {
+      return ChangeType_NewPatient;
+    }
+    else if (type == "NewSeries")
+    {
+      return ChangeType_NewSeries;
+    }
+    else if (type == "NewStudy")
+    {
+      return ChangeType_NewStudy;
+    }
+    else if (type == "AnonymizedStudy")
+    {
+      return ChangeType_AnonymizedStudy;
+    }
+    else if (type == "AnonymizedSeries")
+    {
+      return ChangeType_AnonymizedSeries;
+    }
+    else if (type == "ModifiedStudy")
+    {
+      return ChangeType_ModifiedStudy;
+    }
+    else if (type == "ModifiedSeries")
+    {
+      return ChangeType_ModifiedSeries;
+    }
+    else if (type == "AnonymizedPatient")
+    {
+      return ChangeType_AnonymizedPatient;
+    }
+    else if (type == "ModifiedPatient")
+    {
+      return ChangeType_ModifiedPatient;
+    }
+    else if (type == "StablePatient")
+    {
+      return ChangeType_StablePatient;
+    }
+    else if (type == "StableStudy")
+    {
+      return ChangeType_StableStudy;
+    }
+    else if (type == "StableSeries")
+    {
+      return ChangeType_StableSeries;
+    }
+    else if (type == "Deleted")
+    {
+      return ChangeType_Deleted;
+    }
+    else if (type == "NewChildInstance")
+    {
+      return ChangeType_NewChildInstance;
+    }
+    else if (type == "UpdatedAttachment")
+    {
+      return ChangeType_UpdatedAttachment;
+    }
+    else if (type == "UpdatedMetadata")
+    {
+      return ChangeType_UpdatedMetadata;
+    }
+
+    throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+
   
   bool IsUserMetadata(MetadataType metadata)
   {
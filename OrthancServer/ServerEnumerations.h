@@ -153,5 +153,7 @@ namespace Orthanc
 
   const char* EnumerationToString(ChangeType type);
 
+  ChangeType StringToChangeType(const std::string& type);
+
   bool IsUserMetadata(MetadataType type);
 }
@@ -86,11 +86,13 @@ namespace Orthanc
     };
 
     ServerContext& context_;
+    PublicIdCache& publicIdCache_;
     bool hasRemainingLevel_;
     ResourceType remainingType_;
     std::string remainingPublicId_;
     std::list<FileToRemove> pendingFilesToRemove_;
     std::list<ServerIndexChange> pendingChanges_;
+    std::list<std::string> pendingDeletedResources_;
     uint64_t sizeOfFilesToRemove_;
     bool insideTransaction_;
 
@@ -100,11 +102,15 @@ namespace Orthanc
       hasRemainingLevel_ = false;
       pendingFilesToRemove_.clear();
       pendingChanges_.clear();
+      pendingDeletedResources_.clear();
     }
 
   public:
-    Listener(ServerContext& context) : context_(context),
-                                       insideTransaction_(false)      
+    Listener(ServerContext& context,
+             PublicIdCache& publicIdCache) : 
+      context_(context),
+      publicIdCache_(publicIdCache),
+      insideTransaction_(false)      
     {
       Reset();
       assert(ResourceType_Patient < ResourceType_Study &&
@@ -128,6 +134,11 @@ namespace Orthanc
       return sizeOfFilesToRemove_;
     }
 
+    bool HasFilesToRemove() const
+    {
+      return !pendingFilesToRemove_.empty();
+    }
+
     void CommitFilesToRemove()
     {
       for (std::list<FileToRemove>::const_iterator 
@@ -138,6 +149,19 @@ namespace Orthanc
       }
     }
 
+    void CommitDeletedResources()
+    {
+      // Invalidate again the deleted resources, now that the deletion
+      // is visible to the read-only connections: A concurrent reader
+      // might have started before the transaction was committed
+      for (std::list<std::string>::const_iterator
+             it = pendingDeletedResources_.begin(); 
+           it != pendingDeletedResources_.end(); ++it)
+      {
+        publicIdCache_.Invalidate(*it);
+      }
+    }
+
     void CommitChanges()
     {
       for (std::list<ServerIndexChange>::const_iterator 
@@ -182,6 +206,16 @@ namespace Orthanc
               << EnumerationToString(change.GetResourceType()) << ": " 
               << EnumerationToString(change.GetChangeType());
 
+      if (change.GetChangeType() == ChangeType_Deleted)
+      {
+        publicIdCache_.Invalidate(change.GetPublicId());
+
+        if (insideTransaction_)
+        {
+          pendingDeletedResources_.push_back(change.GetPublicId());
+        }
+      }
+
       if (insideTransaction_)
       {
         pendingChanges_.push_back(change);
@@ -247,10 +281,23 @@ namespace Orthanc
       {
         transaction_->Commit();
 
+        index_.listener_->CommitDeletedResources();
+
         // We can remove the files once the SQLite transaction has
         // been successfully committed. Some files might have to be
-        // deleted because of recycling.
-        index_.listener_->CommitFilesToRemove();
+        // deleted because of recycling. If the database keeps the
+        // list of the deleted files, this is done in the background.
+        if (index_.hasFileReaper_)
+        {
+          if (index_.listener_->HasFilesToRemove())
+          {
+            index_.WakeUpFileReaper();
+          }
+        }
+        else
+        {
+          index_.listener_->CommitFilesToRemove();
+        }
 
         index_.currentStorageSize_ += sizeOfAddedFiles;
 
@@ -266,29 +313,177 @@ namespace Orthanc
   };
 
 
+  class ServerIndex::ReadOnlyTransaction : public boost::noncopyable
+  {
+  private:
+    ServerIndex& index_;
+    uint64_t cacheGeneration_;
+    IDatabaseWrapper* reader_;
+    std::auto_ptr<boost::mutex::scoped_lock> lock_;
+    std::auto_ptr<SQLite::ITransaction> transaction_;
+
+    void Release()
+    {
+      if (reader_ != NULL)
+      {
+        boost::mutex::scoped_lock lock(index_.readersMutex_);
+        index_.availableReaders_.push(reader_);
+        index_.readerReleased_.notify_one();
+        reader_ = NULL;
+      }
+    }
+
+  public:
+    ReadOnlyTransaction(ServerIndex& index) : 
+      index_(index),
+      cacheGeneration_(index.publicIdCache_.GetGeneration()),  // Before the snapshot
+      reader_(NULL)
+    {
+      {
+        boost::mutex::scoped_lock lock(index_.readersMutex_);
+
+        if (!index_.readers_.empty())
+        {
+          while (index_.availableReaders_.empty())
+          {
+            index_.readerReleased_.wait(lock);
+          }
+
+          reader_ = index_.availableReaders_.top();
+          index_.availableReaders_.pop();
+        }
+      }
+
+      if (reader_ == NULL)
+      {
+        // No read-only connection is available, fallback to the
+        // writer connection, that must be accessed exclusively
+        lock_.reset(new boost::mutex::scoped_lock(index_.mutex_));
+      }
+      else
+      {
+        try
+        {
+          // Give a consistent snapshot of the database to the caller
+          transaction_.reset(reader_->StartTransaction());
+          transaction_->Begin();
+        }
+        catch (OrthancException&)
+        {
+          transaction_.reset(NULL);
+          Release();
+          throw;
+        }
+      }
+    }
+
+    ~ReadOnlyTransaction()
+    {
+      if (transaction_.get() != NULL)
+      {
+        try
+        {
+          transaction_->Commit();
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot close a read-only transaction: " << e.What();
+        }
+
+        transaction_.reset(NULL);
+      }
+
+      Release();
+    }
+
+    bool IsConcurrent() const
+    {
+      return reader_ != NULL;
+    }
+
+    IDatabaseWrapper& GetDatabase()
+    {
+      return (reader_ == NULL ? index_.db_ : *reader_);
+    }
+
+    bool LookupResource(int64_t& id,
+                        ResourceType& type,
+                        const std::string& publicId)
+    {
+      if (index_.publicIdCache_.Lookup(id, type, publicId))
+      {
+        return true;
+      }
+      else if (GetDatabase().LookupResource(id, type, publicId))
+      {
+        index_.publicIdCache_.Add(publicId, id, type, cacheGeneration_);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    // The resource must have been found by "LookupResource()"
+    bool LookupParent(int64_t& parentId,
+                      std::string& parentPublicId,
+                      int64_t id,
+                      ResourceType type,
+                      const std::string& publicId)
+    {
+      if (type == ResourceType_Patient)
+      {
+        return false;
+      }
+      else if (index_.publicIdCache_.LookupParent(parentId, parentPublicId, publicId))
+      {
+        return true;
+      }
+      else if (GetDatabase().LookupParent(parentId, id))
+      {
+        parentPublicId = GetDatabase().GetPublicId(parentId);
+        index_.publicIdCache_.Add(publicId, id, type, parentId, parentPublicId, cacheGeneration_);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+  };
+
+
   class ServerIndex::UnstableResourcePayload
   {
   private:
     ResourceType type_;
     std::string publicId_;
-    boost::posix_time::ptime time_;
+    uint64_t deadline_;
 
   public:
-    UnstableResourcePayload() : type_(ResourceType_Instance)
+    UnstableResourcePayload() :
+      type_(ResourceType_Instance),
+      deadline_(0)
     {
     }
 
     UnstableResourcePayload(Orthanc::ResourceType type,
-                            const std::string& publicId) : 
+                            const std::string& publicId,
+                            unsigned int stableAge) : 
       type_(type),
       publicId_(publicId)
     {
-      time_ = boost::posix_time::second_clock::local_time();
+      deadline_ = (SystemToolbox::GetMonotonicMicroseconds() +
+                   static_cast<uint64_t>(stableAge) * 1000000);
     }
 
-    unsigned int GetAge() const
+    // Time at which the resource becomes stable, if it does not
+    // receive any new instance in the meantime (on the monotonic
+    // clock, so that a change of the system time has no effect)
+    uint64_t GetDeadline() const
     {
-      return (boost::posix_time::second_clock::local_time() - time_).total_seconds();
+      return deadline_;
     }
 
     ResourceType GetResourceType() const
@@ -313,7 +508,7 @@ namespace Orthanc
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, uuid) ||
+    if (!LookupResourceWithCache(id, type, uuid) ||
         expectedType != type)
     {
       return false;
@@ -342,126 +537,433 @@ namespace Orthanc
   }
 
 
-  void ServerIndex::FlushThread(ServerIndex* that)
+  void ServerIndex::WakeUpFileReaper()
   {
-    // By default, wait for 10 seconds before flushing
-    unsigned int sleep = 10;
+    boost::mutex::scoped_lock lock(fileReaperMutex_);
+    fileReaperWakeup_.notify_one();
+  }
 
-    try
+
+  void ServerIndex::SetFileDeletionRate(unsigned int rate)
+  {
+    boost::mutex::scoped_lock lock(fileReaperMutex_);
+    fileDeletionRate_ = rate;
+
+    if (rate > 0)
     {
-      boost::mutex::scoped_lock lock(that->mutex_);
-      std::string sleepString;
+      LOG(WARNING) << "At most " << rate << " deleted files are removed per second";
+    }
+  }
 
-      if (that->db_.LookupGlobalProperty(sleepString, GlobalProperty_FlushSleep) &&
-          Toolbox::IsInteger(sleepString))
-      {
-        sleep = boost::lexical_cast<unsigned int>(sleepString);
-      }
+
+  namespace
+  {
+    // A file that could not be removed from the storage area, and
+    // that is kept in the list of the deleted files to be retried
+    struct FailedRemoval
+    {
+      unsigned int        attempts_;
+      boost::system_time  nextAttempt_;
+    };
+  }
+
+
+  static bool RemoveDeletedFile(ServerContext& context,
+                                const FileInfo& file)
+  {
+    try
+    {
+      context.RemoveFile(file.GetUuid(), file.GetContentType());
+      return true;
     }
-    catch (boost::bad_lexical_cast&)
+    catch (OrthancException& e)
     {
+      if (e.GetErrorCode() == ErrorCode_InexistentFile ||
+          e.GetErrorCode() == ErrorCode_UnknownResource)
+      {
+        // The file is already gone
+        return true;
+      }
+      else
+      {
+        LOG(ERROR) << "Cannot remove the deleted file " << file.GetUuid()
+                   << " from the storage area: " << e.What();
+        return false;
+      }
     }
+  }
 
-    LOG(INFO) << "Starting the database flushing thread (sleep = " << sleep << ")";
 
-    unsigned int count = 0;
+  void ServerIndex::FileReaperThread(ServerIndex* that)
+  {
+    // Number of files that are read from the database, then removed
+    // from the storage area without holding the lock on the index
+    static const uint32_t BATCH_SIZE = 100;
+
+    // Delay before retrying a failed removal, that is doubled after
+    // each new failure of the same file (in seconds)
+    static const unsigned int MAX_RETRY_EXPONENT = 12;  // ~1 hour
+
+    LOG(INFO) << "Starting the background removal of the deleted files";
+
+    typedef std::map<std::string, FailedRemoval>  FailedRemovals;
+    FailedRemovals failures;
 
     while (!that->done_)
     {
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
-      count++;
-      if (count < sleep)
+      std::list<FileInfo> files;
+
       {
-        continue;
+        boost::mutex::scoped_lock lock(that->mutex_);
+        that->db_.GetDeletedFiles(files, BATCH_SIZE);
       }
 
-      Logging::Flush();
+      std::list<std::string> removed;
+      std::list<std::string> postponed;
+      bool attempted = false;
 
-      boost::mutex::scoped_lock lock(that->mutex_);
-      that->db_.FlushToDisk();
-      count = 0;
-    }
+      const boost::system_time now = boost::get_system_time();
 
-    LOG(INFO) << "Stopping the database flushing thread";
-  }
+      for (std::list<FileInfo>::const_iterator 
+             it = files.begin(); it != files.end() && !that->done_; ++it)
+      {
+        FailedRemovals::iterator failure = failures.find(it->GetUuid());
 
+        if (failure != failures.end() &&
+            now < failure->second.nextAttempt_)
+        {
+          // Waiting for the next attempt: The file is moved to the
+          // end of the list, so as not to block the other files
+          postponed.push_back(it->GetUuid());
+          continue;
+        }
 
-  static void ComputeExpectedNumberOfInstances(IDatabaseWrapper& db,
-                                               int64_t series,
-                                               const DicomMap& dicomSummary)
-  {
-    try
-    {
-      const DicomValue* value;
-      const DicomValue* value2;
-          
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGES_IN_ACQUISITION)) != NULL &&
-          (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TEMPORAL_POSITIONS)) != NULL)
+        attempted = true;
+
+        if (RemoveDeletedFile(that->context_, *it))
+        {
+          removed.push_back(it->GetUuid());
+
+          if (failure != failures.end())
+          {
+            failures.erase(failure);
+          }
+        }
+        else
+        {
+          // The file is kept in the database, to be retried later
+          FailedRemoval& retry = failures[it->GetUuid()];
+
+          if (failure == failures.end())
+          {
+            retry.attempts_ = 0;
+          }
+
+          unsigned int delay = 1u << std::min(retry.attempts_, MAX_RETRY_EXPONENT);
+          retry.attempts_++;
+          retry.nextAttempt_ = boost::get_system_time() + boost::posix_time::seconds(delay);
+          postponed.push_back(it->GetUuid());
+
+          LOG(WARNING) << "The removal of the deleted file " << it->GetUuid()
+                       << " will be retried in " << delay << " seconds";
+        }
+
+        unsigned int rate;
+
+        {
+          boost::mutex::scoped_lock lock(that->fileReaperMutex_);
+          rate = that->fileDeletionRate_;
+        }
+
+        if (rate > 0)
+        {
+          boost::this_thread::sleep(boost::posix_time::microseconds(1000000 / rate));
+        }
+      }
+
+      if (!removed.empty() ||
+          !postponed.empty())
       {
-        // Patch for series with temporal positions thanks to Will Ryder
-        int64_t imagesInAcquisition = boost::lexical_cast<int64_t>(value->GetContent());
-        int64_t countTemporalPositions = boost::lexical_cast<int64_t>(value2->GetContent());
-        std::string expected = boost::lexical_cast<std::string>(imagesInAcquisition * countTemporalPositions);
-        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, expected);
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        std::auto_ptr<SQLite::ITransaction> transaction(that->db_.StartTransaction());
+        transaction->Begin();
+
+        for (std::list<std::string>::const_iterator 
+               it = removed.begin(); it != removed.end(); ++it)
+        {
+          that->db_.ClearDeletedFile(*it);
+        }
+
+        for (std::list<std::string>::const_iterator 
+               it = postponed.begin(); it != postponed.end(); ++it)
+        {
+          that->db_.PostponeDeletedFile(*it);
+        }
+
+        transaction->Commit();
       }
 
-      else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_SLICES)) != NULL &&
-               (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TIME_SLICES)) != NULL)
+      if (!removed.empty())
       {
-        // Support of Cardio-PET images
-        int64_t numberOfSlices = boost::lexical_cast<int64_t>(value->GetContent());
-        int64_t numberOfTimeSlices = boost::lexical_cast<int64_t>(value2->GetContent());
-        std::string expected = boost::lexical_cast<std::string>(numberOfSlices * numberOfTimeSlices);
-        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, expected);
+        VLOG(1) << removed.size() << " deleted files were removed from the storage area";
       }
 
-      else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES)) != NULL)
+      if (!attempted)
       {
-        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, value->GetContent());
+        // Wait for some file to be deleted, or for the next retry
+        boost::mutex::scoped_lock lock(that->fileReaperMutex_);
+        if (!that->done_)
+        {
+          that->fileReaperWakeup_.timed_wait(lock, boost::posix_time::seconds(1));
+        }
       }
     }
-    catch (OrthancException&)
+
+    LOG(INFO) << "Stopping the background removal of the deleted files";
+  }
+
+
+  void ServerIndex::SetChangesRetention(uint64_t maximumCount,
+                                        unsigned int maximumAge)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumChangesCount_ = maximumCount;
+    maximumChangesAge_ = maximumAge;
+
+    if (maximumCount > 0)
     {
+      LOG(WARNING) << "At most " << maximumCount << " entries are kept in the logs of the changes and exports";
     }
-    catch (boost::bad_lexical_cast&)
+
+    if (maximumAge > 0)
     {
+      LOG(WARNING) << "The entries of the logs of the changes and exports are kept for "
+                   << maximumAge << " days";
     }
   }
 
 
-
-
-  bool ServerIndex::GetMetadataAsInteger(int64_t& result,
-                                         int64_t id,
-                                         MetadataType type)
+  bool ServerIndex::PruneLogs(uint32_t maxResults)
   {
-    std::string s;
-    if (!db_.LookupMetadata(s, id, type))
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // for writing.
+
+    std::string minDate;
+    if (maximumChangesAge_ > 0)
     {
-      return false;
+      // Same format as "SystemToolbox::GetNowIsoString(true)"
+      minDate = boost::posix_time::to_iso_string
+        (boost::posix_time::second_clock::universal_time() - 
+         boost::posix_time::hours(24 * maximumChangesAge_));
     }
 
-    try
+    uint32_t removedChanges, removedExports;
+
+    std::auto_ptr<SQLite::ITransaction> transaction(db_.StartTransaction());
+    transaction->Begin();
+
+    if (!db_.PruneChanges(removedChanges, maximumChangesCount_, minDate, maxResults) ||
+        !db_.PruneExportedResources(removedExports, maximumChangesCount_, minDate, maxResults))
     {
-      result = boost::lexical_cast<int64_t>(s);
-      return true;
+      transaction->Rollback();
+      throw OrthancException(ErrorCode_NotImplemented);
     }
-    catch (boost::bad_lexical_cast&)
+
+    transaction->Commit();
+
+    if (removedChanges > 0 ||
+        removedExports > 0)
     {
-      return false;
+      VLOG(1) << "Pruned " << removedChanges << " changes and "
+              << removedExports << " exports from the logs";
     }
+
+    return (removedChanges == maxResults ||
+            removedExports == maxResults);
   }
 
 
-  void ServerIndex::LogChange(int64_t internalId,
-                              ChangeType changeType,
-                              ResourceType resourceType,
-                              const std::string& publicId)
+  void ServerIndex::LogRetentionThread(ServerIndex* that)
   {
-    ServerIndexChange change(changeType, resourceType, publicId);
+    // Small batches, so that "mutex_" is only locked for a short time
+    static const uint32_t BATCH_SIZE = 1000;
+    static const unsigned int PERIOD = 10;  // In seconds
 
-    if (changeType <= ChangeType_INTERNAL_LastLogged)
-    {
+    LOG(INFO) << "Starting the thread for the retention of the logs";
+
+    unsigned int count = PERIOD;
+
+    while (!that->done_)
+    {
+      bool pending = false;
+
+      if (count >= PERIOD)
+      {
+        count = 0;
+
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        if (that->maximumChangesCount_ > 0 ||
+            that->maximumChangesAge_ > 0)
+        {
+          try
+          {
+            pending = that->PruneLogs(BATCH_SIZE);
+          }
+          catch (OrthancException& e)
+          {
+            if (e.GetErrorCode() == ErrorCode_NotImplemented)
+            {
+              LOG(WARNING) << "The database engine cannot prune the logs of the changes and exports";
+              break;
+            }
+            else
+            {
+              LOG(ERROR) << "Cannot prune the logs of the changes and exports: " << e.What();
+            }
+          }
+        }
+      }
+
+      if (pending)
+      {
+        // Let the other writers access the index before the next batch
+        count = PERIOD;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      }
+      else
+      {
+        boost::this_thread::sleep(boost::posix_time::seconds(1));
+        count++;
+      }
+    }
+
+    LOG(INFO) << "Stopping the thread for the retention of the logs";
+  }
+
+
+  void ServerIndex::FlushThread(ServerIndex* that)
+  {
+    // By default, wait for 10 seconds before flushing
+    unsigned int sleep = 10;
+
+    try
+    {
+      boost::mutex::scoped_lock lock(that->mutex_);
+      std::string sleepString;
+
+      if (that->db_.LookupGlobalProperty(sleepString, GlobalProperty_FlushSleep) &&
+          Toolbox::IsInteger(sleepString))
+      {
+        sleep = boost::lexical_cast<unsigned int>(sleepString);
+      }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+
+    LOG(INFO) << "Starting the database flushing thread (sleep = " << sleep << ")";
+
+    unsigned int count = 0;
+
+    while (!that->done_)
+    {
+      boost::this_thread::sleep(boost::posix_time::seconds(1));
+      count++;
+      if (count < sleep)
+      {
+        continue;
+      }
+
+      Logging::Flush();
+
+      boost::mutex::scoped_lock lock(that->mutex_);
+      that->db_.FlushToDisk();
+      count = 0;
+    }
+
+    LOG(INFO) << "Stopping the database flushing thread";
+  }
+
+
+  static void ComputeExpectedNumberOfInstances(IDatabaseWrapper& db,
+                                               int64_t series,
+                                               const DicomMap& dicomSummary)
+  {
+    try
+    {
+      const DicomValue* value;
+      const DicomValue* value2;
+          
+      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGES_IN_ACQUISITION)) != NULL &&
+          (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TEMPORAL_POSITIONS)) != NULL)
+      {
+        // Patch for series with temporal positions thanks to Will Ryder
+        int64_t imagesInAcquisition = boost::lexical_cast<int64_t>(value->GetContent());
+        int64_t countTemporalPositions = boost::lexical_cast<int64_t>(value2->GetContent());
+        std::string expected = boost::lexical_cast<std::string>(imagesInAcquisition * countTemporalPositions);
+        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, expected);
+      }
+
+      else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_SLICES)) != NULL &&
+               (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TIME_SLICES)) != NULL)
+      {
+        // Support of Cardio-PET images
+        int64_t numberOfSlices = boost::lexical_cast<int64_t>(value->GetContent());
+        int64_t numberOfTimeSlices = boost::lexical_cast<int64_t>(value2->GetContent());
+        std::string expected = boost::lexical_cast<std::string>(numberOfSlices * numberOfTimeSlices);
+        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, expected);
+      }
+
+      else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES)) != NULL)
+      {
+        db.SetMetadata(series, MetadataType_Series_ExpectedNumberOfInstances, value->GetContent());
+      }
+    }
+    catch (OrthancException&)
+    {
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+  }
+
+
+
+
+  bool ServerIndex::GetMetadataAsInteger(int64_t& result,
+                                         IDatabaseWrapper& db,
+                                         int64_t id,
+                                         MetadataType type)
+  {
+    std::string s;
+    if (!db.LookupMetadata(s, id, type))
+    {
+      return false;
+    }
+
+    try
+    {
+      result = boost::lexical_cast<int64_t>(s);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+  }
+
+
+  void ServerIndex::LogChange(int64_t internalId,
+                              ChangeType changeType,
+                              ResourceType resourceType,
+                              const std::string& publicId)
+  {
+    ServerIndexChange change(changeType, resourceType, publicId);
+
+    if (changeType <= ChangeType_INTERNAL_LastLogged)
+    {
       db_.LogChange(internalId, change);
     }
 
@@ -540,15 +1042,37 @@ namespace Orthanc
   ServerIndex::ServerIndex(ServerContext& context,
                            IDatabaseWrapper& db) : 
     done_(false),
+    context_(context),
+    hasFileReaper_(false),
+    fileDeletionRate_(0),
+    maximumChangesCount_(0),
+    maximumChangesAge_(0),
     db_(db),
     maximumStorageSize_(0),
-    maximumPatients_(0)
+    maximumPatients_(0),
+    storeLeaderActive_(false),
+    storeBatchMaxSize_(1),
+    storeBatchWindow_(0),
+    storeBatchCount_(0),
+    storeBatchInstances_(0),
+    storeBatchLargest_(0)
   {
-    listener_.reset(new Listener(context));
+    stableAge_ = Configuration::GetGlobalUnsignedIntegerParameter("StableAge", 60);
+    if (stableAge_ == 0)
+    {
+      stableAge_ = 60;
+    }
+
+    listener_.reset(new Listener(context, publicIdCache_));
     db_.SetListener(*listener_);
 
     currentStorageSize_ = db_.GetTotalCompressedSize();
 
+    {
+      std::list<FileInfo> files;
+      hasFileReaper_ = db_.GetDeletedFiles(files, 1);
+    }
+
     // Initial recycling if the parameters have changed since the last
     // execution of Orthanc
     StandaloneRecycling();
@@ -559,6 +1083,13 @@ namespace Orthanc
     }
 
     unstableResourcesMonitorThread_ = boost::thread(UnstableResourcesMonitorThread, this);
+
+    if (hasFileReaper_)
+    {
+      fileReaperThread_ = boost::thread(FileReaperThread, this);
+    }
+
+    logRetentionThread_ = boost::thread(LogRetentionThread, this);
   }
 
 
@@ -588,12 +1119,106 @@ namespace Orthanc
 
       if (unstableResourcesMonitorThread_.joinable())
       {
+        {
+          boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+          unstableResourcesChanged_.notify_one();
+        }
+
         unstableResourcesMonitorThread_.join();
       }
+
+      if (logRetentionThread_.joinable())
+      {
+        logRetentionThread_.join();
+      }
+
+      if (fileReaperThread_.joinable())
+      {
+        // The files that are not removed yet will be removed at the
+        // next start of Orthanc
+        WakeUpFileReaper();
+        fileReaperThread_.join();
+      }
+
+      CloseReadOnlyConnections();
+    }
+  }
+
+
+  void ServerIndex::CloseReadOnlyConnections()
+  {
+    // Wait for the pending read-only transactions to complete
+    boost::mutex::scoped_lock lock(readersMutex_);
+    while (availableReaders_.size() != readers_.size())
+    {
+      readerReleased_.wait(lock);
+    }
+
+    for (size_t i = 0; i < readers_.size(); i++)
+    {
+      assert(readers_[i] != NULL);
+
+      try
+      {
+        readers_[i]->Close();
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Cannot close a read-only connection to the database: " << e.What();
+      }
+
+      delete readers_[i];
+    }
+
+    readers_.clear();
+
+    while (!availableReaders_.empty())
+    {
+      availableReaders_.pop();
+    }
+  }
+
+
+  void ServerIndex::SetConcurrentReaders(unsigned int count)
+  {
+    CloseReadOnlyConnections();
+
+    boost::mutex::scoped_lock lock(readersMutex_);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      IDatabaseWrapper* reader;
+
+      {
+        boost::mutex::scoped_lock lock2(mutex_);
+        reader = db_.OpenReadOnlyConnection();
+      }
+
+      if (reader == NULL)
+      {
+        LOG(WARNING) << "The database back-end does not support concurrent readers, "
+                     << "all the accesses to the database will be serialized";
+        break;
+      }
+
+      readers_.push_back(reader);
+      availableReaders_.push(reader);
+    }
+
+    if (!readers_.empty())
+    {
+      LOG(WARNING) << "Number of concurrent readers of the database: " << readers_.size();
     }
   }
 
 
+  unsigned int ServerIndex::GetConcurrentReadersCount()
+  {
+    boost::mutex::scoped_lock lock(readersMutex_);
+    return static_cast<unsigned int>(readers_.size());
+  }
+
+
 
   void ServerIndex::SetInstanceMetadata(std::map<MetadataType, std::string>& instanceMetadata,
                                         int64_t instance,
@@ -606,282 +1231,625 @@ namespace Orthanc
 
 
 
-  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
-                                 DicomInstanceToStore& instanceToStore,
-                                 const Attachments& attachments)
+  StoreStatus ServerIndex::StoreInternal(uint64_t& instanceSize,
+                                         std::map<MetadataType, std::string>& instanceMetadata,
+                                         UnstableResources& unstableResources,
+                                         StoredResources& storedResources,
+                                         DicomInstanceToStore& instanceToStore,
+                                         const Attachments& attachments)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // for writing, and a transaction must be active. The caller is
+    // in charge of committing the transaction if "StoreStatus_Success"
+    // is returned, and of rolling it back on exceptions. The parent
+    // resources are added to "unstableResources", that must be
+    // given to MarkAsUnstable() once the transaction is committed.
+    // Similarly, the whole hierarchy is added to "storedResources",
+    // that must be given to CacheStoredResources().
 
     const DicomMap& dicomSummary = instanceToStore.GetSummary();
     const ServerIndex::MetadataMap& metadata = instanceToStore.GetMetadata();
 
     instanceMetadata.clear();
+    instanceSize = 0;
 
     DicomInstanceHasher hasher(instanceToStore.GetSummary());
 
-    try
+    // Do nothing if the instance already exists
     {
-      Transaction t(*this);
-
-      // Do nothing if the instance already exists
+      ResourceType type;
+      int64_t tmp;
+      if (LookupResourceWithCache(tmp, type, hasher.HashInstance()))
       {
-        ResourceType type;
-        int64_t tmp;
-        if (db_.LookupResource(tmp, type, hasher.HashInstance()))
-        {
-          assert(type == ResourceType_Instance);
-          db_.GetAllMetadata(instanceMetadata, tmp);
-          return StoreStatus_AlreadyStored;
-        }
-      }
-
-      // Ensure there is enough room in the storage for the new instance
-      uint64_t instanceSize = 0;
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
-      {
-        instanceSize += it->GetCompressedSize();
+        assert(type == ResourceType_Instance);
+        db_.GetAllMetadata(instanceMetadata, tmp);
+        return StoreStatus_AlreadyStored;
       }
+    }
 
-      Recycle(instanceSize, hasher.HashPatient());
-
-      // Create the instance
-      int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
-      ServerToolbox::StoreMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
-
-      // Detect up to which level the patient/study/series/instance
-      // hierarchy must be created
-      int64_t patient = -1, study = -1, series = -1;
-      bool isNewPatient = false;
-      bool isNewStudy = false;
-      bool isNewSeries = false;
-
-      {
-        ResourceType dummy;
-
-        if (db_.LookupResource(series, dummy, hasher.HashSeries()))
-        {
-          assert(dummy == ResourceType_Series);
-          // The patient, the study and the series already exist
+    // Ensure there is enough room in the storage for the new instance
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
+    {
+      instanceSize += it->GetCompressedSize();
+    }
 
-          bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
-                     db_.LookupResource(study, dummy, hasher.HashStudy()));
-          assert(ok);
-        }
-        else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
-        {
-          assert(dummy == ResourceType_Study);
+    Recycle(instanceSize, hasher.HashPatient());
 
-          // New series: The patient and the study already exist
-          isNewSeries = true;
+    // Create the instance
+    int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
+    ServerToolbox::StoreMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
 
-          bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
-          assert(ok);
-        }
-        else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
-        {
-          assert(dummy == ResourceType_Patient);
+    // Detect up to which level the patient/study/series/instance
+    // hierarchy must be created
+    int64_t patient = -1, study = -1, series = -1;
+    bool isNewPatient = false;
+    bool isNewStudy = false;
+    bool isNewSeries = false;
 
-          // New study and series: The patient already exist
-          isNewStudy = true;
-          isNewSeries = true;
-        }
-        else
-        {
-          // New patient, study and series: Nothing exists
-          isNewPatient = true;
-          isNewStudy = true;
-          isNewSeries = true;
-        }
-      }
+    {
+      ResourceType dummy;
 
-      // Create the series if needed
-      if (isNewSeries)
+      if (LookupResourceWithCache(series, dummy, hasher.HashSeries()))
       {
-        series = CreateResource(hasher.HashSeries(), ResourceType_Series);
-        ServerToolbox::StoreMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
-      }
+        assert(dummy == ResourceType_Series);
+        // The patient, the study and the series already exist
 
-      // Create the study if needed
-      if (isNewStudy)
-      {
-        study = CreateResource(hasher.HashStudy(), ResourceType_Study);
-        ServerToolbox::StoreMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+        bool ok = (LookupResourceWithCache(patient, dummy, hasher.HashPatient()) &&
+                   LookupResourceWithCache(study, dummy, hasher.HashStudy()));
+        assert(ok);
       }
-
-      // Create the patient if needed
-      if (isNewPatient)
+      else if (LookupResourceWithCache(study, dummy, hasher.HashStudy()))
       {
-        patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
-        ServerToolbox::StoreMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
-      }
+        assert(dummy == ResourceType_Study);
 
-      // Create the parent-to-child links
-      db_.AttachChild(series, instance);
+        // New series: The patient and the study already exist
+        isNewSeries = true;
 
-      if (isNewSeries)
-      {
-        db_.AttachChild(study, series);
+        bool ok = LookupResourceWithCache(patient, dummy, hasher.HashPatient());
+        assert(ok);
       }
-
-      if (isNewStudy)
+      else if (LookupResourceWithCache(patient, dummy, hasher.HashPatient()))
       {
-        db_.AttachChild(patient, study);
-      }
+        assert(dummy == ResourceType_Patient);
 
-      // Sanity checks
-      assert(patient != -1);
-      assert(study != -1);
-      assert(series != -1);
-      assert(instance != -1);
-
-      // Attach the files to the newly created instance
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
+        // New study and series: The patient already exist
+        isNewStudy = true;
+        isNewSeries = true;
+      }
+      else
       {
-        db_.AddAttachment(instance, *it);
+        // New patient, study and series: Nothing exists
+        isNewPatient = true;
+        isNewStudy = true;
+        isNewSeries = true;
       }
+    }
 
-      // Attach the user-specified metadata
-      for (MetadataMap::const_iterator 
-             it = metadata.begin(); it != metadata.end(); ++it)
-      {
-        switch (it->first.first)
-        {
-          case ResourceType_Patient:
-            db_.SetMetadata(patient, it->first.second, it->second);
-            break;
+    // Create the series if needed
+    if (isNewSeries)
+    {
+      series = CreateResource(hasher.HashSeries(), ResourceType_Series);
+      ServerToolbox::StoreMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
+    }
 
-          case ResourceType_Study:
-            db_.SetMetadata(study, it->first.second, it->second);
-            break;
+    // Create the study if needed
+    if (isNewStudy)
+    {
+      study = CreateResource(hasher.HashStudy(), ResourceType_Study);
+      ServerToolbox::StoreMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+    }
 
-          case ResourceType_Series:
-            db_.SetMetadata(series, it->first.second, it->second);
-            break;
+    // Create the patient if needed
+    if (isNewPatient)
+    {
+      patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
+      ServerToolbox::StoreMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
+    }
 
-          case ResourceType_Instance:
-            SetInstanceMetadata(instanceMetadata, instance, it->first.second, it->second);
-            break;
+    // Create the parent-to-child links
+    db_.AttachChild(series, instance);
 
-          default:
-            throw OrthancException(ErrorCode_ParameterOutOfRange);
-        }
+    if (isNewSeries)
+    {
+      db_.AttachChild(study, series);
+    }
+
+    if (isNewStudy)
+    {
+      db_.AttachChild(patient, study);
+    }
+
+    // Sanity checks
+    assert(patient != -1);
+    assert(study != -1);
+    assert(series != -1);
+    assert(instance != -1);
+
+    storedResources.push_back(StoredResource(hasher.HashInstance(), instance, ResourceType_Instance,
+                                             series, hasher.HashSeries()));
+    storedResources.push_back(StoredResource(hasher.HashSeries(), series, ResourceType_Series,
+                                             study, hasher.HashStudy()));
+    storedResources.push_back(StoredResource(hasher.HashStudy(), study, ResourceType_Study,
+                                             patient, hasher.HashPatient()));
+    storedResources.push_back(StoredResource(hasher.HashPatient(), patient, ResourceType_Patient,
+                                             -1, ""));
+
+    // Attach the files to the newly created instance
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
+    {
+      db_.AddAttachment(instance, *it);
+    }
+
+    // Attach the user-specified metadata
+    for (MetadataMap::const_iterator 
+           it = metadata.begin(); it != metadata.end(); ++it)
+    {
+      switch (it->first.first)
+      {
+        case ResourceType_Patient:
+          db_.SetMetadata(patient, it->first.second, it->second);
+          break;
+
+        case ResourceType_Study:
+          db_.SetMetadata(study, it->first.second, it->second);
+          break;
+
+        case ResourceType_Series:
+          db_.SetMetadata(series, it->first.second, it->second);
+          break;
+
+        case ResourceType_Instance:
+          SetInstanceMetadata(instanceMetadata, instance, it->first.second, it->second);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
+    }
 
-      // Attach the auto-computed metadata for the patient/study/series levels
-      std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
-      db_.SetMetadata(series, MetadataType_LastUpdate, now);
-      db_.SetMetadata(study, MetadataType_LastUpdate, now);
-      db_.SetMetadata(patient, MetadataType_LastUpdate, now);
+    // Attach the auto-computed metadata for the patient/study/series levels
+    std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
+    db_.SetMetadata(series, MetadataType_LastUpdate, now);
+    db_.SetMetadata(study, MetadataType_LastUpdate, now);
+    db_.SetMetadata(patient, MetadataType_LastUpdate, now);
 
-      // Attach the auto-computed metadata for the instance level,
-      // reflecting these additions into the input metadata map
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_ReceptionDate, now);
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteAet, instanceToStore.GetRemoteAet());
-      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_Origin, 
-                          EnumerationToString(instanceToStore.GetRequestOrigin()));
-        
+    // Attach the auto-computed metadata for the instance level,
+    // reflecting these additions into the input metadata map
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_ReceptionDate, now);
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_RemoteAet, instanceToStore.GetRemoteAet());
+    SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_Origin, 
+                        EnumerationToString(instanceToStore.GetRequestOrigin()));
+      
+    {
+      std::string s;
+      if (instanceToStore.LookupTransferSyntax(s))
       {
-        std::string s;
-        if (instanceToStore.LookupTransferSyntax(s))
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_TransferSyntax, s);
+      }
+    }
+
+    const DicomValue* value;
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&
+        !value->IsNull() &&
+        !value->IsBinary())
+    {
+      SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_SopClassUid, value->GetContent());
+    }
+
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
+        (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+    {
+      if (!value->IsNull() && 
+          !value->IsBinary())
+      {
+        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_IndexInSeries, value->GetContent());
+      }
+    }
+
+    // Check whether the series of this new instance is now completed
+    if (isNewSeries)
+    {
+      ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+    }
+
+    SeriesStatus seriesStatus = GetSeriesStatus(db_, series);
+    if (seriesStatus == SeriesStatus_Complete)
+    {
+      LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+    }
+
+    // Mark the parent resources of this instance as unstable
+    LogChange(series, ChangeType_NewChildInstance, ResourceType_Series, hasher.HashSeries());
+    LogChange(study, ChangeType_NewChildInstance, ResourceType_Study, hasher.HashStudy());
+    LogChange(patient, ChangeType_NewChildInstance, ResourceType_Patient, hasher.HashPatient());
+
+    unstableResources.push_back(UnstableResource(series, ResourceType_Series, hasher.HashSeries()));
+    unstableResources.push_back(UnstableResource(study, ResourceType_Study, hasher.HashStudy()));
+    unstableResources.push_back(UnstableResource(patient, ResourceType_Patient, hasher.HashPatient()));
+
+    return StoreStatus_Success;
+  }
+
+
+  StoreStatus ServerIndex::StoreSingleInstance(std::map<MetadataType, std::string>& instanceMetadata,
+                                               DicomInstanceToStore& instanceToStore,
+                                               const Attachments& attachments)
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // for writing.
+
+    try
+    {
+      Transaction t(*this);
+
+      uint64_t instanceSize;
+      UnstableResources unstableResources;
+      StoredResources storedResources;
+      StoreStatus status = StoreInternal(instanceSize, instanceMetadata, unstableResources,
+                                         storedResources, instanceToStore, attachments);
+
+      if (status == StoreStatus_Success)
+      {
+        t.Commit(instanceSize);
+        MarkAsUnstable(unstableResources);
+        CacheStoredResources(storedResources);
+      }
+
+      return status;
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+    }
+
+    return StoreStatus_Failure;
+  }
+
+
+  class ServerIndex::PendingStore : public boost::noncopyable
+  {
+  private:
+    std::map<MetadataType, std::string>& instanceMetadata_;
+    DicomInstanceToStore& instanceToStore_;
+    const Attachments& attachments_;
+    StoreStatus status_;
+    bool done_;
+
+  public:
+    PendingStore(std::map<MetadataType, std::string>& instanceMetadata,
+                 DicomInstanceToStore& instanceToStore,
+                 const Attachments& attachments) :
+      instanceMetadata_(instanceMetadata),
+      instanceToStore_(instanceToStore),
+      attachments_(attachments),
+      status_(StoreStatus_Failure),
+      done_(false)
+    {
+    }
+
+    std::map<MetadataType, std::string>& GetInstanceMetadata()
+    {
+      return instanceMetadata_;
+    }
+
+    DicomInstanceToStore& GetInstanceToStore()
+    {
+      return instanceToStore_;
+    }
+
+    const Attachments& GetAttachments() const
+    {
+      return attachments_;
+    }
+
+    StoreStatus GetStatus() const
+    {
+      return status_;
+    }
+
+    void SetStatus(StoreStatus status)
+    {
+      status_ = status;
+    }
+
+    bool IsDone() const
+    {
+      return done_;
+    }
+
+    void SetDone()
+    {
+      done_ = true;
+    }
+  };
+
+
+  void ServerIndex::StoreBatch(const std::vector<PendingStore*>& batch)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (batch.size() > 1)
+    {
+      // Keep track of the size of the instances that have already
+      // been stored by this batch, so that the recycling of the
+      // subsequent instances takes them into account
+      uint64_t sizeOfAddedFiles = 0;
+
+      try
+      {
+        Transaction t(*this);
+
+        UnstableResources unstableResources;
+        StoredResources storedResources;
+        std::vector<StoreStatus> status(batch.size());
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+          uint64_t instanceSize;
+          status[i] = StoreInternal(instanceSize,
+                                    batch[i]->GetInstanceMetadata(),
+                                    unstableResources,
+                                    storedResources,
+                                    batch[i]->GetInstanceToStore(),
+                                    batch[i]->GetAttachments());
+          currentStorageSize_ += instanceSize;
+          sizeOfAddedFiles += instanceSize;
+        }
+
+        t.Commit(0);
+
+        // The resources are only tracked once they exist in the
+        // database, as the transaction might have been rolled back
+        MarkAsUnstable(unstableResources);
+        CacheStoredResources(storedResources);
+
+        for (size_t i = 0; i < batch.size(); i++)
         {
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_TransferSyntax, s);
+          batch[i]->SetStatus(status[i]);
         }
+
+        return;
       }
+      catch (OrthancException& e)
+      {
+        currentStorageSize_ -= sizeOfAddedFiles;
 
-      const DicomValue* value;
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&
-          !value->IsNull() &&
-          !value->IsBinary())
+        LOG(WARNING) << "Cannot store a batch of " << batch.size() << " instances in the index ("
+                     << e.What() << "), storing them one by one";
+      }
+    }
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      batch[i]->SetStatus(StoreSingleInstance(batch[i]->GetInstanceMetadata(),
+                                              batch[i]->GetInstanceToStore(),
+                                              batch[i]->GetAttachments()));
+    }
+  }
+
+
+  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
+                                 DicomInstanceToStore& instanceToStore,
+                                 const Attachments& attachments)
+  {
+    PendingStore request(instanceMetadata, instanceToStore, attachments);
+
+    boost::mutex::scoped_lock lock(storeQueueMutex_);
+
+    if (storeBatchMaxSize_ <= 1)
+    {
+      // Group commit is disabled
+      lock.unlock();
+
+      boost::mutex::scoped_lock lock2(mutex_);
+      return StoreSingleInstance(instanceMetadata, instanceToStore, attachments);
+    }
+
+    storeQueue_.push_back(&request);
+    storeQueueChanged_.notify_all();
+
+    while (!request.IsDone())
+    {
+      if (storeLeaderActive_)
       {
-        SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_SopClassUid, value->GetContent());
+        // Another thread is collecting or storing a batch, wait for it
+        storeQueueChanged_.wait(lock);
+        continue;
       }
 
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
-          (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+      // This thread becomes the leader of the next batch. If other
+      // instances were queued while the previous batch was stored,
+      // wait for more instances to be received, until either the
+      // batch is full, or the time window has elapsed. A lone
+      // instance is stored immediately, so that a single sender
+      // does not pay for the time window.
+      storeLeaderActive_ = true;
+
+      if (storeQueue_.size() > 1)
       {
-        if (!value->IsNull() && 
-            !value->IsBinary())
+        const boost::system_time timeout = (boost::get_system_time() + 
+                                            boost::posix_time::milliseconds(storeBatchWindow_));
+        while (storeQueue_.size() < storeBatchMaxSize_ &&
+               storeQueueChanged_.timed_wait(lock, timeout))
         {
-          SetInstanceMetadata(instanceMetadata, instance, MetadataType_Instance_IndexInSeries, value->GetContent());
         }
       }
 
-      // Check whether the series of this new instance is now completed
-      if (isNewSeries)
+      std::vector<PendingStore*> batch;
+      batch.reserve(storeBatchMaxSize_);
+      while (!storeQueue_.empty() &&
+             batch.size() < storeBatchMaxSize_)
       {
-        ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+        batch.push_back(storeQueue_.front());
+        storeQueue_.pop_front();
       }
 
-      SeriesStatus seriesStatus = GetSeriesStatus(series);
-      if (seriesStatus == SeriesStatus_Complete)
+      lock.unlock();
+
+      try
       {
-        LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+        StoreBatch(batch);
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Unexpected error while storing a batch of instances in the index";
       }
 
-      // Mark the parent resources of this instance as unstable
-      MarkAsUnstable(series, ResourceType_Series, hasher.HashSeries());
-      MarkAsUnstable(study, ResourceType_Study, hasher.HashStudy());
-      MarkAsUnstable(patient, ResourceType_Patient, hasher.HashPatient());
+      lock.lock();
 
-      t.Commit(instanceSize);
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        batch[i]->SetDone();
+      }
+
+      storeBatchCount_ += 1;
+      storeBatchInstances_ += batch.size();
+      storeBatchLargest_ = std::max(storeBatchLargest_, static_cast<unsigned int>(batch.size()));
 
-      return StoreStatus_Success;
+      storeLeaderActive_ = false;
+      storeQueueChanged_.notify_all();
     }
-    catch (OrthancException& e)
+
+    return request.GetStatus();
+  }
+
+
+  void ServerIndex::SetStoreBatching(unsigned int maxSize,
+                                     unsigned int window)
+  {
+    boost::mutex::scoped_lock lock(storeQueueMutex_);
+
+    storeBatchMaxSize_ = maxSize;
+    storeBatchWindow_ = window;
+
+    if (maxSize > 1)
     {
-      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+      LOG(WARNING) << "Group commit of the received instances: at most " << maxSize
+                   << " instances within " << window << "ms";
     }
+  }
 
-    return StoreStatus_Failure;
+
+  void ServerIndex::GetStoreBatchStatistics(uint64_t& countBatches,
+                                            uint64_t& countInstances,
+                                            unsigned int& largestBatch)
+  {
+    boost::mutex::scoped_lock lock(storeQueueMutex_);
+
+    countBatches = storeBatchCount_;
+    countInstances = storeBatchInstances_;
+    largestBatch = storeBatchLargest_;
+  }
+
+
+  void ServerIndex::SetPublicIdCacheSize(size_t size)
+  {
+    publicIdCache_.SetMaximumSize(size);
+
+    if (size > 0)
+    {
+      LOG(WARNING) << "Cache of the public IDs of the resources: at most " << size << " entries";
+    }
+  }
+
+
+  void ServerIndex::GetPublicIdCacheStatistics(size_t& size,
+                                               size_t& maximumSize,
+                                               uint64_t& hits,
+                                               uint64_t& misses)
+  {
+    publicIdCache_.GetStatistics(size, maximumSize, hits, misses);
+  }
+
+
+  bool ServerIndex::LookupResourceWithCache(int64_t& id,
+                                            ResourceType& type,
+                                            const std::string& publicId)
+  {
+    return (publicIdCache_.Lookup(id, type, publicId) ||
+            db_.LookupResource(id, type, publicId));
   }
 
 
   void ServerIndex::ComputeStatistics(Json::Value& target)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+
     target = Json::objectValue;
 
-    uint64_t cs = currentStorageSize_;
-    assert(cs == db_.GetTotalCompressedSize());
-    uint64_t us = db_.GetTotalUncompressedSize();
+    uint64_t cs, us;
+    if (t.IsConcurrent())
+    {
+      // The in-memory counter of the index might be ahead of the
+      // snapshot of the read-only connection
+      cs = db.GetTotalCompressedSize();
+    }
+    else
+    {
+      cs = currentStorageSize_;
+      assert(cs == db.GetTotalCompressedSize());
+    }
+
+    us = db.GetTotalUncompressedSize();
     target["TotalDiskSize"] = boost::lexical_cast<std::string>(cs);
     target["TotalUncompressedSize"] = boost::lexical_cast<std::string>(us);
     target["TotalDiskSizeMB"] = static_cast<unsigned int>(cs / MEGA_BYTES);
     target["TotalUncompressedSizeMB"] = static_cast<unsigned int>(us / MEGA_BYTES);
 
-    target["CountPatients"] = static_cast<unsigned int>(db_.GetResourceCount(ResourceType_Patient));
-    target["CountStudies"] = static_cast<unsigned int>(db_.GetResourceCount(ResourceType_Study));
-    target["CountSeries"] = static_cast<unsigned int>(db_.GetResourceCount(ResourceType_Series));
-    target["CountInstances"] = static_cast<unsigned int>(db_.GetResourceCount(ResourceType_Instance));
+    target["CountPatients"] = static_cast<unsigned int>(db.GetResourceCount(ResourceType_Patient));
+    target["CountStudies"] = static_cast<unsigned int>(db.GetResourceCount(ResourceType_Study));
+    target["CountSeries"] = static_cast<unsigned int>(db.GetResourceCount(ResourceType_Series));
+    target["CountInstances"] = static_cast<unsigned int>(db.GetResourceCount(ResourceType_Instance));
+
+    uint64_t countBatches, countInstances;
+    unsigned int largestBatch;
+    GetStoreBatchStatistics(countBatches, countInstances, largestBatch);
+
+    Json::Value batches = Json::objectValue;
+    batches["Count"] = boost::lexical_cast<std::string>(countBatches);
+    batches["CountInstances"] = boost::lexical_cast<std::string>(countInstances);
+    batches["Largest"] = largestBatch;
+    target["StoreBatches"] = batches;
+
+    size_t cacheSize, cacheMaximumSize;
+    uint64_t cacheHits, cacheMisses;
+    publicIdCache_.GetStatistics(cacheSize, cacheMaximumSize, cacheHits, cacheMisses);
+
+    Json::Value cache = Json::objectValue;
+    cache["Size"] = static_cast<unsigned int>(cacheSize);
+    cache["MaximumSize"] = static_cast<unsigned int>(cacheMaximumSize);
+    cache["Hits"] = boost::lexical_cast<std::string>(cacheHits);
+    cache["Misses"] = boost::lexical_cast<std::string>(cacheMisses);
+    target["PublicIdCache"] = cache;
   }          
 
 
 
-  SeriesStatus ServerIndex::GetSeriesStatus(int64_t id)
+  static bool ParseInteger(int64_t& result,
+                           const std::string& value)
   {
-    // Get the expected number of instances in this series (from the metadata)
-    int64_t expected;
-    if (!GetMetadataAsInteger(expected, id, MetadataType_Series_ExpectedNumberOfInstances))
+    try
     {
-      return SeriesStatus_Unknown;
+      result = boost::lexical_cast<int64_t>(value);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
     }
+  }
 
-    // Loop over the instances of this series
-    std::list<int64_t> children;
-    db_.GetChildrenInternalId(children, id);
 
+  SeriesStatus ServerIndex::ComputeSeriesStatus(int64_t expected,
+                                                const std::list<int64_t>& indexes)
+  {
     std::set<int64_t> instances;
     for (std::list<int64_t>::const_iterator 
-           it = children.begin(); it != children.end(); ++it)
+           it = indexes.begin(); it != indexes.end(); ++it)
     {
-      // Get the index of this instance in the series
-      int64_t index;
-      if (!GetMetadataAsInteger(index, *it, MetadataType_Instance_IndexInSeries))
-      {
-        return SeriesStatus_Unknown;
-      }
+      int64_t index = *it;
 
       if (!(index > 0 && index <= expected))
       {
@@ -909,14 +1877,82 @@ namespace Orthanc
   }
 
 
+  SeriesStatus ServerIndex::GetSeriesStatus(IDatabaseWrapper& db,
+                                            int64_t id)
+  {
+    // Get the expected number of instances in this series (from the metadata)
+    int64_t expected;
+    if (!GetMetadataAsInteger(expected, db, id, MetadataType_Series_ExpectedNumberOfInstances))
+    {
+      return SeriesStatus_Unknown;
+    }
+
+    // Loop over the instances of this series
+    std::list<int64_t> children;
+    db.GetChildrenInternalId(children, id);
+
+    std::list<int64_t> indexes;
+    for (std::list<int64_t>::const_iterator 
+           it = children.begin(); it != children.end(); ++it)
+    {
+      // Get the index of this instance in the series
+      int64_t index;
+      if (!GetMetadataAsInteger(index, db, *it, MetadataType_Instance_IndexInSeries))
+      {
+        return SeriesStatus_Unknown;
+      }
+
+      indexes.push_back(index);
+    }
+
+    return ComputeSeriesStatus(expected, indexes);
+  }
+
+
+  SeriesStatus ServerIndex::GetSeriesStatus(const ExpandedResource& series)
+  {
+    std::string s;
+    int64_t expected;
+    if (!series.LookupMetadata(s, MetadataType_Series_ExpectedNumberOfInstances) ||
+        !ParseInteger(expected, s))
+    {
+      return SeriesStatus_Unknown;
+    }
+
+    if (series.GetChildrenIndexInSeries().size() != series.GetChildren().size())
+    {
+      // Some instance has no index in the series
+      return SeriesStatus_Unknown;
+    }
+
+    std::list<int64_t> indexes;
+    for (std::list<std::string>::const_iterator it = series.GetChildrenIndexInSeries().begin();
+         it != series.GetChildrenIndexInSeries().end(); ++it)
+    {
+      int64_t index;
+      if (!ParseInteger(index, *it))
+      {
+        return SeriesStatus_Unknown;
+      }
+
+      indexes.push_back(index);
+    }
+
+    return ComputeSeriesStatus(expected, indexes);
+  }
+
+
   void ServerIndex::MainDicomTagsToJson(Json::Value& target,
-                                        int64_t resourceId,
-                                        ResourceType resourceType)
+                                        const ExpandedResource& resource)
   {
     DicomMap tags;
-    db_.GetMainDicomTags(tags, resourceId);
+    for (std::map<DicomTag, std::string>::const_iterator 
+           it = resource.GetMainDicomTags().begin(); it != resource.GetMainDicomTags().end(); ++it)
+    {
+      tags.SetValue(it->first, it->second, false);
+    }
 
-    if (resourceType == ResourceType_Study)
+    if (resource.GetResourceType() == ResourceType_Study)
     {
       DicomMap t1, t2;
       tags.ExtractStudyInformation(t1);
@@ -935,63 +1971,114 @@ namespace Orthanc
     }
   }
 
-  bool ServerIndex::LookupResource(Json::Value& result,
-                                   const std::string& publicId,
-                                   ResourceType expectedType)
-  {
-    result = Json::objectValue;
 
-    boost::mutex::scoped_lock lock(mutex_);
+  void ServerIndex::ExpandResource(ExpandedResource& resource,
+                                   ReadOnlyTransaction& transaction)
+  {
+    IDatabaseWrapper& db = transaction.GetDatabase();
 
-    // Lookup for the requested resource
-    int64_t id;
-    ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
-        type != expectedType)
-    {
-      return false;
-    }
+    const int64_t id = resource.GetInternalId();
+    const ResourceType type = resource.GetResourceType();
 
     // Find the parent resource (if it exists)
     if (type != ResourceType_Patient)
     {
       int64_t parentId;
-      if (!db_.LookupParent(parentId, id))
+      std::string parentPublicId;
+      if (!transaction.LookupParent(parentId, parentPublicId, id, type, resource.GetPublicId()))
       {
         throw OrthancException(ErrorCode_InternalError);
       }
 
-      std::string parent = db_.GetPublicId(parentId);
+      resource.SetParentId(parentPublicId);
+    }
+
+    // List the children resources
+    if (type != ResourceType_Instance)
+    {
+      db.GetChildrenPublicId(resource.GetChildren(), id);
+    }
+
+    DicomMap tags;
+    db.GetMainDicomTags(tags, id);
+
+    DicomArray array(tags);
+    for (size_t i = 0; i < array.GetSize(); i++)
+    {
+      const DicomValue& value = array.GetElement(i).GetValue();
+      if (!value.IsNull() &&
+          !value.IsBinary())
+      {
+        resource.GetMainDicomTags()[array.GetElement(i).GetTag()] = value.GetContent();
+      }
+    }
+
+    db.GetAllMetadata(resource.GetMetadata(), id);
+
+    if (type == ResourceType_Series)
+    {
+      std::list<int64_t> children;
+      db.GetChildrenInternalId(children, id);
+
+      for (std::list<int64_t>::const_iterator 
+             it = children.begin(); it != children.end(); ++it)
+      {
+        std::string index;
+        if (db.LookupMetadata(index, *it, MetadataType_Instance_IndexInSeries))
+        {
+          resource.GetChildrenIndexInSeries().push_back(index);
+        }
+      }
+    }
+
+    if (type == ResourceType_Instance)
+    {
+      FileInfo attachment;
+      if (db.LookupAttachment(attachment, id, FileContentType_Dicom))
+      {
+        resource.SetDicomFile(attachment.GetUuid(), attachment.GetUncompressedSize());
+      }
+    }
+  }
+
+
+  void ServerIndex::FormatExpandedResource(Json::Value& result,
+                                           const ExpandedResource& resource,
+                                           bool isStable)
+  {
+    const ResourceType type = resource.GetResourceType();
+
+    result = Json::objectValue;
+
+    // Record the parent resource (if it exists)
+    switch (type)
+    {
+      case ResourceType_Patient:
+        break;
 
-      switch (type)
-      {
-        case ResourceType_Study:
-          result["ParentPatient"] = parent;
-          break;
+      case ResourceType_Study:
+        result["ParentPatient"] = resource.GetParentId();
+        break;
 
-        case ResourceType_Series:
-          result["ParentStudy"] = parent;
-          break;
+      case ResourceType_Series:
+        result["ParentStudy"] = resource.GetParentId();
+        break;
 
-        case ResourceType_Instance:
-          result["ParentSeries"] = parent;
-          break;
+      case ResourceType_Instance:
+        result["ParentSeries"] = resource.GetParentId();
+        break;
 
-        default:
-          throw OrthancException(ErrorCode_InternalError);
-      }
+      default:
+        throw OrthancException(ErrorCode_InternalError);
     }
 
-    // List the children resources
-    std::list<std::string> children;
-    db_.GetChildrenPublicId(children, id);
-
+    // Record the children resources
     if (type != ResourceType_Instance)
     {
       Json::Value c = Json::arrayValue;
 
       for (std::list<std::string>::const_iterator
-             it = children.begin(); it != children.end(); ++it)
+             it = resource.GetChildren().begin(); it != resource.GetChildren().end(); ++it)
       {
         c.append(*it);
       }
@@ -1015,6 +2102,9 @@ namespace Orthanc
       }
     }
 
+    std::string tmp;
+    int64_t i;
+
     // Set the resource type
     switch (type)
     {
@@ -1029,10 +2119,10 @@ namespace Orthanc
       case ResourceType_Series:
       {
         result["Type"] = "Series";
-        result["Status"] = EnumerationToString(GetSeriesStatus(id));
+        result["Status"] = EnumerationToString(GetSeriesStatus(resource));
 
-        int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Series_ExpectedNumberOfInstances))
+        if (resource.LookupMetadata(tmp, MetadataType_Series_ExpectedNumberOfInstances) &&
+            ParseInteger(i, tmp))
           result["ExpectedNumberOfInstances"] = static_cast<int>(i);
         else
           result["ExpectedNumberOfInstances"] = Json::nullValue;
@@ -1044,17 +2134,16 @@ namespace Orthanc
       {
         result["Type"] = "Instance";
 
-        FileInfo attachment;
-        if (!db_.LookupAttachment(attachment, id, FileContentType_Dicom))
+        if (!resource.HasDicomFile())
         {
           throw OrthancException(ErrorCode_InternalError);
         }
 
-        result["FileSize"] = static_cast<unsigned int>(attachment.GetUncompressedSize());
-        result["FileUuid"] = attachment.GetUuid();
+        result["FileSize"] = static_cast<unsigned int>(resource.GetDicomFileSize());
+        result["FileUuid"] = resource.GetDicomFileUuid();
 
-        int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Instance_IndexInSeries))
+        if (resource.LookupMetadata(tmp, MetadataType_Instance_IndexInSeries) &&
+            ParseInteger(i, tmp))
           result["IndexInSeries"] = static_cast<int>(i);
         else
           result["IndexInSeries"] = Json::nullValue;
@@ -1067,17 +2156,15 @@ namespace Orthanc
     }
 
     // Record the remaining information
-    result["ID"] = publicId;
-    MainDicomTagsToJson(result, id, type);
-
-    std::string tmp;
+    result["ID"] = resource.GetPublicId();
+    MainDicomTagsToJson(result, resource);
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_AnonymizedFrom))
+    if (resource.LookupMetadata(tmp, MetadataType_AnonymizedFrom))
     {
       result["AnonymizedFrom"] = tmp;
     }
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_ModifiedFrom))
+    if (resource.LookupMetadata(tmp, MetadataType_ModifiedFrom))
     {
       result["ModifiedFrom"] = tmp;
     }
@@ -1086,32 +2173,109 @@ namespace Orthanc
         type == ResourceType_Study ||
         type == ResourceType_Series)
     {
-      result["IsStable"] = !unstableResources_.Contains(id);
+      result["IsStable"] = isStable;
 
-      if (db_.LookupMetadata(tmp, id, MetadataType_LastUpdate))
+      if (resource.LookupMetadata(tmp, MetadataType_LastUpdate))
       {
         result["LastUpdate"] = tmp;
       }
     }
+  }
+
+
+  bool ServerIndex::LookupResource(Json::Value& result,
+                                   const std::string& publicId,
+                                   ResourceType expectedType)
+  {
+    result = Json::objectValue;
+
+    ReadOnlyTransaction t(*this);
+
+    // Lookup for the requested resource
+    int64_t id;
+    ResourceType type;
+    if (!t.LookupResource(id, type, publicId) ||
+        type != expectedType)
+    {
+      return false;
+    }
+
+    ExpandedResource resource(id, type, publicId);
+    ExpandResource(resource, t);
+    FormatExpandedResource(result, resource, !IsUnstableResource(id));
 
     return true;
   }
 
 
+  void ServerIndex::LookupResources(Json::Value& result,
+                                    const std::list<std::string>& publicIds,
+                                    ResourceType expectedType)
+  {
+    result = Json::arrayValue;
+
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+
+    std::list<ExpandedResource> resources;
+
+    if (!db.ExpandResources(resources, publicIds, expectedType))
+    {
+      // No batched lookups in this database engine, fallback to one
+      // lookup per resource (but still within one transaction)
+      for (std::list<std::string>::const_iterator
+             it = publicIds.begin(); it != publicIds.end(); ++it)
+      {
+        int64_t id;
+        ResourceType type;
+        if (t.LookupResource(id, type, *it) &&
+            type == expectedType)
+        {
+          resources.push_back(ExpandedResource(id, type, *it));
+          ExpandResource(resources.back(), t);
+        }
+      }
+    }
+
+    // Answer in the order of the request, skipping the unknown resources
+    std::map<std::string, const ExpandedResource*> index;
+    for (std::list<ExpandedResource>::const_iterator 
+           it = resources.begin(); it != resources.end(); ++it)
+    {
+      index[it->GetPublicId()] = &(*it);
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = publicIds.begin(); it != publicIds.end(); ++it)
+    {
+      std::map<std::string, const ExpandedResource*>::const_iterator found = index.find(*it);
+
+      if (found != index.end())
+      {
+        Json::Value item;
+        FormatExpandedResource(item, *found->second,
+                               !IsUnstableResource(found->second->GetInternalId()));
+        result.append(item);
+      }
+    }
+  }
+
+
   bool ServerIndex::LookupAttachment(FileInfo& attachment,
                                      const std::string& instanceUuid,
                                      FileContentType contentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, instanceUuid))
+    if (!t.LookupResource(id, type, instanceUuid))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    if (db_.LookupAttachment(attachment, id, contentType))
+    if (db.LookupAttachment(attachment, id, contentType))
     {
       assert(attachment.GetContentType() == contentType);
       return true;
@@ -1127,8 +2291,9 @@ namespace Orthanc
   void ServerIndex::GetAllUuids(std::list<std::string>& target,
                                 ResourceType resourceType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+    db.GetAllPublicIds(target, resourceType);
   }
 
 
@@ -1143,8 +2308,9 @@ namespace Orthanc
       return;
     }
 
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType, since, limit);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+    db.GetAllPublicIds(target, resourceType, since, limit);
   }
 
 
@@ -1169,7 +2335,7 @@ namespace Orthanc
     target["Done"] = done;
 
     int64_t last = (log.empty() ? since : log.back().GetSeq());
-    target["Last"] = static_cast<int>(last);
+    target["Last"] = static_cast<Json::Int64>(last);
   }
 
 
@@ -1181,21 +2347,78 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetChanges(changes, done, since, maxResults);
+      ReadOnlyTransaction t(*this);
+      IDatabaseWrapper& db = t.GetDatabase();
+      db.GetChanges(changes, done, since, maxResults);
     }
 
     FormatLog(target, changes, "Changes", done, since);
   }
 
 
+  void ServerIndex::GetChanges(Json::Value& target,
+                               int64_t since,
+                               unsigned int maxResults,
+                               const std::set<ChangeType>& changeTypes,
+                               const std::set<ResourceType>& levels)
+  {
+    // Bound the number of changes that are read from the database
+    // by one call, if the filters reject most of them
+    static const unsigned int MAX_SCANNED = 10000;
+
+    std::list<ServerIndexChange> filtered;
+    bool done = false;
+    int64_t last = since;
+
+    {
+      ReadOnlyTransaction t(*this);
+      IDatabaseWrapper& db = t.GetDatabase();
+
+      unsigned int scanned = 0;
+      while (!done &&
+             filtered.size() < maxResults &&
+             scanned < MAX_SCANNED)
+      {
+        std::list<ServerIndexChange> changes;
+        db.GetChanges(changes, done, last, maxResults);
+
+        for (std::list<ServerIndexChange>::const_iterator
+               it = changes.begin(); it != changes.end(); ++it)
+        {
+          if (filtered.size() == maxResults)
+          {
+            // Some changes of this page remain to be scanned
+            done = false;
+            break;
+          }
+
+          last = it->GetSeq();
+          scanned++;
+
+          if ((changeTypes.empty() || 
+               changeTypes.find(it->GetChangeType()) != changeTypes.end()) &&
+              (levels.empty() ||
+               levels.find(it->GetResourceType()) != levels.end()))
+          {
+            filtered.push_back(*it);
+          }
+        }
+      }
+    }
+
+    FormatLog(target, filtered, "Changes", done, since);
+    target["Last"] = static_cast<Json::Int64>(last);
+  }
+
+
   void ServerIndex::GetLastChange(Json::Value& target)
   {
     std::list<ServerIndexChange> changes;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetLastChange(changes);
+      ReadOnlyTransaction t(*this);
+      IDatabaseWrapper& db = t.GetDatabase();
+      db.GetLastChange(changes);
     }
 
     FormatLog(target, changes, "Changes", true, 0);
@@ -1210,7 +2433,7 @@ namespace Orthanc
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!LookupResourceWithCache(id, type, publicId))
     {
       throw OrthancException(ErrorCode_InternalError);
     }
@@ -1300,8 +2523,9 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetExportedResources(exported, done, since, maxResults);
+      ReadOnlyTransaction t(*this);
+      IDatabaseWrapper& db = t.GetDatabase();
+      db.GetExportedResources(exported, done, since, maxResults);
     }
 
     FormatLog(target, exported, "Exports", done, since);
@@ -1313,8 +2537,9 @@ namespace Orthanc
     std::list<ExportedResource> exported;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetLastExportedResource(exported);
+      ReadOnlyTransaction t(*this);
+      IDatabaseWrapper& db = t.GetDatabase();
+      db.GetLastExportedResource(exported);
     }
 
     FormatLog(target, exported, "Exports", true, 0);
@@ -1359,7 +2584,7 @@ namespace Orthanc
     // already stored
     int64_t patientToAvoid;
     ResourceType type;
-    bool hasPatientToAvoid = db_.LookupResource(patientToAvoid, type, newPatientId);
+    bool hasPatientToAvoid = LookupResourceWithCache(patientToAvoid, type, newPatientId);
 
     if (hasPatientToAvoid && type != ResourceType_Patient)
     {
@@ -1438,18 +2663,19 @@ namespace Orthanc
 
   bool ServerIndex::IsProtectedPatient(const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!t.LookupResource(id, type, publicId) ||
         type != ResourceType_Patient)
     {
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    return db_.IsProtectedPatient(id);
+    return db.IsProtectedPatient(id);
   }
      
 
@@ -1462,7 +2688,7 @@ namespace Orthanc
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!LookupResourceWithCache(id, type, publicId) ||
         type != ResourceType_Patient)
     {
       throw OrthancException(ErrorCode_ParameterOutOfRange);
@@ -1483,11 +2709,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType type;
     int64_t resource;
-    if (!db_.LookupResource(resource, type, publicId))
+    if (!t.LookupResource(resource, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1499,12 +2726,12 @@ namespace Orthanc
     }
 
     std::list<int64_t> tmp;
-    db_.GetChildrenInternalId(tmp, resource);
+    db.GetChildrenInternalId(tmp, resource);
 
     for (std::list<int64_t>::const_iterator 
            it = tmp.begin(); it != tmp.end(); ++it)
     {
-      result.push_back(db_.GetPublicId(*it));
+      result.push_back(db.GetPublicId(*it));
     }
   }
 
@@ -1514,11 +2741,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!t.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1541,14 +2769,14 @@ namespace Orthanc
       int64_t resource = toExplore.top();
       toExplore.pop();
 
-      if (db_.GetResourceType(resource) == ResourceType_Instance)
+      if (db.GetResourceType(resource) == ResourceType_Instance)
       {
-        result.push_back(db_.GetPublicId(resource));
+        result.push_back(db.GetPublicId(resource));
       }
       else
       {
         // Tag all the children of this resource as to be explored
-        db_.GetChildrenInternalId(tmp, resource);
+        db.GetChildrenInternalId(tmp, resource);
         for (std::list<int64_t>::const_iterator 
                it = tmp.begin(); it != tmp.end(); ++it)
         {
@@ -1568,7 +2796,7 @@ namespace Orthanc
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!LookupResourceWithCache(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1592,7 +2820,7 @@ namespace Orthanc
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!LookupResourceWithCache(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1612,32 +2840,34 @@ namespace Orthanc
                                    const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!t.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    return db_.LookupMetadata(target, id, type);
+    return db.LookupMetadata(target, id, type);
   }
 
 
   void ServerIndex::ListAvailableMetadata(std::list<MetadataType>& target,
                                           const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!t.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableMetadata(target, id);
+    db.ListAvailableMetadata(target, id);
   }
 
 
@@ -1645,42 +2875,35 @@ namespace Orthanc
                                              const std::string& publicId,
                                              ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!t.LookupResource(id, type, publicId) ||
         expectedType != type)
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableAttachments(target, id);
+    db.ListAvailableAttachments(target, id);
   }
 
 
   bool ServerIndex::LookupParent(std::string& target,
                                  const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!t.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
     int64_t parentId;
-    if (db_.LookupParent(parentId, id))
-    {
-      target = db_.GetPublicId(parentId);
-      return true;
-    }
-    else
-    {
-      return false;
-    }
+    return t.LookupParent(parentId, target, id, type, publicId);
   }
 
 
@@ -1705,7 +2928,7 @@ namespace Orthanc
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!LookupResourceWithCache(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1733,8 +2956,41 @@ namespace Orthanc
                                           /* out */ unsigned int& countStudies, 
                                           /* out */ unsigned int& countSeries, 
                                           /* out */ unsigned int& countInstances, 
+                                          /* in  */ IDatabaseWrapper& db,
                                           /* in  */ int64_t id,
                                           /* in  */ ResourceType type)
+  {
+    if (db.GetResourceStatistics(compressedSize, uncompressedSize, countStudies,
+                                 countSeries, countInstances, id))
+    {
+      // The database maintains aggregated statistics, no need to
+      // walk through the subtree of the resource
+    }
+    else
+    {
+      WalkStatistics(compressedSize, uncompressedSize, countStudies,
+                     countSeries, countInstances, db, id);
+    }
+
+    if (countStudies == 0)
+    {
+      countStudies = 1;
+    }
+
+    if (countSeries == 0)
+    {
+      countSeries = 1;
+    }
+  }
+
+
+  void ServerIndex::WalkStatistics(/* out */ uint64_t& compressedSize, 
+                                   /* out */ uint64_t& uncompressedSize, 
+                                   /* out */ unsigned int& countStudies, 
+                                   /* out */ unsigned int& countSeries, 
+                                   /* out */ unsigned int& countInstances, 
+                                   /* in  */ IDatabaseWrapper& db,
+                                   /* in  */ int64_t id)
   {
     std::stack<int64_t> toExplore;
     toExplore.push(id);
@@ -1751,16 +3007,16 @@ namespace Orthanc
       int64_t resource = toExplore.top();
       toExplore.pop();
 
-      ResourceType thisType = db_.GetResourceType(resource);
+      ResourceType thisType = db.GetResourceType(resource);
 
       std::list<FileContentType> f;
-      db_.ListAvailableAttachments(f, resource);
+      db.ListAvailableAttachments(f, resource);
 
       for (std::list<FileContentType>::const_iterator
              it = f.begin(); it != f.end(); ++it)
       {
         FileInfo attachment;
-        if (db_.LookupAttachment(attachment, resource, *it))
+        if (db.LookupAttachment(attachment, resource, *it))
         {
           compressedSize += attachment.GetCompressedSize();
           uncompressedSize += attachment.GetUncompressedSize();
@@ -1789,7 +3045,7 @@ namespace Orthanc
 
         // Tag all the children of this resource as to be explored
         std::list<int64_t> tmp;
-        db_.GetChildrenInternalId(tmp, resource);
+        db.GetChildrenInternalId(tmp, resource);
         for (std::list<int64_t>::const_iterator 
                it = tmp.begin(); it != tmp.end(); ++it)
         {
@@ -1797,16 +3053,6 @@ namespace Orthanc
         }
       }
     }
-
-    if (countStudies == 0)
-    {
-      countStudies = 1;
-    }
-
-    if (countSeries == 0)
-    {
-      countSeries = 1;
-    }
   }
 
 
@@ -1814,11 +3060,12 @@ namespace Orthanc
   void ServerIndex::GetStatistics(Json::Value& target,
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!t.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1829,7 +3076,7 @@ namespace Orthanc
     unsigned int countSeries;
     unsigned int countInstances;
     GetStatisticsInternal(compressedSize, uncompressedSize, countStudies, 
-                          countSeries, countInstances, top, type);
+                          countSeries, countInstances, db, top, type);
 
     target = Json::objectValue;
     target["DiskSize"] = boost::lexical_cast<std::string>(compressedSize);
@@ -1863,91 +3110,197 @@ namespace Orthanc
                                   /* out */ unsigned int& countInstances, 
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!t.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
     GetStatisticsInternal(compressedSize, uncompressedSize, countStudies, 
-                          countSeries, countInstances, top, type);    
+                          countSeries, countInstances, db, top, type);    
   }
 
 
   void ServerIndex::UnstableResourcesMonitorThread(ServerIndex* that)
   {
-    int stableAge = Configuration::GetGlobalUnsignedIntegerParameter("StableAge", 60);
-    if (stableAge <= 0)
-    {
-      stableAge = 60;
-    }
+    // Maximum number of stable resources whose changes are logged
+    // within a single transaction
+    static const size_t MAX_BATCH_SIZE = 1000;
 
-    LOG(INFO) << "Starting the monitor for stable resources (stable age = " << stableAge << ")";
+    LOG(INFO) << "Starting the monitor for stable resources (stable age = " << that->stableAge_ << ")";
 
     while (!that->done_)
     {
-      // Check for stable resources each second
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
+      std::vector< std::pair<int64_t, UnstableResourcePayload> >  stable;
+
+      {
+        boost::mutex::scoped_lock lock(that->unstableResourcesMutex_);
+
+        if (that->done_)
+        {
+          break;
+        }
+
+        const uint64_t now = SystemToolbox::GetMonotonicMicroseconds();
+
+        if (that->unstableResources_.IsEmpty())
+        {
+          // Wait for some resource to become unstable
+          that->unstableResourcesChanged_.wait(lock);
+        }
+        else if (that->unstableResources_.GetOldestPayload().GetDeadline() > now)
+        {
+          // Sleep until the oldest unstable resource becomes stable.
+          // The condition variable waits on the system clock: The
+          // sleep is bounded to 1 second, which bounds the effect of a
+          // change of the system time on the detection of the stable
+          // resources.
+          const uint64_t delay = std::min(that->unstableResources_.GetOldestPayload().GetDeadline() - now,
+                                          static_cast<uint64_t>(1000000));
+          that->unstableResourcesChanged_.timed_wait
+            (lock, boost::posix_time::microseconds(delay));
+        }
+        else
+        {
+          // These DICOM resources have not received any new instance
+          // for some time. They can be considered as stable.
+          while (stable.size() < MAX_BATCH_SIZE &&
+                 !that->unstableResources_.IsEmpty() &&
+                 that->unstableResources_.GetOldestPayload().GetDeadline() <= now)
+          {
+            UnstableResourcePayload payload;
+            int64_t id = that->unstableResources_.RemoveOldest(payload);
+            stable.push_back(std::make_pair(id, payload));
+          }
+        }
+      }
+
+      if (stable.empty())
+      {
+        continue;
+      }
 
       boost::mutex::scoped_lock lock(that->mutex_);
+      Transaction transaction(*that);
 
-      while (!that->unstableResources_.IsEmpty() &&
-             that->unstableResources_.GetOldestPayload().GetAge() > static_cast<unsigned int>(stableAge))
+      for (size_t i = 0; i < stable.size(); i++)
       {
-        // This DICOM resource has not received any new instance for
-        // some time. It can be considered as stable.
-          
-        UnstableResourcePayload payload;
-        int64_t id = that->unstableResources_.RemoveOldest(payload);
+        const int64_t id = stable[i].first;
+        const UnstableResourcePayload& payload = stable[i].second;
 
-        // Ensure that the resource is still existing before logging the change
-        if (that->db_.IsExistingResource(id))
+        // Ensure that the resource is still existing, and that it has
+        // not received a new instance since it was found stable,
+        // before logging the change
+        if (that->IsUnstableResource(id) ||
+            !that->db_.IsExistingResource(id))
         {
-          switch (payload.GetResourceType())
-          {
-            case ResourceType_Patient:
-              that->LogChange(id, ChangeType_StablePatient, ResourceType_Patient, payload.GetPublicId());
-              break;
+          continue;
+        }
 
-            case ResourceType_Study:
-              that->LogChange(id, ChangeType_StableStudy, ResourceType_Study, payload.GetPublicId());
-              break;
+        switch (payload.GetResourceType())
+        {
+          case ResourceType_Patient:
+            that->LogChange(id, ChangeType_StablePatient, ResourceType_Patient, payload.GetPublicId());
+            break;
 
-            case ResourceType_Series:
-              that->LogChange(id, ChangeType_StableSeries, ResourceType_Series, payload.GetPublicId());
-              break;
+          case ResourceType_Study:
+            that->LogChange(id, ChangeType_StableStudy, ResourceType_Study, payload.GetPublicId());
+            break;
 
-            default:
-              throw OrthancException(ErrorCode_InternalError);
-          }
+          case ResourceType_Series:
+            that->LogChange(id, ChangeType_StableSeries, ResourceType_Series, payload.GetPublicId());
+            break;
 
-          //LOG(INFO) << "Stable resource: " << EnumerationToString(payload.type_) << " " << id;
+          default:
+            throw OrthancException(ErrorCode_InternalError);
         }
+
+        //LOG(INFO) << "Stable resource: " << EnumerationToString(payload.type_) << " " << id;
       }
+
+      transaction.Commit(0);
     }
 
     LOG(INFO) << "Closing the monitor thread for stable resources";
   }
+
+
+  void ServerIndex::SetStableAge(unsigned int seconds)
+  {
+    if (seconds == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+    stableAge_ = seconds;
+  }
+
+
+  bool ServerIndex::IsUnstableResource(int64_t id)
+  {
+    boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+    return unstableResources_.Contains(id);
+  }
   
 
-  void ServerIndex::MarkAsUnstable(int64_t id,
-                                   Orthanc::ResourceType type,
-                                   const std::string& publicId)
+  void ServerIndex::CacheStoredResources(const StoredResources& resources)
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // for writing, and the transaction that created the resources
+    // must be committed. As no resource can be deleted meanwhile,
+    // the current generation of the cache can be used.
+
+    const uint64_t generation = publicIdCache_.GetGeneration();
+
+    for (StoredResources::const_iterator it = resources.begin(); it != resources.end(); ++it)
+    {
+      if (it->parentId_ == -1)
+      {
+        publicIdCache_.Add(it->publicId_, it->id_, it->type_, generation);
+      }
+      else
+      {
+        publicIdCache_.Add(it->publicId_, it->id_, it->type_,
+                           it->parentId_, it->parentPublicId_, generation);
+      }
+    }
+  }
+
+
+  void ServerIndex::MarkAsUnstable(const UnstableResources& resources)
   {
-    // WARNING: Before calling this method, "mutex_" must be locked.
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // for writing, and the transaction that created the resources
+    // must be committed.
+
+    if (resources.empty())
+    {
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(unstableResourcesMutex_);
 
-    assert(type == Orthanc::ResourceType_Patient ||
-           type == Orthanc::ResourceType_Study ||
-           type == Orthanc::ResourceType_Series);
+    if (unstableResources_.IsEmpty())
+    {
+      // Otherwise, the deadline of the new resource comes after
+      // the one the monitor thread is waiting for
+      unstableResourcesChanged_.notify_one();
+    }
 
-    UnstableResourcePayload payload(type, publicId);
-    unstableResources_.AddOrMakeMostRecent(id, payload);
-    //LOG(INFO) << "Unstable resource: " << EnumerationToString(type) << " " << id;
+    for (UnstableResources::const_iterator it = resources.begin(); it != resources.end(); ++it)
+    {
+      assert(it->type_ == Orthanc::ResourceType_Patient ||
+             it->type_ == Orthanc::ResourceType_Study ||
+             it->type_ == Orthanc::ResourceType_Series);
 
-    LogChange(id, ChangeType_NewChildInstance, type, publicId);
+      UnstableResourcePayload payload(it->type_, it->publicId_, stableAge_);
+      unstableResources_.AddOrMakeMostRecent(it->id_, payload);
+    }
   }
 
 
@@ -1965,11 +3318,12 @@ namespace Orthanc
     
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     LookupIdentifierQuery query(level);
     query.AddConstraint(tag, IdentifierConstraintType_Equal, value);
-    query.Apply(result, db_);
+    query.Apply(result, db);
   }
 
 
@@ -1982,7 +3336,7 @@ namespace Orthanc
 
     ResourceType resourceType;
     int64_t resourceId;
-    if (!db_.LookupResource(resourceId, resourceType, publicId))
+    if (!LookupResourceWithCache(resourceId, resourceType, publicId))
     {
       return StoreStatus_Failure;  // Inexistent resource
     }
@@ -2032,7 +3386,7 @@ namespace Orthanc
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!LookupResourceWithCache(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -2051,19 +3405,20 @@ namespace Orthanc
   bool ServerIndex::GetMetadata(Json::Value& target,
                                 const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     target = Json::objectValue;
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!t.LookupResource(id, type, publicId))
     {
       return false;
     }
 
     std::list<MetadataType> metadata;
-    db_.ListAvailableMetadata(metadata, id);
+    db.ListAvailableMetadata(metadata, id);
 
     for (std::list<MetadataType>::const_iterator
            it = metadata.begin(); it != metadata.end(); ++it)
@@ -2071,7 +3426,7 @@ namespace Orthanc
       std::string key = EnumerationToString(*it);
 
       std::string value;
-      if (!db_.LookupMetadata(value, id, *it))
+      if (!db.LookupMetadata(value, id, *it))
       {
         value.clear();
       }
@@ -2094,10 +3449,11 @@ namespace Orthanc
   std::string ServerIndex::GetGlobalProperty(GlobalProperty property,
                                              const std::string& defaultValue)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     std::string value;
-    if (db_.LookupGlobalProperty(value, property))
+    if (db.LookupGlobalProperty(value, property))
     {
       return value;
     }
@@ -2125,12 +3481,13 @@ namespace Orthanc
 
     result.Clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!t.LookupResource(id, type, publicId) ||
         type != expectedType)
     {
       return false;
@@ -2139,7 +3496,7 @@ namespace Orthanc
     if (type == ResourceType_Study)
     {
       DicomMap tmp;
-      db_.GetMainDicomTags(tmp, id);
+      db.GetMainDicomTags(tmp, id);
 
       switch (levelOfInterest)
       {
@@ -2157,7 +3514,7 @@ namespace Orthanc
     }
     else
     {
-      db_.GetMainDicomTags(result, id);
+      db.GetMainDicomTags(result, id);
       return true;
     }    
   }
@@ -2166,17 +3523,18 @@ namespace Orthanc
   bool ServerIndex::LookupResourceType(ResourceType& type,
                                        const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
 
     int64_t id;
-    return db_.LookupResource(id, type, publicId);
+    return t.LookupResource(id, type, publicId);
   }
 
 
   unsigned int ServerIndex::GetDatabaseVersion()
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    return db_.GetDatabaseVersion();
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+    return db.GetDatabaseVersion();
   }
 
 
@@ -2184,10 +3542,11 @@ namespace Orthanc
                                    std::vector<std::string>& instances,
                                    const ::Orthanc::LookupResource& lookup)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
    
     std::list<int64_t> tmp;
-    lookup.FindCandidates(tmp, db_);
+    lookup.FindCandidates(tmp, db);
 
     resources.resize(tmp.size());
     instances.resize(tmp.size());
@@ -2196,16 +3555,63 @@ namespace Orthanc
     for (std::list<int64_t>::const_iterator
            it = tmp.begin(); it != tmp.end(); ++it, pos++)
     {
-      assert(db_.GetResourceType(*it) == lookup.GetLevel());
+      assert(db.GetResourceType(*it) == lookup.GetLevel());
       
       int64_t instance;
-      if (!ServerToolbox::FindOneChildInstance(instance, db_, *it, lookup.GetLevel()))
+      if (!ServerToolbox::FindOneChildInstance(instance, db, *it, lookup.GetLevel()))
       {
         throw OrthancException(ErrorCode_InternalError);
       }
 
-      resources[pos] = db_.GetPublicId(*it);
-      instances[pos] = db_.GetPublicId(instance);
+      resources[pos] = db.GetPublicId(*it);
+      instances[pos] = db.GetPublicId(instance);
+    }
+  }
+
+
+  void ServerIndex::FindResources(std::list<std::string>& result,
+                                  const ::Orthanc::LookupResource& lookup,
+                                  size_t since,
+                                  size_t limit)
+  {
+    if (lookup.HasUnoptimizedConstraints())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    result.clear();
+
+    ReadOnlyTransaction t(*this);
+    IDatabaseWrapper& db = t.GetDatabase();
+
+    if (!lookup.HasConstraints() &&
+        limit != 0)
+    {
+      // Paging through all the resources of one level: The database
+      // applies "since" and "limit" by itself
+      db.GetAllPublicIds(result, lookup.GetLevel(), since, limit);
+      return;
+    }
+
+    // The candidates are intersected in memory from one level to the
+    // other, so all the matching internal IDs are loaded before the
+    // paging. Only the resources in the requested page are converted
+    // to their public identifier.
+    std::list<int64_t> tmp;
+    lookup.FindCandidates(tmp, db);
+    size_t pos = 0;
+    for (std::list<int64_t>::const_iterator
+           it = tmp.begin(); it != tmp.end(); ++it, pos++)
+    {
+      if (limit != 0 &&
+          result.size() >= limit)
+      {
+        break;
+      }
+      else if (pos >= since)
+      {
+        result.push_back(db.GetPublicId(*it));
+      }
     }
   }
 
@@ -2214,30 +3620,35 @@ namespace Orthanc
                                  const std::string& publicId,
                                  ResourceType parentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadOnlyTransaction t(*this);
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!t.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
+    // Walk up the hierarchy through the cache of the public IDs,
+    // which avoids any SQL lookup if the parents are cached
+    std::string current = publicId;
+
     while (type != parentType)
     {
       int64_t parentId;
+      std::string parentPublicId;
 
-      if (type == ResourceType_Patient ||    // Cannot further go up in hierarchy
-          !db_.LookupParent(parentId, id))
+      if (!t.LookupParent(parentId, parentPublicId, id, type, current))   // Cannot further go up in hierarchy
       {
         return false;
       }
 
       id = parentId;
       type = GetParentResourceType(type);
+      current = parentPublicId;
     }
 
-    target = db_.GetPublicId(id);
+    target = current;
     return true;
   }
 
@@ -2258,10 +3669,10 @@ namespace Orthanc
       int64_t patient = -1, study = -1, series = -1, instance = -1;
 
       ResourceType dummy;      
-      if (!db_.LookupResource(patient, dummy, hasher.HashPatient()) ||
-          !db_.LookupResource(study, dummy, hasher.HashStudy()) ||
-          !db_.LookupResource(series, dummy, hasher.HashSeries()) ||
-          !db_.LookupResource(instance, dummy, hasher.HashInstance()) ||
+      if (!LookupResourceWithCache(patient, dummy, hasher.HashPatient()) ||
+          !LookupResourceWithCache(study, dummy, hasher.HashStudy()) ||
+          !LookupResourceWithCache(series, dummy, hasher.HashSeries()) ||
+          !LookupResourceWithCache(instance, dummy, hasher.HashInstance()) ||
           patient == -1 ||
           study == -1 ||
           series == -1 ||
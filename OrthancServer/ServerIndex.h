@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <stack>
 #include <boost/thread.hpp>
 #include <boost/noncopyable.hpp>
 #include "../Core/Cache/LeastRecentlyUsedIndex.h"
@@ -40,6 +41,7 @@
 #include "../Core/DicomFormat/DicomMap.h"
 #include "../Core/DicomFormat/DicomInstanceHasher.h"
 #include "ServerEnumerations.h"
+#include "PublicIdCache.h"
 
 #include "IDatabaseWrapper.h"
 
@@ -59,30 +61,115 @@ namespace Orthanc
   private:
     class Listener;
     class Transaction;
+    class ReadOnlyTransaction;
     class UnstableResourcePayload;
+    class PendingStore;
 
     bool done_;
+
+    // Protects "db_" (the only connection that is allowed to modify
+    // the database) and the in-process state of the index. The
+    // lookups that go through a read-only connection do not take it.
     boost::mutex mutex_;
+
+    // Pool of read-only connections to the database, that allow the
+    // lookup methods to run concurrently with each other and with
+    // the writer connection
+    std::vector<IDatabaseWrapper*> readers_;
+    std::stack<IDatabaseWrapper*> availableReaders_;
+    boost::mutex readersMutex_;
+    boost::condition_variable readerReleased_;
+
     boost::thread flushThread_;
     boost::thread unstableResourcesMonitorThread_;
 
+    // Background removal of the deleted files from the storage area,
+    // if the database keeps a persistent list of such files
+    ServerContext& context_;
+    bool hasFileReaper_;
+    boost::thread fileReaperThread_;
+    boost::mutex fileReaperMutex_;
+    boost::condition_variable fileReaperWakeup_;
+    unsigned int fileDeletionRate_;
+
+    // Retention of the "Changes" and "ExportedResources" logs
+    // (protected by "mutex_")
+    boost::thread logRetentionThread_;
+    uint64_t maximumChangesCount_;
+    unsigned int maximumChangesAge_;
+
     std::auto_ptr<Listener> listener_;
     IDatabaseWrapper& db_;
+
+    // The unstable resources, ordered by their deadline: As the
+    // stable age is constant, the least recently updated resource is
+    // the first one to become stable. This structure has its own
+    // mutex, so that the monitor thread only takes the lock on the
+    // index to log the changes of a batch of stable resources.
     LeastRecentlyUsedIndex<int64_t, UnstableResourcePayload>  unstableResources_;
+    boost::mutex unstableResourcesMutex_;
+    boost::condition_variable unstableResourcesChanged_;
+    unsigned int stableAge_;
+
+    // Cache of the lookups of the resources by their public ID (it
+    // has its own mutex)
+    PublicIdCache publicIdCache_;
 
     uint64_t currentStorageSize_;
     uint64_t maximumStorageSize_;
     unsigned int maximumPatients_;
 
+    // Group commit of the incoming instances: The concurrent calls
+    // to "Store()" are queued, and stored by batches within a single
+    // SQLite transaction (protected by "storeQueueMutex_")
+    boost::mutex storeQueueMutex_;
+    boost::condition_variable storeQueueChanged_;
+    std::list<PendingStore*> storeQueue_;
+    bool storeLeaderActive_;
+    unsigned int storeBatchMaxSize_;
+    unsigned int storeBatchWindow_;
+    uint64_t storeBatchCount_;
+    uint64_t storeBatchInstances_;
+    unsigned int storeBatchLargest_;
+
     static void FlushThread(ServerIndex* that);
 
+    static void FileReaperThread(ServerIndex* that);
+
+    static void LogRetentionThread(ServerIndex* that);
+
+    // The caller must lock "mutex_". Returns "true" if some
+    // entries remain to be pruned.
+    bool PruneLogs(uint32_t maxResults);
+
+    void WakeUpFileReaper();
+
     static void UnstableResourcesMonitorThread(ServerIndex* that);
 
-    void MainDicomTagsToJson(Json::Value& result,
-                             int64_t resourceId,
-                             ResourceType resourceType);
+    static void MainDicomTagsToJson(Json::Value& result,
+                                    const ExpandedResource& resource);
+
+    // The caller must lock "mutex_". The resources that are
+    // read from the database are not added to the cache, as the
+    // current transaction might be rolled back.
+    bool LookupResourceWithCache(int64_t& id,
+                                 ResourceType& type,
+                                 const std::string& publicId);
+
+    static SeriesStatus ComputeSeriesStatus(int64_t expected,
+                                            const std::list<int64_t>& indexes);
+
+    static SeriesStatus GetSeriesStatus(IDatabaseWrapper& db,
+                                        int64_t id);
+
+    static SeriesStatus GetSeriesStatus(const ExpandedResource& series);
 
-    SeriesStatus GetSeriesStatus(int64_t id);
+    static void ExpandResource(ExpandedResource& resource,
+                               ReadOnlyTransaction& transaction);
+
+    static void FormatExpandedResource(Json::Value& result,
+                                       const ExpandedResource& resource,
+                                       bool isStable);
 
     bool IsRecyclingNeeded(uint64_t instanceSize);
 
@@ -91,21 +178,82 @@ namespace Orthanc
 
     void StandaloneRecycling();
 
-    void MarkAsUnstable(int64_t id,
-                        Orthanc::ResourceType type,
-                        const std::string& publicId);
-
-    void GetStatisticsInternal(/* out */ uint64_t& compressedSize, 
+    // Parent resource of a stored instance, that is marked as
+    // unstable once the transaction of the store is committed
+    struct UnstableResource
+    {
+      int64_t       id_;
+      ResourceType  type_;
+      std::string   publicId_;
+
+      UnstableResource(int64_t id,
+                       ResourceType type,
+                       const std::string& publicId) :
+        id_(id),
+        type_(type),
+        publicId_(publicId)
+      {
+      }
+    };
+
+    typedef std::vector<UnstableResource>  UnstableResources;
+
+    bool IsUnstableResource(int64_t id);
+
+    void MarkAsUnstable(const UnstableResources& resources);
+
+    // Resource of the hierarchy of a stored instance, that is added
+    // to the cache of the public IDs (together with its parent) once
+    // the transaction of the store is committed
+    struct StoredResource
+    {
+      std::string   publicId_;
+      int64_t       id_;
+      ResourceType  type_;
+      int64_t       parentId_;
+      std::string   parentPublicId_;
+
+      StoredResource(const std::string& publicId,
+                     int64_t id,
+                     ResourceType type,
+                     int64_t parentId,
+                     const std::string& parentPublicId) :
+        publicId_(publicId),
+        id_(id),
+        type_(type),
+        parentId_(parentId),
+        parentPublicId_(parentPublicId)
+      {
+      }
+    };
+
+    typedef std::vector<StoredResource>  StoredResources;
+
+    void CacheStoredResources(const StoredResources& resources);
+
+    static void GetStatisticsInternal(/* out */ uint64_t& compressedSize, 
+                                      /* out */ uint64_t& uncompressedSize, 
+                                      /* out */ unsigned int& countStudies, 
+                                      /* out */ unsigned int& countSeries, 
+                                      /* out */ unsigned int& countInstances, 
+                                      /* in  */ IDatabaseWrapper& db,
+                                      /* in  */ int64_t id,
+                                      /* in  */ ResourceType type);
+
+    static void WalkStatistics(/* out */ uint64_t& compressedSize, 
                                /* out */ uint64_t& uncompressedSize, 
                                /* out */ unsigned int& countStudies, 
                                /* out */ unsigned int& countSeries, 
                                /* out */ unsigned int& countInstances, 
-                               /* in  */ int64_t id,
-                               /* in  */ ResourceType type);
+                               /* in  */ IDatabaseWrapper& db,
+                               /* in  */ int64_t id);
 
-    bool GetMetadataAsInteger(int64_t& result,
-                              int64_t id,
-                              MetadataType type);
+    static bool GetMetadataAsInteger(int64_t& result,
+                                     IDatabaseWrapper& db,
+                                     int64_t id,
+                                     MetadataType type);
+
+    void CloseReadOnlyConnections();
 
     void LogChange(int64_t internalId,
                    ChangeType changeType,
@@ -122,6 +270,19 @@ namespace Orthanc
                              MetadataType metadata,
                              const std::string& value);
 
+    StoreStatus StoreInternal(uint64_t& instanceSize,
+                              std::map<MetadataType, std::string>& instanceMetadata,
+                              UnstableResources& unstableResources,
+                              StoredResources& storedResources,
+                              DicomInstanceToStore& instance,
+                              const Attachments& attachments);
+
+    StoreStatus StoreSingleInstance(std::map<MetadataType, std::string>& instanceMetadata,
+                                    DicomInstanceToStore& instance,
+                                    const Attachments& attachments);
+
+    void StoreBatch(const std::vector<PendingStore*>& batch);
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database);
@@ -146,16 +307,60 @@ namespace Orthanc
     // "count == 0" means no limit on the number of patients
     void SetMaximumPatientCount(unsigned int count);
 
+    // "count == 0" means that all the accesses to the database are
+    // serialized through a single connection
+    void SetConcurrentReaders(unsigned int count);
+
+    unsigned int GetConcurrentReadersCount();
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       DicomInstanceToStore& instance,
                       const Attachments& attachments);
 
+    // "maxSize <= 1" disables the group commit of the incoming
+    // instances. "window" is expressed in milliseconds.
+    void SetStoreBatching(unsigned int maxSize,
+                          unsigned int window);
+
+    void GetStoreBatchStatistics(uint64_t& countBatches,
+                                 uint64_t& countInstances,
+                                 unsigned int& largestBatch);
+
+    // Maximum number of entries in the "Changes" and
+    // "ExportedResources" logs, and maximum age (in days) of these
+    // entries. The value 0 disables the corresponding limit.
+    void SetChangesRetention(uint64_t maximumCount,
+                             unsigned int maximumAge);
+
+    // Maximum number of files that are removed per second by the
+    // background reaper (0 means no limit)
+    void SetFileDeletionRate(unsigned int rate);
+
+    // Number of seconds without receiving a new instance after which
+    // a patient, a study or a series is considered as stable (only
+    // applies to the resources that are updated afterwards)
+    void SetStableAge(unsigned int seconds);
+
+    // A size of 0 disables the cache of the public IDs
+    void SetPublicIdCacheSize(size_t size);
+
+    void GetPublicIdCacheStatistics(size_t& size,
+                                    size_t& maximumSize,
+                                    uint64_t& hits,
+                                    uint64_t& misses);
+
     void ComputeStatistics(Json::Value& target);                        
 
     bool LookupResource(Json::Value& result,
                         const std::string& publicId,
                         ResourceType expectedType);
 
+    // Expands a page of resources with a fixed number of queries to
+    // the database, and within a single transaction
+    void LookupResources(Json::Value& result,
+                         const std::list<std::string>& publicIds,
+                         ResourceType expectedType);
+
     bool LookupAttachment(FileInfo& attachment,
                           const std::string& instanceUuid,
                           FileContentType contentType);
@@ -176,6 +381,15 @@ namespace Orthanc
                     int64_t since,
                     unsigned int maxResults);
 
+    // Only reports the changes whose type and resource level belong
+    // to the given sets (an empty set disables the filter). The
+    // "Last" field is the last scanned change, even if filtered out.
+    void GetChanges(Json::Value& target,
+                    int64_t since,
+                    unsigned int maxResults,
+                    const std::set<ChangeType>& changeTypes,
+                    const std::set<ResourceType>& levels);
+
     void GetLastChange(Json::Value& target);
 
     void LogExportedResource(const std::string& publicId,
@@ -272,6 +486,17 @@ namespace Orthanc
                         std::vector<std::string>& instances,
                         const ::Orthanc::LookupResource& lookup);
 
+    // Can only be used if the lookup has no unoptimized constraint,
+    // i.e. if it is entirely evaluated by the database. "limit == 0"
+    // means no limit on the number of results. Beware that "since"
+    // and "limit" are only pushed to the database if the lookup has
+    // no constraint at all: Otherwise, the cost of the lookup grows
+    // with the number of matching resources, whatever the page size.
+    void FindResources(std::list<std::string>& result,
+                       const ::Orthanc::LookupResource& lookup,
+                       size_t since,
+                       size_t limit);
+
     bool LookupParent(std::string& target,
                       const std::string& publicId,
                       ResourceType parentType);
@@ -118,7 +118,7 @@ namespace Orthanc
     void Format(Json::Value& item) const
     {
       item = Json::objectValue;
-      item["Seq"] = static_cast<int>(seq_);
+      item["Seq"] = static_cast<Json::Int64>(seq_);
       item["ChangeType"] = EnumerationToString(changeType_);
       item["ResourceType"] = EnumerationToString(resourceType_);
       item["ID"] = publicId_;
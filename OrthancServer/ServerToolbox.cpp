@@ -433,7 +433,8 @@ namespace Orthanc
         Json::Value dicomAsJson;
         locker.GetDicom().DatasetToJson(dicomAsJson);
 
-        std::string s = dicomAsJson.toStyledString();
+        std::string s;
+        context.FormatDicomAsJson(s, dicomAsJson);
         context.AddAttachment(*it, FileContentType_DicomAsJson, s.c_str(), s.size());
 
         context.GetIndex().ReconstructInstance(locker.GetDicom());
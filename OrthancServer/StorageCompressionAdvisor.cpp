@@ -0,0 +1,233 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "StorageCompressionAdvisor.h"
+
+#include "../Core/Compression/IBufferCompressor.h"
+#include "../Core/FileStorage/StorageAccessor.h"
+#include "../Core/OrthancException.h"
+
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <memory>
+#include <string.h>
+
+namespace Orthanc
+{
+  static const size_t DEFAULT_SAMPLE_SIZE = 64 * 1024;
+
+
+  static uint64_t GetElapsedMicroseconds(const boost::posix_time::ptime& start)
+  {
+    boost::posix_time::time_duration elapsed =
+      boost::posix_time::microsec_clock::universal_time() - start;
+    return static_cast<uint64_t>(elapsed.total_microseconds());
+  }
+
+
+  bool StorageCompressionAdvisor::IsSampleCompressible(CompressionType compression,
+                                                       float maximumRatio,
+                                                       const void* data,
+                                                       size_t size,
+                                                       uint64_t& sampleTime) const
+  {
+    if (size == 0)
+    {
+      sampleTime = 0;
+      return false;
+    }
+
+    // The pixel data is generally found at the end of the file
+    size_t sampleSize = std::min(size, sampleSize_);
+    const uint8_t* sample = reinterpret_cast<const uint8_t*>(data) + (size - sampleSize);
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    std::auto_ptr<IBufferCompressor> compressor(StorageAccessor::CreateCompressor(compression));
+
+    std::string compressed;
+    compressor->Compress(compressed, sample, sampleSize);
+
+    sampleTime = GetElapsedMicroseconds(start);
+
+    return (static_cast<float>(compressed.size()) <=
+            maximumRatio * static_cast<float>(sampleSize));
+  }
+
+
+  StorageCompressionAdvisor::StorageCompressionAdvisor() :
+    adaptive_(true),
+    sampleSize_(DEFAULT_SAMPLE_SIZE),
+    maximumSampleRatio_(0.9f)
+  {
+  }
+
+
+  void StorageCompressionAdvisor::SetAdaptive(bool adaptive)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    adaptive_ = adaptive;
+  }
+
+
+  bool StorageCompressionAdvisor::IsAdaptive()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return adaptive_;
+  }
+
+
+  void StorageCompressionAdvisor::SetMaximumSampleRatio(float ratio)
+  {
+    if (ratio <= 0.0f ||
+        ratio > 1.0f)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSampleRatio_ = ratio;
+  }
+
+
+  bool StorageCompressionAdvisor::IsCompressedTransferSyntax(const std::string& transferSyntax)
+  {
+    // All the transfer syntaxes "1.2.840.10008.1.2.4.*" encapsulate
+    // pixel data that is compressed by JPEG, JPEG-LS, JPEG 2000,
+    // MPEG or HEVC. Deflated transfer syntax is "1.2.840.10008.1.2.1.99".
+    static const char* const ENCAPSULATED = "1.2.840.10008.1.2.4.";
+
+    return (transferSyntax.compare(0, strlen(ENCAPSULATED), ENCAPSULATED) == 0 ||
+            transferSyntax == "1.2.840.10008.1.2.1.99");
+  }
+
+
+  CompressionType StorageCompressionAdvisor::Select(const std::string& transferSyntax,
+                                                    CompressionType requested,
+                                                    const void* data,
+                                                    size_t size)
+  {
+    if (requested == CompressionType_None)
+    {
+      return CompressionType_None;
+    }
+
+    bool adaptive;
+    float ratio;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      adaptive = adaptive_;
+      ratio = maximumSampleRatio_;
+    }
+
+    if (!adaptive)
+    {
+      return requested;
+    }
+
+    if (IsCompressedTransferSyntax(transferSyntax))
+    {
+      return CompressionType_None;
+    }
+
+    uint64_t sampleTime;
+    bool compressible = IsSampleCompressible(requested, ratio, data, size, sampleTime);
+
+    {
+      // The time spent on the sample is part of the cost of the policy
+      boost::mutex::scoped_lock lock(mutex_);
+      statistics_[transferSyntax].compressionTime_ += sampleTime;
+    }
+
+    return compressible ? requested : CompressionType_None;
+  }
+
+
+  void StorageCompressionAdvisor::RecordCompressed(const std::string& transferSyntax,
+                                                   uint64_t uncompressedSize,
+                                                   uint64_t compressedSize,
+                                                   uint64_t compressionTime)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Counters& counters = statistics_[transferSyntax];
+    counters.compressedCount_ ++;
+    counters.uncompressedSize_ += uncompressedSize;
+    counters.storedSize_ += compressedSize;
+    counters.compressionTime_ += compressionTime;
+  }
+
+
+  void StorageCompressionAdvisor::RecordRaw(const std::string& transferSyntax,
+                                            uint64_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Counters& counters = statistics_[transferSyntax];
+    counters.rawCount_ ++;
+    counters.uncompressedSize_ += size;
+    counters.storedSize_ += size;
+  }
+
+
+  void StorageCompressionAdvisor::Format(Json::Value& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target = Json::objectValue;
+
+    for (Statistics::const_iterator it = statistics_.begin();
+         it != statistics_.end(); ++it)
+    {
+      const Counters& counters = it->second;
+
+      Json::Value item = Json::objectValue;
+      item["CountCompressed"] = boost::lexical_cast<std::string>(counters.compressedCount_);
+      item["CountRaw"] = boost::lexical_cast<std::string>(counters.rawCount_);
+      item["UncompressedSize"] = boost::lexical_cast<std::string>(counters.uncompressedSize_);
+      item["StoredSize"] = boost::lexical_cast<std::string>(counters.storedSize_);
+
+      // The compression can make some files larger
+      int64_t saved = (static_cast<int64_t>(counters.uncompressedSize_) -
+                       static_cast<int64_t>(counters.storedSize_));
+      item["SavedSize"] = boost::lexical_cast<std::string>(saved);
+      item["CompressionTimeMs"] = boost::lexical_cast<std::string>(counters.compressionTime_ / 1000);
+
+      target[it->first.empty() ? "Unknown" : it->first] = item;
+    }
+  }
+}
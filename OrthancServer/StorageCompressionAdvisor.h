@@ -0,0 +1,124 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Enumerations.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/value.h>
+#include <map>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Decides whether an incoming DICOM file is worth compressing in
+   * the storage area, and accumulates per transfer syntax the bytes
+   * that are saved by the compression against the time spent on it.
+   *
+   * The files whose transfer syntax encapsulates compressed pixel
+   * data (JPEG, JPEG-LS, JPEG 2000, MPEG...) are stored raw. For the
+   * other files, the tail of the buffer (that mostly contains the
+   * pixel data) is compressed as a sample, and the file is stored
+   * raw if the sample does not shrink enough.
+   **/
+  class StorageCompressionAdvisor : public boost::noncopyable
+  {
+  private:
+    struct Counters
+    {
+      uint64_t  compressedCount_;
+      uint64_t  rawCount_;
+      uint64_t  uncompressedSize_;
+      uint64_t  storedSize_;
+      uint64_t  compressionTime_;  // In microseconds
+
+      Counters() :
+        compressedCount_(0),
+        rawCount_(0),
+        uncompressedSize_(0),
+        storedSize_(0),
+        compressionTime_(0)
+      {
+      }
+    };
+
+    typedef std::map<std::string, Counters>  Statistics;
+
+    boost::mutex  mutex_;
+    bool          adaptive_;
+    size_t        sampleSize_;
+    float         maximumSampleRatio_;
+    Statistics    statistics_;
+
+    bool IsSampleCompressible(CompressionType compression,
+                              float maximumRatio,
+                              const void* data,
+                              size_t size,
+                              uint64_t& sampleTime) const;
+
+  public:
+    StorageCompressionAdvisor();
+
+    // If disabled, all the DICOM files are compressed as requested
+    void SetAdaptive(bool adaptive);
+
+    bool IsAdaptive();
+
+    // A sample ratio of "0.9" means that the file is stored raw if
+    // its sample is not at least 10% smaller once compressed
+    void SetMaximumSampleRatio(float ratio);
+
+    static bool IsCompressedTransferSyntax(const std::string& transferSyntax);
+
+    // Returns the compression to be applied to the DICOM file, which
+    // is either "requested" or "CompressionType_None"
+    CompressionType Select(const std::string& transferSyntax,
+                           CompressionType requested,
+                           const void* data,
+                           size_t size);
+
+    void RecordCompressed(const std::string& transferSyntax,
+                          uint64_t uncompressedSize,
+                          uint64_t compressedSize,
+                          uint64_t compressionTime);
+
+    void RecordRaw(const std::string& transferSyntax,
+                   uint64_t size);
+
+    void Format(Json::Value& target);
+  };
+}
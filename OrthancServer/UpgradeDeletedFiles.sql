@@ -0,0 +1,21 @@
+-- This SQLite script installs the persistent list of the files that
+-- were removed from the index, but that are still to be removed from
+-- the storage area by the background reaper of Orthanc. As for
+-- "UpgradeStatistics.sql", it does not change the version of the
+-- database schema.
+
+CREATE TABLE DeletedFiles(
+       uuid TEXT PRIMARY KEY,
+       fileType INTEGER,
+       compressedSize INTEGER
+       );
+
+-- The file is queued within the same transaction as the deletion of
+-- its attachment, so that it is eventually removed even if Orthanc
+-- is stopped before the reaper has processed it
+
+CREATE TRIGGER DeletedFileQueued
+AFTER DELETE ON AttachedFiles
+BEGIN
+  INSERT OR IGNORE INTO DeletedFiles VALUES(old.uuid, old.fileType, old.compressedSize);
+END;
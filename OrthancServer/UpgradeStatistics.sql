@@ -0,0 +1,201 @@
+-- This SQLite script installs the aggregated statistics in a version
+-- 6 Orthanc database. It does not change the version of the database
+-- schema, as these tables are only maintained by the SQLite back-end
+-- of Orthanc, and not by the database plugins.
+
+
+-- Aggregated statistics about the subtree of each resource (the
+-- resource itself is included in the counters)
+
+CREATE TABLE ResourceStatistics(
+       id INTEGER PRIMARY KEY REFERENCES Resources(internalId) ON DELETE CASCADE,
+       countStudies INTEGER,
+       countSeries INTEGER,
+       countInstances INTEGER,
+       compressedSize INTEGER,
+       uncompressedSize INTEGER
+       );
+
+
+-- Global statistics about the database (this table has exactly one row)
+
+CREATE TABLE GlobalStatistics(
+       countPatients INTEGER,
+       countStudies INTEGER,
+       countSeries INTEGER,
+       countInstances INTEGER,
+       compressedSize INTEGER,
+       uncompressedSize INTEGER
+       );
+
+
+-- Initialize the statistics from the content of the database. The
+-- values "1", "2", "3" and "4" correspond to the "ResourceType_Patient",
+-- "ResourceType_Study", "ResourceType_Series" and
+-- "ResourceType_Instance" enumerations in C++.
+
+INSERT INTO ResourceStatistics
+  SELECT internalId, resourceType = 2, resourceType = 3, resourceType = 4,
+         (SELECT IFNULL(SUM(compressedSize), 0) FROM AttachedFiles WHERE id = internalId),
+         (SELECT IFNULL(SUM(uncompressedSize), 0) FROM AttachedFiles WHERE id = internalId)
+  FROM Resources ORDER BY resourceType DESC;
+
+CREATE TEMPORARY TABLE ChildrenStatistics AS
+  SELECT r.parentId AS id, SUM(s.countSeries) AS countSeries,
+         SUM(s.countInstances) AS countInstances,
+         SUM(s.compressedSize) AS compressedSize,
+         SUM(s.uncompressedSize) AS uncompressedSize
+  FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId
+  WHERE r.resourceType = 4 AND r.parentId IS NOT NULL GROUP BY r.parentId;
+
+UPDATE ResourceStatistics SET
+  countInstances = countInstances + (SELECT countInstances FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id),
+  compressedSize = compressedSize + (SELECT compressedSize FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id),
+  uncompressedSize = uncompressedSize + (SELECT uncompressedSize FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id)
+  WHERE id IN (SELECT id FROM ChildrenStatistics);
+
+DELETE FROM ChildrenStatistics;
+INSERT INTO ChildrenStatistics
+  SELECT r.parentId, SUM(s.countSeries), SUM(s.countInstances),
+         SUM(s.compressedSize), SUM(s.uncompressedSize)
+  FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId
+  WHERE r.resourceType = 3 AND r.parentId IS NOT NULL GROUP BY r.parentId;
+
+UPDATE ResourceStatistics SET
+  countSeries = countSeries + (SELECT countSeries FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id),
+  countInstances = countInstances + (SELECT countInstances FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id),
+  compressedSize = compressedSize + (SELECT compressedSize FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id),
+  uncompressedSize = uncompressedSize + (SELECT uncompressedSize FROM ChildrenStatistics AS c WHERE c.id = ResourceStatistics.id)
+  WHERE id IN (SELECT id FROM ChildrenStatistics);
+
+UPDATE ResourceStatistics SET
+  countStudies = countStudies + (SELECT COUNT(*) FROM Resources AS r WHERE r.parentId = ResourceStatistics.id),
+  countSeries = countSeries + (SELECT IFNULL(SUM(s.countSeries), 0) FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId WHERE r.parentId = ResourceStatistics.id),
+  countInstances = countInstances + (SELECT IFNULL(SUM(s.countInstances), 0) FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId WHERE r.parentId = ResourceStatistics.id),
+  compressedSize = compressedSize + (SELECT IFNULL(SUM(s.compressedSize), 0) FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId WHERE r.parentId = ResourceStatistics.id),
+  uncompressedSize = uncompressedSize + (SELECT IFNULL(SUM(s.uncompressedSize), 0) FROM Resources AS r INNER JOIN ResourceStatistics AS s ON s.id = r.internalId WHERE r.parentId = ResourceStatistics.id)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 1);
+
+DROP TABLE ChildrenStatistics;
+
+INSERT INTO GlobalStatistics VALUES(
+       (SELECT COUNT(*) FROM Resources WHERE resourceType = 1),
+       (SELECT COUNT(*) FROM Resources WHERE resourceType = 2),
+       (SELECT COUNT(*) FROM Resources WHERE resourceType = 3),
+       (SELECT COUNT(*) FROM Resources WHERE resourceType = 4),
+       (SELECT IFNULL(SUM(compressedSize), 0) FROM AttachedFiles),
+       (SELECT IFNULL(SUM(uncompressedSize), 0) FROM AttachedFiles));
+
+
+-- The following triggers keep the statistics up-to-date. A resource
+-- has at most 3 ancestors, that are explicitly enumerated. If an
+-- ancestor is being deleted by the same statement, the chain of
+-- ancestors is broken, which prevents the same resource from being
+-- subtracted twice.
+
+CREATE TRIGGER StatisticsResourceAdded
+AFTER INSERT ON Resources
+BEGIN
+  INSERT INTO ResourceStatistics VALUES(new.internalId, new.resourceType = 2,
+                                        new.resourceType = 3, new.resourceType = 4, 0, 0);
+  UPDATE ResourceStatistics SET
+    countStudies = countStudies + (new.resourceType = 2),
+    countSeries = countSeries + (new.resourceType = 3),
+    countInstances = countInstances + (new.resourceType = 4)
+    WHERE id IN (new.parentId,
+                 (SELECT parentId FROM Resources WHERE internalId = new.parentId),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = new.parentId)));
+  UPDATE GlobalStatistics SET
+    countPatients = countPatients + (new.resourceType = 1),
+    countStudies = countStudies + (new.resourceType = 2),
+    countSeries = countSeries + (new.resourceType = 3),
+    countInstances = countInstances + (new.resourceType = 4);
+END;
+
+CREATE TRIGGER StatisticsResourceAttached
+AFTER UPDATE OF parentId ON Resources
+FOR EACH ROW WHEN new.parentId IS NOT old.parentId
+BEGIN
+  UPDATE ResourceStatistics SET
+    countStudies = countStudies - (SELECT countStudies FROM ResourceStatistics WHERE id = new.internalId),
+    countSeries = countSeries - (SELECT countSeries FROM ResourceStatistics WHERE id = new.internalId),
+    countInstances = countInstances - (SELECT countInstances FROM ResourceStatistics WHERE id = new.internalId),
+    compressedSize = compressedSize - (SELECT compressedSize FROM ResourceStatistics WHERE id = new.internalId),
+    uncompressedSize = uncompressedSize - (SELECT uncompressedSize FROM ResourceStatistics WHERE id = new.internalId)
+    WHERE id IN (old.parentId,
+                 (SELECT parentId FROM Resources WHERE internalId = old.parentId),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = old.parentId)));
+  UPDATE ResourceStatistics SET
+    countStudies = countStudies + (SELECT countStudies FROM ResourceStatistics WHERE id = new.internalId),
+    countSeries = countSeries + (SELECT countSeries FROM ResourceStatistics WHERE id = new.internalId),
+    countInstances = countInstances + (SELECT countInstances FROM ResourceStatistics WHERE id = new.internalId),
+    compressedSize = compressedSize + (SELECT compressedSize FROM ResourceStatistics WHERE id = new.internalId),
+    uncompressedSize = uncompressedSize + (SELECT uncompressedSize FROM ResourceStatistics WHERE id = new.internalId)
+    WHERE id IN (new.parentId,
+                 (SELECT parentId FROM Resources WHERE internalId = new.parentId),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = new.parentId)));
+END;
+
+CREATE TRIGGER StatisticsResourceDeleting
+BEFORE DELETE ON Resources
+BEGIN
+  UPDATE ResourceStatistics SET
+    countStudies = countStudies - (SELECT countStudies FROM ResourceStatistics WHERE id = old.internalId),
+    countSeries = countSeries - (SELECT countSeries FROM ResourceStatistics WHERE id = old.internalId),
+    countInstances = countInstances - (SELECT countInstances FROM ResourceStatistics WHERE id = old.internalId),
+    compressedSize = compressedSize - (SELECT compressedSize FROM ResourceStatistics WHERE id = old.internalId),
+    uncompressedSize = uncompressedSize - (SELECT uncompressedSize FROM ResourceStatistics WHERE id = old.internalId)
+    WHERE id IN (old.parentId,
+                 (SELECT parentId FROM Resources WHERE internalId = old.parentId),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = old.parentId)));
+END;
+
+CREATE TRIGGER StatisticsResourceDeleted
+AFTER DELETE ON Resources
+BEGIN
+  UPDATE GlobalStatistics SET
+    countPatients = countPatients - (old.resourceType = 1),
+    countStudies = countStudies - (old.resourceType = 2),
+    countSeries = countSeries - (old.resourceType = 3),
+    countInstances = countInstances - (old.resourceType = 4);
+END;
+
+CREATE TRIGGER StatisticsAttachmentAdded
+AFTER INSERT ON AttachedFiles
+BEGIN
+  UPDATE ResourceStatistics SET
+    compressedSize = compressedSize + new.compressedSize,
+    uncompressedSize = uncompressedSize + new.uncompressedSize
+    WHERE id IN (new.id,
+                 (SELECT parentId FROM Resources WHERE internalId = new.id),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = new.id)),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = 
+                   (SELECT parentId FROM Resources WHERE internalId = new.id))));
+  UPDATE GlobalStatistics SET
+    compressedSize = compressedSize + new.compressedSize,
+    uncompressedSize = uncompressedSize + new.uncompressedSize;
+END;
+
+CREATE TRIGGER StatisticsAttachmentDeleted
+AFTER DELETE ON AttachedFiles
+BEGIN
+  UPDATE ResourceStatistics SET
+    compressedSize = compressedSize - old.compressedSize,
+    uncompressedSize = uncompressedSize - old.uncompressedSize
+    WHERE id IN (old.id,
+                 (SELECT parentId FROM Resources WHERE internalId = old.id),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = old.id)),
+                 (SELECT parentId FROM Resources WHERE internalId = 
+                  (SELECT parentId FROM Resources WHERE internalId = 
+                   (SELECT parentId FROM Resources WHERE internalId = old.id))));
+  UPDATE GlobalStatistics SET
+    compressedSize = compressedSize - old.compressedSize,
+    uncompressedSize = uncompressedSize - old.uncompressedSize;
+END;
@@ -85,6 +85,84 @@ public:
       server_.Store(id, toStore);
     }
   }
+
+
+  virtual bool CreateTemporaryFile(std::string& path)
+  {
+    return (server_.IsBitPreservingStoreScp() &&
+            server_.CreateTemporaryStorageFile(path));
+  }
+
+
+  virtual void HandleFile(const std::string& path,
+                          const DicomMap& dicomSummary,
+                          const Json::Value& dicomJson,
+                          const std::string& remoteIp,
+                          const std::string& remoteAet,
+                          const std::string& calledAet) 
+  {
+    DicomInstanceToStore toStore;
+    toStore.SetDicomProtocolOrigin(remoteIp.c_str(), remoteAet.c_str(), calledAet.c_str());
+    toStore.SetFile(path);
+    toStore.SetSummary(dicomSummary);
+    toStore.SetJson(dicomJson);
+
+    std::string id;
+    server_.Store(id, toStore);
+  }
+};
+
+
+
+class OrthancUploadHandler : public IHttpUploadHandler
+{
+private:
+  ServerContext& context_;
+
+public:
+  OrthancUploadHandler(ServerContext& context) :
+    context_(context)
+  {
+  }
+
+  virtual bool CreateUploadFile(std::string& path,
+                                HttpMethod method,
+                                const UriComponents& uri,
+                                const IHttpHandler::Arguments& headers)
+  {
+    // Only the DICOM files that are uploaded to "/instances" are
+    // written to the storage area by chunks
+    return (method == HttpMethod_Post &&
+            uri.size() == 1 &&
+            uri[0] == "instances" &&
+            context_.CreateTemporaryStorageFile(path));
+  }
+
+  virtual void HandleUpload(HttpOutput& output,
+                            RequestOrigin origin,
+                            const char* remoteIp,
+                            const char* username,
+                            HttpMethod method,
+                            const UriComponents& uri,
+                            const IHttpHandler::Arguments& headers,
+                            const std::string& path)
+  {
+    LOG(INFO) << "Receiving a DICOM file of " << SystemToolbox::GetFileSize(path)
+              << " bytes through HTTP (streaming upload)";
+
+    DicomInstanceToStore toStore;
+    toStore.SetHttpOrigin(remoteIp, username);
+    toStore.SetFile(path);
+
+    std::string publicId;
+    StoreStatus status = context_.Store(publicId, toStore);
+
+    Json::Value result;
+    OrthancRestApi::FormatStoredResource(result, publicId, ResourceType_Instance, status);
+
+    RestApiOutput answer(output, method);
+    answer.AnswerJson(result);
+  }
 };
 
 
@@ -760,6 +838,7 @@ static bool StartHttpServer(ServerContext& context,
 
   // HTTP server
   MyIncomingHttpRequestFilter httpFilter(context, plugins);
+  OrthancUploadHandler uploadHandler(context);
   MongooseServer httpServer;
   httpServer.SetPortNumber(Configuration::GetGlobalUnsignedIntegerParameter("HttpPort", 8042));
   httpServer.SetRemoteAccessAllowed(Configuration::GetGlobalBoolParameter("RemoteAccessAllowed", false));
@@ -767,6 +846,8 @@ static bool StartHttpServer(ServerContext& context,
   httpServer.SetHttpCompressionEnabled(Configuration::GetGlobalBoolParameter("HttpCompressionEnabled", true));
   httpServer.SetIncomingHttpRequestFilter(httpFilter);
   httpServer.SetHttpExceptionFormatter(exceptionFormatter);
+  httpServer.SetUploadHandler(uploadHandler);
+  httpServer.SetUploadBufferSize(static_cast<size_t>(Configuration::GetGlobalUnsignedIntegerParameter("HttpUploadBufferSize", 0)) * 1024 * 1024);  // In MB
 
   httpServer.SetAuthenticationEnabled(Configuration::GetGlobalBoolParameter("AuthenticationEnabled", false));
   Configuration::SetupRegisteredUsers(httpServer);
@@ -797,6 +878,9 @@ static bool StartHttpServer(ServerContext& context,
   
   bool restart = WaitForExit(context, restApi);
 
+  // Release the HTTP clients that wait for changes
+  context.CloseChangesFeed();
+
   httpServer.Stop();
   LOG(WARNING) << "    HTTP server has stopped";
 
@@ -971,6 +1055,54 @@ static void UpgradeDatabase(IDatabaseWrapper& database,
 }
 
 
+
+static void ConfigureStorageCompression(ServerContext& context)
+{
+  context.SetCompressionEnabled(Configuration::GetGlobalBoolParameter("StorageCompression", false));
+  context.GetCompressionAdvisor().SetAdaptive
+    (Configuration::GetGlobalBoolParameter("StorageCompressionAdaptive", true));
+
+  Json::Value configuration;
+  Configuration::GetConfiguration(configuration);
+
+  if (!configuration.isMember("StorageCompressionPolicy"))
+  {
+    return;
+  }
+
+  // Compression of the attachments depending on their type, for
+  // instance: { "dicom" : "None", "dicom-as-json" : "Zstd" }
+  const Json::Value& policy = configuration["StorageCompressionPolicy"];
+  if (policy.type() != Json::objectValue)
+  {
+    LOG(ERROR) << "The configuration option \"StorageCompressionPolicy\" must be an object";
+    throw OrthancException(ErrorCode_BadParameterType);
+  }
+
+  Json::Value::Members members = policy.getMemberNames();
+  for (size_t i = 0; i < members.size(); i++)
+  {
+    const Json::Value& value = policy[members[i]];
+    if (value.type() != Json::stringValue)
+    {
+      LOG(ERROR) << "Bad compression for attachments of type \"" << members[i] << "\"";
+      throw OrthancException(ErrorCode_BadParameterType);
+    }
+
+    CompressionType compression = StringToCompressionType(value.asString());
+
+    if (members[i] == "Default")
+    {
+      context.SetDefaultCompression(compression);
+    }
+    else
+    {
+      context.SetCompression(StringToContentType(members[i]), compression);
+    }
+  }
+}
+
+
 static bool ConfigureServerContext(IDatabaseWrapper& database,
                                    IStorageArea& storageArea,
                                    OrthancPlugins *plugins)
@@ -987,7 +1119,8 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
   DicomUserConnection::SetDefaultTimeout(Configuration::GetGlobalUnsignedIntegerParameter("DicomScuTimeout", 10));
 
   ServerContext context(database, storageArea);
-  context.SetCompressionEnabled(Configuration::GetGlobalBoolParameter("StorageCompression", false));
+  ConfigureStorageCompression(context);
+  context.SetBitPreservingStoreScp(Configuration::GetGlobalBoolParameter("DicomScpBitPreserving", false));
   context.SetStoreMD5ForAttachments(Configuration::GetGlobalBoolParameter("StoreMD5ForAttachments", true));
 
   try
@@ -1009,6 +1142,37 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     context.GetIndex().SetMaximumStorageSize(0);
   }
 
+  context.GetIndex().SetConcurrentReaders(Configuration::GetGlobalUnsignedIntegerParameter("ConcurrentDatabaseReaders", 0));
+  context.GetIndex().SetStoreBatching(Configuration::GetGlobalUnsignedIntegerParameter("StoreBatchSize", 1),
+                                      Configuration::GetGlobalUnsignedIntegerParameter("StoreBatchWindow", 5));
+  context.GetIndex().SetChangesRetention(Configuration::GetGlobalUnsignedIntegerParameter("MaximumChangesCount", 0),
+                                         Configuration::GetGlobalUnsignedIntegerParameter("MaximumChangesAge", 0));
+  context.GetIndex().SetFileDeletionRate(Configuration::GetGlobalUnsignedIntegerParameter("FileDeletionRate", 0));
+  context.GetIndex().SetPublicIdCacheSize(Configuration::GetGlobalUnsignedIntegerParameter("PublicIdCacheSize", 0));
+  context.SetAttachmentCacheSize(static_cast<uint64_t>
+                                 (Configuration::GetGlobalUnsignedIntegerParameter("AttachmentCacheSize", 0)) * 1024 * 1024);
+  context.SetDicomCacheSize(static_cast<size_t>
+                            (Configuration::GetGlobalUnsignedIntegerParameter("DicomCacheSize", 128)) * 1024 * 1024);
+  context.SetDicomAsJsonCacheSize(static_cast<size_t>
+                                  (Configuration::GetGlobalUnsignedIntegerParameter("DicomAsJsonCacheSize", 64)) * 1024 * 1024);
+  context.GetArchiveCache().SetMaximumSize(static_cast<uint64_t>
+                                          (Configuration::GetGlobalUnsignedIntegerParameter("ArchiveCacheSize", 1024)) * 1024 * 1024);
+  context.SetHttpCacheMaxAge(Configuration::GetGlobalUnsignedIntegerParameter("HttpCacheMaxAge", 0));
+  context.SetMaximumChangesStreamClients(Configuration::GetGlobalUnsignedIntegerParameter("ChangesStreamMaxClients", 4));
+
+  {
+    std::string format = Configuration::GetGlobalStringParameter("DicomAsJsonFormat", "Json");
+    if (format == "Binary")
+    {
+      context.SetBinaryDicomAsJson(true);
+    }
+    else if (format != "Json")
+    {
+      LOG(ERROR) << "Unknown format for the DICOM-as-JSON summaries: " << format;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
   LoadLuaScripts(context);
 
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -138,9 +138,36 @@ namespace Orthanc
       return false;
     }
 
+    virtual bool ExpandResources(std::list<ExpandedResource>& target,
+                                 const std::list<std::string>& publicIds,
+                                 ResourceType level)
+    {
+      // Not available in the database SDK, the core of Orthanc will
+      // look up each resource individually
+      return false;
+    }
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id);
 
+    virtual bool GetDeletedFiles(std::list<FileInfo>& target,
+                                 uint32_t maxResults)
+    {
+      // Not available in the database SDK, the files are removed as
+      // soon as the transaction is committed
+      return false;
+    }
+
+    virtual void ClearDeletedFile(const std::string& uuid)
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    virtual void PostponeDeletedFile(const std::string& uuid)
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
     virtual void GetAllInternalIds(std::list<int64_t>& target,
                                    ResourceType resourceType);
 
@@ -172,6 +199,23 @@ namespace Orthanc
 
     virtual void GetLastExportedResource(std::list<ExportedResource>& target /*out*/);
 
+    virtual bool PruneChanges(uint32_t& removed /*out*/,
+                              uint64_t maxCount,
+                              const std::string& minDate,
+                              uint32_t maxResults)
+    {
+      // Not available in the database SDK, the logs are not pruned
+      return false;
+    }
+
+    virtual bool PruneExportedResources(uint32_t& removed /*out*/,
+                                        uint64_t maxCount,
+                                        const std::string& minDate,
+                                        uint32_t maxResults)
+    {
+      return false;
+    }
+
     virtual void GetMainDicomTags(DicomMap& map,
                                   int64_t id);
 
@@ -181,6 +225,18 @@ namespace Orthanc
 
     virtual ResourceType GetResourceType(int64_t resourceId);
 
+    virtual bool GetResourceStatistics(/* out */ uint64_t& compressedSize, 
+                                       /* out */ uint64_t& uncompressedSize, 
+                                       /* out */ unsigned int& countStudies, 
+                                       /* out */ unsigned int& countSeries, 
+                                       /* out */ unsigned int& countInstances, 
+                                       int64_t id)
+    {
+      // Not available in the database SDK, the core of Orthanc will
+      // walk through the subtree of the resource
+      return false;
+    }
+
     virtual uint64_t GetTotalCompressedSize();
     
     virtual uint64_t GetTotalUncompressedSize();
@@ -213,6 +269,18 @@ namespace Orthanc
                                   IdentifierConstraintType type,
                                   const std::string& value);
 
+    virtual bool LookupMainDicomTag(std::list<int64_t>& result,
+                                    ResourceType level,
+                                    const DicomTag& tag,
+                                    IdentifierConstraintType type,
+                                    const std::string& value,
+                                    bool caseSensitive)
+    {
+      // Not available in the database SDK, the main DICOM tags will
+      // be filtered by the core of Orthanc
+      return false;
+    }
+
     virtual bool LookupMetadata(std::string& target,
                                 int64_t id,
                                 MetadataType type);
@@ -261,6 +329,12 @@ namespace Orthanc
     virtual void Upgrade(unsigned int targetVersion,
                          IStorageArea& storageArea);
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection()
+    {
+      // The database plugins are in charge of their own concurrency
+      return NULL;
+    }
+
     void AnswerReceived(const _OrthancPluginDatabaseAnswer& answer);
   };
 }
@@ -136,6 +136,7 @@ namespace Orthanc
     {
     private:
       _OrthancPluginRegisterStorageArea callbacks_;
+      OrthancPluginStorageReadRange     readRange_;
       PluginsErrorDictionary&  errorDictionary_;
 
       void Free(void* buffer) const
@@ -148,8 +149,10 @@ namespace Orthanc
 
     public:
       PluginStorageArea(const _OrthancPluginRegisterStorageArea& callbacks,
+                        OrthancPluginStorageReadRange readRange,
                         PluginsErrorDictionary&  errorDictionary) : 
         callbacks_(callbacks),
+        readRange_(readRange),
         errorDictionary_(errorDictionary)
       {
       }
@@ -206,6 +209,55 @@ namespace Orthanc
       }
 
 
+      virtual bool HasEfficientReadRange()
+      {
+        return readRange_ != NULL;
+      }
+
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        if (start > end)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        if (readRange_ == NULL)
+        {
+          // The plugin cannot read partial files
+          std::string whole;
+          Read(whole, uuid, type);
+
+          if (end > whole.size())
+          {
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+          }
+
+          content.assign(whole, static_cast<size_t>(start), static_cast<size_t>(end - start));
+          return;
+        }
+
+        content.resize(static_cast<size_t>(end - start));
+        if (content.empty())
+        {
+          return;
+        }
+
+        OrthancPluginErrorCode error = readRange_
+          (&content[0], uuid.c_str(), Plugins::Convert(type), start, end - start);
+
+        if (error != OrthancPluginErrorCode_Success)
+        {
+          errorDictionary_.LogError(error, true);
+          throw OrthancException(static_cast<ErrorCode>(error));
+        }
+      }
+
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
@@ -226,6 +278,7 @@ namespace Orthanc
     private:
       SharedLibrary&   sharedLibrary_;
       _OrthancPluginRegisterStorageArea  callbacks_;
+      OrthancPluginStorageReadRange      readRange_;
       PluginsErrorDictionary&  errorDictionary_;
 
     public:
@@ -234,10 +287,16 @@ namespace Orthanc
                          PluginsErrorDictionary&  errorDictionary) :
         sharedLibrary_(sharedLibrary),
         callbacks_(callbacks),
+        readRange_(NULL),
         errorDictionary_(errorDictionary)
       {
       }
 
+      void SetReadRange(OrthancPluginStorageReadRange readRange)
+      {
+        readRange_ = readRange;
+      }
+
       SharedLibrary&  GetSharedLibrary()
       {
         return sharedLibrary_;
@@ -245,7 +304,7 @@ namespace Orthanc
 
       IStorageArea* Create() const
       {
-        return new PluginStorageArea(callbacks_, errorDictionary_);
+        return new PluginStorageArea(callbacks_, readRange_, errorDictionary_);
       }
     };
   }
@@ -1287,14 +1346,14 @@ namespace Orthanc
     const _OrthancPluginGetDicomForInstance& p = 
       *reinterpret_cast<const _OrthancPluginGetDicomForInstance*>(parameters);
 
-    std::string dicom;
+    AttachmentCache::Content dicom;
 
     {
       PImpl::ServerContextLock lock(*pimpl_);
-      lock.GetContext().ReadDicom(dicom, p.instanceId);
+      dicom = lock.GetContext().ReadDicom(p.instanceId);
     }
 
-    CopyToMemoryBuffer(*p.target, dicom);
+    CopyToMemoryBuffer(*p.target, *dicom);
   }
 
 
@@ -1957,14 +2016,14 @@ namespace Orthanc
         throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
 
-      std::string content;
+      AttachmentCache::Content content;
 
       {
         PImpl::ServerContextLock lock(*pimpl_);
-        lock.GetContext().ReadDicom(content, p.instanceId);
+        content = lock.GetContext().ReadDicom(p.instanceId);
       }
 
-      dicom.reset(new ParsedDicomFile(content));
+      dicom.reset(new ParsedDicomFile(*content));
     }
 
     Json::Value json;
@@ -2722,6 +2781,24 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_RegisterStorageAreaReadRange:
+      {
+        LOG(INFO) << "Plugin has registered the partial reads of its custom storage area";
+        const _OrthancPluginRegisterStorageAreaReadRange& p = 
+          *reinterpret_cast<const _OrthancPluginRegisterStorageAreaReadRange*>(parameters);
+
+        // Only the plugin that has registered the storage area can
+        // complement it
+        if (pimpl_->storageArea_.get() == NULL ||
+            &pimpl_->storageArea_->GetSharedLibrary() != &plugin)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        pimpl_->storageArea_->SetReadRange(p.readRange);
+        return true;
+      }
+
       case _OrthancPluginService_SetPluginProperty:
       {
         const _OrthancPluginSetPluginProperty& p = 
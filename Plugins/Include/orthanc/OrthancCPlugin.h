@@ -434,6 +434,7 @@ extern "C"
     _OrthancPluginService_RegisterFindCallback = 1008,
     _OrthancPluginService_RegisterMoveCallback = 1009,
     _OrthancPluginService_RegisterIncomingHttpRequestFilter2 = 1010,
+    _OrthancPluginService_RegisterStorageAreaReadRange = 1011,
 
     /* Sending answers to REST calls */
     _OrthancPluginService_AnswerBuffer = 2000,
@@ -1004,6 +1005,31 @@ extern "C"
 
 
 
+  /**
+   * @brief Callback for reading a range of a file from the storage area.
+   *
+   * Signature of a callback function that is triggered when Orthanc
+   * reads a part of a file from the storage area, for instance to
+   * answer a HTTP request with a "Range" header. The target buffer
+   * is allocated by Orthanc, and its size is the size of the range.
+   *
+   * @param target The buffer where to copy the content of the range (output).
+   * @param uuid The UUID of the file of interest.
+   * @param type The content type corresponding to this file. 
+   * @param rangeStart The offset of the first byte of the range.
+   * @param rangeSize The number of bytes in the range.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageReadRange) (
+    void* target,
+    const char* uuid,
+    OrthancPluginContentType type,
+    uint64_t rangeStart,
+    uint64_t rangeSize);
+
+
+
   /**
    * @brief Callback for removing a file from the storage area.
    *
@@ -2560,6 +2586,39 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    OrthancPluginStorageReadRange  readRange;
+  } _OrthancPluginRegisterStorageAreaReadRange;
+
+  /**
+   * @brief Register the partial reads of a custom storage area.
+   *
+   * This function complements OrthancPluginRegisterStorageArea(), by
+   * registering a callback that reads a range of bytes of a file
+   * without reading the whole file. Orthanc uses it to answer the
+   * HTTP requests with a "Range" header. If no such callback is
+   * registered, Orthanc reads the whole file. This function must be
+   * called after OrthancPluginRegisterStorageArea(), during the
+   * initialization of the plugin.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param readRange The callback function to read a range of a file from the custom storage area.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterStorageAreaReadRange(
+    OrthancPluginContext*          context,
+    OrthancPluginStorageReadRange  readRange)
+  {
+    _OrthancPluginRegisterStorageAreaReadRange params;
+    params.readRange = readRange;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterStorageAreaReadRange, &params);
+  }
+
+
+
   /**
    * @brief Return the path to the Orthanc executable.
    *
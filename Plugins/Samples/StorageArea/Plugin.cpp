@@ -103,6 +103,29 @@ static OrthancPluginErrorCode StorageRead(void** content,
 }
 
 
+static OrthancPluginErrorCode StorageReadRange(void* target,
+                                               const char* uuid,
+                                               OrthancPluginContentType type,
+                                               uint64_t rangeStart,
+                                               uint64_t rangeSize)
+{
+  std::string path = GetPath(uuid);
+
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp)
+  {
+    return OrthancPluginErrorCode_StorageAreaPlugin;
+  }
+
+  bool ok = (fseek(fp, static_cast<long>(rangeStart), SEEK_SET) == 0 &&
+             fread(target, static_cast<size_t>(rangeSize), 1, fp) == 1);
+
+  fclose(fp);
+
+  return ok ? OrthancPluginErrorCode_Success : OrthancPluginErrorCode_StorageAreaPlugin;
+}
+
+
 static OrthancPluginErrorCode StorageRemove(const char* uuid,
                                             OrthancPluginContentType type)
 {
@@ -140,6 +163,7 @@ extern "C"
     }
 
     OrthancPluginRegisterStorageArea(context, StorageCreate, StorageRead, StorageRemove);
+    OrthancPluginRegisterStorageAreaReadRange(context, StorageReadRange);
 
     return 0;
   }
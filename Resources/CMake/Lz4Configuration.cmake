@@ -0,0 +1,25 @@
+if (STATIC_BUILD OR NOT USE_SYSTEM_LZ4)
+  # The archive of LZ4 is not available yet among the third-party
+  # downloads of Orthanc: Its sources must be provided by the user
+  if (NOT EXISTS "${LZ4_SOURCES_DIR}/lib/lz4.c")
+    message(FATAL_ERROR "Set LZ4_SOURCES_DIR to the sources of LZ4 (>= 1.7.3), or set USE_SYSTEM_LZ4 to ON")
+  endif()
+
+  include_directories(
+    ${LZ4_SOURCES_DIR}/lib
+    )
+
+  set(LZ4_SOURCES
+    ${LZ4_SOURCES_DIR}/lib/lz4.c
+    )
+
+  source_group(ThirdParty\\lz4 REGULAR_EXPRESSION ${LZ4_SOURCES_DIR}/.*)
+
+else()
+  CHECK_INCLUDE_FILE_CXX(lz4.h HAVE_LZ4_H)
+  if (NOT HAVE_LZ4_H)
+    message(FATAL_ERROR "Please install the liblz4-dev package")
+  endif()
+
+  link_libraries(lz4)
+endif()
@@ -76,6 +76,18 @@ if (NOT ENABLE_ZLIB)
   add_definitions(-DORTHANC_ENABLE_ZLIB=0)
 endif()
 
+if (NOT ENABLE_LZ4)
+  unset(USE_SYSTEM_LZ4 CACHE)
+  unset(LZ4_SOURCES_DIR CACHE)
+  add_definitions(-DORTHANC_ENABLE_LZ4=0)
+endif()
+
+if (NOT ENABLE_ZSTD)
+  unset(USE_SYSTEM_ZSTD CACHE)
+  unset(ZSTD_SOURCES_DIR CACHE)
+  add_definitions(-DORTHANC_ENABLE_ZSTD=0)
+endif()
+
 if (NOT ENABLE_PNG)
   unset(USE_SYSTEM_LIBPNG CACHE)
   add_definitions(-DORTHANC_ENABLE_PNG=0)
@@ -241,6 +253,7 @@ if (ENABLE_WEB_SERVER)
     ${ORTHANC_ROOT}/Core/HttpServer/HttpStreamTranscoder.cpp
     ${ORTHANC_ROOT}/Core/HttpServer/HttpToolbox.cpp
     ${ORTHANC_ROOT}/Core/HttpServer/MongooseServer.cpp
+    ${ORTHANC_ROOT}/Core/HttpServer/StorageAreaHttpSender.cpp
     ${ORTHANC_ROOT}/Core/HttpServer/StringHttpOutput.cpp
     ${ORTHANC_ROOT}/Core/RestApi/RestApi.cpp
     ${ORTHANC_ROOT}/Core/RestApi/RestApiCall.cpp
@@ -280,18 +293,43 @@ if (ENABLE_ZLIB)
     ${ORTHANC_ROOT}/Core/Compression/DeflateBaseCompressor.cpp
     ${ORTHANC_ROOT}/Core/Compression/HierarchicalZipWriter.cpp
     ${ORTHANC_ROOT}/Core/Compression/GzipCompressor.cpp
+    ${ORTHANC_ROOT}/Core/Compression/ZipStreamWriter.cpp
     ${ORTHANC_ROOT}/Core/Compression/ZipWriter.cpp
     ${ORTHANC_ROOT}/Core/Compression/ZlibCompressor.cpp
     )
 
   if (NOT ORTHANC_SANDBOXED)
     list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+      ${ORTHANC_ROOT}/Core/Compression/ZipStreamPipeline.cpp
       ${ORTHANC_ROOT}/Core/FileStorage/StorageAccessor.cpp
       )
   endif()
 endif()
 
 
+##
+## Fast compression codecs for the storage area: LZ4 and Zstandard
+##
+
+if (ENABLE_LZ4)
+  include(${CMAKE_CURRENT_LIST_DIR}/Lz4Configuration.cmake)
+  add_definitions(-DORTHANC_ENABLE_LZ4=1)
+
+  list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${ORTHANC_ROOT}/Core/Compression/Lz4Compressor.cpp
+    )
+endif()
+
+if (ENABLE_ZSTD)
+  include(${CMAKE_CURRENT_LIST_DIR}/ZstdConfiguration.cmake)
+  add_definitions(-DORTHANC_ENABLE_ZSTD=1)
+
+  list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${ORTHANC_ROOT}/Core/Compression/ZstdCompressor.cpp
+    )
+endif()
+
+
 ##
 ## PNG support: libpng (in conjunction with zlib)
 ##
@@ -498,6 +536,7 @@ else()
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
     ${ORTHANC_ROOT}/Core/Cache/SharedArchive.cpp
     ${ORTHANC_ROOT}/Core/FileStorage/FilesystemStorage.cpp
+    ${ORTHANC_ROOT}/Core/FileStorage/PackedStorage.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/BagOfTasksProcessor.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/Mutex.cpp
     ${ORTHANC_ROOT}/Core/MultiThreading/ReaderWriterLock.cpp
@@ -544,12 +583,14 @@ set(ORTHANC_CORE_SOURCES_DEPENDENCIES
   ${LIBP11_SOURCES}
   ${LIBPNG_SOURCES}
   ${LUA_SOURCES}
+  ${LZ4_SOURCES}
   ${MONGOOSE_SOURCES}
   ${OPENSSL_SOURCES}
   ${PUGIXML_SOURCES}
   ${SQLITE_SOURCES}
   ${UUID_SOURCES}
   ${ZLIB_SOURCES}
+  ${ZSTD_SOURCES}
 
   ${ORTHANC_ROOT}/Resources/ThirdParty/md5/md5.c
   ${ORTHANC_ROOT}/Resources/ThirdParty/base64/base64.cpp
@@ -47,12 +47,16 @@ set(USE_SYSTEM_LIBJPEG ON CACHE BOOL "Use the system version of libjpeg")
 set(USE_SYSTEM_LIBP11 OFF CACHE BOOL "Use the system version of libp11 (PKCS#11 wrapper library)")
 set(USE_SYSTEM_LIBPNG ON CACHE BOOL "Use the system version of libpng")
 set(USE_SYSTEM_LUA ON CACHE BOOL "Use the system version of Lua")
+set(USE_SYSTEM_LZ4 ON CACHE BOOL "Use the system version of LZ4")
 set(USE_SYSTEM_MONGOOSE ON CACHE BOOL "Use the system version of Mongoose")
 set(USE_SYSTEM_OPENSSL ON CACHE BOOL "Use the system version of OpenSSL")
 set(USE_SYSTEM_PUGIXML ON CACHE BOOL "Use the system version of Pugixml")
 set(USE_SYSTEM_SQLITE ON CACHE BOOL "Use the system version of SQLite")
 set(USE_SYSTEM_UUID ON CACHE BOOL "Use the system version of the uuid library from e2fsprogs")
 set(USE_SYSTEM_ZLIB ON CACHE BOOL "Use the system version of ZLib")
+set(USE_SYSTEM_ZSTD ON CACHE BOOL "Use the system version of Zstandard")
+set(LZ4_SOURCES_DIR "" CACHE PATH "Directory containing the sources of LZ4 (if not using the system version)")
+set(ZSTD_SOURCES_DIR "" CACHE PATH "Directory containing the sources of Zstandard (if not using the system version)")
 
 # Parameters specific to DCMTK
 set(DCMTK_DICTIONARY_DIR "" CACHE PATH "Directory containing the DCMTK dictionaries \"dicom.dic\" and \"private.dic\" (only when using system version of DCMTK)") 
@@ -90,10 +94,12 @@ set(ENABLE_JPEG OFF CACHE INTERNAL "Enable support of JPEG")
 set(ENABLE_GOOGLE_TEST OFF CACHE INTERNAL "Enable support of Google Test")
 set(ENABLE_LOCALE OFF CACHE INTERNAL "Enable support for locales (notably in Boost)")
 set(ENABLE_LUA OFF CACHE INTERNAL "Enable support of Lua scripting")
+set(ENABLE_LZ4 OFF CACHE INTERNAL "Enable support of the LZ4 compression")
 set(ENABLE_PNG OFF CACHE INTERNAL "Enable support of PNG")
 set(ENABLE_PUGIXML OFF CACHE INTERNAL "Enable support of XML through Pugixml")
 set(ENABLE_SQLITE OFF CACHE INTERNAL "Enable support of SQLite databases")
 set(ENABLE_ZLIB OFF CACHE INTERNAL "Enable support of zlib")
+set(ENABLE_ZSTD OFF CACHE INTERNAL "Enable support of the Zstandard compression")
 set(ENABLE_WEB_CLIENT OFF CACHE INTERNAL "Enable Web client")
 set(ENABLE_WEB_SERVER OFF CACHE INTERNAL "Enable embedded Web server")
 set(ENABLE_DCMTK OFF CACHE INTERNAL "Enable DCMTK")
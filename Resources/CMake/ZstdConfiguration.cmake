@@ -0,0 +1,34 @@
+if (STATIC_BUILD OR NOT USE_SYSTEM_ZSTD)
+  # The archive of Zstandard is not available yet among the
+  # third-party downloads of Orthanc: Its sources must be provided by
+  # the user
+  if (NOT EXISTS "${ZSTD_SOURCES_DIR}/lib/zstd.h")
+    message(FATAL_ERROR "Set ZSTD_SOURCES_DIR to the sources of Zstandard (>= 1.3.0), or set USE_SYSTEM_ZSTD to ON")
+  endif()
+
+  include_directories(
+    ${ZSTD_SOURCES_DIR}/lib
+    ${ZSTD_SOURCES_DIR}/lib/common
+    )
+
+  add_definitions(
+    -DZSTD_LEGACY_SUPPORT=0
+    -DZSTD_DISABLE_ASM
+    )
+
+  file(GLOB ZSTD_SOURCES
+    ${ZSTD_SOURCES_DIR}/lib/common/*.c
+    ${ZSTD_SOURCES_DIR}/lib/compress/*.c
+    ${ZSTD_SOURCES_DIR}/lib/decompress/*.c
+    )
+
+  source_group(ThirdParty\\zstd REGULAR_EXPRESSION ${ZSTD_SOURCES_DIR}/.*)
+
+else()
+  CHECK_INCLUDE_FILE_CXX(zstd.h HAVE_ZSTD_H)
+  if (NOT HAVE_ZSTD_H)
+    message(FATAL_ERROR "Please install the libzstd-dev package")
+  endif()
+
+  link_libraries(zstd)
+endif()
@@ -0,0 +1,192 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+#include "../OrthancServer/BinaryDicomAsJson.h"
+
+#include <stdio.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <json/reader.h>
+
+using namespace Orthanc;
+
+
+static void GetSampleDicomAsJson(Json::Value& target)
+{
+  static const char* SAMPLE =
+    "{"
+    "  \"0008,0016\" : { \"Name\" : \"SOPClassUID\", \"Type\" : \"String\", \"Value\" : \"1.2.840.10008.5.1.4.1.1.2\" },"
+    "  \"0010,0010\" : { \"Name\" : \"PatientName\", \"Type\" : \"String\", \"Value\" : \"Doe^J\\u00e9r\\u00f4me\" },"
+    "  \"0010,1010\" : { \"Name\" : \"PatientAge\", \"Type\" : \"Null\", \"Value\" : null },"
+    "  \"0028,0010\" : { \"Name\" : \"Rows\", \"Type\" : \"String\", \"Value\" : \"512\" },"
+    "  \"7fe0,0010\" : { \"Name\" : \"PixelData\", \"Type\" : \"TooLong\", \"Value\" : null },"
+    "  \"0008,1140\" : { \"Name\" : \"ReferencedImageSequence\", \"Type\" : \"Sequence\", \"Value\" : ["
+    "    { \"0008,1150\" : { \"Name\" : \"ReferencedSOPClassUID\", \"Type\" : \"String\", \"Value\" : \"1.2.3\" } },"
+    "    { }"
+    "  ] },"
+    "  \"misc\" : [ true, false, -1, 0, 4294967296, -9007199254740993, 18446744073709551615, 3.25, -0.5, \"\", [], {} ]"
+    "}";
+
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(SAMPLE, target));
+}
+
+
+TEST(BinaryDicomAsJson, Basic)
+{
+  Json::Value source;
+  GetSampleDicomAsJson(source);
+
+  std::string encoded;
+  BinaryDicomAsJson::Encode(encoded, source);
+  ASSERT_TRUE(BinaryDicomAsJson::IsBinary(encoded));
+  ASSERT_FALSE(BinaryDicomAsJson::IsBinary(source.toStyledString()));
+  ASSERT_FALSE(BinaryDicomAsJson::IsBinary(""));
+  ASSERT_LT(encoded.size(), source.toStyledString().size());
+
+  Json::Value decoded;
+  BinaryDicomAsJson::Decode(decoded, encoded);
+  ASSERT_TRUE(decoded == source);
+  ASSERT_EQ(source.toStyledString(), decoded.toStyledString());
+
+  ASSERT_EQ(7u, decoded.size());
+  ASSERT_TRUE(decoded["0010,0010"] == source["0010,0010"]);
+  ASSERT_EQ("Sequence", decoded["0008,1140"]["Type"].asString());
+  ASSERT_EQ(2u, decoded["0008,1140"]["Value"].size());
+  ASSERT_TRUE(decoded["misc"] == source["misc"]);
+
+  // Empty summary
+  BinaryDicomAsJson::Encode(encoded, Json::objectValue);
+  BinaryDicomAsJson::Decode(decoded, encoded);
+  ASSERT_EQ(Json::objectValue, decoded.type());
+  ASSERT_EQ(0u, decoded.size());
+
+  ASSERT_THROW(BinaryDicomAsJson::Encode(encoded, Json::arrayValue), OrthancException);
+}
+
+
+TEST(BinaryDicomAsJson, Corrupted)
+{
+  Json::Value source, decoded;
+  GetSampleDicomAsJson(source);
+
+  std::string encoded;
+  BinaryDicomAsJson::Encode(encoded, source);
+
+  ASSERT_THROW(BinaryDicomAsJson::Decode(decoded, source.toStyledString()), OrthancException);
+
+  // Truncated documents
+  for (size_t i = 0; i < encoded.size(); i++)
+  {
+    ASSERT_THROW(BinaryDicomAsJson::Decode(decoded, encoded.substr(0, i)), OrthancException);
+  }
+
+  // Bad version
+  std::string s = encoded;
+  s[4] = 2;
+  ASSERT_THROW(BinaryDicomAsJson::Decode(decoded, s), OrthancException);
+
+  // Trailing garbage
+  ASSERT_THROW(BinaryDicomAsJson::Decode(decoded, encoded + "x"), OrthancException);
+
+  // Altered bytes must never crash the decoder
+  for (size_t i = 5; i < encoded.size(); i++)
+  {
+    s = encoded;
+    s[i] = static_cast<char>(0xff);
+
+    try
+    {
+      BinaryDicomAsJson::Decode(decoded, s);
+    }
+    catch (OrthancException&)
+    {
+    }
+  }
+}
+
+
+TEST(BinaryDicomAsJson, DISABLED_Benchmark)
+{
+  static const unsigned int COUNT = 10000;
+
+  // Typical summary of a CT slice, with ~150 tags
+  Json::Value source;
+  GetSampleDicomAsJson(source);
+
+  for (unsigned int i = 0; i < 150; i++)
+  {
+    char key[16];
+    sprintf(key, "%04x,%04x", 0x0018 + i / 16, 0x1000 + i);
+
+    Json::Value tag;
+    tag["Name"] = "Tag" + boost::lexical_cast<std::string>(i);
+    tag["Type"] = "String";
+    tag["Value"] = boost::lexical_cast<std::string>(i * 3.1415);
+    source[key] = tag;
+  }
+
+  std::string json = source.toStyledString();
+  std::string binary;
+  BinaryDicomAsJson::Encode(binary, source);
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    Json::Value decoded;
+    Json::Reader reader;
+    reader.parse(json, decoded);
+  }
+
+  boost::posix_time::time_duration jsonElapsed = boost::posix_time::microsec_clock::local_time() - start;
+  start = boost::posix_time::microsec_clock::local_time();
+
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    Json::Value decoded;
+    BinaryDicomAsJson::Decode(decoded, binary);
+  }
+
+  boost::posix_time::time_duration binaryElapsed = boost::posix_time::microsec_clock::local_time() - start;
+
+  LOG(WARNING) << "JSON: " << json.size() << " bytes, parsed " << COUNT
+               << " times in " << jsonElapsed.total_milliseconds() << "ms";
+  LOG(WARNING) << "Binary: " << binary.size() << " bytes, decoded " << COUNT
+               << " times in " << binaryElapsed.total_milliseconds() << "ms";
+}
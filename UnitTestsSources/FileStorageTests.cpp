@@ -35,13 +35,19 @@
 #include "gtest/gtest.h"
 
 #include <ctype.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/FileStorage/PackedStorage.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/HttpServer/BufferHttpSender.h"
 #include "../Core/HttpServer/FilesystemHttpSender.h"
+#include "../Core/HttpServer/StorageAreaHttpSender.h"
+#include "../Core/HttpServer/StringHttpOutput.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
+#include "../Core/SystemToolbox.h"
 #include "../Core/Toolbox.h"
 #include "../OrthancServer/ServerIndex.h"
 
@@ -86,6 +92,38 @@ TEST(FilesystemStorage, Basic2)
   ASSERT_EQ(s.GetSize(uid), data.size());
 }
 
+TEST(FilesystemStorage, CreateFromFile)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  s.Clear();
+
+  std::string data = Toolbox::GenerateUuid();
+  std::string path = s.CreateTemporaryPath();
+  SystemToolbox::WriteFile(data, path);
+
+  std::string uid = Toolbox::GenerateUuid();
+  s.CreateFromFile(uid, path, FileContentType_Dicom);
+  ASSERT_FALSE(SystemToolbox::IsRegularFile(path));
+  ASSERT_TRUE(SystemToolbox::IsRegularFile(s.GetAttachmentPath(uid)));
+
+  std::string d;
+  s.Read(d, uid, FileContentType_Dicom);
+  ASSERT_EQ(data, d);
+
+  // The temporary files are not listed as attachments
+  path = s.CreateTemporaryPath();
+  SystemToolbox::WriteFile(data, path);
+
+  std::set<std::string> ss;
+  s.ListAllFiles(ss);
+  ASSERT_EQ(1u, ss.size());
+  ASSERT_EQ(uid, *ss.begin());
+
+  ASSERT_THROW(s.CreateFromFile(uid, path, FileContentType_Dicom), OrthancException);
+  SystemToolbox::RemoveFile(path);
+  s.Remove(uid, FileContentType_Dicom);
+}
+
 TEST(FilesystemStorage, EndToEnd)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -122,10 +160,81 @@ TEST(FilesystemStorage, EndToEnd)
 }
 
 
-TEST(StorageAccessor, NoCompression)
+namespace
 {
-  FilesystemStorage s("UnitTestsStorage");
-  StorageAccessor accessor(s);
+  enum StorageAreaClass
+  {
+    StorageAreaClass_Filesystem,
+    StorageAreaClass_Packed
+  };
+
+  class StorageAreaTest : public ::testing::TestWithParam<StorageAreaClass>
+  {
+  protected:
+    std::auto_ptr<IStorageArea> storage_;
+
+    virtual void SetUp() 
+    {
+      switch (GetParam())
+      {
+        case StorageAreaClass_Filesystem:
+          storage_.reset(new FilesystemStorage("UnitTestsStorage"));
+          break;
+
+        case StorageAreaClass_Packed:
+          storage_.reset(new PackedStorage("UnitTestsPackedStorage", 1024 * 1024));
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    virtual void TearDown()
+    {
+      storage_.reset(NULL);
+    }
+  };
+}
+
+
+INSTANTIATE_TEST_CASE_P(StorageAreaName,
+                        StorageAreaTest,
+                        ::testing::Values(StorageAreaClass_Filesystem,
+                                          StorageAreaClass_Packed));
+
+
+TEST_P(StorageAreaTest, Basic)
+{
+  std::string data = Toolbox::GenerateUuid();
+  std::string uid = Toolbox::GenerateUuid();
+  storage_->Create(uid, data.c_str(), data.size(), FileContentType_Dicom);
+
+  std::string d;
+  storage_->Read(d, uid, FileContentType_Dicom);
+  ASSERT_EQ(data, d);
+
+  // Empty attachment
+  std::string empty = Toolbox::GenerateUuid();
+  storage_->Create(empty, NULL, 0, FileContentType_DicomAsJson);
+  storage_->Read(d, empty, FileContentType_DicomAsJson);
+  ASSERT_TRUE(d.empty());
+
+  ASSERT_THROW(storage_->Create(uid, data.c_str(), data.size(), FileContentType_Dicom), OrthancException);
+  ASSERT_THROW(storage_->Create("nope", data.c_str(), data.size(), FileContentType_Dicom), OrthancException);
+
+  storage_->Remove(uid, FileContentType_Dicom);
+  storage_->Remove(empty, FileContentType_DicomAsJson);
+  ASSERT_THROW(storage_->Read(d, uid, FileContentType_Dicom), OrthancException);
+
+  // Removing an inexistent attachment is not an error
+  storage_->Remove(uid, FileContentType_Dicom);
+}
+
+
+TEST_P(StorageAreaTest, AccessorNoCompression)
+{
+  StorageAccessor accessor(*storage_);
 
   std::string data = "Hello world";
   FileInfo info = accessor.Write(data, FileContentType_Dicom, CompressionType_None, true);
@@ -143,10 +252,9 @@ TEST(StorageAccessor, NoCompression)
 }
 
 
-TEST(StorageAccessor, Compression)
+TEST_P(StorageAreaTest, AccessorCompression)
 {
-  FilesystemStorage s("UnitTestsStorage");
-  StorageAccessor accessor(s);
+  StorageAccessor accessor(*storage_);
 
   std::string data = "Hello world";
   FileInfo info = accessor.Write(data, FileContentType_DicomAsJson, CompressionType_ZlibWithSize, true);
@@ -163,10 +271,9 @@ TEST(StorageAccessor, Compression)
 }
 
 
-TEST(StorageAccessor, Mix)
+TEST_P(StorageAreaTest, AccessorMix)
 {
-  FilesystemStorage s("UnitTestsStorage");
-  StorageAccessor accessor(s);
+  StorageAccessor accessor(*storage_);
 
   std::string r;
   std::string compressedData = "Hello";
@@ -188,3 +295,820 @@ TEST(StorageAccessor, Mix)
   ASSERT_THROW(accessor.Read(r, uncompressedInfo.GetUuid(), FileContentType_Unknown), OrthancException);
   */
 }
+
+
+
+TEST(StorageAccessor, AnswerFile)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  // Larger than one memory-mapped window (16MB)
+  std::string data;
+  data.resize(16 * 1024 * 1024 + 12345);
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<char>(i % 251);
+  }
+
+  FileInfo raw = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+  FileInfo compressed = accessor.Write(data, FileContentType_Dicom, CompressionType_ZlibWithSize, false);
+
+  {
+    FilesystemHttpSender sender(s, raw.GetUuid());
+#if !defined(_WIN32)
+    ASSERT_TRUE(sender.IsMemoryMapped());
+#endif
+    ASSERT_EQ(data.size(), sender.GetContentLength());
+
+    std::string t;
+    while (sender.ReadNextChunk())
+    {
+      t.append(sender.GetChunkContent(), sender.GetChunkSize());
+    }
+
+    ASSERT_TRUE(data == t);
+  }
+
+  {
+    // Arbitrary files are never memory-mapped
+    FilesystemHttpSender sender(s.GetAttachmentPath(raw.GetUuid()));
+    ASSERT_FALSE(sender.IsMemoryMapped());
+  }
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    // The uncompressed attachment is streamed from the file, and the
+    // compressed one is uncompressed in memory
+    StringHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      accessor.AnswerFile(output, i == 0 ? raw : compressed, "application/dicom");
+    }
+
+    std::string t;
+    stream.GetOutput(t);
+    ASSERT_TRUE(data == t);
+  }
+
+  accessor.Remove(raw);
+  accessor.Remove(compressed);
+}
+
+
+TEST(FilesystemHttpSender, Range)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  std::string data;
+  data.resize(16 * 1024 * 1024 + 12345);
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<char>(i % 251);
+  }
+
+  FileInfo raw = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    std::auto_ptr<FilesystemHttpSender> sender;
+    if (i == 0)
+    {
+      sender.reset(new FilesystemHttpSender(s, raw.GetUuid()));
+    }
+    else
+    {
+      sender.reset(new FilesystemHttpSender(s.GetAttachmentPath(raw.GetUuid())));
+    }
+
+    // The range is not aligned on the pages, and overlaps two windows
+    // of the memory mapping
+    const uint64_t start = 16 * 1024 * 1024 - 1001;
+    const uint64_t end = data.size() - 17;
+    ASSERT_TRUE(sender->SetRange(start, end));
+    ASSERT_EQ(data.size(), sender->GetContentLength());
+
+    std::string t;
+    while (sender->ReadNextChunk())
+    {
+      t.append(sender->GetChunkContent(), sender->GetChunkSize());
+    }
+
+    ASSERT_TRUE(data.substr(start, end - start) == t);
+
+    ASSERT_TRUE(sender->SetRange(3, 3));
+    ASSERT_FALSE(sender->ReadNextChunk());
+
+    ASSERT_THROW(sender->SetRange(4, 3), OrthancException);
+    ASSERT_THROW(sender->SetRange(0, data.size() + 1), OrthancException);
+  }
+
+  accessor.Remove(raw);
+}
+
+
+TEST(StorageAreaHttpSender, Chunks)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  std::string data;
+  data.resize(10000);
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<char>(i % 251);
+  }
+
+  FileInfo raw = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+
+  StorageAreaHttpSender sender(s, raw.GetUuid(), FileContentType_Dicom, data.size());
+  sender.SetChunkSize(1000);
+  ASSERT_THROW(sender.SetChunkSize(0), OrthancException);
+
+  std::string t;
+  unsigned int count = 0;
+  while (sender.ReadNextChunk())
+  {
+    ASSERT_GE(1000u, sender.GetChunkSize());
+    t.append(sender.GetChunkContent(), sender.GetChunkSize());
+    count++;
+  }
+
+  ASSERT_EQ(10u, count);
+  ASSERT_TRUE(data == t);
+
+  ASSERT_TRUE(sender.SetRange(123, 4567));
+
+  t.clear();
+  count = 0;
+  while (sender.ReadNextChunk())
+  {
+    ASSERT_GE(1000u, sender.GetChunkSize());
+    t.append(sender.GetChunkContent(), sender.GetChunkSize());
+    count++;
+  }
+
+  ASSERT_EQ(5u, count);
+  ASSERT_TRUE(data.substr(123, 4567 - 123) == t);
+
+  accessor.Remove(raw);
+}
+
+
+namespace
+{
+  class HeaderHttpOutput : public IHttpOutputStream
+  {
+  public:
+    HttpStatus   status_;
+    std::string  header_;
+    std::string  body_;
+
+    virtual void OnHttpStatusReceived(HttpStatus status)
+    {
+      status_ = status;
+    }
+
+    virtual void Send(bool isHeader, const void* buffer, size_t length)
+    {
+      (isHeader ? header_ : body_).append(reinterpret_cast<const char*>(buffer), length);
+    }
+  };
+
+  class UnseekableHttpSender : public BufferHttpSender
+  {
+  public:
+    virtual bool SetRange(uint64_t start,
+                          uint64_t end)
+    {
+      return false;
+    }
+  };
+}
+
+
+TEST(HttpOutput, Range)
+{
+  const std::string data = "0123456789";
+  const std::string path = "UnitTestsResults/range.txt";
+  SystemToolbox::WriteFile(data, path);
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=2-4");
+      FilesystemHttpSender sender(path);
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_206_PartialContent, stream.status_);
+    ASSERT_EQ("234", stream.body_);
+    ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes 2-4/10\r\n"));
+    ASSERT_NE(std::string::npos, stream.header_.find("Content-Length: 3\r\n"));
+  }
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=-3");
+      FilesystemHttpSender sender(path);
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_206_PartialContent, stream.status_);
+    ASSERT_EQ("789", stream.body_);
+  }
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=20-");
+      FilesystemHttpSender sender(path);
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_416_RequestedRangeNotSatisfiable, stream.status_);
+    ASSERT_TRUE(stream.body_.empty());
+    ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes */10\r\n"));
+  }
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=0-1,-2");
+      FilesystemHttpSender sender(path);
+      sender.SetContentType("text/plain");
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_206_PartialContent, stream.status_);
+
+    const std::string tag = "Content-Type: multipart/byteranges; boundary=";
+    size_t pos = stream.header_.find(tag);
+    ASSERT_NE(std::string::npos, pos);
+    std::string boundary = stream.header_.substr(pos + tag.size());
+    boundary = boundary.substr(0, boundary.find("\r\n"));
+
+    ASSERT_EQ("--" + boundary + "\r\n" +
+              "Content-Type: text/plain\r\n" +
+              "Content-Range: bytes 0-1/10\r\n\r\n01\r\n" +
+              "--" + boundary + "\r\n" +
+              "Content-Type: text/plain\r\n" +
+              "Content-Range: bytes 8-9/10\r\n\r\n89\r\n" +
+              "--" + boundary + "--\r\n", stream.body_);
+    ASSERT_NE(std::string::npos, stream.header_.find("Content-Length: " + 
+                                                     boost::lexical_cast<std::string>(stream.body_.size()) + "\r\n"));
+  }
+
+  {
+    // An invalid range, or overlapping ranges that are larger than
+    // the content, lead to the full content
+    const char* headers[] = { "bytes=0-7,2-9", "nope" };
+
+    for (size_t i = 0; i < 2; i++)
+    {
+      HeaderHttpOutput stream;
+
+      {
+        HttpOutput output(stream, false);
+        output.SetRequestedRange(headers[i]);
+        FilesystemHttpSender sender(path);
+        output.Answer(sender);
+      }
+
+      ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+      ASSERT_EQ(data, stream.body_);
+    }
+  }
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=2-4,6-6");
+      BufferHttpSender sender;
+      sender.GetBuffer() = data;
+      sender.SetChunkSize(1);
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_206_PartialContent, stream.status_);
+    ASSERT_NE(std::string::npos, stream.body_.find("Content-Range: bytes 2-4/10\r\n\r\n234\r\n"));
+    ASSERT_NE(std::string::npos, stream.body_.find("Content-Range: bytes 6-6/10\r\n\r\n6\r\n"));
+  }
+
+  {
+    // Range is ignored by the senders that cannot be seeked
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedRange("bytes=2-4");
+      UnseekableHttpSender sender;
+      sender.GetBuffer() = data;
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+    ASSERT_EQ(data, stream.body_);
+    ASSERT_EQ(std::string::npos, stream.header_.find("Accept-Ranges"));
+  }
+}
+
+
+TEST(HttpOutput, EntityTag)
+{
+  const std::string data = "0123456789";
+
+  {
+    // No "If-None-Match": The tag is sent with the answer
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      ASSERT_FALSE(output.SetEntityTag("abc", "no-cache"));
+      output.Answer(data);
+    }
+
+    ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+    ASSERT_EQ(data, stream.body_);
+    ASSERT_NE(std::string::npos, stream.header_.find("ETag: \"abc\"\r\n"));
+    ASSERT_NE(std::string::npos, stream.header_.find("Cache-Control: no-cache\r\n"));
+    ASSERT_EQ(std::string::npos, stream.header_.find("Vary"));
+  }
+
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedEntityTags("\"nope\"");
+      ASSERT_FALSE(output.SetEntityTag("abc", "max-age=60, immutable"));
+
+      BufferHttpSender sender;
+      sender.GetBuffer() = data;
+      output.Answer(sender);
+    }
+
+    ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+    ASSERT_EQ(data, stream.body_);
+    ASSERT_NE(std::string::npos, stream.header_.find("ETag: \"abc\"\r\n"));
+    ASSERT_NE(std::string::npos, stream.header_.find("Cache-Control: max-age=60, immutable\r\n"));
+  }
+
+  {
+    // The tag differs if the body is compressed
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetGzipAllowed(true);
+      ASSERT_FALSE(output.SetEntityTag("abc", ""));
+      output.Answer(data);
+    }
+
+    ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+    ASSERT_NE(std::string::npos, stream.header_.find("ETag: \"abc-gzip\"\r\n"));
+    ASSERT_EQ(std::string::npos, stream.header_.find("Cache-Control"));
+  }
+
+  const char* matching[] = { "\"abc\"", "\"x\", W/\"abc\"", "*", "\"abc-gzip\"" };
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      output.SetRequestedEntityTags(matching[i]);
+      ASSERT_TRUE(output.SetEntityTag("abc", "no-cache"));
+    }
+
+    ASSERT_EQ(HttpStatus_304_NotModified, stream.status_);
+    ASSERT_TRUE(stream.body_.empty());
+    ASSERT_EQ(std::string::npos, stream.header_.find("Content-Length"));
+    ASSERT_NE(std::string::npos, stream.header_.find("Cache-Control: no-cache\r\n"));
+    ASSERT_NE(std::string::npos, stream.header_.find(i == 3 ? "ETag: \"abc-gzip\"\r\n" : "ETag: \"abc\"\r\n"));
+  }
+
+  {
+    // Content negotiation: "Vary" is sent with the answer and with "304"
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      HeaderHttpOutput stream;
+
+      {
+        HttpOutput output(stream, false);
+        output.SetVary("Accept");
+        output.SetRequestedEntityTags(i == 0 ? "" : "\"abc\"");
+
+        if (!output.SetEntityTag("abc", "no-cache"))
+        {
+          output.Answer(data);
+        }
+      }
+
+      ASSERT_EQ(i == 0 ? HttpStatus_200_Ok : HttpStatus_304_NotModified, stream.status_);
+      ASSERT_NE(std::string::npos, stream.header_.find("Vary: Accept\r\n"));
+    }
+  }
+
+  {
+    // The tag is not sent with the errors
+    HeaderHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      ASSERT_FALSE(output.SetEntityTag("abc", "no-cache"));
+      output.SendStatus(HttpStatus_404_NotFound);
+    }
+
+    ASSERT_EQ(HttpStatus_404_NotFound, stream.status_);
+    ASSERT_EQ(std::string::npos, stream.header_.find("ETag"));
+  }
+
+  {
+    HeaderHttpOutput stream;
+    HttpOutput output(stream, false);
+    ASSERT_THROW(output.SetEntityTag("", ""), OrthancException);
+    ASSERT_THROW(output.SetEntityTag("a\"b", ""), OrthancException);
+    output.AnswerEmpty();
+  }
+}
+
+
+TEST_P(StorageAreaTest, ReadRange)
+{
+  std::string data = "0123456789";
+  std::string uuid = Toolbox::GenerateUuid();
+  storage_->Create(uuid, data.c_str(), data.size(), FileContentType_Dicom);
+
+  std::string s;
+  storage_->ReadRange(s, uuid, FileContentType_Dicom, 2, 5);
+  ASSERT_EQ("234", s);
+  storage_->ReadRange(s, uuid, FileContentType_Dicom, 0, 10);
+  ASSERT_EQ(data, s);
+  storage_->ReadRange(s, uuid, FileContentType_Dicom, 4, 4);
+  ASSERT_TRUE(s.empty());
+
+  ASSERT_THROW(storage_->ReadRange(s, uuid, FileContentType_Dicom, 5, 4), OrthancException);
+  ASSERT_THROW(storage_->ReadRange(s, uuid, FileContentType_Dicom, 0, 11), OrthancException);
+  ASSERT_THROW(storage_->ReadRange(s, Toolbox::GenerateUuid(), FileContentType_Dicom, 0, 1), OrthancException);
+
+  storage_->Remove(uuid, FileContentType_Dicom);
+}
+
+
+TEST_P(StorageAreaTest, AnswerRange)
+{
+  StorageAccessor accessor(*storage_);
+
+  std::string data;
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    data += boost::lexical_cast<std::string>(i);
+  }
+
+  // The uncompressed attachments are read by ranges from the storage
+  // area, and the compressed ones are uncompressed in memory
+  const CompressionType compressions[] = { CompressionType_None, CompressionType_ZlibWithSize };
+
+  for (size_t i = 0; i < 2; i++)
+  {
+    FileInfo info = accessor.Write(data, FileContentType_Dicom, compressions[i], false);
+
+    {
+      HeaderHttpOutput stream;
+
+      {
+        HttpOutput output(stream, false);
+        output.SetRequestedRange("bytes=100-199");
+        accessor.AnswerFile(output, info, "application/dicom");
+      }
+
+      ASSERT_EQ(HttpStatus_206_PartialContent, stream.status_);
+      ASSERT_EQ(data.substr(100, 100), stream.body_);
+    }
+
+    {
+      HeaderHttpOutput stream;
+
+      {
+        HttpOutput output(stream, false);
+        accessor.AnswerFile(output, info, "application/dicom");
+      }
+
+      ASSERT_EQ(HttpStatus_200_Ok, stream.status_);
+      ASSERT_EQ(data, stream.body_);
+      ASSERT_NE(std::string::npos, stream.header_.find("Accept-Ranges: bytes\r\n"));
+    }
+
+    accessor.Remove(info);
+  }
+}
+
+
+static std::string GeneratePackedContent(unsigned int i)
+{
+  // Content of varying size, so that the records span several segments
+  return std::string(10 + (i * 37) % 500, static_cast<char>('a' + i % 26));
+}
+
+
+TEST(PackedStorage, Persistence)
+{
+  boost::filesystem::remove_all("UnitTestsPackedStorage");
+
+  std::vector<std::string> uuids;
+
+  {
+    PackedStorage s("UnitTestsPackedStorage", 4096);
+    s.SetCompactionRatio(0);
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      std::string content = GeneratePackedContent(i);
+      uuids.push_back(Toolbox::GenerateUuid());
+      s.Create(uuids.back(), content.c_str(), content.size(), FileContentType_Dicom);
+    }
+
+    for (unsigned int i = 0; i < 100; i += 3)
+    {
+      s.Remove(uuids[i], FileContentType_Dicom);
+    }
+
+    unsigned int segments;
+    uint64_t live, garbage;
+    s.GetStatistics(segments, live, garbage);
+    ASSERT_LT(1u, segments);
+    ASSERT_LT(0u, garbage);
+  }
+
+  // Reopen the storage area: Both the sealed segments (through their
+  // index) and the active segment (by scanning it) are reloaded
+  PackedStorage s("UnitTestsPackedStorage", 4096);
+
+  std::set<std::string> ss;
+  s.ListAllFiles(ss);
+  ASSERT_EQ(66u, ss.size());
+
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    std::string d;
+    if (i % 3 == 0)
+    {
+      ASSERT_TRUE(ss.find(uuids[i]) == ss.end());
+      ASSERT_THROW(s.Read(d, uuids[i], FileContentType_Dicom), OrthancException);
+    }
+    else
+    {
+      ASSERT_TRUE(ss.find(uuids[i]) != ss.end());
+      s.Read(d, uuids[i], FileContentType_Dicom);
+      ASSERT_EQ(GeneratePackedContent(i), d);
+      ASSERT_EQ(d.size(), s.GetSize(uuids[i]));
+    }
+  }
+
+  s.Clear();
+  s.ListAllFiles(ss);
+  ASSERT_EQ(0u, ss.size());
+}
+
+
+TEST(PackedStorage, Compaction)
+{
+  boost::filesystem::remove_all("UnitTestsPackedStorage");
+
+  std::vector<std::string> uuids;
+
+  {
+    PackedStorage s("UnitTestsPackedStorage", 4096);
+    s.SetCompactionRatio(0);
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      std::string content = GeneratePackedContent(i);
+      uuids.push_back(Toolbox::GenerateUuid());
+      s.Create(uuids.back(), content.c_str(), content.size(), FileContentType_Dicom);
+    }
+
+    // Remove 3 attachments out of 4
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      if (i % 4 != 0)
+      {
+        s.Remove(uuids[i], FileContentType_Dicom);
+      }
+    }
+
+    unsigned int segmentsBefore, segmentsAfter;
+    uint64_t liveBefore, liveAfter, garbageBefore, garbageAfter;
+    s.GetStatistics(segmentsBefore, liveBefore, garbageBefore);
+
+    s.SetCompactionRatio(50);
+    s.Compact();
+
+    s.GetStatistics(segmentsAfter, liveAfter, garbageAfter);
+    ASSERT_EQ(liveBefore, liveAfter);
+    ASSERT_LT(garbageAfter, garbageBefore);
+    ASSERT_LT(segmentsAfter, segmentsBefore);
+
+    // Remove an attachment that was moved by the compaction
+    s.Remove(uuids[0], FileContentType_Dicom);
+  }
+
+  PackedStorage s("UnitTestsPackedStorage", 4096);
+
+  std::set<std::string> ss;
+  s.ListAllFiles(ss);
+  ASSERT_EQ(24u, ss.size());
+
+  for (unsigned int i = 4; i < 100; i += 4)
+  {
+    std::string d;
+    s.Read(d, uuids[i], FileContentType_Dicom);
+    ASSERT_EQ(GeneratePackedContent(i), d);
+  }
+
+  s.Clear();
+}
+
+
+TEST(PackedStorage, CompactionFlush)
+{
+  boost::filesystem::remove_all("UnitTestsPackedStorage");
+
+  PackedStorage s("UnitTestsPackedStorage", 16384);
+  s.SetCompactionRatio(0);
+
+  // Fill a first segment, then seal it by writing a large attachment
+  std::vector<std::string> uuids;
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    std::string content = GeneratePackedContent(i);
+    uuids.push_back(Toolbox::GenerateUuid());
+    s.Create(uuids.back(), content.c_str(), content.size(), FileContentType_Dicom);
+  }
+
+  std::string large(12000, 'x');
+  std::string largeUuid = Toolbox::GenerateUuid();
+  s.Create(largeUuid, large.c_str(), large.size(), FileContentType_Dicom);
+
+  for (unsigned int i = 1; i < 20; i++)
+  {
+    s.Remove(uuids[i], FileContentType_Dicom);
+  }
+
+  // The appends to the active segment are not synchronized
+  ASSERT_LT(0u, s.GetUnflushedSize());
+
+  unsigned int segmentsBefore, segmentsAfter;
+  uint64_t live, garbage;
+  s.GetStatistics(segmentsBefore, live, garbage);
+
+  s.SetCompactionRatio(50);
+  s.Compact();
+
+  // The first segment has been removed, and the record it contained
+  // has been flushed to the active segment before
+  s.GetStatistics(segmentsAfter, live, garbage);
+  ASSERT_EQ(segmentsBefore - 1, segmentsAfter);
+  ASSERT_EQ(0u, s.GetUnflushedSize());
+
+  std::string d;
+  s.Read(d, uuids[0], FileContentType_Dicom);
+  ASSERT_EQ(GeneratePackedContent(0), d);
+
+  s.Clear();
+}
+
+
+TEST(PackedStorage, SegmentNumbers)
+{
+  boost::filesystem::remove_all("UnitTestsPackedStorage");
+
+  PackedStorage s("UnitTestsPackedStorage", 4096);
+
+  std::string content = GeneratePackedContent(0);
+  s.Create(Toolbox::GenerateUuid(), content.c_str(), content.size(), FileContentType_Dicom);
+  ASSERT_TRUE(boost::filesystem::exists("UnitTestsPackedStorage/segment-00000001.dat"));
+
+  // The number of a removed segment is never reused, as its files
+  // might still be in the process of being removed
+  s.Clear();
+  s.Create(Toolbox::GenerateUuid(), content.c_str(), content.size(), FileContentType_Dicom);
+  ASSERT_FALSE(boost::filesystem::exists("UnitTestsPackedStorage/segment-00000001.dat"));
+  ASSERT_TRUE(boost::filesystem::exists("UnitTestsPackedStorage/segment-00000002.dat"));
+
+  s.Clear();
+}
+
+
+TEST(PackedStorage, Recovery)
+{
+  boost::filesystem::remove_all("UnitTestsPackedStorage");
+
+  std::string a = Toolbox::GenerateUuid();
+  std::string b = Toolbox::GenerateUuid();
+
+  {
+    PackedStorage s("UnitTestsPackedStorage", 1024 * 1024);
+    s.Create(a, "Hello", 5, FileContentType_Dicom);
+  }
+
+  {
+    // Simulate a crash while writing a record at the end of the
+    // active segment
+    boost::filesystem::ofstream f;
+    f.open("UnitTestsPackedStorage/segment-00000001.dat",
+           std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+    f << "OPKR" << b << "garbage";
+  }
+
+  PackedStorage s("UnitTestsPackedStorage", 1024 * 1024);
+
+  std::set<std::string> ss;
+  s.ListAllFiles(ss);
+  ASSERT_EQ(1u, ss.size());
+
+  std::string d;
+  s.Read(d, a, FileContentType_Dicom);
+  ASSERT_EQ("Hello", d);
+
+  // The incomplete record has been truncated
+  s.Create(b, "World", 5, FileContentType_Dicom);
+  s.Read(d, b, FileContentType_Dicom);
+  ASSERT_EQ("World", d);
+
+  s.Clear();
+}
+
+
+TEST(PackedStorage, DISABLED_Benchmark)
+{
+  // Ingestion of small attachments, which is the worst case for the
+  // one-file-per-attachment storage
+  static const unsigned int COUNT = 100000;
+  static const size_t SIZE = 4096;
+
+  std::string content(SIZE, 'x');
+  std::vector<std::string> uuids;
+
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    uuids.push_back(Toolbox::GenerateUuid());
+  }
+
+  for (unsigned int k = 0; k < 2; k++)
+  {
+    std::auto_ptr<IStorageArea> storage;
+
+    if (k == 0)
+    {
+      boost::filesystem::remove_all("UnitTestsStorage");
+      storage.reset(new FilesystemStorage("UnitTestsStorage"));
+    }
+    else
+    {
+      boost::filesystem::remove_all("UnitTestsPackedStorage");
+      storage.reset(new PackedStorage("UnitTestsPackedStorage", 1024 * 1024 * 1024));
+    }
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      storage->Create(uuids[i], content.c_str(), content.size(), FileContentType_Dicom);
+    }
+
+    boost::posix_time::ptime middle = boost::posix_time::microsec_clock::local_time();
+
+    std::string d;
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      storage->Read(d, uuids[(i * 7919) % COUNT], FileContentType_Dicom);
+    }
+
+    boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      storage->Remove(uuids[i], FileContentType_Dicom);
+    }
+
+    LOG(WARNING) << (k == 0 ? "Filesystem" : "Packed") << " storage: " << COUNT << " attachments of "
+                 << SIZE << " bytes written in " << (middle - start).total_milliseconds()
+                 << "ms, read in " << (end - middle).total_milliseconds() << "ms";
+  }
+}
@@ -42,6 +42,14 @@
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/IDynamicObject.h"
 #include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+#include "../Core/SystemToolbox.h"
+#include "../OrthancServer/ArchiveCache.h"
+#include "../OrthancServer/AttachmentCache.h"
+#include "../OrthancServer/DicomAsJsonCache.h"
+#include "../OrthancServer/ParsedDicomCache.h"
+
+using namespace Orthanc;
 
 
 TEST(LRU, Basic)
@@ -282,3 +290,339 @@ TEST(LRU, SharedArchive)
 
   ASSERT_EQ(2u, count);
 }
+
+
+TEST(AttachmentCache, Basic)
+{
+  AttachmentCache cache(2);
+
+  AttachmentCache::Content a(new std::string(100, 'a'));
+  AttachmentCache::Content b(new std::string(100, 'b'));
+  AttachmentCache::Content c;
+
+  uint64_t size, maximumSize, count, hits, misses, evictions;
+
+  // The cache is disabled by default
+  ASSERT_FALSE(cache.IsCacheable("a", 1));
+  cache.Add("a", a);
+  ASSERT_FALSE(cache.Lookup(c, "a"));
+  cache.GetStatistics(size, maximumSize, count, hits, misses, evictions);
+  ASSERT_EQ(0u, size);
+  ASSERT_EQ(0u, count);
+  ASSERT_EQ(0u, misses);
+
+  // Each of the 2 shards can hold 150 bytes
+  cache.SetMaximumSize(300);
+  ASSERT_TRUE(cache.IsCacheable("a", 150));
+  ASSERT_FALSE(cache.IsCacheable("a", 151));
+
+  cache.Add("a", a);
+  ASSERT_TRUE(cache.Lookup(c, "a"));
+  ASSERT_EQ(a.get(), c.get());  // No copy
+  ASSERT_FALSE(cache.Lookup(c, "nope"));
+
+  cache.Add("big", AttachmentCache::Content(new std::string(200, 'x')));
+  ASSERT_FALSE(cache.Lookup(c, "big"));
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses, evictions);
+  ASSERT_EQ(100u, size);
+  ASSERT_EQ(300u, maximumSize);
+  ASSERT_EQ(1u, count);
+  ASSERT_EQ(1u, hits);
+  ASSERT_EQ(2u, misses);
+  ASSERT_EQ(0u, evictions);
+
+  cache.Invalidate("a");
+  ASSERT_FALSE(cache.Lookup(c, "a"));
+  ASSERT_EQ(100u, a->size());  // The buffer is still owned by "a"
+
+  // Fill the cache until some items get evicted
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    cache.Add(boost::lexical_cast<std::string>(i), b);
+  }
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses, evictions);
+  ASSERT_EQ(2u, count);  // One item per shard
+  ASSERT_EQ(200u, size);
+  ASSERT_EQ(8u, evictions);
+
+  cache.Clear();
+  cache.GetStatistics(size, maximumSize, count, hits, misses, evictions);
+  ASSERT_EQ(0u, count);
+  ASSERT_EQ(0u, size);
+
+  ASSERT_THROW(cache.Add("a", AttachmentCache::Content()), OrthancException);
+}
+
+
+namespace
+{
+  class ParsedDicomProvider : public ParsedDicomCache::IProvider
+  {
+  public:
+    std::map<std::string, unsigned int>  calls_;
+
+    virtual ParsedDicomFile* Provide(size_t& size,
+                                     const std::string& instancePublicId)
+    {
+      calls_[instancePublicId] ++;
+
+      if (instancePublicId == "bad")
+      {
+        throw OrthancException(ErrorCode_InexistentItem);
+      }
+
+      size = 100;
+      return new ParsedDicomFile(true);
+    }
+  };
+}
+
+
+TEST(ParsedDicomCache, Basic)
+{
+  ParsedDicomProvider provider;
+  ParsedDicomCache cache(provider, 250);
+
+  size_t size, maximumSize, count;
+  uint64_t hits, misses;
+
+  {
+    ParsedDicomCache::Accessor a(cache, "a");
+
+    // Another instance can be accessed while "a" is locked
+    ParsedDicomCache::Accessor b(cache, "b");
+    ASSERT_NE(&a.GetDicom(), &b.GetDicom());
+  }
+
+  {
+    ParsedDicomCache::Accessor a(cache, "a");
+  }
+
+  ASSERT_EQ(1u, provider.calls_["a"]);
+  ASSERT_EQ(1u, provider.calls_["b"]);
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(200u, size);
+  ASSERT_EQ(250u, maximumSize);
+  ASSERT_EQ(2u, count);
+  ASSERT_EQ(1u, hits);
+  ASSERT_EQ(2u, misses);
+
+  // "b" is the least recently used entry, and gets evicted
+  {
+    ParsedDicomCache::Accessor c(cache, "c");
+  }
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(200u, size);
+  ASSERT_EQ(2u, count);
+
+  {
+    ParsedDicomCache::Accessor b(cache, "b");
+  }
+
+  ASSERT_EQ(2u, provider.calls_["b"]);
+
+  // An invalidated entry remains valid for its current accessor
+  {
+    ParsedDicomCache::Accessor b(cache, "b");
+    cache.Invalidate("b");
+    ASSERT_TRUE(b.GetDicom().HasTag(DICOM_TAG_SOP_INSTANCE_UID));
+  }
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(100u, size);
+  ASSERT_EQ(1u, count);
+
+  // A failure of the provider is not cached
+  ASSERT_THROW(ParsedDicomCache::Accessor(cache, "bad"), OrthancException);
+  ASSERT_THROW(ParsedDicomCache::Accessor(cache, "bad"), OrthancException);
+  ASSERT_EQ(2u, provider.calls_["bad"]);
+
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(1u, count);
+
+  // The most recent entry is kept, even if it exceeds the maximum size
+  cache.SetMaximumSize(0);
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(100u, size);
+  ASSERT_EQ(1u, count);
+}
+
+
+TEST(DicomAsJsonCache, Basic)
+{
+  DicomAsJsonCache cache;
+
+  DicomAsJsonCache::Content a(new Json::Value("a"));
+  DicomAsJsonCache::Content b(new Json::Value("b"));
+  DicomAsJsonCache::Content c;
+
+  // The cache is disabled by default
+  cache.Add("a", a, 10, cache.GetGeneration());
+  ASSERT_FALSE(cache.Lookup(c, "a"));
+
+  cache.SetMaximumSize(25);
+  cache.Add("a", a, 10, cache.GetGeneration());
+  cache.Add("b", b, 10, cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup(c, "a"));
+  ASSERT_EQ(a.get(), c.get());
+
+  // "b" is the least recently used entry
+  cache.Add("c", a, 10, cache.GetGeneration());
+  ASSERT_FALSE(cache.Lookup(c, "b"));
+  ASSERT_TRUE(cache.Lookup(c, "c"));
+
+  // A read that started before an invalidation is not cached
+  uint64_t generation = cache.GetGeneration();
+  cache.Invalidate("a");
+  ASSERT_FALSE(cache.Lookup(c, "a"));
+  cache.Add("a", a, 10, generation);
+  ASSERT_FALSE(cache.Lookup(c, "a"));
+  cache.Add("a", a, 10, cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup(c, "a"));
+
+  // Too large
+  cache.Add("d", b, 30, cache.GetGeneration());
+  ASSERT_FALSE(cache.Lookup(c, "d"));
+
+  size_t size, maximumSize, count;
+  uint64_t hits, misses;
+  cache.GetStatistics(size, maximumSize, count, hits, misses);
+  ASSERT_EQ(20u, size);
+  ASSERT_EQ(25u, maximumSize);
+  ASSERT_EQ(2u, count);
+  ASSERT_EQ(3u, hits);
+  ASSERT_EQ(4u, misses);
+
+  ASSERT_THROW(cache.Add("e", DicomAsJsonCache::Content(), 1, cache.GetGeneration()), OrthancException);
+}
+
+
+static ArchiveCache::File CreateArchiveFile(size_t size)
+{
+  ArchiveCache::File file(new TemporaryFile("zip"));
+  file->Write(std::string(size, 'z'));
+  return file;
+}
+
+
+TEST(ArchiveCache, Basic)
+{
+  ArchiveCache cache;
+  cache.SetMaximumSize(250);
+
+  ArchiveCache::State state;
+  ArchiveCache::File file;
+  std::string filename;
+  Json::Value status;
+
+  std::string id = "job1";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key1", "a.zip", 0));
+  ASSERT_EQ("job1", id);
+
+  // The same content is shared by the concurrent requests
+  id = "job2";
+  ASSERT_EQ(ArchiveCache::Registration_Existing, cache.Register(id, "key1", "b.zip", 0));
+  ASSERT_EQ("job1", id);
+
+  ASSERT_TRUE(cache.SetProgress("job1", 1, 4));
+  ASSERT_FALSE(cache.SetProgress("nope", 1, 4));
+  ASSERT_TRUE(cache.GetStatus(status, "job1"));
+  ASSERT_EQ("Running", status["State"].asString());
+  ASSERT_EQ(25, status["Progress"].asInt());
+  ASSERT_EQ(4, status["TotalInstances"].asInt());
+  ASSERT_FALSE(cache.GetStatus(status, "nope"));
+
+  ASSERT_TRUE(cache.GetArchive(state, file, filename, "job1"));
+  ASSERT_EQ(ArchiveCache::State_Running, state);
+  ASSERT_TRUE(file.get() == NULL);
+  ASSERT_EQ("a.zip", filename);
+
+  ArchiveCache::File a = CreateArchiveFile(100);
+  cache.SetSuccess("job1", a);
+  ASSERT_THROW(cache.SetFailure("job1", ErrorCode_InternalError), OrthancException);
+
+  ASSERT_TRUE(cache.GetStatus(status, "job1"));
+  ASSERT_EQ("Success", status["State"].asString());
+  ASSERT_EQ(100, status["Progress"].asInt());
+  ASSERT_EQ("100", status["Size"].asString());
+
+  ASSERT_TRUE(cache.GetArchive(state, file, filename, "job1"));
+  ASSERT_EQ(ArchiveCache::State_Success, state);
+  ASSERT_EQ(a.get(), file.get());
+
+  id = "job3";
+  ASSERT_EQ(ArchiveCache::Registration_Existing, cache.Register(id, "key1", "c.zip", 0));
+  ASSERT_EQ("job1", id);
+
+  // Failed archives are not reused
+  id = "job4";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key4", "d.zip", 0));
+  cache.SetFailure("job4", ErrorCode_UnknownResource);
+  ASSERT_TRUE(cache.GetStatus(status, "job4"));
+  ASSERT_EQ("Failure", status["State"].asString());
+  ASSERT_EQ(static_cast<int>(ErrorCode_UnknownResource), status["ErrorCode"].asInt());
+
+  id = "job5";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key4", "d.zip", 0));
+  ASSERT_EQ("job5", id);
+
+  // Eviction of the least recently used archive
+  cache.SetSuccess("job5", CreateArchiveFile(100));
+  ASSERT_TRUE(cache.GetArchive(state, file, filename, "job1"));  // Make "job1" the most recent
+  id = "job6";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key6", "e.zip", 0));
+  cache.SetSuccess("job6", CreateArchiveFile(100));
+
+  ASSERT_TRUE(cache.GetStatus(status, "job1"));
+  ASSERT_FALSE(cache.GetStatus(status, "job5"));
+  ASSERT_TRUE(cache.GetStatus(status, "job6"));
+
+  // The temporary file remains available to the pending downloads
+  ASSERT_EQ(a.get(), file.get());
+  std::string path = a->GetPath();
+  a.reset();
+  ASSERT_TRUE(cache.Remove("job1"));
+  ASSERT_FALSE(cache.Remove("job1"));
+  ASSERT_TRUE(SystemToolbox::IsRegularFile(path));
+  file.reset();
+  ASSERT_FALSE(SystemToolbox::IsRegularFile(path));
+
+  // A running archive that is removed stops reporting its progress
+  id = "job7";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key7", "f.zip", 0));
+  ASSERT_TRUE(cache.Remove("job7"));
+  ASSERT_FALSE(cache.SetProgress("job7", 1, 2));
+  cache.SetSuccess("job7", CreateArchiveFile(10));  // Ignored
+  ASSERT_FALSE(cache.GetStatus(status, "job7"));
+
+  // The most recent archive is kept, even if it is too large
+  cache.SetMaximumSize(10);
+  ASSERT_TRUE(cache.GetStatus(status, "job6"));
+
+  std::list<std::string> archives;
+  cache.ListArchives(archives);
+  ASSERT_EQ(1u, archives.size());
+  ASSERT_EQ("job6", archives.front());
+
+  // The running archives are bounded by their expected size, but the
+  // first one is always accepted
+  id = "job8";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key8", "g.zip", 100));
+  id = "job9";
+  ASSERT_EQ(ArchiveCache::Registration_Rejected, cache.Register(id, "key9", "h.zip", 1));
+  ASSERT_FALSE(cache.GetStatus(status, "job9"));
+  cache.SetFailure("job8", ErrorCode_InternalError);
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key9", "h.zip", 5));
+  id = "job10";
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key10", "i.zip", 5));
+  id = "job11";
+  ASSERT_EQ(ArchiveCache::Registration_Rejected, cache.Register(id, "key11", "j.zip", 1));
+
+  // Removing a running archive releases its budget
+  ASSERT_TRUE(cache.Remove("job10"));
+  ASSERT_EQ(ArchiveCache::Registration_Created, cache.Register(id, "key11", "j.zip", 1));
+}
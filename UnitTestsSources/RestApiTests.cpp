@@ -47,6 +47,8 @@
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/RestApi/RestApiHierarchy.h"
 #include "../Core/HttpServer/HttpContentNegociation.h"
+#include "../Core/HttpServer/HttpOutput.h"
+#include "../Core/HttpServer/StringHttpOutput.h"
 
 using namespace Orthanc;
 
@@ -156,6 +158,26 @@ TEST(RestApi, ChunkedBuffer)
   ASSERT_EQ("helloworld", s);
 }
 
+TEST(RestApi, ChunkedStream)
+{
+  StringHttpOutput stream;
+
+  {
+    HttpOutput output(stream, true /* keep-alive */);
+    output.StartStream("text/plain");
+    output.SendStreamItem("hello", 5);
+    output.SendStreamItem(NULL, 0);
+    output.SendStreamItem("0123456789abcdefghij", 20);
+    ASSERT_TRUE(output.IsWritingStream());
+    output.CloseStream();
+    ASSERT_FALSE(output.IsWritingStream());
+  }
+
+  std::string s;
+  stream.GetOutput(s);
+  ASSERT_EQ("5\r\nhello\r\n14\r\n0123456789abcdefghij\r\n0\r\n\r\n", s);
+}
+
 TEST(RestApi, ParseCookies)
 {
   IHttpHandler::Arguments headers;
@@ -185,6 +207,61 @@ TEST(RestApi, ParseCookies)
   ASSERT_EQ("v", cookies["n"]);
 }
 
+TEST(RestApi, ParseRanges)
+{
+  std::list<HttpToolbox::Range> ranges;
+
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, "bytes=0-499", 1000));
+  ASSERT_EQ(1u, ranges.size());
+  ASSERT_EQ(0u, ranges.front().first);
+  ASSERT_EQ(500u, ranges.front().second);
+
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, " bytes=500- , -100,990-2000", 1000));
+  ASSERT_EQ(3u, ranges.size());
+  ASSERT_EQ(500u, ranges.front().first);
+  ASSERT_EQ(1000u, ranges.front().second);
+  ranges.pop_front();
+  ASSERT_EQ(900u, ranges.front().first);
+  ASSERT_EQ(1000u, ranges.front().second);
+  ranges.pop_front();
+  ASSERT_EQ(990u, ranges.front().first);
+  ASSERT_EQ(1000u, ranges.front().second);
+
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, "bytes=-2000", 1000));
+  ASSERT_EQ(1u, ranges.size());
+  ASSERT_EQ(0u, ranges.front().first);
+  ASSERT_EQ(1000u, ranges.front().second);
+
+  // Syntactically valid, but not satisfiable
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, "bytes=1000-", 1000));
+  ASSERT_TRUE(ranges.empty());
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, "bytes=-0", 1000));
+  ASSERT_TRUE(ranges.empty());
+  ASSERT_TRUE(HttpToolbox::ParseRanges(ranges, "bytes=0-", 0));
+  ASSERT_TRUE(ranges.empty());
+
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "items=0-10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "bytes=10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "bytes=10-5", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "bytes=a-5", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "bytes=-", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRanges(ranges, "bytes=99999999999999999999-", 1000));
+}
+
+TEST(RestApi, MatchEntityTag)
+{
+  ASSERT_TRUE(HttpToolbox::MatchEntityTag("\"abc\"", "abc"));
+  ASSERT_TRUE(HttpToolbox::MatchEntityTag(" \"x\" , W/\"abc\"", "abc"));
+  ASSERT_TRUE(HttpToolbox::MatchEntityTag("*", "abc"));
+
+  ASSERT_FALSE(HttpToolbox::MatchEntityTag("", "abc"));
+  ASSERT_FALSE(HttpToolbox::MatchEntityTag("abc", "abc"));
+  ASSERT_FALSE(HttpToolbox::MatchEntityTag("\"abcd\"", "abc"));
+  ASSERT_FALSE(HttpToolbox::MatchEntityTag("\"ab\"", "abc"));
+  ASSERT_FALSE(HttpToolbox::MatchEntityTag("\"x\", \"y\"", "abc"));
+}
+
 TEST(RestApi, RestApiPath)
 {
   IHttpHandler::Arguments args;
@@ -40,6 +40,10 @@
 #include "../OrthancServer/ServerContext.h"
 #include "../OrthancServer/ServerIndex.h"
 #include "../OrthancServer/Search/LookupIdentifierQuery.h"
+#include "../OrthancServer/Search/LookupResource.h"
+#include "../OrthancServer/Search/RangeConstraint.h"
+#include "../OrthancServer/Search/ValueConstraint.h"
+#include "../OrthancServer/Search/WildcardConstraint.h"
 
 #include <ctype.h>
 #include <algorithm>
@@ -523,6 +527,237 @@ TEST_P(DatabaseWrapperTest, Upward)
 }
 
 
+TEST_P(DatabaseWrapperTest, ResourceStatistics)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Patient),   // 0
+    index_->CreateResource("b", ResourceType_Study),     // 1
+    index_->CreateResource("c", ResourceType_Series),    // 2
+    index_->CreateResource("d", ResourceType_Instance),  // 3
+    index_->CreateResource("e", ResourceType_Instance),  // 4
+    index_->CreateResource("f", ResourceType_Study),     // 5
+    index_->CreateResource("g", ResourceType_Series),    // 6
+    index_->CreateResource("h", ResourceType_Instance)   // 7
+  };
+
+  index_->AttachChild(a[0], a[1]);
+  index_->AttachChild(a[1], a[2]);
+  index_->AttachChild(a[2], a[3]);
+  index_->AttachChild(a[0], a[5]);
+  index_->AttachChild(a[5], a[6]);
+  index_->AttachChild(a[6], a[7]);
+
+  index_->AddAttachment(a[3], FileInfo("d1", FileContentType_Dicom, 10, "md5"));
+  index_->AddAttachment(a[3], FileInfo("d2", FileContentType_DicomAsJson, 20, "md5", 
+                                       CompressionType_ZlibWithSize, 5, "md5"));
+  index_->AddAttachment(a[4], FileInfo("e1", FileContentType_Dicom, 100, "md5"));
+  index_->AddAttachment(a[7], FileInfo("h1", FileContentType_Dicom, 1000, "md5"));
+
+  // The instance "e" is attached after its attachments were added
+  index_->AttachChild(a[2], a[4]);
+
+  uint64_t cs, us;
+  unsigned int countStudies, countSeries, countInstances;
+
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[0]));
+  ASSERT_EQ(2u, countStudies);
+  ASSERT_EQ(2u, countSeries);
+  ASSERT_EQ(3u, countInstances);
+  ASSERT_EQ(1115u, cs);
+  ASSERT_EQ(1130u, us);
+
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[1]));
+  ASSERT_EQ(1u, countStudies);
+  ASSERT_EQ(1u, countSeries);
+  ASSERT_EQ(2u, countInstances);
+  ASSERT_EQ(115u, cs);
+  ASSERT_EQ(130u, us);
+
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[3]));
+  ASSERT_EQ(0u, countStudies);
+  ASSERT_EQ(0u, countSeries);
+  ASSERT_EQ(1u, countInstances);
+  ASSERT_EQ(15u, cs);
+  ASSERT_EQ(30u, us);
+
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Patient));
+  ASSERT_EQ(2u, index_->GetResourceCount(ResourceType_Study));
+  ASSERT_EQ(2u, index_->GetResourceCount(ResourceType_Series));
+  ASSERT_EQ(3u, index_->GetResourceCount(ResourceType_Instance));
+  ASSERT_EQ(1115u, index_->GetTotalCompressedSize());
+  ASSERT_EQ(1130u, index_->GetTotalUncompressedSize());
+
+  index_->DeleteAttachment(a[3], FileContentType_DicomAsJson);
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[0]));
+  ASSERT_EQ(1110u, cs);
+  ASSERT_EQ(1110u, us);
+  ASSERT_EQ(1110u, index_->GetTotalCompressedSize());
+
+  // Deleting the last instance of a series also removes the series
+  // and its parent study
+  index_->DeleteResource(a[7]);
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[0]));
+  ASSERT_EQ(1u, countStudies);
+  ASSERT_EQ(1u, countSeries);
+  ASSERT_EQ(2u, countInstances);
+  ASSERT_EQ(110u, cs);
+  ASSERT_EQ(110u, us);
+
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Patient));
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Study));
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Series));
+  ASSERT_EQ(2u, index_->GetResourceCount(ResourceType_Instance));
+  ASSERT_EQ(110u, index_->GetTotalCompressedSize());
+
+  index_->DeleteResource(a[3]);
+  ASSERT_TRUE(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[0]));
+  ASSERT_EQ(1u, countStudies);
+  ASSERT_EQ(1u, countSeries);
+  ASSERT_EQ(1u, countInstances);
+  ASSERT_EQ(100u, cs);
+  ASSERT_EQ(1u, index_->GetResourceCount(ResourceType_Instance));
+  ASSERT_EQ(100u, index_->GetTotalUncompressedSize());
+
+  index_->DeleteResource(a[0]);
+  ASSERT_THROW(index_->GetResourceStatistics(cs, us, countStudies, countSeries, countInstances, a[0]),
+               OrthancException);
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Patient));
+  ASSERT_EQ(0u, index_->GetResourceCount(ResourceType_Study));
+  ASSERT_EQ(0u, index_->GetTotalCompressedSize());
+  CheckTableRecordCount(0, "ResourceStatistics");
+}
+
+
+TEST_P(DatabaseWrapperTest, DeletedFiles)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Patient),
+    index_->CreateResource("b", ResourceType_Study),
+    index_->CreateResource("c", ResourceType_Series),
+    index_->CreateResource("d", ResourceType_Instance),
+    index_->CreateResource("e", ResourceType_Instance)
+  };
+
+  index_->AttachChild(a[0], a[1]);
+  index_->AttachChild(a[1], a[2]);
+  index_->AttachChild(a[2], a[3]);
+  index_->AttachChild(a[2], a[4]);
+
+  index_->AddAttachment(a[3], FileInfo("d1", FileContentType_Dicom, 10, "md5"));
+  index_->AddAttachment(a[3], FileInfo("d2", FileContentType_DicomAsJson, 20, "md5"));
+  index_->AddAttachment(a[4], FileInfo("e1", FileContentType_Dicom, 100, "md5"));
+
+  std::list<FileInfo> files;
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 10));
+  ASSERT_TRUE(files.empty());
+
+  // The removed attachments are recorded in the same transaction
+  index_->DeleteResource(a[3]);
+  CheckTableRecordCount(2, "DeletedFiles");
+  CheckTableRecordCount(1, "AttachedFiles");
+
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 1));
+  ASSERT_EQ(1u, files.size());
+
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 10));
+  ASSERT_EQ(2u, files.size());
+
+  for (std::list<FileInfo>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    if (it->GetUuid() == "d1")
+    {
+      ASSERT_EQ(FileContentType_Dicom, it->GetContentType());
+      ASSERT_EQ(10u, it->GetCompressedSize());
+    }
+    else
+    {
+      ASSERT_EQ("d2", it->GetUuid());
+      ASSERT_EQ(FileContentType_DicomAsJson, it->GetContentType());
+      ASSERT_EQ(20u, it->GetCompressedSize());
+    }
+  }
+
+  index_->ClearDeletedFile("d1");
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 10));
+  ASSERT_EQ(1u, files.size());
+  ASSERT_EQ("d2", files.front().GetUuid());
+
+  // Deleting the patient cascades to the remaining instance
+  index_->DeleteResource(a[0]);
+  CheckTableRecordCount(2, "DeletedFiles");
+  CheckTableRecordCount(0, "AttachedFiles");
+
+  // A file whose removal has failed goes to the end of the list
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 1));
+  ASSERT_EQ("d2", files.front().GetUuid());
+  index_->PostponeDeletedFile("d2");
+  CheckTableRecordCount(2, "DeletedFiles");
+  ASSERT_TRUE(index_->GetDeletedFiles(files, 10));
+  ASSERT_EQ(2u, files.size());
+  ASSERT_EQ("e1", files.front().GetUuid());
+  ASSERT_EQ("d2", files.back().GetUuid());
+  ASSERT_EQ(FileContentType_DicomAsJson, files.back().GetContentType());
+  ASSERT_EQ(20u, files.back().GetCompressedSize());
+
+  index_->ClearDeletedFile("d2");
+  index_->ClearDeletedFile("e1");
+  CheckTableRecordCount(0, "DeletedFiles");
+}
+
+
+TEST_P(DatabaseWrapperTest, PruneLogs)
+{
+  int64_t a = index_->CreateResource("a", ResourceType_Patient);
+
+  for (int i = 0; i < 10; i++)
+  {
+    std::string date = "2018010" + boost::lexical_cast<std::string>(i) + "T000000";
+    index_->LogChange(a, ServerIndexChange(-1, ChangeType_NewPatient, ResourceType_Patient, "a", date));
+    index_->LogExportedResource(ExportedResource(-1, ResourceType_Patient, "a", "modality", date,
+                                                 "patient", "", "", ""));
+  }
+
+  uint32_t removed;
+
+  // By number of entries, in batches
+  ASSERT_TRUE(index_->PruneChanges(removed, 3, "", 2));
+  ASSERT_EQ(2u, removed);
+  ASSERT_TRUE(index_->PruneChanges(removed, 3, "", 100));
+  ASSERT_EQ(5u, removed);
+  ASSERT_TRUE(index_->PruneChanges(removed, 3, "", 100));
+  ASSERT_EQ(0u, removed);
+  CheckTableRecordCount(3, "Changes");
+
+  // By date
+  ASSERT_TRUE(index_->PruneExportedResources(removed, 0, "20180105T000000", 100));
+  ASSERT_EQ(5u, removed);
+  CheckTableRecordCount(5, "ExportedResources");
+
+  // The most recent entry is always kept, to report the last sequence number
+  ASSERT_TRUE(index_->PruneChanges(removed, 0, "20190101T000000", 100));
+  ASSERT_EQ(2u, removed);
+  ASSERT_TRUE(index_->PruneExportedResources(removed, 1, "", 100));
+  ASSERT_EQ(4u, removed);
+
+  std::list<ServerIndexChange> changes;
+  index_->GetLastChange(changes);
+  ASSERT_EQ(1u, changes.size());
+  ASSERT_EQ(10, changes.front().GetSeq());
+
+  std::list<ExportedResource> exports;
+  index_->GetLastExportedResource(exports);
+  ASSERT_EQ(1u, exports.size());
+  ASSERT_EQ(10, exports.front().GetSeq());
+
+  // New entries keep on increasing the sequence numbers
+  index_->LogChange(a, ServerIndexChange(ChangeType_NewPatient, ResourceType_Patient, "a"));
+  bool done;
+  index_->GetChanges(changes, done, 0, 100);
+  ASSERT_EQ(2u, changes.size());
+  ASSERT_EQ(11, changes.back().GetSeq());
+}
+
+
 TEST_P(DatabaseWrapperTest, PatientRecycling)
 {
   std::vector<int64_t> patients;
@@ -765,6 +1000,180 @@ TEST_P(DatabaseWrapperTest, LookupIdentifier)
 
 
 
+TEST_P(DatabaseWrapperTest, LookupMainDicomTag)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Study),   // 0
+    index_->CreateResource("b", ResourceType_Study),   // 1
+    index_->CreateResource("c", ResourceType_Study),   // 2
+    index_->CreateResource("d", ResourceType_Series)   // 3
+  };
+
+  index_->SetMainDicomTag(a[0], DICOM_TAG_PATIENT_NAME, "Smith^John");
+  index_->SetMainDicomTag(a[1], DICOM_TAG_PATIENT_NAME, "SMITH^Jane");
+  index_->SetMainDicomTag(a[2], DICOM_TAG_PATIENT_NAME, "Doe^\xc3\x89lodie");  // Uppercase "E" with acute accent
+  index_->SetMainDicomTag(a[3], DICOM_TAG_PATIENT_NAME, "Smith^John");
+  index_->SetMainDicomTag(a[0], DICOM_TAG_STUDY_DATE, "20180101");
+  index_->SetMainDicomTag(a[1], DICOM_TAG_STUDY_DATE, "20180315");
+  index_->SetMainDicomTag(a[2], DICOM_TAG_STUDY_DATE, "20181231");
+
+  // Patient name and study date are also identifiers at the study level
+  for (size_t i = 0; i < 3; i++)
+  {
+    DicomMap tags;
+    index_->GetMainDicomTags(tags, a[i]);
+    index_->SetIdentifierTag(a[i], DICOM_TAG_PATIENT_NAME, ServerToolbox::NormalizeIdentifier
+                             (tags.GetValue(DICOM_TAG_PATIENT_NAME).GetContent()));
+    index_->SetIdentifierTag(a[i], DICOM_TAG_STUDY_DATE, ServerToolbox::NormalizeIdentifier
+                             (tags.GetValue(DICOM_TAG_STUDY_DATE).GetContent()));
+  }
+
+  std::list<int64_t> s;
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Equal, "Smith^John", true));
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ(a[0], s.front());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Equal, "smith^john", true));
+  ASSERT_EQ(0u, s.size());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Equal, "smith^john", false));
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ(a[0], s.front());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Equal, "doe^\xc3\xa9lodie", false));
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ(a[2], s.front());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Wildcard, "*SMITH*", false));
+  ASSERT_EQ(2u, s.size());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Wildcard, "*SMITH*", true));
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ(a[1], s.front());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_PATIENT_NAME,
+                                         IdentifierConstraintType_Wildcard, "Smith^J?hn", true));
+  ASSERT_EQ(1u, s.size());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_STUDY_DATE,
+                                         IdentifierConstraintType_GreaterOrEqual, "20180301", true));
+  ASSERT_EQ(2u, s.size());
+
+  ASSERT_TRUE(index_->LookupMainDicomTag(s, ResourceType_Study, DICOM_TAG_STUDY_DATE,
+                                         IdentifierConstraintType_SmallerOrEqual, "20180315", true));
+  ASSERT_EQ(2u, s.size());
+
+  {
+    LookupResource lookup(ResourceType_Study);
+    lookup.Add(DICOM_TAG_PATIENT_NAME, new WildcardConstraint("*smith*", false));
+    lookup.Add(DICOM_TAG_STUDY_DATE, new RangeConstraint("20180201", "", true));
+    ASSERT_FALSE(lookup.HasUnoptimizedConstraints());
+
+    lookup.FindCandidates(s, *index_);
+    ASSERT_EQ(1u, s.size());
+    ASSERT_EQ(a[1], s.front());
+  }
+
+  {
+    LookupResource lookup(ResourceType_Study);
+    lookup.Add(DicomTag(0x0010, 0x0040) /* PatientSex, patient level */, new ValueConstraint("M", true));
+    ASSERT_FALSE(lookup.HasUnoptimizedConstraints());
+
+    lookup.FindCandidates(s, *index_);
+    ASSERT_EQ(0u, s.size());
+
+    lookup.Add(DicomTag(0x0008, 0x0060) /* Modality, series level */, new ValueConstraint("CT", true));
+    ASSERT_TRUE(lookup.HasUnoptimizedConstraints());
+  }
+}
+
+
+/**
+ * Benchmark of "/tools/find" over a synthetic database with 1M
+ * studies. Disabled by default, as it takes several minutes and
+ * requires a few GB of RAM. Run it with:
+ * "./UnitTests --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*"
+ **/
+TEST(LookupResource, DISABLED_Benchmark)
+{
+  static const unsigned int COUNT = 1000000;
+  static const char* NAMES[] = { "Smith", "Doe", "Martin", "Dupont", "Garcia", "Peeters", "Jansen", "Rossi" };
+
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+
+  {
+    std::auto_ptr<SQLite::ITransaction> t(db.StartTransaction());
+    t->Begin();
+
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      std::string id = boost::lexical_cast<std::string>(i);
+      std::string name = std::string(NAMES[i % 8]) + "^" + id;
+
+      char date[16];
+      int k = static_cast<int>(i);
+      sprintf(date, "%04d%02d%02d", 1990 + k % 30, 1 + (k / 30) % 12, 1 + (k / 360) % 28);
+
+      DicomMap tags;
+      tags.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id, false);
+      tags.SetValue(DICOM_TAG_PATIENT_NAME, name, false);
+      tags.SetValue(DicomTag(0x0010, 0x0040), (i % 2) ? "M" : "F", false);  // PatientSex
+      tags.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3." + id, false);
+      tags.SetValue(DICOM_TAG_STUDY_DATE, date, false);
+      tags.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "Study " + id, false);
+      tags.SetValue(DICOM_TAG_ACCESSION_NUMBER, "ACC" + id, false);
+
+      int64_t study = db.CreateResource("study-" + id, ResourceType_Study);
+      ServerToolbox::StoreMainDicomTags(db, study, ResourceType_Study, tags);
+    }
+
+    t->Commit();
+  }
+
+  const struct
+  {
+    DicomTag     tag_;
+    const char*  query_;
+    bool         caseSensitive_;
+  } QUERIES[] = {
+    { DICOM_TAG_PATIENT_NAME, "*SMITH*", false },
+    { DICOM_TAG_PATIENT_NAME, "doe^4242", false },
+    { DICOM_TAG_PATIENT_ID, "patient-4242", true },
+    { DICOM_TAG_STUDY_DATE, "20000101-20051231", true },
+    { DicomTag(0x0010, 0x0040), "M", true },
+    { DICOM_TAG_STUDY_DESCRIPTION, "Study 42*", true }
+  };
+
+  for (size_t i = 0; i < sizeof(QUERIES) / sizeof(QUERIES[0]); i++)
+  {
+    LookupResource lookup(ResourceType_Study);
+    lookup.AddDicomConstraint(QUERIES[i].tag_, QUERIES[i].query_, QUERIES[i].caseSensitive_);
+    ASSERT_FALSE(lookup.HasUnoptimizedConstraints());
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+    std::list<int64_t> result;
+    lookup.FindCandidates(result, db);
+
+    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+
+    LOG(WARNING) << "Lookup " << QUERIES[i].tag_.Format() << "=\"" << QUERIES[i].query_ << "\": "
+                 << result.size() << " matches in " << elapsed.total_milliseconds() << "ms";
+  }
+
+  db.Close();
+}
+
+
+
 TEST(ServerIndex, AttachmentRecycling)
 {
   const std::string path = "UnitTestsStorage";
@@ -839,6 +1248,541 @@ TEST(ServerIndex, AttachmentRecycling)
 }
 
 
+TEST(ServerIndex, ConcurrentReaders)
+{
+  {
+    DatabaseWrapper db;   // Not available for an in-memory database
+    db.SetConcurrentReaders(true);
+    ASSERT_FALSE(db.HasConcurrentReaders());
+    db.Open();
+    ASSERT_TRUE(db.OpenReadOnlyConnection() == NULL);
+    db.Close();
+  }
+
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  SystemToolbox::RemoveFile(path + "/index-concurrent");
+  DatabaseWrapper db(path + "/index-concurrent");
+  db.SetConcurrentReaders(true);
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetConcurrentReaders(2);
+  ASSERT_EQ(2u, index.GetConcurrentReadersCount());
+
+  DicomMap instance;
+  instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+  instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+  instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series", false);
+  instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance", false);
+
+  std::map<MetadataType, std::string> instanceMetadata;
+  DicomInstanceToStore toStore;
+  toStore.SetSummary(instance);
+  ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, ServerIndex::Attachments()));
+
+  // The read-only connections must see the changes of the writer
+  DicomInstanceHasher hasher(instance);
+  ResourceType type;
+  ASSERT_TRUE(index.LookupResourceType(type, hasher.HashSeries()));
+  ASSERT_EQ(ResourceType_Series, type);
+
+  Json::Value tmp;
+  index.ComputeStatistics(tmp);
+  ASSERT_EQ(1, tmp["CountPatients"].asInt());
+  ASSERT_EQ(1, tmp["CountInstances"].asInt());
+
+  ASSERT_TRUE(index.LookupResource(tmp, hasher.HashSeries(), ResourceType_Series));
+  ASSERT_EQ(hasher.HashStudy(), tmp["ParentStudy"].asString());
+  ASSERT_FALSE(tmp["IsStable"].asBool());
+
+  context.Stop();
+  ASSERT_EQ(0u, index.GetConcurrentReadersCount());
+  db.Close();
+}
+
+
+static void StoreInstanceThread(ServerIndex* index,
+                                unsigned int i,
+                                StoreStatus* status)
+{
+  std::string id = boost::lexical_cast<std::string>(i % 4);
+  DicomMap instance;
+  instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id, false);
+  instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + id, false);
+  instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + id, false);
+  instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + boost::lexical_cast<std::string>(i), false);
+
+  std::map<MetadataType, std::string> instanceMetadata;
+  DicomInstanceToStore toStore;
+  toStore.SetSummary(instance);
+  *status = index->Store(instanceMetadata, toStore, ServerIndex::Attachments());
+}
+
+
+TEST(ServerIndex, GroupCommit)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetStoreBatching(8, 50);
+
+  static const unsigned int COUNT = 32;
+  std::vector<StoreStatus> status(COUNT, StoreStatus_Failure);
+
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    threads.create_thread(boost::bind(StoreInstanceThread, &index, i, &status[i]));
+  }
+
+  threads.join_all();
+
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    ASSERT_EQ(StoreStatus_Success, status[i]);
+  }
+
+  // Storing again the same instance must be detected inside a
+  // batch. A lone instance must not wait for the time window.
+  index.SetStoreBatching(8, 60000);
+
+  const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  StoreStatus again;
+  StoreInstanceThread(&index, 0, &again);
+  ASSERT_EQ(StoreStatus_AlreadyStored, again);
+  ASSERT_GT(10, (boost::posix_time::microsec_clock::universal_time() - start).total_seconds());
+
+  uint64_t countBatches, countInstances;
+  unsigned int largestBatch;
+  index.GetStoreBatchStatistics(countBatches, countInstances, largestBatch);
+  ASSERT_EQ(COUNT + 1, countInstances);
+  ASSERT_LT(countBatches, countInstances);
+  ASSERT_LT(1u, largestBatch);
+  ASSERT_GE(8u, largestBatch);
+
+  Json::Value tmp;
+  index.ComputeStatistics(tmp);
+  ASSERT_EQ(4, tmp["CountPatients"].asInt());
+  ASSERT_EQ(static_cast<int>(COUNT), tmp["CountInstances"].asInt());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, FilteredChanges)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  uint64_t count = context.GetChangesCount();
+
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    StoreStatus status;
+    StoreInstanceThread(&index, i, &status);
+    ASSERT_EQ(StoreStatus_Success, status);
+  }
+
+  std::set<ChangeType> changeTypes;
+  std::set<ResourceType> levels;
+
+  Json::Value changes;
+  index.GetChanges(changes, 0, 100, changeTypes, levels);
+  ASSERT_EQ(20u, changes["Changes"].size());   // 4 patients, 4 studies, 4 series, 8 instances
+  ASSERT_TRUE(changes["Done"].asBool());
+
+  levels.insert(ResourceType_Instance);
+  index.GetChanges(changes, 0, 100, changeTypes, levels);
+  ASSERT_EQ(8u, changes["Changes"].size());
+  ASSERT_EQ("NewInstance", changes["Changes"][0]["ChangeType"].asString());
+
+  // Paging through the filtered changes
+  levels.clear();
+  changeTypes.insert(StringToChangeType("NewStudy"));
+  index.GetChanges(changes, 0, 3, changeTypes, levels);
+  ASSERT_EQ(3u, changes["Changes"].size());
+  ASSERT_FALSE(changes["Done"].asBool());
+  ASSERT_EQ(changes["Changes"][2]["Seq"].asInt(), changes["Last"].asInt());
+
+  index.GetChanges(changes, changes["Last"].asInt(), 3, changeTypes, levels);
+  ASSERT_EQ(1u, changes["Changes"].size());
+  ASSERT_EQ("NewStudy", changes["Changes"][0]["ChangeType"].asString());
+  ASSERT_TRUE(changes["Done"].asBool());
+
+  // The "Last" field moves forward, even if no change matches
+  int64_t last = changes["Last"].asInt();
+  index.GetChanges(changes, last, 3, changeTypes, levels);
+  ASSERT_EQ(0u, changes["Changes"].size());
+  ASSERT_TRUE(changes["Done"].asBool());
+  ASSERT_LE(last, changes["Last"].asInt());
+
+  ASSERT_THROW(StringToChangeType("Nope"), OrthancException);
+
+  // Notification of the new changes
+  ASSERT_LT(count, context.GetChangesCount());
+  count = context.GetChangesCount();
+  ASSERT_FALSE(context.WaitForChanges(count, 10));
+
+  StoreStatus status;
+  StoreInstanceThread(&index, 8, &status);
+  ASSERT_EQ(StoreStatus_Success, status);
+
+  uint64_t previous = count;
+  ASSERT_TRUE(context.WaitForChanges(count, 10));
+  ASSERT_LT(previous, count);
+
+  context.CloseChangesFeed();
+  ASSERT_TRUE(context.IsChangesFeedClosed());
+  ASSERT_FALSE(context.WaitForChanges(previous, 1000));
+
+  // Bounded number of clients of the stream of changes
+  context.SetMaximumChangesStreamClients(2);
+  ASSERT_TRUE(context.AddChangesStreamClient());
+  ASSERT_TRUE(context.AddChangesStreamClient());
+  ASSERT_FALSE(context.AddChangesStreamClient());
+  context.RemoveChangesStreamClient();
+  ASSERT_TRUE(context.AddChangesStreamClient());
+  context.RemoveChangesStreamClient();
+  context.RemoveChangesStreamClient();
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, StableResources)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetStableAge(1);
+  ASSERT_THROW(index.SetStableAge(0), OrthancException);
+
+  // "series-0" is received first, but it receives a new instance
+  // before "series-1" becomes stable, which postpones its deadline
+  StoreStatus status;
+  StoreInstanceThread(&index, 0, &status);
+  ASSERT_EQ(StoreStatus_Success, status);
+  StoreInstanceThread(&index, 1, &status);
+  ASSERT_EQ(StoreStatus_Success, status);
+
+  SystemToolbox::USleep(500000);
+  StoreInstanceThread(&index, 4, &status);
+  ASSERT_EQ(StoreStatus_Success, status);
+
+  std::set<ChangeType> changeTypes;
+  changeTypes.insert(ChangeType_StableSeries);
+  std::set<ResourceType> levels;
+
+  Json::Value changes;
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    index.GetChanges(changes, 0, 10, changeTypes, levels);
+    if (changes["Changes"].size() >= 2)
+    {
+      break;
+    }
+
+    SystemToolbox::USleep(100000);
+  }
+
+  ASSERT_EQ(2u, changes["Changes"].size());
+
+  // The stable events are logged in the order of their deadlines
+  Json::Value tags;
+  ASSERT_TRUE(index.LookupResource(tags, changes["Changes"][0]["ID"].asString(), ResourceType_Series));
+  ASSERT_EQ("series-1", tags["MainDicomTags"]["SeriesInstanceUID"].asString());
+  ASSERT_TRUE(index.LookupResource(tags, changes["Changes"][1]["ID"].asString(), ResourceType_Series));
+  ASSERT_EQ("series-0", tags["MainDicomTags"]["SeriesInstanceUID"].asString());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, LookupResources)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    std::string id = boost::lexical_cast<std::string>(i);
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+    instance.SetValue(DICOM_TAG_PATIENT_NAME, "Doe^John", false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + boost::lexical_cast<std::string>(i % 2), false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id, false);
+    instance.SetValue(DICOM_TAG_INSTANCE_NUMBER, boost::lexical_cast<std::string>(i / 2 + 1), false);
+
+    ServerIndex::Attachments attachments;
+    attachments.push_back(FileInfo("uuid-" + id, FileContentType_Dicom, 100 + i, "md5"));
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+  }
+
+  const ResourceType levels[] = { 
+    ResourceType_Patient, ResourceType_Study, ResourceType_Series, ResourceType_Instance
+  };
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    std::list<std::string> ids;
+    index.GetAllUuids(ids, levels[i]);
+    ids.push_front("nope");
+
+    // The batched expansion must give the same result as the
+    // individual lookups, in the same order
+    Json::Value batch;
+    index.LookupResources(batch, ids, levels[i]);
+    ASSERT_EQ(Json::arrayValue, batch.type());
+    ASSERT_EQ(ids.size() - 1, batch.size());
+
+    Json::Value::ArrayIndex pos = 0;
+    for (std::list<std::string>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+    {
+      Json::Value item;
+      if (index.LookupResource(item, *it, levels[i]))
+      {
+        ASSERT_EQ(item.toStyledString(), batch[pos].toStyledString());
+        pos++;
+      }
+    }
+
+    ASSERT_EQ(batch.size(), pos);
+  }
+
+  // Resources of another level are ignored
+  std::list<std::string> studies;
+  index.GetAllUuids(studies, ResourceType_Study);
+
+  Json::Value batch;
+  index.LookupResources(batch, studies, ResourceType_Series);
+  ASSERT_EQ(0u, batch.size());
+
+  // Paging through the lookups, with and without constraints
+  LookupResource all(ResourceType_Instance);
+  ASSERT_FALSE(all.HasConstraints());
+
+  std::list<std::string> page;
+  index.FindResources(page, all, 2, 3);
+  ASSERT_EQ(3u, page.size());
+  index.FindResources(page, all, 5, 3);
+  ASSERT_EQ(1u, page.size());
+  index.FindResources(page, all, 0, 0);
+  ASSERT_EQ(6u, page.size());
+
+  LookupResource series(ResourceType_Instance);
+  series.AddDicomConstraint(DICOM_TAG_SERIES_INSTANCE_UID, "series-0", true);
+  ASSERT_TRUE(series.HasConstraints());
+  index.FindResources(page, series, 1, 5);
+  ASSERT_EQ(2u, page.size());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(PublicIdCache, Basic)
+{
+  PublicIdCache cache;
+
+  int64_t id;
+  ResourceType type;
+
+  // The cache is disabled by default
+  cache.Add("a", 1, ResourceType_Patient, cache.GetGeneration());
+  ASSERT_FALSE(cache.Lookup(id, type, "a"));
+
+  cache.SetMaximumSize(2);
+  cache.Add("a", 1, ResourceType_Patient, cache.GetGeneration());
+  cache.Add("b", 2, ResourceType_Study, cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup(id, type, "a"));
+  ASSERT_EQ(1, id);
+  ASSERT_EQ(ResourceType_Patient, type);
+
+  // "b" is the least recently used entry
+  cache.Add("c", 3, ResourceType_Series, cache.GetGeneration());
+  ASSERT_FALSE(cache.Lookup(id, type, "b"));
+  ASSERT_TRUE(cache.Lookup(id, type, "c"));
+  ASSERT_EQ(3, id);
+  ASSERT_EQ(ResourceType_Series, type);
+
+  // A lookup that started before a deletion is not cached
+  uint64_t generation = cache.GetGeneration();
+  cache.Invalidate("a");
+  ASSERT_FALSE(cache.Lookup(id, type, "a"));
+  cache.Add("a", 1, ResourceType_Patient, generation);
+  ASSERT_FALSE(cache.Lookup(id, type, "a"));
+  cache.Add("a", 1, ResourceType_Patient, cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup(id, type, "a"));
+
+  size_t size, maximumSize;
+  uint64_t hits, misses;
+  cache.GetStatistics(size, maximumSize, hits, misses);
+  ASSERT_EQ(2u, size);
+  ASSERT_EQ(2u, maximumSize);
+  ASSERT_EQ(3u, hits);
+  ASSERT_EQ(3u, misses);
+
+  cache.SetMaximumSize(1);
+  cache.GetStatistics(size, maximumSize, hits, misses);
+  ASSERT_EQ(1u, size);
+
+  cache.Clear();
+  ASSERT_FALSE(cache.Lookup(id, type, "a"));
+  ASSERT_FALSE(cache.Lookup(id, type, "c"));
+
+  // The parent is only known if it was given to the cache, in which
+  // case it completes the existing entry
+  int64_t parentId;
+  std::string parentPublicId;
+  cache.Add("d", 4, ResourceType_Instance, cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup(id, type, "d"));
+  ASSERT_FALSE(cache.LookupParent(parentId, parentPublicId, "d"));
+  cache.Add("d", 4, ResourceType_Instance, 3, "c", cache.GetGeneration());
+  ASSERT_TRUE(cache.LookupParent(parentId, parentPublicId, "d"));
+  ASSERT_EQ(3, parentId);
+  ASSERT_EQ("c", parentPublicId);
+  ASSERT_TRUE(cache.Lookup(id, type, "d"));
+  ASSERT_EQ(4, id);
+  ASSERT_EQ(ResourceType_Instance, type);
+}
+
+
+TEST(ServerIndex, PublicIdCache)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetPublicIdCacheSize(100);
+
+  StoreStatus status;
+  StoreInstanceThread(&index, 0, &status);
+  ASSERT_EQ(StoreStatus_Success, status);
+
+  std::list<std::string> instances;
+  index.GetAllUuids(instances, ResourceType_Instance);
+  ASSERT_EQ(1u, instances.size());
+
+  size_t size, maximumSize;
+  uint64_t hits, misses;
+  ResourceType type;
+
+  ASSERT_TRUE(index.LookupResourceType(type, instances.front()));
+  ASSERT_EQ(ResourceType_Instance, type);
+  index.GetPublicIdCacheStatistics(size, maximumSize, hits, misses);
+  uint64_t previousHits = hits;
+
+  ASSERT_TRUE(index.LookupResourceType(type, instances.front()));
+  ASSERT_EQ(ResourceType_Instance, type);
+  index.GetPublicIdCacheStatistics(size, maximumSize, hits, misses);
+  ASSERT_EQ(previousHits + 1, hits);
+  ASSERT_EQ(4u, size);   // The store has cached the whole hierarchy
+  ASSERT_EQ(100u, maximumSize);
+
+  // Walking up to the patient is answered by the cache
+  std::list<std::string> patients;
+  index.GetAllUuids(patients, ResourceType_Patient);
+  ASSERT_EQ(1u, patients.size());
+
+  uint64_t previousMisses = misses;
+  std::string patient;
+  ASSERT_TRUE(index.LookupParent(patient, instances.front(), ResourceType_Patient));
+  ASSERT_EQ(patients.front(), patient);
+  index.GetPublicIdCacheStatistics(size, maximumSize, hits, misses);
+  ASSERT_EQ(previousMisses, misses);
+
+  // The deletion of the instance must invalidate the cache
+  Json::Value target;
+  ASSERT_TRUE(index.DeleteResource(target, instances.front(), ResourceType_Instance));
+  ASSERT_FALSE(index.LookupResourceType(type, instances.front()));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, DicomCacheInvalidation)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+
+  std::string instanceId;
+
+  {
+    ParsedDicomFile dicom(true);
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_ID, "patient");
+    dicom.ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "study");
+    dicom.ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, "series");
+    dicom.ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, "instance");
+
+    DicomInstanceToStore toStore;
+    toStore.SetParsedDicomFile(dicom);
+    ASSERT_EQ(StoreStatus_Success, context.Store(instanceId, toStore));
+  }
+
+  {
+    ServerContext::DicomCacheLocker locker(context, instanceId);
+    ASSERT_EQ(instanceId, locker.GetDicom().GetHasher().HashInstance());
+  }
+
+  Json::Value statistics;
+  context.GetDicomCacheStatistics(statistics);
+  ASSERT_EQ("1", statistics["Count"].asString());
+
+  // Deleting the parent study must drop the parsed instance
+  std::string studyId;
+  ASSERT_TRUE(context.GetIndex().LookupParent(studyId, instanceId, ResourceType_Study));
+
+  Json::Value remaining;
+  ASSERT_TRUE(context.DeleteResource(remaining, studyId, ResourceType_Study));
+
+  context.GetDicomCacheStatistics(statistics);
+  ASSERT_EQ("0", statistics["Count"].asString());
+
+  context.Stop();
+  db.Close();
+}
+
+
 TEST(LookupIdentifierQuery, NormalizeIdentifier)
 {
   ASSERT_EQ("H^L.LO", ServerToolbox::NormalizeIdentifier("   Hé^l.LO  %_  "));
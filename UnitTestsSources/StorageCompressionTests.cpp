@@ -0,0 +1,92 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2018 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#include "../Core/OrthancException.h"
+#include "../OrthancServer/StorageCompressionAdvisor.h"
+
+using namespace Orthanc;
+
+
+TEST(StorageCompressionAdvisor, Basic)
+{
+  ASSERT_TRUE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2.4.50"));
+  ASSERT_TRUE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2.4.90"));
+  ASSERT_TRUE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2.4.100"));
+  ASSERT_TRUE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2.1.99"));
+  ASSERT_FALSE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2"));
+  ASSERT_FALSE(StorageCompressionAdvisor::IsCompressedTransferSyntax("1.2.840.10008.1.2.1"));
+  ASSERT_FALSE(StorageCompressionAdvisor::IsCompressedTransferSyntax(""));
+
+  std::string zeros(100000, '\0');
+
+  std::string noise;
+  noise.resize(100000);
+  uint32_t seed = 42;
+  for (size_t i = 0; i < noise.size(); i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    noise[i] = static_cast<char>(seed >> 24);
+  }
+
+  StorageCompressionAdvisor advisor;
+  ASSERT_TRUE(advisor.IsAdaptive());
+  ASSERT_EQ(CompressionType_None, advisor.Select("1.2.840.10008.1.2.1", CompressionType_None, zeros.c_str(), zeros.size()));
+  ASSERT_EQ(CompressionType_ZlibWithSize, advisor.Select("1.2.840.10008.1.2.1", CompressionType_ZlibWithSize, zeros.c_str(), zeros.size()));
+  ASSERT_EQ(CompressionType_None, advisor.Select("1.2.840.10008.1.2.4.50", CompressionType_ZlibWithSize, zeros.c_str(), zeros.size()));
+  ASSERT_EQ(CompressionType_None, advisor.Select("1.2.840.10008.1.2.1", CompressionType_ZlibWithSize, noise.c_str(), noise.size()));
+  ASSERT_EQ(CompressionType_None, advisor.Select("", CompressionType_ZlibWithSize, NULL, 0));
+
+  advisor.SetAdaptive(false);
+  ASSERT_EQ(CompressionType_ZlibWithSize, advisor.Select("1.2.840.10008.1.2.4.50", CompressionType_ZlibWithSize, zeros.c_str(), zeros.size()));
+  ASSERT_EQ(CompressionType_ZlibWithSize, advisor.Select("1.2.840.10008.1.2.1", CompressionType_ZlibWithSize, noise.c_str(), noise.size()));
+
+  ASSERT_THROW(advisor.SetMaximumSampleRatio(0.0f), OrthancException);
+  ASSERT_THROW(advisor.SetMaximumSampleRatio(1.5f), OrthancException);
+
+  advisor.RecordCompressed("1.2.840.10008.1.2.1", 1000, 400, 3000);
+  advisor.RecordRaw("1.2.840.10008.1.2.4.50", 500);
+  advisor.RecordRaw("", 10);
+
+  Json::Value s;
+  advisor.Format(s);
+  ASSERT_EQ(Json::objectValue, s.type());
+  ASSERT_TRUE(s.isMember("Unknown"));
+  ASSERT_EQ("1", s["1.2.840.10008.1.2.1"]["CountCompressed"].asString());
+  ASSERT_EQ("0", s["1.2.840.10008.1.2.1"]["CountRaw"].asString());
+  ASSERT_EQ("600", s["1.2.840.10008.1.2.1"]["SavedSize"].asString());
+  ASSERT_EQ("1", s["1.2.840.10008.1.2.4.50"]["CountRaw"].asString());
+  ASSERT_EQ("0", s["1.2.840.10008.1.2.4.50"]["SavedSize"].asString());
+}
@@ -43,6 +43,14 @@
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/Compression/GzipCompressor.h"
 
+#if ORTHANC_ENABLE_LZ4 == 1
+#  include "../Core/Compression/Lz4Compressor.h"
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Core/Compression/ZstdCompressor.h"
+#endif
+
 
 using namespace Orthanc;
 
@@ -178,6 +186,89 @@ TEST(Zlib, Empty)
 }
 
 
+#if ORTHANC_ENABLE_LZ4 == 1
+TEST(Lz4, Basic)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  std::string compressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+
+  std::string uncompressed;
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_EQ(s.size(), uncompressed.size());
+  ASSERT_EQ(0, memcmp(&s[0], &uncompressed[0], s.size()));
+}
+
+
+TEST(Lz4, Empty)
+{
+  std::string s = "";
+
+  std::string compressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+  ASSERT_TRUE(compressed.empty());
+
+  std::string uncompressed;
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_TRUE(uncompressed.empty());
+}
+#endif
+
+
+#if ORTHANC_ENABLE_ZSTD == 1
+TEST(Zstd, Basic)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  std::string compressed;
+  ZstdCompressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+
+  std::string uncompressed;
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_EQ(s.size(), uncompressed.size());
+  ASSERT_EQ(0, memcmp(&s[0], &uncompressed[0], s.size()));
+}
+
+
+TEST(Zstd, Corrupted)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  std::string compressed;
+  ZstdCompressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+
+  ASSERT_FALSE(compressed.empty());
+  compressed[0] = static_cast<char>(compressed[0] + 1);  // Alter the uncompressed size
+  std::string u;
+
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed), OrthancException);
+}
+
+
+TEST(Zstd, Empty)
+{
+  std::string s = "";
+
+  std::string compressed;
+  ZstdCompressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+  ASSERT_TRUE(compressed.empty());
+
+  std::string uncompressed;
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_TRUE(uncompressed.empty());
+}
+#endif
+
+
 static bool ReadAllStream(std::string& result,
                           IHttpStreamAnswer& stream,
                           bool allowGzip = false,
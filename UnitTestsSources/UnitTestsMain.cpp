@@ -37,6 +37,7 @@
 #include "gtest/gtest.h"
 
 #include <ctype.h>
+#include <sstream>
 
 #include "../Core/DicomFormat/DicomTag.h"
 #include "../Core/HttpServer/HttpToolbox.h"
@@ -333,6 +334,21 @@ TEST(Toolbox, ComputeMD5)
   ASSERT_EQ("8b1a9953c4611296a827abf8c47804d7", s);
   Toolbox::ComputeMD5(s, "");
   ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", s);
+
+  std::stringstream hello("Hello");
+  Toolbox::ComputeMD5(s, hello);
+  ASSERT_EQ("8b1a9953c4611296a827abf8c47804d7", s);
+
+  std::stringstream empty;
+  Toolbox::ComputeMD5(s, empty);
+  ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", s);
+
+  std::string large(200000, 'a');
+  std::string expected;
+  Toolbox::ComputeMD5(expected, large);
+  std::stringstream stream(large);
+  Toolbox::ComputeMD5(s, stream);
+  ASSERT_EQ(expected, s);
 }
 
 TEST(Toolbox, ComputeSHA1)
@@ -37,6 +37,9 @@
 #include "../Core/OrthancException.h"
 #include "../Core/Compression/ZipWriter.h"
 #include "../Core/Compression/HierarchicalZipWriter.h"
+#include "../Core/Compression/ZipStreamPipeline.h"
+#include "../Core/Compression/ZipStreamWriter.h"
+#include "../Core/SystemToolbox.h"
 #include "../Core/Toolbox.h"
 
 
@@ -187,3 +190,337 @@ TEST(HierarchicalZipWriter, Basic)
 
   **/
 }
+
+
+namespace
+{
+  class StringZipStream : public ZipStreamWriter::IOutputStream
+  {
+  private:
+    std::string  content_;
+    unsigned int countWrites_;
+
+  public:
+    StringZipStream() : countWrites_(0)
+    {
+    }
+
+    virtual void Write(const void* data,
+                       size_t size)
+    {
+      content_.append(reinterpret_cast<const char*>(data), size);
+      countWrites_++;
+    }
+
+    const std::string& GetContent() const
+    {
+      return content_;
+    }
+
+    unsigned int GetCountWrites() const
+    {
+      return countWrites_;
+    }
+  };
+}
+
+
+static uint64_t ReadLittleEndian(const std::string& s,
+                                 size_t offset,
+                                 unsigned int bytes)
+{
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < bytes; i++)
+  {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(s[offset + i])) << (8 * i);
+  }
+
+  return value;
+}
+
+
+TEST(ZipStreamWriter, Basic)
+{
+  static const std::string COMMENT = "Created by Orthanc";
+
+  StringZipStream stream;
+
+  {
+    ZipStreamWriter w(stream);
+    w.OpenFile("world/hello");
+    w.Write("Hello world");
+    w.SetCompressionLevel(0);
+    w.OpenFile("world/stored");
+    w.Write("Hello stored world");
+    ASSERT_EQ(0u, stream.GetCountWrites());  // Everything is buffered
+
+    w.Close();
+    ASSERT_TRUE(w.IsClosed());
+    ASSERT_THROW(w.OpenFile("closed"), OrthancException);
+  }
+
+  const std::string& zip = stream.GetContent();
+  Orthanc::SystemToolbox::WriteFile(zip, "UnitTestsResults/stream.zip");
+
+  ASSERT_EQ(0x04034b50u, ReadLittleEndian(zip, 0, 4));   // Local header
+  ASSERT_EQ(0x0008u, ReadLittleEndian(zip, 6, 2));       // Data descriptor
+  ASSERT_EQ(8u, ReadLittleEndian(zip, 8, 2));            // Deflate
+
+  // End of central directory record
+  size_t end = zip.size() - 22 - COMMENT.size();
+  ASSERT_EQ(0x06054b50u, ReadLittleEndian(zip, end, 4));
+  ASSERT_EQ(2u, ReadLittleEndian(zip, end + 10, 2));     // Number of files
+  ASSERT_EQ(COMMENT, zip.substr(end + 22));
+
+  uint64_t size = ReadLittleEndian(zip, end + 12, 4);
+  uint64_t offset = ReadLittleEndian(zip, end + 16, 4);
+  ASSERT_EQ(end, offset + size);
+
+  // The second file is stored: Its content is readable in the archive
+  ASSERT_EQ(0x02014b50u, ReadLittleEndian(zip, offset, 4));
+  ASSERT_EQ(11u, ReadLittleEndian(zip, offset + 24, 4));  // Uncompressed size
+  size_t second = offset + 46 + std::string("world/hello").size();
+  ASSERT_EQ(0u, ReadLittleEndian(zip, second + 10, 2));
+  ASSERT_EQ(18u, ReadLittleEndian(zip, second + 20, 4));   // Compressed size
+  ASSERT_EQ(18u, ReadLittleEndian(zip, second + 24, 4));   // Uncompressed size
+
+  size_t local = static_cast<size_t>(ReadLittleEndian(zip, second + 42, 4));
+  ASSERT_EQ("world/stored", zip.substr(local + 30, 12));
+  ASSERT_EQ("Hello stored world", zip.substr(local + 30 + 12, 18));
+  ASSERT_EQ(0x08074b50u, ReadLittleEndian(zip, local + 30 + 12 + 18, 4));
+  ASSERT_EQ(ReadLittleEndian(zip, second + 16, 4),       // CRC-32
+            ReadLittleEndian(zip, local + 30 + 12 + 18 + 4, 4));
+}
+
+
+TEST(ZipStreamWriter, Basic64)
+{
+  static const std::string COMMENT = "Created by Orthanc";
+
+  StringZipStream stream;
+
+  {
+    ZipStreamWriter w(stream);
+    w.SetZip64(true);
+    w.OpenFile("world/hello");
+    w.Write("Hello world");
+    ASSERT_THROW(w.SetZip64(false), OrthancException);
+    w.Close();
+  }
+
+  const std::string& zip = stream.GetContent();
+  Orthanc::SystemToolbox::WriteFile(zip, "UnitTestsResults/stream64.zip");
+
+  ASSERT_EQ(45u, ReadLittleEndian(zip, 4, 2));
+  ASSERT_EQ(20u, ReadLittleEndian(zip, 28, 2));           // ZIP64 extra field
+
+  size_t end = zip.size() - 22 - COMMENT.size();
+  ASSERT_EQ(0x06054b50u, ReadLittleEndian(zip, end, 4));
+  ASSERT_EQ(0xffffffffu, ReadLittleEndian(zip, end + 16, 4));
+
+  // ZIP64 end of central directory locator and record
+  ASSERT_EQ(0x07064b50u, ReadLittleEndian(zip, end - 20, 4));
+  uint64_t record = ReadLittleEndian(zip, end - 12, 8);
+  ASSERT_EQ(0x06064b50u, ReadLittleEndian(zip, record, 4));
+  ASSERT_EQ(1u, ReadLittleEndian(zip, record + 32, 8));   // Number of files
+
+  uint64_t size = ReadLittleEndian(zip, record + 40, 8);
+  uint64_t offset = ReadLittleEndian(zip, record + 48, 8);
+  ASSERT_EQ(record, offset + size);
+
+  // 8-byte sizes in the data descriptor
+  ASSERT_EQ(0x08074b50u, ReadLittleEndian(zip, offset - 24, 4));
+  ASSERT_EQ(11u, ReadLittleEndian(zip, offset - 8, 8));
+}
+
+
+TEST(ZipStreamWriter, Exceptions)
+{
+  StringZipStream stream;
+  ZipStreamWriter w(stream);
+  ASSERT_THROW(w.Write("hello world"), OrthancException);
+  ASSERT_THROW(w.SetCompressionLevel(10), OrthancException);
+}
+
+
+TEST(HierarchicalZipWriter, Stream)
+{
+  // Pseudo-random content that cannot be compressed
+  std::string large;
+  large.resize(1024 * 1024);
+
+  uint32_t seed = 42;
+  for (size_t i = 0; i < large.size(); i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    large[i] = static_cast<char>(seed >> 24);
+  }
+
+  StringZipStream stream;
+
+  {
+    HierarchicalZipWriter w(stream);
+    ASSERT_TRUE(w.IsStreamed());
+    ASSERT_THROW(w.SetAppendToExisting(true), OrthancException);
+
+    w.OpenDirectory("hello");
+    w.OpenFile("large");
+    w.Write(large);
+    w.OpenFile("large");
+    w.Write(large);
+    w.CloseDirectory();
+    w.Close();
+  }
+
+  // The archive is sent by blocks while it is being created
+  ASSERT_LT(1u, stream.GetCountWrites());
+  ASSERT_LT(2 * large.size(), stream.GetContent().size());
+
+  Orthanc::SystemToolbox::WriteFile(stream.GetContent(), "UnitTestsResults/stream2.zip");
+
+  /**
+     "unzip -l stream2.zip" must list "hello/large" and "hello/large-2"
+  **/
+}
+
+
+TEST(ZipStreamWriter, PreparedFile)
+{
+  std::string content = "Hello world, hello world, hello world, hello world";
+
+  ZipStreamWriter::PreparedFile deflated;
+  std::string s = content;
+  deflated.Prepare(s, 6);
+  ASSERT_TRUE(s.empty());
+  ASSERT_EQ(content.size(), deflated.GetUncompressedSize());
+  ASSERT_LT(deflated.GetCompressedSize(), content.size());
+
+  // Too short to be compressed
+  ZipStreamWriter::PreparedFile stored;
+  s = "Hello";
+  stored.Prepare(s, 6);
+  ASSERT_EQ(5u, stored.GetCompressedSize());
+
+  StringZipStream stream;
+
+  {
+    ZipStreamWriter w(stream);
+    w.SetZip64(true);
+    w.WritePreparedFile("deflated", deflated);
+    w.OpenFile("streamed");
+    w.Write(content);
+    w.WritePreparedFile("stored", stored);
+    w.Close();
+  }
+
+  const std::string& zip = stream.GetContent();
+  Orthanc::SystemToolbox::WriteFile(zip, "UnitTestsResults/prepared.zip");
+
+  // The CRC and the sizes are known in the local header
+  ASSERT_EQ(0u, ReadLittleEndian(zip, 6, 2));
+  ASSERT_NE(0u, ReadLittleEndian(zip, 14, 4));
+  ASSERT_EQ(content.size(), ReadLittleEndian(zip, 30 + 8 + 4, 8));
+  ASSERT_EQ(deflated.GetCompressedSize(), ReadLittleEndian(zip, 30 + 8 + 12, 8));
+}
+
+
+namespace
+{
+  class PipelineFile : public ZipStreamPipeline::IFile
+  {
+  private:
+    unsigned int                index_;
+    std::vector<unsigned int>&  completed_;
+
+  public:
+    PipelineFile(unsigned int index,
+                 std::vector<unsigned int>& completed) :
+      index_(index),
+      completed_(completed)
+    {
+    }
+
+    virtual void Read(std::string& content,
+                      bool& compress)
+    {
+      if (index_ == 1000)
+      {
+        throw OrthancException(ErrorCode_InexistentFile);
+      }
+
+      // Files of varying sizes, so that they are ready out of order
+      content.assign(1000 * (index_ % 7), static_cast<char>('a' + index_ % 26));
+      compress = (index_ % 3 != 0);
+    }
+
+    virtual void Complete()
+    {
+      completed_.push_back(index_);
+    }
+  };
+}
+
+
+TEST(ZipStreamPipeline, Basic)
+{
+  StringZipStream stream;
+  std::vector<unsigned int> completed;
+
+  {
+    HierarchicalZipWriter w(stream);
+
+    {
+      ZipStreamPipeline pipeline(w, 3, 2, 8);
+
+      w.OpenDirectory("dir");
+      for (unsigned int i = 0; i < 100; i++)
+      {
+        pipeline.AddFile("file", new PipelineFile(i, completed));
+      }
+
+      w.CloseDirectory();
+      pipeline.Flush();
+    }
+
+    w.Close();
+  }
+
+  ASSERT_EQ(100u, completed.size());
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(i, completed[i]);
+  }
+
+  Orthanc::SystemToolbox::WriteFile(stream.GetContent(), "UnitTestsResults/pipeline.zip");
+
+  /**
+     "unzip -l pipeline.zip" must list "dir/file" to "dir/file-100"
+  **/
+}
+
+
+TEST(ZipStreamPipeline, Failure)
+{
+  StringZipStream stream;
+  std::vector<unsigned int> completed;
+
+  HierarchicalZipWriter w(stream);
+  ZipStreamPipeline pipeline(w, 2, 2, 4);
+
+  pipeline.AddFile("ok", new PipelineFile(1, completed));
+  pipeline.AddFile("fail", new PipelineFile(1000, completed));
+  pipeline.AddFile("ok", new PipelineFile(2, completed));
+
+  try
+  {
+    pipeline.Flush();
+    ASSERT_TRUE(false);
+  }
+  catch (OrthancException& e)
+  {
+    ASSERT_EQ(ErrorCode_InexistentFile, e.GetErrorCode());
+  }
+
+  ASSERT_EQ(1u, completed.size());
+  ASSERT_THROW(ZipStreamPipeline(w, 0, 1, 1), OrthancException);
+}